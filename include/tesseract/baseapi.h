@@ -466,6 +466,20 @@ public:
    */
   void InitForAnalysePage();
 
+  /**
+   * Create a new, independent TessBaseAPI instance which is initialized
+   * with the same datapath, language(s), engine mode and parameter values
+   * as this one. Used to populate the page worker pool of ProcessPages.
+   * The loaded LSTM models are shared with this instance rather than
+   * loaded again, and the clone's networks refer to their weights. They
+   * are kept alive by shared ownership, so this instance may be destroyed
+   * before the clone. Only the first clone of a model briefly holds a copy
+   * of the weights while it initializes.
+   * Returns nullptr if this instance has not been initialized or the clone
+   * failed to initialize. The caller owns the returned instance.
+   */
+  TessBaseAPI *CloneForWorker() const;
+
   /**
    * Read a "config" file containing a set of param, value pairs.
    * Searches the standard places: tessdata/configs, tessdata/tessconfigs
@@ -732,6 +746,21 @@ public:
   bool ProcessPages(const char *filename, const char *retry_config,
                     int timeout_millisec, TessResultRenderer *renderer);
 
+  /**
+   * Same as above, but OCRs the pages of a multi-page TIFF or image list
+   * concurrently on `page_workers` engine instances (this one plus
+   * `page_workers - 1` clones, see CloneForWorker()). The results are
+   * handed to the renderer in page order, exactly as in the serial case.
+   *
+   * `page_workers` <= 1 processes the pages one after another; the
+   * `page_worker_threads` parameter provides the default used by the
+   * 4-argument ProcessPages() call. A `retry_config` also forces serial
+   * processing, as the retry temporarily rewrites the parameters.
+   */
+  bool ProcessPages(const char *filename, const char *retry_config,
+                    int timeout_millisec, TessResultRenderer *renderer,
+                    int page_workers);
+
 protected:
   // Does the real work of ProcessPages.
   bool ProcessPagesInternal(const char *filename, const char *retry_config,
@@ -1004,6 +1033,16 @@ public:
    **/
   static void ClearPersistentCache();
 
+  /**
+   * Set the maximum number of threads that all TessBaseAPI instances of this
+   * process together may use for parallel work (0 = number of hardware
+   * threads, the default). Each instance can be limited further with the
+   * thread_budget variable, e.g. set it to 1 when running one instance per
+   * core. Threads that are currently running finish their work first.
+   **/
+  static void SetProcessThreadBudget(int num_threads);
+  static int GetProcessThreadBudget();
+
   /**
    * Check whether a word is valid according to Tesseract's language model
    *
@@ -1128,6 +1167,7 @@ protected:
   std::string language_;             ///< Last initialized language.
   OcrEngineMode last_oem_requested_; ///< Last ocr language mode requested.
   bool recognition_done_;            ///< page_res_ contains recognition data.
+  int page_workers_;                 ///< ProcessPages worker count; -1: use page_worker_threads.
 
   /**
    * @defgroup ThresholderParams Thresholder Parameters
@@ -1158,6 +1198,9 @@ private:
                                  const char *filename, const char *retry_config,
                                  int timeout_millisec,
                                  TessResultRenderer *renderer);
+  // Number of engine instances ProcessPages may use for the current document.
+  // Always 1 when a `retry_config` is given.
+  int PageWorkerCount(const char *retry_config) const;
 }; // class TessBaseAPI.
 
 /** Escape a char string - replace &<>"' with HTML codes. */
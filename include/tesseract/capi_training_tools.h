@@ -36,6 +36,7 @@ TESS_API int tesseract_shape_clustering_main(int argc, const char** argv);
 TESS_API int tesseract_combine_lang_model_main(int argc, const char** argv);
 TESS_API int tesseract_combine_tessdata_main(int argc, const char** argv);
 TESS_API int tesseract_dawg2wordlist_main(int argc, const char** argv);
+TESS_API int tesseract_lstm_bench_main(int argc, const char** argv);
 TESS_API int tesseract_lstm_eval_main(int argc, const char** argv);
 TESS_API int tesseract_lstm_training_main(int argc, const char** argv);
 TESS_API int tesseract_merge_unicharsets_main(int argc, const char** argv);
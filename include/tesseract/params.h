@@ -51,6 +51,8 @@ extern STRING_VAR_H(vars_report_file);
 extern BOOL_VAR_H(report_all_variables);
 extern DOUBLE_VAR_H(allowed_image_memory_capacity);
 extern BOOL_VAR_H(two_pass);
+extern INT_VAR_H(page_worker_threads);
+extern BOOL_VAR_H(tessdata_use_mmap);
 
 } // namespace tesseract
 
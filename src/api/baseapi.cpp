@@ -45,6 +45,7 @@
 #include "polyblk.h"         // for POLY_BLOCK
 #include "rect.h"            // for TBOX
 #include "stepblob.h"        // for C_BLOB_IT, C_BLOB, C_BLOB_LIST
+#include "taskscheduler.h"   // for TaskScheduler
 #include "tessdatamanager.h" // for TessdataManager, kTrainedDataSuffix
 #include "tesseractclass.h"  // for Tesseract
 #include <tesseract/tprintf.h>         // for tprintf
@@ -69,16 +70,23 @@
 #include <tesseract/params.h>    // for Param, ..., ParamVectorSet class definitions
 #include <tesseract/assert.h>
 
+#include <algorithm> // for std::max
+#include <atomic>   // for std::atomic
 #include <cmath>    // for round, M_PI
+#include <condition_variable> // for std::condition_variable
 #include <cstdint>  // for int32_t
 #include <cstring>  // for strcmp, strcpy
+#include <deque>    // for std::deque
 #include <filesystem> // for path
 #include <fstream>  // for size_t
+#include <functional> // for std::function
 #include <iostream> // for std::cin
 #include <locale>   // for std::locale::classic
 #include <memory>   // for std::unique_ptr
+#include <mutex>    // for std::mutex
 #include <set>      // for std::pair
 #include <sstream>  // for std::stringstream
+#include <thread>   // for std::thread
 #include <vector>   // for std::vector
 #include <cfloat>
 
@@ -126,6 +134,7 @@ BOOL_VAR(verbose_process, false, "Print descriptive messages reporting which ste
 STRING_VAR(vars_report_file, "+", "Filename/path to write the 'Which -c variables were used' report. File may be 'stdout', '1' or '-' to be output to stdout. File may be 'stderr', '2' or '+' to be output to stderr. Empty means no report will be produced.");
 BOOL_VAR(report_all_variables, true, "When reporting the variables used (via 'vars_report_file') also report all *unused* variables, hence the report will always list *all* available variables.");
 DOUBLE_VAR(allowed_image_memory_capacity, ImageCostEstimate::get_max_system_allowance(), "Set maximum memory allowance for image data: this will be used as part of a sanity check for oversized input images.");
+INT_VAR(page_worker_threads, 0, "Number of engine instances used to OCR the pages of a multi-page TIFF or image list concurrently. The results are still rendered in page order. 0 or 1 processes the pages one after another.");
 BOOL_VAR(two_pass, false, "Enable double analysis: this will analyse every image twice. Once with the given page segmentation mode (typically 3), and then once with a single block page segmentation mode. The second run runs on a modified image where any earlier blocks are turned black, causing Tesseract to skip them for the second analysis. Currently two pages are output for a single image, so this is clearly a hack, but it's not as computationally intensive as running two full runs. (In fact, it might add as little as ~10% overhead, depending on the input image)   WARNING: This will probably break weird non-filepath file input patterns like \"-\" for stdin, or things that resolve using libcurl.");
 
 
@@ -254,6 +263,7 @@ TessBaseAPI::TessBaseAPI()
       pix_visible_image_(nullptr),
       last_oem_requested_(OEM_DEFAULT),
       recognition_done_(false),
+      page_workers_(-1),
       rect_left_(0),
       rect_top_(0),
       rect_width_(0),
@@ -807,6 +817,65 @@ void TessBaseAPI::InitForAnalysePage() {
   tesseract().InitAdaptiveClassifier(nullptr);
 }
 
+// Sets `target` to the value of `source`, which must be a parameter of the
+// same name and type, without a round trip through its text form.
+static void CopyParamValue(const Param &source, Param *target) {
+  switch (source.type()) {
+    case INT_PARAM:
+      static_cast<IntParam *>(target)->set_value(static_cast<const IntParam &>(source).value(),
+                                                 PARAM_VALUE_IS_SET_BY_APPLICATION);
+      break;
+    case BOOL_PARAM:
+      static_cast<BoolParam *>(target)->set_value(static_cast<const BoolParam &>(source).value(),
+                                                  PARAM_VALUE_IS_SET_BY_APPLICATION);
+      break;
+    case DOUBLE_PARAM:
+      static_cast<DoubleParam *>(target)->set_value(static_cast<const DoubleParam &>(source).value(),
+                                                    PARAM_VALUE_IS_SET_BY_APPLICATION);
+      break;
+    case STRING_PARAM:
+      static_cast<StringParam *>(target)->set_value(static_cast<const StringParam &>(source).value(),
+                                                    PARAM_VALUE_IS_SET_BY_APPLICATION);
+      break;
+    default:
+      target->set_value(source.raw_value_str().c_str());
+      break;
+  }
+}
+
+/**
+ * Create a new TessBaseAPI instance initialized like this one: same datapath,
+ * language(s) and engine mode, with all parameter values copied over.
+ */
+TessBaseAPI *TessBaseAPI::CloneForWorker() const {
+  if (tesseract_ == nullptr || language_.empty()) {
+    return nullptr;
+  }
+
+  auto *clone = new TessBaseAPI();
+  clone->output_file_ = output_file_;
+  Tesseract &clone_tess = clone->tesseract();
+  // Share the loaded (immutable) LSTM models instead of loading them again;
+  // only the per-instance state gets allocated by the clone.
+  clone_tess.set_model_source(tesseract_);
+  // Copy the parameter values one by one. The global parameters are shared
+  // by both instances anyway.
+  for (Param *param : tesseract_->params().as_list()) {
+    Param *target = ParamUtils::FindParam(param->name_str(), clone_tess.params_collective());
+    if (target != nullptr && target != param) {
+      CopyParamValue(*param, target);
+    }
+  }
+  bool ok = clone->Init_Internal(datapath_.c_str(), clone_tess.params_collective(), std::vector<std::string>(), reader_, nullptr, 0) == 0;
+  clone_tess.set_model_source(nullptr);
+  if (!ok) {
+    tprintError("Failed to initialize a worker clone of the tesseract engine.\n");
+    delete clone;
+    return nullptr;
+  }
+  return clone;
+}
+
 /**
  * Read a "config" file containing a set of parameter name, value pairs.
  * Searches the standard places: tessdata/configs, tessdata/tessconfigs
@@ -1545,6 +1614,153 @@ int TessBaseAPI::GetSourceYResolution() {
   return thresholder_->GetSourceYResolution();
 }
 
+int TessBaseAPI::PageWorkerCount(const char *retry_config) const {
+  int count = (page_workers_ >= 0) ? page_workers_ : static_cast<int>(page_worker_threads);
+  if (tesseract_ != nullptr && tesseract_->tessedit_page_number >= 0) {
+    // A single page has been requested: nothing to distribute.
+    return 1;
+  }
+  if (count > 1 && retry_config != nullptr && retry_config[0] != '\0') {
+    // A retry swaps the parameters through the shared kOldVarsFile and may
+    // change global parameters, which the other workers would see.
+    tprintWarn("A retry config cannot be used with page workers; processing the pages one by one.\n");
+    return 1;
+  }
+  return std::max(count, 1);
+}
+
+// A page image travelling from the page reader to the page workers.
+struct PendingPage {
+  Pix *pix = nullptr;
+  std::string filename;
+  int page_number = 0; // value for `applybox_page`
+  int serial = 0;      // position in the rendered output
+};
+
+// Delivers the next page of the document. Returns false when no more pages
+// are available; sets `read_error` when that is due to a failure.
+using PageReader = std::function<bool(PendingPage &page, bool &read_error)>;
+
+// OCRs the pages delivered by `next_page` on `api` plus `num_workers - 1`
+// clones of it and feeds the results to `renderer` in the order the pages
+// were read. The page reader runs on the calling thread; at most
+// 2 * num_workers decoded pages are queued ahead of the workers.
+//
+// Renderers are not thread-safe and read their data from the engine which
+// produced the page, so each worker waits for its turn before handing its
+// own engine to TessResultRenderer::AddImage and only then starts on its
+// next page. Rendering therefore stays strictly sequential and in order.
+static bool ProcessPagesOnWorkers(TessBaseAPI &api, int num_workers, const PageReader &next_page,
+                                  const char *retry_config, int timeout_millisec,
+                                  TessResultRenderer *renderer) {
+  std::vector<std::unique_ptr<TessBaseAPI>> clones;
+  for (int i = 1; i < num_workers; ++i) {
+    TessBaseAPI *clone = api.CloneForWorker();
+    if (clone == nullptr) {
+      break;
+    }
+    clones.emplace_back(clone);
+  }
+  std::vector<TessBaseAPI *> workers{&api};
+  for (auto &clone : clones) {
+    workers.push_back(clone.get());
+  }
+  tprintInfo("Processing pages on {} engine instances.\n", workers.size());
+
+  const size_t queue_capacity = 2 * workers.size();
+  std::mutex queue_mutex;
+  std::condition_variable queue_cv;
+  std::deque<PendingPage> queue;
+  bool reading_done = false;
+  std::mutex render_mutex;
+  std::condition_variable render_cv;
+  int next_to_render = 0;
+  std::atomic<bool> failed(false);
+
+  auto fail = [&]() {
+    failed = true;
+    // Take both locks so no waiter can miss the wake-up.
+    { std::lock_guard<std::mutex> lock(queue_mutex); }
+    { std::lock_guard<std::mutex> lock(render_mutex); }
+    queue_cv.notify_all();
+    render_cv.notify_all();
+  };
+
+  auto run_worker = [&](TessBaseAPI *worker) {
+    for (;;) {
+      PendingPage page;
+      {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        queue_cv.wait(lock, [&] { return !queue.empty() || reading_done || failed; });
+        if (queue.empty() || failed) {
+          return;
+        }
+        page = std::move(queue.front());
+        queue.pop_front();
+      }
+      queue_cv.notify_all();
+
+      worker->tesseract().applybox_page.set_value(page.page_number, PARAM_VALUE_IS_SET_BY_CORE_RUN);
+      bool ok = worker->ProcessPage(page.pix, page.filename.c_str(), retry_config, timeout_millisec, nullptr);
+
+      {
+        std::unique_lock<std::mutex> lock(render_mutex);
+        render_cv.wait(lock, [&] { return next_to_render == page.serial || failed; });
+        if (ok && !failed && renderer != nullptr) {
+          ok = renderer->AddImage(worker);
+        }
+        ++next_to_render;
+      }
+      pixDestroy(&page.pix);
+      if (!ok) {
+        fail();
+        return;
+      }
+      render_cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (auto *worker : workers) {
+    threads.emplace_back(run_worker, worker);
+  }
+
+  for (int serial = 0; !failed; ++serial) {
+    PendingPage page;
+    bool read_error = false;
+    if (!next_page(page, read_error)) {
+      if (read_error) {
+        fail();
+      }
+      break;
+    }
+    page.serial = serial;
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    queue_cv.wait(lock, [&] { return queue.size() < queue_capacity || failed; });
+    if (failed) {
+      pixDestroy(&page.pix);
+      break;
+    }
+    queue.push_back(std::move(page));
+    lock.unlock();
+    queue_cv.notify_all();
+  }
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    reading_done = true;
+  }
+  queue_cv.notify_all();
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  // Pages still queued after a failure have not been processed.
+  for (auto &page : queue) {
+    pixDestroy(&page.pix);
+  }
+  return !failed;
+}
+
 // If `flist` exists, get data from there. Otherwise get data from `buf`.
 // Seems convoluted, but is the easiest way I know of to meet multiple
 // goals. Support streaming from stdin, and also work on platforms
@@ -1588,6 +1804,43 @@ bool TessBaseAPI::ProcessPagesFileList(FILE *flist, std::string *buf, const char
     return false;
   }
 
+  // Each page of a list gets a second pass below, which the page workers
+  // don't do, and which leaves the engine in single block mode for the pages
+  // that follow. So the workers are only used without it.
+  const bool second_pass = two_pass || 1;
+  const int num_workers = second_pass ? 1 : PageWorkerCount(retry_config);
+  if (num_workers > 1) {
+    size_t line_index = 0;
+    int next_page_number = 0;
+    PageReader next_page = [&](PendingPage &page, bool &read_error) {
+      if (flist) {
+        if (fgets(pagename, sizeof(pagename), flist) == nullptr) {
+          return false;
+        }
+      } else {
+        if (line_index >= lines.size()) {
+          return false;
+        }
+        snprintf(pagename, sizeof(pagename), "%s", lines[line_index++].c_str());
+      }
+      chomp_string(pagename);
+      page.pix = pixRead(pagename);
+      if (page.pix == nullptr) {
+        tprintError("Image file {} cannot be read!\n", pagename);
+        read_error = true;
+        return false;
+      }
+      tprintInfo("Processing page #{} : {}\n", next_page_number + 1, pagename);
+      page.filename = pagename;
+      page.page_number = next_page_number++;
+      return true;
+    };
+    if (!ProcessPagesOnWorkers(*this, num_workers, next_page, retry_config, timeout_millisec, renderer)) {
+      return false;
+    }
+    return !renderer || renderer->EndDocument();
+  }
+
   // Loop over all pages - or just the requested one
   for (int i = 0; ; i++) {
     if (flist) {
@@ -1613,7 +1866,7 @@ bool TessBaseAPI::ProcessPagesFileList(FILE *flist, std::string *buf, const char
     tess.applybox_page.set_value(page_number, PARAM_VALUE_IS_SET_BY_CORE_RUN);
     bool r = ProcessPage(pix, pagename, retry_config, timeout_millisec, renderer);
 
-    if (two_pass || 1) {
+    if (second_pass) {
       Boxa *default_boxes = GetComponentImages(tesseract::RIL_BLOCK, true, nullptr, nullptr);
 
       // pixWrite("/tmp/out.png", pix, IFF_PNG);
@@ -1661,6 +1914,30 @@ bool TessBaseAPI::ProcessPagesMultipageTiff(const l_uint8 *data, size_t size, co
   Tesseract& tess = tesseract();
   int page_number = (tess.tessedit_page_number >= 0) ? tess.tessedit_page_number : 0;
   size_t offset = 0;
+
+  const int num_workers = PageWorkerCount(retry_config);
+  if (num_workers > 1) {
+    int pgn = 0;
+    bool more = true;
+    PageReader next_page = [&](PendingPage &page, bool &read_error) {
+      if (!more) {
+        return false;
+      }
+      page.pix = (data) ? pixReadMemFromMultipageTiff(data, size, &offset)
+                        : pixReadFromMultipageTiff(filename, &offset);
+      if (page.pix == nullptr) {
+        return false;
+      }
+      more = (offset != 0);
+      ++pgn;
+      tprintInfo("Processing page #{} of multipage TIFF {}\n", pgn, filename ? filename : "(from internal storage)");
+      page.filename = filename ? filename : "";
+      page.page_number = pgn;
+      return true;
+    };
+    return ProcessPagesOnWorkers(*this, num_workers, next_page, retry_config, timeout_millisec, renderer);
+  }
+
   for (int pgn = 1; ; ++pgn) {
     // pix = (data) ? pixReadMemTiff(data, size, page_number) : pixReadTiff(filename, page_number);
     pix = (data) ? pixReadMemFromMultipageTiff(data, size, &offset)
@@ -1708,6 +1985,15 @@ bool TessBaseAPI::ProcessPages(const char *filename, const char *retry_config, i
   return result;
 }
 
+bool TessBaseAPI::ProcessPages(const char *filename, const char *retry_config, int timeout_millisec,
+                               TessResultRenderer *renderer, int page_workers) {
+  int saved_page_workers = page_workers_;
+  page_workers_ = std::max(page_workers, 1);
+  bool result = ProcessPages(filename, retry_config, timeout_millisec, renderer);
+  page_workers_ = saved_page_workers;
+  return result;
+}
+
 #ifdef HAVE_LIBCURL
 static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp) {
   size = size * nmemb;
@@ -2834,6 +3120,14 @@ void TessBaseAPI::ClearPersistentCache() {
 #endif
 }
 
+void TessBaseAPI::SetProcessThreadBudget(int num_threads) {
+  TaskScheduler::SetProcessThreadBudget(num_threads);
+}
+
+int TessBaseAPI::GetProcessThreadBudget() {
+  return TaskScheduler::ProcessThreadBudget();
+}
+
 /**
  * Check whether a word is valid according to Tesseract's language model
  * returns 0 if the word is invalid, non-zero if valid
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////
+// File:        activations.h
+// Description: Vectorized table based non-linearity functions.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#ifndef TESSERACT_ARCH_ACTIVATIONS_H_
+#define TESSERACT_ARCH_ACTIVATIONS_H_
+
+#include "tesstypes.h"
+
+namespace tesseract {
+
+// Size of the lookup tables of the sigmoid functions (TanhTable and
+// LogisticTable in src/lstm). Must match kTableSize in functions.h.
+constexpr int kActivationTableSize = 4096;
+// Scale factor for float arg to table index. Must match kScaleFactor in
+// functions.h.
+constexpr TFloat kActivationScale = 256.0;
+
+// Applies a table based sigmoid function in-place to the n values of inout.
+// table holds the function values for non-negative arguments, sampled at
+// 1 / kActivationScale intervals. Values in between are interpolated
+// linearly, and arguments beyond the end of the table give 1.
+// Negative arguments are mirrored: if odd, f(-x) = -f(x) (tanh), otherwise
+// f(-x) = 1 - f(x) (logistic).
+// All implementations do the same arithmetic in the same order as the scalar
+// Tanh and Logistic of functions.h, so they agree with them to within the
+// rounding of a single multiply-add (about 1e-7 for float, 1e-15 for double).
+using TableActivationFunction = void (*)(const TFloat *table, bool odd, int n, TFloat *inout);
+
+// Scalar evaluation of a single value, also used for the tails of the
+// vectorized implementations.
+inline TFloat TableActivationValue(const TFloat *table, bool odd, TFloat x) {
+  TFloat a = (x < 0 ? -x : x) * kActivationScale;
+  TFloat y = 1;
+  if (a < kActivationTableSize - 1) {
+    auto index = static_cast<unsigned>(a);
+    TFloat y0 = table[index];
+    TFloat y1 = table[index + 1];
+    // Linear interpolation.
+    y = y0 + (y1 - y0) * (a - index);
+  }
+  if (x < 0) {
+    return odd ? -y : 1 - y;
+  }
+  return y;
+}
+
+// Vectorized implementations, nullptr if not available in this build.
+extern const TableActivationFunction TableActivationSSE;
+extern const TableActivationFunction TableActivationAVX2;
+extern const TableActivationFunction TableActivationAVX512F;
+extern const TableActivationFunction TableActivationNEON;
+
+} // namespace tesseract.
+
+#endif // TESSERACT_ARCH_ACTIVATIONS_H_
@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////
+// File:        activationsavx2.cpp
+// Description: Table based sigmoid functions for AVX2.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include <tesseract/preparation.h> // compiler config, etc.
+
+#include "activations.h"
+
+// General Notice:
+// 
+// This is not about whether the compiler is optimizing **the rest of your code using FMA instructions**.
+// This code should be compiled *anyway*, because tesseract will pick the best variant (this one or another one)
+// **at run-time** on the actual hardware it will be running on.
+// Hence to safely compile tesseract for multiple architectures, one should set the compiler code generation
+// options as low as possible. Meanwhile these important functions are made available, independent of that compiler
+// "optimization setting", by using the appropriate intrinsics. Then, at run-time, a CPU check is performed
+// which will help tesseract decide which actual code chunk to execute. **Irrespective of the original compiler
+// flags setting -- that one only determines the lowest capability hardware this compiled product can actually
+// run on.
+// See also the SIMDDetect::SIMDDetect() code.
+//
+#if defined(__AVX2__) || defined(_M_IX86) || defined(_M_X64)
+
+#  include <immintrin.h>
+
+namespace tesseract {
+
+// Lanes beyond the end of the table are zeroed before the conversion to an
+// index, so the gathers always stay inside the table, and replaced by 1
+// afterwards.
+#  if defined(FAST_FLOAT)
+
+static void TableActivation(const float *table, bool odd, int n, float *inout) {
+  const __m256 sign_bit = _mm256_set1_ps(-0.0f);
+  const __m256 scale = _mm256_set1_ps(kActivationScale);
+  const __m256 limit = _mm256_set1_ps(kActivationTableSize - 1);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 x = _mm256_loadu_ps(inout + i);
+    __m256 a = _mm256_mul_ps(_mm256_andnot_ps(sign_bit, x), scale);
+    __m256 in_table = _mm256_cmp_ps(a, limit, _CMP_LT_OQ);
+    a = _mm256_and_ps(a, in_table);
+    __m256i index = _mm256_cvttps_epi32(a);
+    __m256 y0 = _mm256_i32gather_ps(table, index, 4);
+    __m256 y1 = _mm256_i32gather_ps(table + 1, index, 4);
+    __m256 fraction = _mm256_sub_ps(a, _mm256_cvtepi32_ps(index));
+    __m256 y = _mm256_add_ps(y0, _mm256_mul_ps(_mm256_sub_ps(y1, y0), fraction));
+    y = _mm256_blendv_ps(one, y, in_table);
+    __m256 mirrored = odd ? _mm256_xor_ps(y, sign_bit) : _mm256_sub_ps(one, y);
+    y = _mm256_blendv_ps(y, mirrored, _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+    _mm256_storeu_ps(inout + i, y);
+  }
+  for (; i < n; ++i) {
+    inout[i] = TableActivationValue(table, odd, inout[i]);
+  }
+}
+
+#  else
+
+static void TableActivation(const double *table, bool odd, int n, double *inout) {
+  const __m256d sign_bit = _mm256_set1_pd(-0.0);
+  const __m256d scale = _mm256_set1_pd(kActivationScale);
+  const __m256d limit = _mm256_set1_pd(kActivationTableSize - 1);
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1.0);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d x = _mm256_loadu_pd(inout + i);
+    __m256d a = _mm256_mul_pd(_mm256_andnot_pd(sign_bit, x), scale);
+    __m256d in_table = _mm256_cmp_pd(a, limit, _CMP_LT_OQ);
+    a = _mm256_and_pd(a, in_table);
+    __m128i index = _mm256_cvttpd_epi32(a);
+    __m256d y0 = _mm256_i32gather_pd(table, index, 8);
+    __m256d y1 = _mm256_i32gather_pd(table + 1, index, 8);
+    __m256d fraction = _mm256_sub_pd(a, _mm256_cvtepi32_pd(index));
+    __m256d y = _mm256_add_pd(y0, _mm256_mul_pd(_mm256_sub_pd(y1, y0), fraction));
+    y = _mm256_blendv_pd(one, y, in_table);
+    __m256d mirrored = odd ? _mm256_xor_pd(y, sign_bit) : _mm256_sub_pd(one, y);
+    y = _mm256_blendv_pd(y, mirrored, _mm256_cmp_pd(x, zero, _CMP_LT_OQ));
+    _mm256_storeu_pd(inout + i, y);
+  }
+  for (; i < n; ++i) {
+    inout[i] = TableActivationValue(table, odd, inout[i]);
+  }
+}
+
+#  endif
+
+const TableActivationFunction TableActivationAVX2 = TableActivation;
+
+} // namespace tesseract.
+
+#else
+
+namespace tesseract {
+
+const TableActivationFunction TableActivationAVX2 = nullptr;
+
+} // namespace tesseract.
+
+#endif
@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////
+// File:        activationsavx512.cpp
+// Description: Table based sigmoid functions for AVX-512.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include <tesseract/preparation.h> // compiler config, etc.
+
+#include "activations.h"
+
+// General Notice:
+// 
+// This is not about whether the compiler is optimizing **the rest of your code using FMA instructions**.
+// This code should be compiled *anyway*, because tesseract will pick the best variant (this one or another one)
+// **at run-time** on the actual hardware it will be running on.
+// Hence to safely compile tesseract for multiple architectures, one should set the compiler code generation
+// options as low as possible. Meanwhile these important functions are made available, independent of that compiler
+// "optimization setting", by using the appropriate intrinsics. Then, at run-time, a CPU check is performed
+// which will help tesseract decide which actual code chunk to execute. **Irrespective of the original compiler
+// flags setting -- that one only determines the lowest capability hardware this compiled product can actually
+// run on.
+// See also the SIMDDetect::SIMDDetect() code.
+//
+#if defined(__AVX__) || defined(_M_IX86) || defined(_M_X64)
+
+#  include <immintrin.h>
+#  include <cstdint>
+
+namespace tesseract {
+
+// Lanes beyond the end of the table are zeroed before the conversion to an
+// index, so the gathers always stay inside the table, and replaced by 1
+// afterwards.
+#  if defined(FAST_FLOAT)
+
+static void TableActivation(const float *table, bool odd, int n, float *inout) {
+  const __m512i sign_bit = _mm512_set1_epi32(INT32_MIN);
+  const __m512 scale = _mm512_set1_ps(kActivationScale);
+  const __m512 limit = _mm512_set1_ps(kActivationTableSize - 1);
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512 one = _mm512_set1_ps(1.0f);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512 x = _mm512_loadu_ps(inout + i);
+    __m512 a = _mm512_mul_ps(_mm512_abs_ps(x), scale);
+    __mmask16 in_table = _mm512_cmp_ps_mask(a, limit, _CMP_LT_OQ);
+    a = _mm512_maskz_mov_ps(in_table, a);
+    __m512i index = _mm512_cvttps_epi32(a);
+    __m512 y0 = _mm512_i32gather_ps(index, table, 4);
+    __m512 y1 = _mm512_i32gather_ps(index, table + 1, 4);
+    __m512 fraction = _mm512_sub_ps(a, _mm512_cvtepi32_ps(index));
+    __m512 y = _mm512_add_ps(y0, _mm512_mul_ps(_mm512_sub_ps(y1, y0), fraction));
+    y = _mm512_mask_blend_ps(in_table, one, y);
+    // Float xor needs AVX512DQ, so flip the sign bit as an integer.
+    __m512 mirrored = odd ? _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(y), sign_bit))
+                          : _mm512_sub_ps(one, y);
+    y = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, zero, _CMP_LT_OQ), y, mirrored);
+    _mm512_storeu_ps(inout + i, y);
+  }
+  for (; i < n; ++i) {
+    inout[i] = TableActivationValue(table, odd, inout[i]);
+  }
+}
+
+#  else
+
+static void TableActivation(const double *table, bool odd, int n, double *inout) {
+  const __m512i sign_bit = _mm512_set1_epi64(INT64_MIN);
+  const __m512d scale = _mm512_set1_pd(kActivationScale);
+  const __m512d limit = _mm512_set1_pd(kActivationTableSize - 1);
+  const __m512d zero = _mm512_setzero_pd();
+  const __m512d one = _mm512_set1_pd(1.0);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512d x = _mm512_loadu_pd(inout + i);
+    __m512d a = _mm512_mul_pd(_mm512_abs_pd(x), scale);
+    __mmask8 in_table = _mm512_cmp_pd_mask(a, limit, _CMP_LT_OQ);
+    a = _mm512_maskz_mov_pd(in_table, a);
+    __m256i index = _mm512_cvttpd_epi32(a);
+    __m512d y0 = _mm512_i32gather_pd(index, table, 8);
+    __m512d y1 = _mm512_i32gather_pd(index, table + 1, 8);
+    __m512d fraction = _mm512_sub_pd(a, _mm512_cvtepi32_pd(index));
+    __m512d y = _mm512_add_pd(y0, _mm512_mul_pd(_mm512_sub_pd(y1, y0), fraction));
+    y = _mm512_mask_blend_pd(in_table, one, y);
+    // Float xor needs AVX512DQ, so flip the sign bit as an integer.
+    __m512d mirrored = odd ? _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(y), sign_bit))
+                           : _mm512_sub_pd(one, y);
+    y = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, zero, _CMP_LT_OQ), y, mirrored);
+    _mm512_storeu_pd(inout + i, y);
+  }
+  for (; i < n; ++i) {
+    inout[i] = TableActivationValue(table, odd, inout[i]);
+  }
+}
+
+#  endif
+
+const TableActivationFunction TableActivationAVX512F = TableActivation;
+
+} // namespace tesseract.
+
+#else
+
+namespace tesseract {
+
+const TableActivationFunction TableActivationAVX512F = nullptr;
+
+} // namespace tesseract.
+
+#endif
@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////
+// File:        activationsneon.cpp
+// Description: Table based sigmoid functions for ARM NEON.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include <tesseract/preparation.h> // compiler config, etc.
+
+#include "activations.h"
+
+// Double vectors are only available on AArch64.
+#if defined(HAVE_NEON) && (defined(FAST_FLOAT) || defined(__aarch64__))
+
+#include <arm_neon.h>
+#include <cstdint>
+
+namespace tesseract {
+
+// Documentation:
+// https://developer.arm.com/architectures/instruction-sets/intrinsics/
+
+// NEON has no gather instruction, so the table entries are loaded one by
+// one, while everything else is vectorized.
+// Lanes beyond the end of the table are zeroed before the conversion to an
+// index, so the loads always stay inside the table, and replaced by 1
+// afterwards.
+#if defined(FAST_FLOAT)
+
+static void TableActivation(const float *table, bool odd, int n, float *inout) {
+  const float32x4_t limit = vdupq_n_f32(kActivationTableSize - 1);
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  int32_t index[4];
+  float y0s[4];
+  float y1s[4];
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t x = vld1q_f32(inout + i);
+    float32x4_t a = vmulq_n_f32(vabsq_f32(x), kActivationScale);
+    uint32x4_t in_table = vcltq_f32(a, limit);
+    a = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), in_table));
+    int32x4_t indices = vcvtq_s32_f32(a);
+    vst1q_s32(index, indices);
+    for (int j = 0; j < 4; ++j) {
+      y0s[j] = table[index[j]];
+      y1s[j] = table[index[j] + 1];
+    }
+    float32x4_t y0 = vld1q_f32(y0s);
+    float32x4_t y1 = vld1q_f32(y1s);
+    float32x4_t fraction = vsubq_f32(a, vcvtq_f32_s32(indices));
+    float32x4_t y = vaddq_f32(y0, vmulq_f32(vsubq_f32(y1, y0), fraction));
+    y = vbslq_f32(in_table, y, one);
+    float32x4_t mirrored = odd ? vnegq_f32(y) : vsubq_f32(one, y);
+    y = vbslq_f32(vcltq_f32(x, zero), mirrored, y);
+    vst1q_f32(inout + i, y);
+  }
+  for (; i < n; ++i) {
+    inout[i] = TableActivationValue(table, odd, inout[i]);
+  }
+}
+
+#else
+
+static void TableActivation(const double *table, bool odd, int n, double *inout) {
+  const float64x2_t limit = vdupq_n_f64(kActivationTableSize - 1);
+  const float64x2_t zero = vdupq_n_f64(0.0);
+  const float64x2_t one = vdupq_n_f64(1.0);
+  int64_t index[2];
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    float64x2_t x = vld1q_f64(inout + i);
+    float64x2_t a = vmulq_n_f64(vabsq_f64(x), kActivationScale);
+    uint64x2_t in_table = vcltq_f64(a, limit);
+    a = vreinterpretq_f64_u64(vandq_u64(vreinterpretq_u64_f64(a), in_table));
+    int64x2_t indices = vcvtq_s64_f64(a);
+    vst1q_s64(index, indices);
+    double y0s[2] = {table[index[0]], table[index[1]]};
+    double y1s[2] = {table[index[0] + 1], table[index[1] + 1]};
+    float64x2_t y0 = vld1q_f64(y0s);
+    float64x2_t y1 = vld1q_f64(y1s);
+    float64x2_t fraction = vsubq_f64(a, vcvtq_f64_s64(indices));
+    float64x2_t y = vaddq_f64(y0, vmulq_f64(vsubq_f64(y1, y0), fraction));
+    y = vbslq_f64(in_table, y, one);
+    float64x2_t mirrored = odd ? vnegq_f64(y) : vsubq_f64(one, y);
+    y = vbslq_f64(vcltq_f64(x, zero), mirrored, y);
+    vst1q_f64(inout + i, y);
+  }
+  for (; i < n; ++i) {
+    inout[i] = TableActivationValue(table, odd, inout[i]);
+  }
+}
+
+#endif
+
+const TableActivationFunction TableActivationNEON = TableActivation;
+
+} // namespace tesseract
+
+#else
+
+namespace tesseract {
+
+const TableActivationFunction TableActivationNEON = nullptr;
+
+} // namespace tesseract
+
+#endif
@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////
+// File:        activationssse.cpp
+// Description: Table based sigmoid functions for SSE4.1.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include <tesseract/preparation.h> // compiler config, etc.
+
+#include "activations.h"
+
+// General Notice:
+// 
+// This is not about whether the compiler is optimizing **the rest of your code using FMA instructions**.
+// This code should be compiled *anyway*, because tesseract will pick the best variant (this one or another one)
+// **at run-time** on the actual hardware it will be running on.
+// Hence to safely compile tesseract for multiple architectures, one should set the compiler code generation
+// options as low as possible. Meanwhile these important functions are made available, independent of that compiler
+// "optimization setting", by using the appropriate intrinsics. Then, at run-time, a CPU check is performed
+// which will help tesseract decide which actual code chunk to execute. **Irrespective of the original compiler
+// flags setting -- that one only determines the lowest capability hardware this compiled product can actually
+// run on.
+// See also the SIMDDetect::SIMDDetect() code.
+//
+#if defined(__SSE4_1__) || defined(__AVX__) || defined(_M_IX86) || defined(_M_X64)
+
+#  include <emmintrin.h>
+#  include <smmintrin.h>
+#  include <cstdint>
+
+namespace tesseract {
+
+// SSE has no gather instruction, so the table entries are loaded one by one,
+// while everything else is vectorized.
+// Lanes beyond the end of the table are zeroed before the conversion to an
+// index, so the loads always stay inside the table, and replaced by 1
+// afterwards.
+#  if defined(FAST_FLOAT)
+
+static void TableActivation(const float *table, bool odd, int n, float *inout) {
+  const __m128 sign_bit = _mm_set1_ps(-0.0f);
+  const __m128 scale = _mm_set1_ps(kActivationScale);
+  const __m128 limit = _mm_set1_ps(kActivationTableSize - 1);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  alignas(16) int32_t index[4];
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 x = _mm_loadu_ps(inout + i);
+    __m128 a = _mm_mul_ps(_mm_andnot_ps(sign_bit, x), scale);
+    __m128 in_table = _mm_cmplt_ps(a, limit);
+    a = _mm_and_ps(a, in_table);
+    __m128i indices = _mm_cvttps_epi32(a);
+    _mm_store_si128(reinterpret_cast<__m128i *>(index), indices);
+    __m128 y0 = _mm_setr_ps(table[index[0]], table[index[1]], table[index[2]], table[index[3]]);
+    __m128 y1 = _mm_setr_ps(table[index[0] + 1], table[index[1] + 1], table[index[2] + 1],
+                            table[index[3] + 1]);
+    __m128 fraction = _mm_sub_ps(a, _mm_cvtepi32_ps(indices));
+    __m128 y = _mm_add_ps(y0, _mm_mul_ps(_mm_sub_ps(y1, y0), fraction));
+    y = _mm_blendv_ps(one, y, in_table);
+    __m128 mirrored = odd ? _mm_xor_ps(y, sign_bit) : _mm_sub_ps(one, y);
+    y = _mm_blendv_ps(y, mirrored, _mm_cmplt_ps(x, zero));
+    _mm_storeu_ps(inout + i, y);
+  }
+  for (; i < n; ++i) {
+    inout[i] = TableActivationValue(table, odd, inout[i]);
+  }
+}
+
+#  else
+
+static void TableActivation(const double *table, bool odd, int n, double *inout) {
+  const __m128d sign_bit = _mm_set1_pd(-0.0);
+  const __m128d scale = _mm_set1_pd(kActivationScale);
+  const __m128d limit = _mm_set1_pd(kActivationTableSize - 1);
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d one = _mm_set1_pd(1.0);
+  alignas(16) int32_t index[4];
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d x = _mm_loadu_pd(inout + i);
+    __m128d a = _mm_mul_pd(_mm_andnot_pd(sign_bit, x), scale);
+    __m128d in_table = _mm_cmplt_pd(a, limit);
+    a = _mm_and_pd(a, in_table);
+    __m128i indices = _mm_cvttpd_epi32(a);
+    _mm_store_si128(reinterpret_cast<__m128i *>(index), indices);
+    __m128d y0 = _mm_setr_pd(table[index[0]], table[index[1]]);
+    __m128d y1 = _mm_setr_pd(table[index[0] + 1], table[index[1] + 1]);
+    __m128d fraction = _mm_sub_pd(a, _mm_cvtepi32_pd(indices));
+    __m128d y = _mm_add_pd(y0, _mm_mul_pd(_mm_sub_pd(y1, y0), fraction));
+    y = _mm_blendv_pd(one, y, in_table);
+    __m128d mirrored = odd ? _mm_xor_pd(y, sign_bit) : _mm_sub_pd(one, y);
+    y = _mm_blendv_pd(y, mirrored, _mm_cmplt_pd(x, zero));
+    _mm_storeu_pd(inout + i, y);
+  }
+  for (; i < n; ++i) {
+    inout[i] = TableActivationValue(table, odd, inout[i]);
+  }
+}
+
+#  endif
+
+const TableActivationFunction TableActivationSSE = TableActivation;
+
+} // namespace tesseract.
+
+#else
+
+namespace tesseract {
+
+const TableActivationFunction TableActivationSSE = nullptr;
+
+} // namespace tesseract.
+
+#endif
@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////
+// File:        gradients.h
+// Description: Kernels for the weight gradients and updates of training.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#ifndef TESSERACT_ARCH_GRADIENTS_H_
+#define TESSERACT_ARCH_GRADIENTS_H_
+
+#include "tesstypes.h"
+
+#include <cmath> // for std::sqrt
+
+namespace tesseract {
+
+// Sets sums[r] to the dot product of the n-vectors u[r] and v, for r in
+// [0, 4). Computing four rows of an outer product sum at once loads v once
+// instead of four times.
+// All implementations sum the products of each row in the same
+// kDotProduct4Lanes interleaved partial sums, which they add up pairwise as
+// DotProduct4Generic does, followed by the products of the tail, so they give
+// identical results unless the compiler fuses some multiplies and adds.
+using DotProduct4Function = void (*)(const TFloat *const u[4], const TFloat *v, int n,
+                                     TFloat *sums);
+
+// Applies one Adam step to n weights w, given their deltas dw, the decaying
+// sums of squares of the deltas dw_sq_sum and the momentum-decaying updates:
+// dw_sq_sum = dw_sq_sum * beta + (1 - beta) * dw * dw;
+// dw *= dw_scale;
+// updates = updates * momentum + dw;
+// w += updates / (sqrt(dw_sq_sum) + epsilon).
+// All implementations do the same arithmetic in the same order as
+// AdamStepValue, so they give identical results.
+using AdamStepFunction = void (*)(int n, TFloat beta, TFloat dw_scale, TFloat momentum,
+                                  TFloat epsilon, TFloat *dw, TFloat *dw_sq_sum,
+                                  TFloat *updates, TFloat *w);
+
+// Number of partial sums per row of DotProduct4, the number of TFloat in a
+// 256 bit vector.
+constexpr int kDotProduct4Lanes = 32 / sizeof(TFloat);
+
+// Scalar Adam step of a single weight, also used for the tails of the
+// vectorized implementations.
+inline void AdamStepValue(TFloat beta, TFloat dw_scale, TFloat momentum, TFloat epsilon,
+                          TFloat &dw, TFloat &dw_sq_sum, TFloat &updates, TFloat &w) {
+  dw_sq_sum = dw_sq_sum * beta + (1 - beta) * dw * dw;
+  dw *= dw_scale;
+  updates = updates * momentum + dw;
+  w += updates / (std::sqrt(dw_sq_sum) + epsilon);
+}
+
+// Generic DotProduct4, written so that the compiler can vectorize the
+// partial sums.
+inline void DotProduct4Generic(const TFloat *const u[4], const TFloat *v, int n, TFloat *sums) {
+  TFloat total[4][kDotProduct4Lanes] = {};
+  int k = 0;
+  for (; k + kDotProduct4Lanes <= n; k += kDotProduct4Lanes) {
+    for (int r = 0; r < 4; ++r) {
+      for (int l = 0; l < kDotProduct4Lanes; ++l) {
+        total[r][l] += u[r][k + l] * v[k + l];
+      }
+    }
+  }
+  for (int r = 0; r < 4; ++r) {
+    // Adds the upper half of the partial sums to the lower half, as the
+    // horizontal sum of a vector does, until one is left.
+    for (int width = kDotProduct4Lanes / 2; width > 0; width /= 2) {
+      for (int l = 0; l < width; ++l) {
+        total[r][l] += total[r][l + width];
+      }
+    }
+    sums[r] = total[r][0];
+  }
+  for (; k < n; ++k) {
+    for (int r = 0; r < 4; ++r) {
+      sums[r] += u[r][k] * v[k];
+    }
+  }
+}
+
+// Generic AdamStep.
+inline void AdamStepGeneric(int n, TFloat beta, TFloat dw_scale, TFloat momentum, TFloat epsilon,
+                            TFloat *dw, TFloat *dw_sq_sum, TFloat *updates, TFloat *w) {
+  for (int i = 0; i < n; ++i) {
+    AdamStepValue(beta, dw_scale, momentum, epsilon, dw[i], dw_sq_sum[i], updates[i], w[i]);
+  }
+}
+
+// Vectorized implementations, nullptr if not available in this build.
+extern const DotProduct4Function DotProduct4AVX2;
+extern const AdamStepFunction AdamStepAVX2;
+extern const DotProduct4Function DotProduct4NEON;
+extern const AdamStepFunction AdamStepNEON;
+
+} // namespace tesseract.
+
+#endif // TESSERACT_ARCH_GRADIENTS_H_
@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////
+// File:        gradientsavx2.cpp
+// Description: Kernels for the weight gradients and updates for AVX2.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include <tesseract/preparation.h> // compiler config, etc.
+
+#include "gradients.h"
+
+// See the General Notice in activationsavx2.cpp: this code is compiled
+// anyway, and only run if SIMDDetect finds AVX2 at run-time.
+#if defined(__AVX2__) || defined(_M_IX86) || defined(_M_X64)
+
+#  include <immintrin.h>
+
+namespace tesseract {
+
+#  if defined(FAST_FLOAT)
+
+// Returns the sum of the 8 floats of x.
+static inline float HorizontalSum(__m256 x) {
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+
+static void DotProduct4(const float *const u[4], const float *v, int n, float *sums) {
+  __m256 sum0 = _mm256_setzero_ps();
+  __m256 sum1 = _mm256_setzero_ps();
+  __m256 sum2 = _mm256_setzero_ps();
+  __m256 sum3 = _mm256_setzero_ps();
+  int k = 0;
+  for (; k + 8 <= n; k += 8) {
+    __m256 vk = _mm256_loadu_ps(v + k);
+    sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(u[0] + k), vk));
+    sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(u[1] + k), vk));
+    sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(_mm256_loadu_ps(u[2] + k), vk));
+    sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(_mm256_loadu_ps(u[3] + k), vk));
+  }
+  sums[0] = HorizontalSum(sum0);
+  sums[1] = HorizontalSum(sum1);
+  sums[2] = HorizontalSum(sum2);
+  sums[3] = HorizontalSum(sum3);
+  for (; k < n; ++k) {
+    for (int r = 0; r < 4; ++r) {
+      sums[r] += u[r][k] * v[k];
+    }
+  }
+}
+
+static void AdamStep(int n, float beta, float dw_scale, float momentum, float epsilon, float *dw,
+                     float *dw_sq_sum, float *updates, float *w) {
+  const __m256 beta8 = _mm256_set1_ps(beta);
+  const __m256 update_factor8 = _mm256_set1_ps(1 - beta);
+  const __m256 dw_scale8 = _mm256_set1_ps(dw_scale);
+  const __m256 momentum8 = _mm256_set1_ps(momentum);
+  const __m256 epsilon8 = _mm256_set1_ps(epsilon);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 d = _mm256_loadu_ps(dw + i);
+    __m256 sq = _mm256_loadu_ps(dw_sq_sum + i);
+    sq = _mm256_add_ps(_mm256_mul_ps(sq, beta8),
+                       _mm256_mul_ps(_mm256_mul_ps(update_factor8, d), d));
+    d = _mm256_mul_ps(d, dw_scale8);
+    __m256 u = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(updates + i), momentum8), d);
+    __m256 x = _mm256_add_ps(_mm256_loadu_ps(w + i),
+                             _mm256_div_ps(u, _mm256_add_ps(_mm256_sqrt_ps(sq), epsilon8)));
+    _mm256_storeu_ps(dw + i, d);
+    _mm256_storeu_ps(dw_sq_sum + i, sq);
+    _mm256_storeu_ps(updates + i, u);
+    _mm256_storeu_ps(w + i, x);
+  }
+  for (; i < n; ++i) {
+    AdamStepValue(beta, dw_scale, momentum, epsilon, dw[i], dw_sq_sum[i], updates[i], w[i]);
+  }
+}
+
+#  else
+
+// Returns the sum of the 4 doubles of x.
+static inline double HorizontalSum(__m256d x) {
+  __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1));
+  sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+  return _mm_cvtsd_f64(sum);
+}
+
+static void DotProduct4(const double *const u[4], const double *v, int n, double *sums) {
+  __m256d sum0 = _mm256_setzero_pd();
+  __m256d sum1 = _mm256_setzero_pd();
+  __m256d sum2 = _mm256_setzero_pd();
+  __m256d sum3 = _mm256_setzero_pd();
+  int k = 0;
+  for (; k + 4 <= n; k += 4) {
+    __m256d vk = _mm256_loadu_pd(v + k);
+    sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(u[0] + k), vk));
+    sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(u[1] + k), vk));
+    sum2 = _mm256_add_pd(sum2, _mm256_mul_pd(_mm256_loadu_pd(u[2] + k), vk));
+    sum3 = _mm256_add_pd(sum3, _mm256_mul_pd(_mm256_loadu_pd(u[3] + k), vk));
+  }
+  sums[0] = HorizontalSum(sum0);
+  sums[1] = HorizontalSum(sum1);
+  sums[2] = HorizontalSum(sum2);
+  sums[3] = HorizontalSum(sum3);
+  for (; k < n; ++k) {
+    for (int r = 0; r < 4; ++r) {
+      sums[r] += u[r][k] * v[k];
+    }
+  }
+}
+
+static void AdamStep(int n, double beta, double dw_scale, double momentum, double epsilon,
+                     double *dw, double *dw_sq_sum, double *updates, double *w) {
+  const __m256d beta4 = _mm256_set1_pd(beta);
+  const __m256d update_factor4 = _mm256_set1_pd(1 - beta);
+  const __m256d dw_scale4 = _mm256_set1_pd(dw_scale);
+  const __m256d momentum4 = _mm256_set1_pd(momentum);
+  const __m256d epsilon4 = _mm256_set1_pd(epsilon);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d d = _mm256_loadu_pd(dw + i);
+    __m256d sq = _mm256_loadu_pd(dw_sq_sum + i);
+    sq = _mm256_add_pd(_mm256_mul_pd(sq, beta4),
+                       _mm256_mul_pd(_mm256_mul_pd(update_factor4, d), d));
+    d = _mm256_mul_pd(d, dw_scale4);
+    __m256d u = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(updates + i), momentum4), d);
+    __m256d x = _mm256_add_pd(_mm256_loadu_pd(w + i),
+                              _mm256_div_pd(u, _mm256_add_pd(_mm256_sqrt_pd(sq), epsilon4)));
+    _mm256_storeu_pd(dw + i, d);
+    _mm256_storeu_pd(dw_sq_sum + i, sq);
+    _mm256_storeu_pd(updates + i, u);
+    _mm256_storeu_pd(w + i, x);
+  }
+  for (; i < n; ++i) {
+    AdamStepValue(beta, dw_scale, momentum, epsilon, dw[i], dw_sq_sum[i], updates[i], w[i]);
+  }
+}
+
+#  endif
+
+const DotProduct4Function DotProduct4AVX2 = DotProduct4;
+const AdamStepFunction AdamStepAVX2 = AdamStep;
+
+} // namespace tesseract.
+
+#else
+
+namespace tesseract {
+
+const DotProduct4Function DotProduct4AVX2 = nullptr;
+const AdamStepFunction AdamStepAVX2 = nullptr;
+
+} // namespace tesseract.
+
+#endif
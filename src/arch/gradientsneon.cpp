@@ -0,0 +1,171 @@
+///////////////////////////////////////////////////////////////////////
+// File:        gradientsneon.cpp
+// Description: Kernels for the weight gradients and updates for ARM NEON.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include <tesseract/preparation.h> // compiler config, etc.
+
+#include "gradients.h"
+
+// The vector division and square root, and the double vectors, are only
+// available on AArch64.
+#if defined(HAVE_NEON) && defined(__aarch64__)
+
+#  include <arm_neon.h>
+
+namespace tesseract {
+
+// Documentation:
+// https://developer.arm.com/architectures/instruction-sets/intrinsics/
+
+// A 128 bit vector holds half of the kDotProduct4Lanes partial sums of a row,
+// so each row has a vector for the lower and one for the upper half.
+
+#  if defined(FAST_FLOAT)
+
+// Returns the sum of the 8 floats of lo and hi, added up as by
+// DotProduct4Generic.
+static inline float HorizontalSum(float32x4_t lo, float32x4_t hi) {
+  float32x4_t sum = vaddq_f32(lo, hi);
+  float32x2_t half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+  return vget_lane_f32(half, 0) + vget_lane_f32(half, 1);
+}
+
+static void DotProduct4(const float *const u[4], const float *v, int n, float *sums) {
+  float32x4_t lo[4], hi[4];
+  for (int r = 0; r < 4; ++r) {
+    lo[r] = vdupq_n_f32(0.0f);
+    hi[r] = vdupq_n_f32(0.0f);
+  }
+  int k = 0;
+  for (; k + 8 <= n; k += 8) {
+    float32x4_t v_lo = vld1q_f32(v + k);
+    float32x4_t v_hi = vld1q_f32(v + k + 4);
+    for (int r = 0; r < 4; ++r) {
+      lo[r] = vaddq_f32(lo[r], vmulq_f32(vld1q_f32(u[r] + k), v_lo));
+      hi[r] = vaddq_f32(hi[r], vmulq_f32(vld1q_f32(u[r] + k + 4), v_hi));
+    }
+  }
+  for (int r = 0; r < 4; ++r) {
+    sums[r] = HorizontalSum(lo[r], hi[r]);
+  }
+  for (; k < n; ++k) {
+    for (int r = 0; r < 4; ++r) {
+      sums[r] += u[r][k] * v[k];
+    }
+  }
+}
+
+static void AdamStep(int n, float beta, float dw_scale, float momentum, float epsilon, float *dw,
+                     float *dw_sq_sum, float *updates, float *w) {
+  const float32x4_t beta4 = vdupq_n_f32(beta);
+  const float32x4_t update_factor4 = vdupq_n_f32(1 - beta);
+  const float32x4_t dw_scale4 = vdupq_n_f32(dw_scale);
+  const float32x4_t momentum4 = vdupq_n_f32(momentum);
+  const float32x4_t epsilon4 = vdupq_n_f32(epsilon);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t d = vld1q_f32(dw + i);
+    float32x4_t sq = vld1q_f32(dw_sq_sum + i);
+    sq = vaddq_f32(vmulq_f32(sq, beta4), vmulq_f32(vmulq_f32(update_factor4, d), d));
+    d = vmulq_f32(d, dw_scale4);
+    float32x4_t u = vaddq_f32(vmulq_f32(vld1q_f32(updates + i), momentum4), d);
+    float32x4_t x =
+        vaddq_f32(vld1q_f32(w + i), vdivq_f32(u, vaddq_f32(vsqrtq_f32(sq), epsilon4)));
+    vst1q_f32(dw + i, d);
+    vst1q_f32(dw_sq_sum + i, sq);
+    vst1q_f32(updates + i, u);
+    vst1q_f32(w + i, x);
+  }
+  for (; i < n; ++i) {
+    AdamStepValue(beta, dw_scale, momentum, epsilon, dw[i], dw_sq_sum[i], updates[i], w[i]);
+  }
+}
+
+#  else
+
+// Returns the sum of the 4 doubles of lo and hi, added up as by
+// DotProduct4Generic.
+static inline double HorizontalSum(float64x2_t lo, float64x2_t hi) {
+  float64x2_t sum = vaddq_f64(lo, hi);
+  return vgetq_lane_f64(sum, 0) + vgetq_lane_f64(sum, 1);
+}
+
+static void DotProduct4(const double *const u[4], const double *v, int n, double *sums) {
+  float64x2_t lo[4], hi[4];
+  for (int r = 0; r < 4; ++r) {
+    lo[r] = vdupq_n_f64(0.0);
+    hi[r] = vdupq_n_f64(0.0);
+  }
+  int k = 0;
+  for (; k + 4 <= n; k += 4) {
+    float64x2_t v_lo = vld1q_f64(v + k);
+    float64x2_t v_hi = vld1q_f64(v + k + 2);
+    for (int r = 0; r < 4; ++r) {
+      lo[r] = vaddq_f64(lo[r], vmulq_f64(vld1q_f64(u[r] + k), v_lo));
+      hi[r] = vaddq_f64(hi[r], vmulq_f64(vld1q_f64(u[r] + k + 2), v_hi));
+    }
+  }
+  for (int r = 0; r < 4; ++r) {
+    sums[r] = HorizontalSum(lo[r], hi[r]);
+  }
+  for (; k < n; ++k) {
+    for (int r = 0; r < 4; ++r) {
+      sums[r] += u[r][k] * v[k];
+    }
+  }
+}
+
+static void AdamStep(int n, double beta, double dw_scale, double momentum, double epsilon,
+                     double *dw, double *dw_sq_sum, double *updates, double *w) {
+  const float64x2_t beta2 = vdupq_n_f64(beta);
+  const float64x2_t update_factor2 = vdupq_n_f64(1 - beta);
+  const float64x2_t dw_scale2 = vdupq_n_f64(dw_scale);
+  const float64x2_t momentum2 = vdupq_n_f64(momentum);
+  const float64x2_t epsilon2 = vdupq_n_f64(epsilon);
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    float64x2_t d = vld1q_f64(dw + i);
+    float64x2_t sq = vld1q_f64(dw_sq_sum + i);
+    sq = vaddq_f64(vmulq_f64(sq, beta2), vmulq_f64(vmulq_f64(update_factor2, d), d));
+    d = vmulq_f64(d, dw_scale2);
+    float64x2_t u = vaddq_f64(vmulq_f64(vld1q_f64(updates + i), momentum2), d);
+    float64x2_t x =
+        vaddq_f64(vld1q_f64(w + i), vdivq_f64(u, vaddq_f64(vsqrtq_f64(sq), epsilon2)));
+    vst1q_f64(dw + i, d);
+    vst1q_f64(dw_sq_sum + i, sq);
+    vst1q_f64(updates + i, u);
+    vst1q_f64(w + i, x);
+  }
+  for (; i < n; ++i) {
+    AdamStepValue(beta, dw_scale, momentum, epsilon, dw[i], dw_sq_sum[i], updates[i], w[i]);
+  }
+}
+
+#  endif
+
+const DotProduct4Function DotProduct4NEON = DotProduct4;
+const AdamStepFunction AdamStepNEON = AdamStep;
+
+} // namespace tesseract.
+
+#else
+
+namespace tesseract {
+
+const DotProduct4Function DotProduct4NEON = nullptr;
+const AdamStepFunction AdamStepNEON = nullptr;
+
+} // namespace tesseract.
+
+#endif
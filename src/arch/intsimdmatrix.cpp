@@ -118,4 +118,54 @@ void IntSimdMatrix::MatrixDotVector(const GENERIC_2D_ARRAY<int8_t> &w,
   }
 }
 
+// Computes MatrixDotVector for num_vectors vectors at once.
+void IntSimdMatrix::MatrixDotVectors(const GENERIC_2D_ARRAY<int8_t> &w,
+                                     const std::vector<TFloat> &scales, int num_vectors,
+                                     const int8_t *u, int u_stride, TFloat *v, int v_stride) {
+  int num_out = w.dim1();
+  int num_in = w.dim2() - 1;
+  // Base implementation, with the rows in chunks of four as in
+  // MatrixDotVector, each used for all the vectors.
+  int i;
+  for (i = 0; i < (num_out / 4) * 4; i += 4) {
+    const int8_t *wi0 = w[i + 0];
+    const int8_t *wi1 = w[i + 1];
+    const int8_t *wi2 = w[i + 2];
+    const int8_t *wi3 = w[i + 3];
+    for (int k = 0; k < num_vectors; ++k) {
+      const int8_t *uk = u + k * u_stride;
+      TFloat *vk = v + k * v_stride;
+      int total0 = 0;
+      int total1 = 0;
+      int total2 = 0;
+      int total3 = 0;
+      for (int j = 0; j < num_in; ++j) {
+        total0 += wi0[j] * uk[j];
+        total1 += wi1[j] * uk[j];
+        total2 += wi2[j] * uk[j];
+        total3 += wi3[j] * uk[j];
+      }
+      // Add in the bias and correct for integer values.
+      vk[i + 0] = (total0 + wi0[num_in] * INT8_MAX) * scales[i + 0];
+      vk[i + 1] = (total1 + wi1[num_in] * INT8_MAX) * scales[i + 1];
+      vk[i + 2] = (total2 + wi2[num_in] * INT8_MAX) * scales[i + 2];
+      vk[i + 3] = (total3 + wi3[num_in] * INT8_MAX) * scales[i + 3];
+    }
+  }
+
+  // Capture the remainder mod four
+  for (; i < num_out; ++i) {
+    const int8_t *wi = w[i];
+    for (int k = 0; k < num_vectors; ++k) {
+      const int8_t *uk = u + k * u_stride;
+      int total = 0;
+      for (int j = 0; j < num_in; ++j) {
+        total += wi[j] * uk[j];
+      }
+      // Add in the bias and correct for integer values.
+      v[k * v_stride + i] = (total + wi[num_in] * INT8_MAX) * scales[i];
+    }
+  }
+}
+
 } // namespace tesseract
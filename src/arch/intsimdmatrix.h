@@ -82,6 +82,12 @@ struct TESS_API IntSimdMatrix {
   // Computes the base C++ implementation.
   static void MatrixDotVector(const GENERIC_2D_ARRAY<int8_t> &w, const std::vector<TFloat> &scales,
                               const int8_t *u, TFloat *v);
+  // Computes MatrixDotVector for num_vectors vectors at once, the k-th input
+  // at u + k * u_stride with its output at v + k * v_stride. Each row of w is
+  // used for all the vectors in turn, while it is in cache.
+  static void MatrixDotVectors(const GENERIC_2D_ARRAY<int8_t> &w,
+                               const std::vector<TFloat> &scales, int num_vectors,
+                               const int8_t *u, int u_stride, TFloat *v, int v_stride);
 
   // Rounds the input up to a multiple of the given factor.
   static int Roundup(int input, int factor) {
@@ -112,6 +118,20 @@ struct TESS_API IntSimdMatrix {
   // Number of groups of inputs to be broadcast.
   // num_input_groups_ = num_inputs_per_register_ / num_inputs_per_group_
 
+  // Computes matrix.vector v = Wu for num_vectors vectors at once, as
+  // matrixDotVectorFunction does for each of them: the k-th input at
+  // u + k * u_stride, with its output at v + k * v_stride. v_stride must be at
+  // least the rounded number of outputs, as all of them are written.
+  // Loads each weight once for a block of the vectors, instead of once for
+  // each vector. Only the input after the last vector must be padded: the
+  // padding of the others is over-read from the next one, and meets zero
+  // weights.
+  using MatrixDotVectorsFunction = void (*)(int, int, const int8_t *, const TFloat *, int,
+                                            const int8_t *, int, TFloat *, int);
+  // nullptr if the implementation has none, in which case
+  // matrixDotVectorFunction is run on each vector.
+  MatrixDotVectorsFunction matrixDotVectorsFunction = nullptr;
+
   static const IntSimdMatrix *intSimdMatrix;
   // Only available with NEON.
   static const IntSimdMatrix *intSimdMatrixNEON;
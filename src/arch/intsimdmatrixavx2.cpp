@@ -37,6 +37,7 @@
 #  include <immintrin.h>
 #  include <algorithm>
 #  include <cstdint>
+#  include <cstring>
 #  include <vector>
 
 #  if defined(_MSC_VER) && _MSC_VER >= 1925 && _MSC_VER <= 1929 && \
@@ -403,6 +404,129 @@ static void matrixDotVector(int dim1, int dim2, const int8_t *wi, const TFloat *
   }
 }
 
+// Number of input vectors that matrixDotVectors multiplies by each register
+// of weights while it is loaded.
+constexpr int kNumVectorsPerBlock = 2;
+// Number of output registers of each vector that it computes at once.
+constexpr int kMaxBlockRegisters = 4;
+
+// Computes part of matrix.vector v = Wu for kNumVectors vectors at once, the
+// k-th of them at u + k * u_stride with its results at v + k * v_stride.
+// Computes the kNumRegisters output registers starting at first_register of
+// the register set of set_registers registers at w_set, which is laid out as
+// for PartialMatrixDotVector64 with N = set_registers * 8. Each register of
+// weights is loaded once for all the vectors. The results are the same as
+// those of the partial functions above.
+// u must be padded out with zeros to
+// kNumInputsPerGroup*ceil(num_in/kNumInputsPerGroup) elements, or at least
+// meet zero weights there.
+template <int kNumRegisters, int kNumVectors, class TFloat>
+static inline void PartialMatrixDotVectors(const int8_t *w_set, int set_registers,
+                                           int first_register, const TFloat *scales,
+                                           const int8_t *u, int u_stride, int num_in, TFloat *v,
+                                           int v_stride) {
+  // Register containing 16-bit ones for horizontal add with 16->32 bit
+  // conversion.
+  const __m256i ones = _mm256_set1_epi16(1);
+  __m256i results[kNumVectors][kNumRegisters];
+  for (int k = 0; k < kNumVectors; ++k) {
+    for (int r = 0; r < kNumRegisters; ++r) {
+      results[k][r] = _mm256_setzero_si256();
+    }
+  }
+  const int w_step = set_registers * kNumInputsPerRegister;
+  const int8_t *wi = w_set + first_register * kNumInputsPerRegister;
+  for (int j = 0; j < num_in; j += kNumInputsPerGroup, wi += w_step) {
+    // Replicate the next 4 inputs of each vector 8 times.
+    __m256i rep_inputs[kNumVectors];
+    for (int k = 0; k < kNumVectors; ++k) {
+      int32_t group;
+      std::memcpy(&group, u + k * u_stride + j, sizeof(group));
+      rep_inputs[k] = _mm256_set1_epi32(group);
+    }
+    for (int r = 0; r < kNumRegisters; ++r) {
+      // Load a 4x8 block of weights, with its signs normalized as in
+      // MultiplyGroup once for all the vectors.
+      __m256i weights =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(wi + r * kNumInputsPerRegister));
+      __m256i abs_weights = _mm256_sign_epi8(weights, weights);
+      for (int k = 0; k < kNumVectors; ++k) {
+        __m256i reps = _mm256_sign_epi8(rep_inputs[k], weights);
+        __m256i sums = _mm256_maddubs_epi16(abs_weights, reps);
+        sums = _mm256_madd_epi16(sums, ones);
+        results[k][r] = _mm256_add_epi32(results[k][r], sums);
+      }
+    }
+  }
+  // The biases of the register set follow its weights.
+  const int8_t *biases =
+      w_set + num_in / kNumInputsPerGroup * w_step + first_register * kNumOutputsPerRegister;
+  scales += first_register * kNumOutputsPerRegister;
+  v += first_register * kNumOutputsPerRegister;
+  for (int k = 0; k < kNumVectors; ++k) {
+    for (int r = 0; r < kNumRegisters; ++r) {
+      ExtractResults8(results[k][r], biases + r * kNumOutputsPerRegister,
+                      scales + r * kNumOutputsPerRegister, v + k * v_stride + r * kNumOutputsPerRegister);
+    }
+  }
+}
+
+// Computes the vectors of matrixDotVectors for the register set of
+// set_registers registers at w_set, kNumRegisters of them at a time. The
+// weights of each kNumRegisters stay in cache for all the vectors.
+// num_vectors must be a multiple of kNumVectorsPerBlock.
+template <int kNumRegisters, class TFloat>
+static void MatrixDotVectorsOfSet(const int8_t *w_set, int set_registers, const TFloat *scales,
+                                  int num_vectors, const int8_t *u, int u_stride, int num_in,
+                                  TFloat *v, int v_stride) {
+  for (int first = 0; first < set_registers; first += kNumRegisters) {
+    for (int k = 0; k < num_vectors; k += kNumVectorsPerBlock) {
+      PartialMatrixDotVectors<kNumRegisters, kNumVectorsPerBlock>(
+          w_set, set_registers, first, scales, u + k * u_stride, u_stride, num_in,
+          v + k * v_stride, v_stride);
+    }
+  }
+}
+
+template <class TFloat>
+static void matrixDotVectors(int dim1, int dim2, const int8_t *wi, const TFloat *scales,
+                             int num_vectors, const int8_t *u, int u_stride, TFloat *v,
+                             int v_stride) {
+  const int num_out = dim1;
+  const int num_in = dim2 - 1;
+  const int rounded_num_in = IntSimdMatrix::Roundup(num_in, kNumInputsPerGroup);
+  const int rounded_num_out = IntSimdMatrix::Roundup(num_out, kNumOutputsPerRegister);
+  // A vector left over from the blocks is faster on its own, as the single
+  // vector kernel holds more output registers at once.
+  const int num_blocked = num_vectors - num_vectors % kNumVectorsPerBlock;
+  if (num_blocked < num_vectors) {
+    const int last = num_blocked;
+    matrixDotVector(dim1, dim2, wi, scales, u + last * u_stride, v + last * v_stride);
+  }
+  if (num_blocked == 0) {
+    return;
+  }
+  int output = 0;
+  // The register sets are the same as in matrixDotVector.
+  for (int set_registers = kMaxOutputRegisters; set_registers >= 1; set_registers /= 2) {
+    const int set_size = set_registers * kNumOutputsPerRegister;
+    for (; output + set_size <= rounded_num_out; output += set_size) {
+      if (set_registers >= kMaxBlockRegisters) {
+        MatrixDotVectorsOfSet<kMaxBlockRegisters>(wi, set_registers, scales, num_blocked, u,
+                                                  u_stride, rounded_num_in, v, v_stride);
+      } else if (set_registers == 2) {
+        MatrixDotVectorsOfSet<2>(wi, set_registers, scales, num_blocked, u, u_stride,
+                                 rounded_num_in, v, v_stride);
+      } else {
+        MatrixDotVectorsOfSet<1>(wi, set_registers, scales, num_blocked, u, u_stride,
+                                 rounded_num_in, v, v_stride);
+      }
+      wi += (rounded_num_in + 1) * set_size;
+      scales += set_size;
+      v += set_size;
+    }
+  }
+}
 
 static const IntSimdMatrix simdMatrix = {
     // Function.
@@ -414,7 +538,9 @@ static const IntSimdMatrix simdMatrix = {
     // Number of 8 bit inputs in the inputs register.
     kNumInputsPerRegister,
     // Number of inputs in each weight group.
-    kNumInputsPerGroup
+    kNumInputsPerGroup,
+    // Function for several vectors at once.
+    matrixDotVectors
 };
 
 const IntSimdMatrix *IntSimdMatrix::intSimdMatrixAVX2 = &simdMatrix;
@@ -16,9 +16,21 @@
 ///////////////////////////////////////////////////////////////////////
 
 #include <tesseract/preparation.h> // compiler config, etc.
-#include <numeric> // for std::inner_product
+#include <algorithm>  // for std::max
+#include <cctype>     // for isspace
+#include <chrono>     // for std::chrono
+#include <filesystem> // for std::filesystem
+#include <fstream>    // for std::ifstream, std::ofstream
+#include <map>        // for std::map
+#include <mutex>      // for std::mutex
+#include <numeric>    // for std::inner_product
+#include <string>     // for std::string
+#include <tuple>      // for std::tuple
+#include "activations.h"
 #include "dotproduct.h"
+#include "gradients.h"
 #include "intsimdmatrix.h" // for IntSimdMatrix
+#include "matrix.h"        // for GENERIC_2D_ARRAY
 #include <tesseract/params.h>        // for STRING_VAR
 #include "simddetect.h"
 #include <tesseract/tprintf.h> // for tprintf
@@ -97,6 +109,16 @@ FZ_HEAPDBG_TRACKER_SECTION_START_MARKER(_)
 // in AVX registers.
 DotProductFunction DotProduct;
 
+// Applies a table based sigmoid function to a whole vector, see
+// activations.h. The vectorized implementations reproduce the scalar table
+// interpolation of functions.h, differing only in the rounding of the final
+// multiply-add.
+TableActivationFunction TableActivation;
+
+// Training kernels of WeightMatrix, see gradients.h.
+DotProduct4Function DotProduct4;
+AdamStepFunction AdamStep;
+
 static STRING_VAR(dotproduct, "auto", "Function used for calculation of dot product");
 
 SIMDDetect SIMDDetect::detector;
@@ -156,6 +178,43 @@ static TFloat DotProductStdInnerProduct(const TFloat *u, const TFloat *v, int n)
   return std::inner_product(u, u + n, v, static_cast<TFloat>(0));
 }
 
+// Applies a table based sigmoid function in-place to the n values of inout.
+static void TableActivationGeneric(const TFloat *table, bool odd, int n, TFloat *inout) {
+  for (int i = 0; i < n; ++i) {
+    inout[i] = TableActivationValue(table, odd, inout[i]);
+  }
+}
+
+// Returns the fastest available implementation of the sigmoid functions.
+static TableActivationFunction BestTableActivation(bool avx512F, bool avx2, bool sse, bool neon) {
+  if (avx512F && TableActivationAVX512F != nullptr) {
+    return TableActivationAVX512F;
+  }
+  if (avx2 && TableActivationAVX2 != nullptr) {
+    return TableActivationAVX2;
+  }
+  if (sse && TableActivationSSE != nullptr) {
+    return TableActivationSSE;
+  }
+  if (neon && TableActivationNEON != nullptr) {
+    return TableActivationNEON;
+  }
+  return TableActivationGeneric;
+}
+
+// Selects the fastest available training kernels, or the generic ones.
+static void SetGradientFunctions(bool avx2, bool neon) {
+  DotProduct4 = DotProduct4Generic;
+  AdamStep = AdamStepGeneric;
+  if (avx2 && DotProduct4AVX2 != nullptr) {
+    DotProduct4 = DotProduct4AVX2;
+    AdamStep = AdamStepAVX2;
+  } else if (neon && DotProduct4NEON != nullptr) {
+    DotProduct4 = DotProduct4NEON;
+    AdamStep = AdamStepNEON;
+  }
+}
+
 static void SetDotProduct(DotProductFunction f, const IntSimdMatrix *m = nullptr) {
   DotProduct = f;
   IntSimdMatrix::intSimdMatrix = m;
@@ -301,14 +360,20 @@ SIMDDetect::SIMDDetect() {
 #endif
   }
 
+  // The sigmoid functions only need the vector instructions, not a dot
+  // product implementation, so they are selected independently.
+  TableActivation = BestTableActivation(avx512F_available_, avx2_available_, sse_available_,
+                                        neon_available_);
+  SetGradientFunctions(avx2_available_, neon_available_);
+
   const char *dotproduct_env = getenv("DOTPRODUCT");
   if (dotproduct_env != nullptr) {
     // Override automatic settings by value from environment variable.
     dotproduct = dotproduct_env;
     Update();
+  } else {
+    dotproduct.set_value(dotproduct_method);
   }
-
-  dotproduct.set_value(dotproduct_method);
 }
 
 void SIMDDetect::Update() {
@@ -318,6 +383,10 @@ void SIMDDetect::Update() {
   const std::string &cfg = dotproduct;
   if (cfg == "auto") {
     // Automatic detection. Nothing to be done.
+  } else if (cfg == "autotune") {
+    // Autotune makes the choice when the first model is loaded. Until then,
+    // the automatic detection stays in effect.
+    return;
   } else if (cfg == "generic") {
     // Generic code selected by config variable.
     SetDotProduct(DotProductGeneric);
@@ -326,6 +395,15 @@ void SIMDDetect::Update() {
     // Native optimized code selected by config variable.
     SetDotProduct(DotProductNative, IntSimdMatrix::intSimdMatrix);
     dotproduct_method = "native";
+  } else if (cfg == "avx512vnni" && avx512VNNI_available_ &&
+             IntSimdMatrix::intSimdMatrixAVX512VNNI != nullptr) {
+    // AVX512VNNI selected by config variable.
+    SetDotProduct(DotProductAVX512F, IntSimdMatrix::intSimdMatrixAVX512VNNI);
+    dotproduct_method = "avx512vnni";
+  } else if (cfg == "avx512" && avx512F_available_ && IntSimdMatrix::intSimdMatrixAVX2 != nullptr) {
+    // AVX512F selected by config variable.
+    SetDotProduct(DotProductAVX512F, IntSimdMatrix::intSimdMatrixAVX2);
+    dotproduct_method = "avx512";
   } else if (cfg == "avx2" && avx2_available_ && IntSimdMatrix::intSimdMatrixAVX2 != nullptr) {
     // AVX2 selected by config variable.
     SetDotProduct(DotProductAVX1, IntSimdMatrix::intSimdMatrixAVX2);
@@ -365,12 +443,16 @@ void SIMDDetect::Update() {
     // Unsupported value of config variable.
     tprintWarn(
         "Ignoring unsupported config variable value: dotproduct={}\n"
-        "  Supported values for dotproduct: auto generic native"
+        "  Supported values for dotproduct: auto autotune generic native"
 #if defined(HAVE_FRAMEWORK_ACCELERATE)
         " accelerate"
 #endif
-        "{}{}{}{}{}{} std std::inner_product.\n",
+        "{}{}{}{}{}{}{}{} std std::inner_product.\n",
         cfg,
+        (avx512VNNI_available_ && IntSimdMatrix::intSimdMatrixAVX512VNNI != nullptr)
+            ? " avx512vnni"
+            : "",
+        (avx512F_available_ && IntSimdMatrix::intSimdMatrixAVX2 != nullptr) ? " avx512" : "",
         (avx2_available_ && IntSimdMatrix::intSimdMatrixAVX2 != nullptr) ? " avx2" : "",
         (avx_available_ && IntSimdMatrix::intSimdMatrixSSE != nullptr) ? " avx-1" : "",
         (avx_available_ && IntSimdMatrix::intSimdMatrixSSE != nullptr) ? " avx" : "",
@@ -379,7 +461,308 @@ void SIMDDetect::Update() {
         (neon_available_ && IntSimdMatrix::intSimdMatrixNEON != nullptr) ? " neon" : "");
   }
 
+  // "generic" also disables the vectorized sigmoid functions and training
+  // kernels, which gives results that are independent of the hardware.
+  if (cfg == "generic") {
+    TableActivation = TableActivationGeneric;
+    SetGradientFunctions(false, false);
+  } else {
+    TableActivation = BestTableActivation(avx512F_available_, avx2_available_, sse_available_,
+                                          neon_available_);
+    SetGradientFunctions(avx2_available_, neon_available_);
+  }
+
   dotproduct.set_value(dotproduct_method);
 }
 
+// Serializes Autotune and the checks whether it is pending.
+static std::mutex autotune_mutex;
+
+// Number of times each measurement is repeated, keeping the fastest.
+const int kAutotuneRuns = 5;
+// Number of multiply-adds done in each measurement.
+const int kAutotuneWork = 1 << 20;
+
+bool SIMDDetect::IsAutotunePending() {
+  std::lock_guard<std::mutex> lock(autotune_mutex);
+  const std::string &cfg = dotproduct;
+  return cfg == "autotune";
+}
+
+// Returns the name of the CPU, which identifies the host in the cache.
+static std::string CpuName() {
+  std::string name;
+#if defined(HAS_CPUID)
+  unsigned int regs[12] = {};
+  bool found = false;
+#  if defined(__GNUC__)
+  if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004) {
+    for (unsigned int i = 0; i < 3; ++i) {
+      __get_cpuid(0x80000002 + i, &regs[4 * i], &regs[4 * i + 1], &regs[4 * i + 2],
+                  &regs[4 * i + 3]);
+    }
+    found = true;
+  }
+#  elif defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+  int cpuInfo[4];
+  __cpuid(cpuInfo, 0x80000000);
+  if (static_cast<unsigned int>(cpuInfo[0]) >= 0x80000004) {
+    for (int i = 0; i < 3; ++i) {
+      __cpuid(reinterpret_cast<int *>(&regs[4 * i]), 0x80000002 + i);
+    }
+    found = true;
+  }
+#  endif
+  if (found) {
+    const char *brand = reinterpret_cast<const char *>(regs);
+    for (size_t i = 0; i < sizeof(regs) && brand[i] != '\0'; ++i) {
+      // Tabs and newlines separate the fields of the cache.
+      name += isspace(static_cast<unsigned char>(brand[i])) ? ' ' : brand[i];
+    }
+  }
+#endif
+  return name.empty() ? "unknown" : name;
+}
+
+// Returns the file that caches the choices of Autotune: $TESSERACT_SIMD_CACHE
+// if set, else simd-autotune.txt in a tesseract directory of the user's
+// cache directory, or an empty string if there is none.
+static std::string AutotuneCacheFile() {
+  const char *path = getenv("TESSERACT_SIMD_CACHE");
+  if (path != nullptr) {
+    return path;
+  }
+  std::string dir;
+  if ((path = getenv("XDG_CACHE_HOME")) != nullptr && *path != '\0') {
+    dir = path;
+  } else if ((path = getenv("LOCALAPPDATA")) != nullptr && *path != '\0') {
+    dir = path;
+  } else if ((path = getenv("HOME")) != nullptr && *path != '\0') {
+    dir = std::string(path) + "/.cache";
+  } else {
+    return "";
+  }
+  return dir + "/tesseract/simd-autotune.txt";
+}
+
+// A combination of implementations that the dotproduct variable can select
+// by name. The implementations are the ones that Update selects for it.
+struct SimdChoice {
+  const char *name;
+  DotProductFunction dot_product;
+  const IntSimdMatrix *matrix;
+};
+
+// Returns the seconds taken by the fastest of kAutotuneRuns runs of fn.
+template <class Func>
+static double FastestRun(Func fn) {
+  double best = 0.0;
+  for (int run = 0; run < kAutotuneRuns; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    if (run == 0 || seconds.count() < best) {
+      best = seconds.count();
+    }
+  }
+  return best;
+}
+
+// Returns the seconds that choice takes to multiply once with a matrix of
+// each of the given shapes, as often as given for it.
+static double TimeChoice(const SimdChoice &choice,
+                         const std::map<std::tuple<int, int, bool>, int> &shapes) {
+  double total = 0.0;
+  for (const auto &entry : shapes) {
+    int num_out = std::get<0>(entry.first);
+    int num_in = std::get<1>(entry.first);
+    int reps = std::max(1, kAutotuneWork / std::max(1, num_out * num_in));
+    double seconds;
+    if (std::get<2>(entry.first)) {
+      GENERIC_2D_ARRAY<int8_t> w(num_out, num_in + 1, 0);
+      for (int i = 0; i < num_out; ++i) {
+        for (int j = 0; j <= num_in; ++j) {
+          w(i, j) = static_cast<int8_t>((i * 7 + j * 13) % 255 - 127);
+        }
+      }
+      std::vector<int8_t> shaped;
+      int32_t rounded_num_out;
+      choice.matrix->Init(w, shaped, rounded_num_out);
+      std::vector<TFloat> scales(rounded_num_out, static_cast<TFloat>(1) / INT8_MAX);
+      std::vector<int8_t> u(choice.matrix->RoundInputs(num_in), 1);
+      std::vector<TFloat> v(rounded_num_out);
+      seconds = FastestRun([&]() {
+        for (int r = 0; r < reps; ++r) {
+          choice.matrix->matrixDotVectorFunction(num_out, num_in + 1, &shaped[0], &scales[0],
+                                                 &u[0], &v[0]);
+        }
+      });
+    } else {
+      std::vector<TFloat> w(num_out * (num_in + 1));
+      for (size_t i = 0; i < w.size(); ++i) {
+        w[i] = static_cast<TFloat>(i % 17) / 16;
+      }
+      std::vector<TFloat> u(num_in, static_cast<TFloat>(0.5));
+      std::vector<TFloat> v(num_out);
+      seconds = FastestRun([&]() {
+        for (int r = 0; r < reps; ++r) {
+          for (int i = 0; i < num_out; ++i) {
+            v[i] = choice.dot_product(&w[i * (num_in + 1)], &u[0], num_in);
+          }
+        }
+      });
+    }
+    total += seconds * entry.second / reps;
+  }
+  return total;
+}
+
+// Returns the counts of the distinct shapes. Identical matrices, such as the
+// gates of an LSTM, are timed once.
+static std::map<std::tuple<int, int, bool>, int> CountShapes(
+    const std::vector<MatrixShape> &shapes) {
+  std::map<std::tuple<int, int, bool>, int> shape_counts;
+  for (const auto &shape : shapes) {
+    ++shape_counts[std::make_tuple(shape.num_outputs, shape.num_inputs, shape.int_mode)];
+  }
+  return shape_counts;
+}
+
+// Returns the combinations available on this host for the given shapes.
+static std::vector<SimdChoice> AvailableChoices(const std::vector<MatrixShape> &shapes) {
+  bool int_mode = false;
+  for (const auto &shape : shapes) {
+    int_mode |= shape.int_mode;
+  }
+  std::vector<SimdChoice> choices;
+  auto add_choice = [&](const char *name, bool available, DotProductFunction dot_product,
+                        const IntSimdMatrix *matrix) {
+    if (available && (matrix != nullptr || !int_mode)) {
+      choices.push_back({name, dot_product, matrix});
+    }
+  };
+  add_choice("avx512vnni",
+             SIMDDetect::IsAVX512VNNIAvailable() && SIMDDetect::IsAVX512FAvailable(),
+             DotProductAVX512F, IntSimdMatrix::intSimdMatrixAVX512VNNI);
+  add_choice("avx512", SIMDDetect::IsAVX512FAvailable(), DotProductAVX512F,
+             IntSimdMatrix::intSimdMatrixAVX2);
+  add_choice("avx2", SIMDDetect::IsAVX2Available(), DotProductAVX1,
+             IntSimdMatrix::intSimdMatrixAVX2);
+  add_choice("avx", SIMDDetect::IsAVXAvailable() && IntSimdMatrix::intSimdMatrixSSE != nullptr,
+             DotProductAVX, IntSimdMatrix::intSimdMatrixSSE);
+  add_choice("fma", SIMDDetect::IsFMAAvailable() && IntSimdMatrix::intSimdMatrixSSE != nullptr,
+             DotProductFMA, IntSimdMatrix::intSimdMatrix);
+  add_choice("sse", SIMDDetect::IsSSEAvailable(), DotProductSSE, IntSimdMatrix::intSimdMatrixSSE);
+#if defined(HAVE_NEON) || defined(__aarch64__)
+  add_choice("neon", SIMDDetect::IsNEONAvailable(), DotProductNEON,
+             IntSimdMatrix::intSimdMatrixNEON);
+#endif
+  return choices;
+}
+
+std::vector<std::string> SIMDDetect::AutotuneChoices(const std::vector<MatrixShape> &shapes) {
+  std::vector<std::string> names;
+  for (const auto &choice : AvailableChoices(shapes)) {
+    names.emplace_back(choice.name);
+  }
+  return names;
+}
+
+std::string SIMDDetect::AutotuneCacheKey(const std::vector<MatrixShape> &shapes) {
+  std::string key = CpuName() + "|" + std::to_string(sizeof(TFloat));
+  for (const auto &entry : CountShapes(shapes)) {
+    key += "|" + std::to_string(std::get<0>(entry.first)) + "x" +
+           std::to_string(std::get<1>(entry.first)) + (std::get<2>(entry.first) ? "i" : "f") +
+           "*" + std::to_string(entry.second);
+  }
+  return key;
+}
+
+// The cache has a line per key, made of the key, a tab and the choice.
+std::string SIMDDetect::ReadAutotuneCache(const std::string &cache_file, const std::string &key) {
+  std::ifstream cache_in(cache_file);
+  std::string line;
+  while (std::getline(cache_in, line)) {
+    auto tab = line.find('\t');
+    if (tab == key.size() && line.compare(0, tab, key) == 0) {
+      return line.substr(tab + 1);
+    }
+  }
+  return "";
+}
+
+bool SIMDDetect::WriteAutotuneCache(const std::string &cache_file, const std::string &key,
+                                    const std::string &choice) {
+  std::vector<std::string> lines;
+  {
+    std::ifstream cache_in(cache_file);
+    std::string line;
+    while (std::getline(cache_in, line)) {
+      auto tab = line.find('\t');
+      // Drops the old entry for key, and anything that isn't an entry.
+      if (tab != std::string::npos && (tab != key.size() || line.compare(0, tab, key) != 0)) {
+        lines.push_back(line);
+      }
+    }
+  }
+  lines.push_back(key + '\t' + choice);
+  std::error_code error;
+  std::filesystem::create_directories(std::filesystem::path(cache_file).parent_path(), error);
+  std::ofstream cache_out(cache_file, std::ios::trunc);
+  for (const auto &line : lines) {
+    cache_out << line << '\n';
+  }
+  return static_cast<bool>(cache_out);
+}
+
+std::string SIMDDetect::AutotuneChoice(const std::vector<MatrixShape> &shapes,
+                                       const std::string &cache_file) {
+  std::vector<SimdChoice> choices = AvailableChoices(shapes);
+  if (choices.empty() || shapes.empty()) {
+    return "";
+  }
+  std::string key = AutotuneCacheKey(shapes);
+  std::string choice_name = cache_file.empty() ? "" : ReadAutotuneCache(cache_file, key);
+  for (const auto &choice : choices) {
+    if (choice_name == choice.name) {
+      tprintDebug("SIMD autotune selected {} (cached).\n", choice_name);
+      return choice_name;
+    }
+  }
+  // Nothing cached, or a choice that isn't available any more.
+  choice_name.clear();
+  auto shape_counts = CountShapes(shapes);
+  double best_seconds = 0.0;
+  for (const auto &choice : choices) {
+    double seconds = TimeChoice(choice, shape_counts);
+    tprintDebug("SIMD autotune: {} takes {} us per model timestep.\n", choice.name,
+                seconds * 1e6);
+    if (choice_name.empty() || seconds < best_seconds) {
+      choice_name = choice.name;
+      best_seconds = seconds;
+    }
+  }
+  if (!cache_file.empty()) {
+    WriteAutotuneCache(cache_file, key, choice_name);
+  }
+  tprintDebug("SIMD autotune selected {}.\n", choice_name);
+  return choice_name;
+}
+
+void SIMDDetect::Autotune(const std::vector<MatrixShape> &shapes) {
+  std::lock_guard<std::mutex> lock(autotune_mutex);
+  const std::string &cfg = dotproduct;
+  if (cfg != "autotune") {
+    return;
+  }
+  std::string choice_name = AutotuneChoice(shapes, AutotuneCacheFile());
+  if (choice_name.empty()) {
+    // Nothing to choose from, so the automatic detection stays in effect.
+    dotproduct = "auto";
+  } else {
+    dotproduct = choice_name.c_str();
+    Update();
+  }
+}
+
 } // namespace tesseract
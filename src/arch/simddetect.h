@@ -18,14 +18,38 @@
 #define TESSERACT_ARCH_SIMDDETECT_H_
 
 #include <tesseract/export.h>
+#include "activations.h"
+#include "gradients.h"
 #include "tesstypes.h"
 
+#include <string>
+#include <vector>
+
 namespace tesseract {
 
 // Function pointer for best calculation of dot product.
 using DotProductFunction = TFloat (*)(const TFloat *, const TFloat *, int);
 extern DotProductFunction DotProduct;
 
+// Function pointer for best implementation of the table based sigmoid
+// functions (Tanh, Logistic) applied to whole vectors.
+extern TESS_API TableActivationFunction TableActivation;
+
+// Function pointers for best implementation of the training kernels of
+// WeightMatrix: four dot products at once for the outer product sums, and
+// the Adam weight update.
+extern DotProduct4Function DotProduct4;
+extern AdamStepFunction AdamStep;
+
+// The shape of a weight matrix of a network, see SIMDDetect::Autotune.
+struct MatrixShape {
+  int num_outputs;
+  int num_inputs;
+  // True if the weights are 8 bit ints, which are multiplied by the
+  // IntSimdMatrix instead of by DotProduct.
+  bool int_mode;
+};
+
 // Architecture detector. Add code here to detect any other architectures for
 // SIMD-based faster dot product functions. Intended to be a single static
 // object, but it does no real harm to have more than one.
@@ -67,6 +91,38 @@ public:
   // Update settings after config variable was set.
   static TESS_API void Update();
 
+  // Returns true if the dotproduct variable is "autotune", which asks for
+  // Autotune to choose the implementations when the first model is loaded.
+  static TESS_API bool IsAutotunePending();
+  // If autotuning is pending, times the available combinations of DotProduct
+  // and IntSimdMatrix on matrices of the given shapes, selects the fastest
+  // and sets the dotproduct variable to its name. The winner is cached per
+  // CPU and set of shapes in a file (see AutotuneCacheFile in the .cpp), so
+  // it is only measured once per host.
+  // As it may change the IntSimdMatrix, it must run before any weights are
+  // shaped for it.
+  static TESS_API void Autotune(const std::vector<MatrixShape> &shapes);
+
+  // The parts of Autotune, exposed for testing.
+  // Returns the name of the fastest of the available combinations on
+  // matrices of the given shapes, taken from cache_file if it holds one for
+  // them, else measured and stored in cache_file, unless that is empty.
+  // Returns an empty string if there is nothing to choose from.
+  static TESS_API std::string AutotuneChoice(const std::vector<MatrixShape> &shapes,
+                                             const std::string &cache_file);
+  // Returns the names of the combinations available on this host for
+  // matrices of the given shapes.
+  static TESS_API std::vector<std::string> AutotuneChoices(const std::vector<MatrixShape> &shapes);
+  // Returns the key of the cache entry for this CPU and the given shapes.
+  static TESS_API std::string AutotuneCacheKey(const std::vector<MatrixShape> &shapes);
+  // Returns the choice cached for key in cache_file, or an empty string.
+  static TESS_API std::string ReadAutotuneCache(const std::string &cache_file,
+                                                const std::string &key);
+  // Stores choice for key in cache_file, replacing any earlier entry for key.
+  // Returns false in case of error.
+  static TESS_API bool WriteAutotuneCache(const std::string &cache_file, const std::string &key,
+                                          const std::string &choice);
+
 private:
   // Constructor, must set all static member variables.
   SIMDDetect();
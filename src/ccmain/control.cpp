@@ -21,6 +21,7 @@
 
 #include <parameters/parameters.h>
 
+#include <algorithm> // for std::max
 #include <cctype>
 #include <cmath>
 #include <cstdint> // for int16_t, int32_t
@@ -472,11 +473,26 @@ bool Tesseract::RecogAllWordsPassN(int pass_n, ETEXT_DESC *monitor, PAGE_RES_IT
     boxaDestroy(&boxa);
   }
 
+  // Words up to here have already been run through the LSTM network in
+  // batches by LSTMPrefetchWords.
+  unsigned int prefetched_end = 0;
   for (unsigned int w = 0; w < words->size(); ++w) {
     WordData *word = &(*words)[w];
     if (w > 0) {
       word->prev_word = &(*words)[w - 1];
     }
+    if (pass_n == 1 && w >= prefetched_end &&
+        (most_recently_used_->lstm_batch_size > 1 || most_recently_used_->lstm_parallel_lines)) {
+      // Follow the language of the previous word, as classify_word_and_language
+      // tries that first. In parallel, enough words are run for a batch on
+      // each thread.
+      unsigned num_words = std::max(1, static_cast<int>(most_recently_used_->lstm_batch_size));
+      if (most_recently_used_->lstm_parallel_lines) {
+        num_words *= most_recently_used_->scheduler().MaxConcurrency();
+      }
+      prefetched_end = w + num_words;
+      most_recently_used_->LSTMPrefetchWords(*words, w, prefetched_end);
+    }
     if (debug) {
       tprintDebug("Pass{}: chunk #{}: now going to OCR content at bbox:{}\n",
           pass_n, w + 1, word->word->word->bounding_box().print_to_str());
@@ -539,6 +555,15 @@ bool Tesseract::RecogAllWordsPassN(int pass_n, ETEXT_DESC *monitor, PAGE_RES_IT
       pr_it->MakeCurrentWordFuzzy();
     }
   }
+  if (pass_n == 1) {
+    // Drop any batched LSTM outputs that were not used.
+    for (unsigned int s = 0; s <= sub_langs_.size(); ++s) {
+      Tesseract *lang_t = s < sub_langs_.size() ? sub_langs_[s] : this;
+      if (lang_t->lstm_recognizer_ != nullptr) {
+        lang_t->lstm_recognizer_->ClearPrecomputedLines();
+      }
+    }
+  }
   return true;
 }
 
@@ -568,6 +593,33 @@ bool Tesseract::recog_all_words(PAGE_RES *page_res, ETEXT_DESC *monitor,
                                 int dopasses) {
   PAGE_RES_IT page_res_it(page_res);
 
+  // The thread budget and the scratch memory limit of this engine also
+  // apply to its sub-languages.
+  scheduler();
+  size_t scratch_limit = static_cast<size_t>(std::max(0, static_cast<int>(lstm_scratch_limit_mb)))
+                         << 20;
+  if (lstm_recognizer_ != nullptr) {
+    lstm_recognizer_->SetScratchMemoryLimit(scratch_limit);
+    lstm_recognizer_->SetInvertOptions(invert_polarity_margin, invert_concurrently);
+    lstm_recognizer_->SetBeamWidthBounds(lstm_beam_min_width, lstm_beam_max_width,
+                                         lstm_beam_confident_margin,
+                                         lstm_beam_ambiguous_margin);
+    lstm_recognizer_->SetParallelLines(lstm_parallel_lines);
+  }
+  for (auto &lang : sub_langs_) {
+    lang->scheduler_.set_max_threads(thread_budget);
+    if (lang->lstm_recognizer_ != nullptr) {
+      lang->lstm_recognizer_->SetScratchMemoryLimit(scratch_limit);
+      lang->lstm_recognizer_->SetInvertOptions(lang->invert_polarity_margin,
+                                               lang->invert_concurrently);
+      lang->lstm_recognizer_->SetBeamWidthBounds(lang->lstm_beam_min_width,
+                                                 lang->lstm_beam_max_width,
+                                                 lang->lstm_beam_confident_margin,
+                                                 lang->lstm_beam_ambiguous_margin);
+      lang->lstm_recognizer_->SetParallelLines(lang->lstm_parallel_lines);
+    }
+  }
+
   if (tessedit_minimal_rej_pass1) {
     tessedit_test_adaption.set_value(true);
     tessedit_minimal_rejection.set_value(true);
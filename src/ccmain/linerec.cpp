@@ -69,7 +69,10 @@ bool Tesseract::TrainLineRecognizer(const char *input_imagename, const std::stri
     return false;
   }
   images.Shuffle();
-  if (!images.SaveDocument(lstmf_name.c_str(), nullptr)) {
+  bool saved = lstmf_indexed
+                   ? images.SaveIndexedDocument(lstmf_name.c_str(), lstmf_compressed, nullptr)
+                   : images.SaveDocument(lstmf_name.c_str(), nullptr);
+  if (!saved) {
     tprintError("Failed to write training data to {}!\n", lstmf_name);
     return false;
   }
@@ -232,26 +235,72 @@ ImageData *Tesseract::GetRectImage(const TBOX &box, const BLOCK &block, int padd
   return new ImageData(vertical_text, box_pix);
 }
 
-// Recognizes a word or group of words, converting to WERD_RES in *words.
-// Analogous to classify_word_pass1, but can handle a group of words as well.
-void Tesseract::LSTMRecognizeWord(const BLOCK &block, ROW *row, WERD_RES *word,
-                                  PointerVector<WERD_RES> *words) {
-  TBOX word_box = word->word->bounding_box();
+// Returns the image that LSTMRecognizeWord feeds to the network for the given
+// word, with the box it covers in *word_box, or nullptr on failure.
+ImageData *Tesseract::GetLSTMWordImage(const BLOCK &block, ROW *row, WERD_RES *word,
+                                       TBOX *word_box) const {
+  *word_box = word->word->bounding_box();
   // Get the word image - no frills.
   if (tessedit_pageseg_mode == PSM_SINGLE_WORD || tessedit_pageseg_mode == PSM_RAW_LINE) {
     // In single word mode, use the whole image without any other row/word
     // interpretation.
-    word_box = TBOX(0, 0, ImageWidth(), ImageHeight());
+    *word_box = TBOX(0, 0, ImageWidth(), ImageHeight());
   } else {
-    float baseline = row->base_line((word_box.left() + word_box.right()) / 2);
-    if (baseline + row->descenders() < word_box.bottom()) {
-      word_box.set_bottom(baseline + row->descenders());
+    float baseline = row->base_line((word_box->left() + word_box->right()) / 2);
+    if (baseline + row->descenders() < word_box->bottom()) {
+      word_box->set_bottom(baseline + row->descenders());
     }
-    if (baseline + row->x_height() + row->ascenders() > word_box.top()) {
-      word_box.set_top(baseline + row->x_height() + row->ascenders());
+    if (baseline + row->x_height() + row->ascenders() > word_box->top()) {
+      word_box->set_top(baseline + row->x_height() + row->ascenders());
     }
   }
-  ImageData *im_data = GetRectImage(word_box, block, kImagePadding, &word_box);
+  return GetRectImage(*word_box, block, kImagePadding, word_box);
+}
+
+// Runs the LSTM network over words [start, end) in batched forward passes,
+// so that the LSTMRecognizeWord calls that follow for those words only have
+// to decode the outputs. Only words that classify_word_pass1 would give to
+// the LSTM are included.
+void Tesseract::LSTMPrefetchWords(const std::vector<WordData> &words, unsigned start,
+                                  unsigned end) {
+  if (lstm_recognizer_ == nullptr || (lstm_batch_size < 2 && !lstm_parallel_lines)) {
+    return;
+  }
+#if DISABLED_LEGACY_ENGINE
+  if (tessedit_ocr_engine_mode != OEM_LSTM_ONLY) {
+#else
+  if (tessedit_ocr_engine_mode != OEM_LSTM_ONLY &&
+      tessedit_ocr_engine_mode != OEM_TESSERACT_LSTM_COMBINED) {
+#endif // DISABLED_LEGACY_ENGINE
+    return;
+  }
+  std::vector<const ImageData *> images;
+  std::vector<TBOX> word_boxes;
+  for (unsigned w = start; w < end && w < words.size(); ++w) {
+    const WordData &word_data = words[w];
+    if (word_data.word->odd_size && tessedit_ocr_engine_mode != OEM_LSTM_ONLY) {
+      continue;
+    }
+    TBOX word_box;
+    ImageData *im_data = GetLSTMWordImage(*word_data.block, word_data.row, word_data.word, &word_box);
+    if (im_data != nullptr) {
+      images.push_back(im_data);
+      word_boxes.push_back(word_box);
+    }
+  }
+  lstm_recognizer_->SetDebug(classify_debug_level > 0 ? tess_debug_lstm : 0);
+  lstm_recognizer_->ForwardLines(images, word_boxes, invert_threshold, lstm_batch_size);
+  for (auto im_data : images) {
+    delete im_data;
+  }
+}
+
+// Recognizes a word or group of words, converting to WERD_RES in *words.
+// Analogous to classify_word_pass1, but can handle a group of words as well.
+void Tesseract::LSTMRecognizeWord(const BLOCK &block, ROW *row, WERD_RES *word,
+                                  PointerVector<WERD_RES> *words) {
+  TBOX word_box;
+  ImageData *im_data = GetLSTMWordImage(block, row, word, &word_box);
   if (im_data == nullptr) {
     return;
   }
@@ -430,6 +430,7 @@ ChoiceIterator::ChoiceIterator(const LTRResultIterator &result_it) {
   blanks_before_word_ = result_it.BlanksBeforeWord();
   BLOB_CHOICE_LIST *choices = nullptr;
   tstep_index_ = &result_it.blob_index_;
+  word_res_->EnsureLSTMChoices();
   if (oemLSTM_ && !word_res_->CTC_symbol_choices.empty()) {
     if (!word_res_->CTC_symbol_choices[0].empty() &&
         strcmp(word_res_->CTC_symbol_choices[0][0].first, " ")) {
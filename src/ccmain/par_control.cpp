@@ -21,10 +21,6 @@
 #include "tesseractclass.h"
 #include "blobs.h"
 
-#ifdef _OPENMP
-#  include <omp.h>
-#endif // _OPENMP
-
 namespace tesseract {
 
 struct BlobData {
@@ -58,15 +54,12 @@ void Tesseract::PrerecAllWordsPar(const std::vector<WordData> &words) {
   }
   // Pre-classify all the blobs.
   if (tessedit_parallelize > 1) {
-#  ifdef _OPENMP
-#    pragma omp parallel for num_threads(10)
-#  endif // _OPENMP
-    // NOLINTNEXTLINE(modernize-loop-convert)
-    // Error C3016: index variable in OpenMP 'for' statement must have signed integral type
-    for (size_t b = 0; b < blobs.size(); ++b) {
-      *blobs[b].choices =
-          blobs[b].tesseract->classify_blob(blobs[b].blob, "par", Diagnostics::WHITE, nullptr);
-    }
+    scheduler().ParallelFor(blobs.size(), [&blobs](int, int start, int end) {
+      for (int b = start; b < end; ++b) {
+        *blobs[b].choices =
+            blobs[b].tesseract->classify_blob(blobs[b].blob, "par", Diagnostics::WHITE, nullptr);
+      }
+    });
   } else {
     // TODO(AMD) parallelize this.
     for (auto &blob : blobs) {
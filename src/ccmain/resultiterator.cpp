@@ -686,6 +686,7 @@ char *ResultIterator::GetUTF8Text(PageIteratorLevel level) const {
 std::vector<std::vector<std::vector<std::pair<const char *, float>>>>
     *ResultIterator::GetRawLSTMTimesteps() const {
   if (it_->word() != nullptr) {
+    it_->word()->EnsureLSTMChoices();
     return &it_->word()->segmented_timesteps;
   } else {
     return nullptr;
@@ -695,6 +696,7 @@ std::vector<std::vector<std::vector<std::pair<const char *, float>>>>
 std::vector<std::vector<std::pair<const char *, float>>> *ResultIterator::GetBestLSTMSymbolChoices()
     const {
   if (it_->word() != nullptr) {
+    it_->word()->EnsureLSTMChoices();
     return &it_->word()->CTC_symbol_choices;
   } else {
     return nullptr;
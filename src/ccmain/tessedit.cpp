@@ -209,13 +209,22 @@ bool Tesseract::init_tesseract_lang_data(const std::string &arg0,
 #endif // DISABLED_LEGACY_ENGINE
     if (mgr->IsComponentAvailable(TESSDATA_LSTM)) {
       lstm_recognizer_ = new LSTMRecognizer(this);
+      lstm_recognizer_->SetScheduler(&scheduler_);
 
       ResyncVariablesInternally();
       // lstm_recognizer_->SetDataPathPrefix(language_data_path_prefix);
       // lstm_recognizer_->CopyDebugParameters(this, &getDict());
       // lstm_recognizer_->SetDebug(tess_debug_lstm);
 
-      ASSERT_HOST(lstm_recognizer_->Load(this->params_collective(), lstm_use_matrix ? language : "", mgr));
+      LSTMRecognizer *shared = FindSharedLSTMRecognizer(lang_);
+      if (shared != nullptr && lstm_recognizer_->ShareModelFrom(*shared)) {
+        // Only the (per-instance) dictionary remains to be loaded.
+        if (lstm_use_matrix) {
+          lstm_recognizer_->LoadDictionary(this->params_collective(), language, mgr);
+        }
+      } else {
+        ASSERT_HOST(lstm_recognizer_->Load(this->params_collective(), lstm_use_matrix ? language : "", mgr));
+      }
       // TODO: ConvertToInt optional extra
     } else {
       tprintError("LSTM requested, but not present!! Loading tesseract.\n");
@@ -522,7 +531,12 @@ int Tesseract::init_tesseract_internal(const std::string &arg0, const std::strin
   // If only LSTM will be used, skip loading Tesseract classifier's
   // pre-trained templates and dictionary.
   bool init_tesseract = (tessedit_ocr_engine_mode != OEM_LSTM_ONLY);
-  program_editup(textbase, init_tesseract ? mgr : nullptr, init_tesseract ? mgr : nullptr);
+  // Only when the traineddata is memory mapped, holding on to it costs
+  // nothing, so the classifier templates are then only parsed once something
+  // gets classified by the legacy engine, which may be never in combined
+  // mode. Otherwise they are loaded right away, as before.
+  program_editup(textbase, init_tesseract ? mgr : nullptr, init_tesseract ? mgr : nullptr,
+                 mgr->is_mapped());
   return 0; // Normal exit
 }
 
@@ -553,19 +567,28 @@ void Tesseract::SetupUniversalFontIds() {
   // delete callback.
   UnicityTable<FontInfo> all_fonts;
 
-  // Create the universal ID table.
-  CollectFonts(get_fontinfo_table(), &all_fonts);
+  // Create the universal ID table. The tables are used as they are: the
+  // fonts of deferred templates get their ids once those are loaded.
+  CollectFonts(fontinfo_table_, &all_fonts);
   for (auto &sub_lang : sub_langs_) {
-    CollectFonts(sub_lang->get_fontinfo_table(), &all_fonts);
+    CollectFonts(sub_lang->fontinfo_table_, &all_fonts);
   }
   // Assign ids from the table to each font table.
-  AssignIds(all_fonts, &get_fontinfo_table());
+  AssignIds(all_fonts, &fontinfo_table_);
   for (auto &sub_lang : sub_langs_) {
-    AssignIds(all_fonts, &sub_lang->get_fontinfo_table());
+    AssignIds(all_fonts, &sub_lang->fontinfo_table_);
   }
   font_table_size_ = all_fonts.size();
 }
 
+void Tesseract::DeferredTemplatesLoaded() {
+  Tesseract *root = this;
+  while (root->parent_instance_ != nullptr) {
+    root = root->parent_instance_;
+  }
+  root->SetupUniversalFontIds();
+}
+
 #endif // !DISABLED_LEGACY_ENGINE
 
 void Tesseract::end_tesseract() {
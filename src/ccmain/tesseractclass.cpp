@@ -50,6 +50,7 @@ namespace tesseract {
 
 Tesseract::Tesseract(Tesseract *parent)
     : parent_instance_(parent)
+    , model_source_(nullptr)
     , BOOL_MEMBER(tessedit_resegment_from_boxes, false,
                   "Take segmentation and labeling from box file", params())
     , BOOL_MEMBER(tessedit_resegment_from_line_boxes, false,
@@ -72,6 +73,17 @@ Tesseract::Tesseract(Tesseract *parent)
     , DOUBLE_MEMBER(invert_threshold, 0.7,
                     "For lines with a mean confidence below this value, OCR is also tried with an inverted image.",
                     params())
+    , DOUBLE_MEMBER(invert_polarity_margin, 0.0,
+                    "Lines whose share of light pixels differs from 1/2 by at least this margin are "
+                    "taken to be dark on light (or light on dark) text, and tried that way first; "
+                    "the other way is only tried if the result is below invert_threshold. "
+                    "0 (or 0.5 or more) always tries the line as it is first.",
+                    params())
+    , BOOL_MEMBER(invert_concurrently, false,
+                  "Try lines whose polarity is unclear (see invert_polarity_margin) as they are "
+                  "and inverted at the same time, on two threads, instead of inverted only after "
+                  "a poor result. Lowers the latency of such lines at the cost of more work.",
+                  params())
     ,
     // The default for pageseg_mode is the old behaviour, so as not to
     // upset anything that relies on that.
@@ -153,6 +165,12 @@ Tesseract::Tesseract(Tesseract *parent)
     , INT_MEMBER(bidi_debug, 0, "Debug level for BiDi.", params())
     , INT_MEMBER(applybox_debug, 1, "Debug level for apply boxes.", params())
     , INT_MEMBER(applybox_page, 0, "Page number to apply boxes from.", params())
+    , BOOL_MEMBER(lstmf_indexed, false,
+                  "Write lstmf training files with an index, so that training "
+                  "can read any line without reading the lines before it.",
+                  params())
+    , BOOL_MEMBER(lstmf_compressed, false,
+                  "Compress the lines of indexed lstmf training files.", params())
     , STRING_MEMBER(applybox_exposure_pattern, ".exp",
                     "Exposure value follows "
                     "this pattern in the image filename. The name of the image "
@@ -427,7 +445,12 @@ Tesseract::Tesseract(Tesseract *parent)
                     params())
     , DOUBLE_MEMBER(textord_tabfind_aligned_gap_fraction, 0.75,
                     "Fraction of height used as a minimum gap for aligned blobs.", params())
-    , INT_MEMBER(tessedit_parallelize, 0, "Run in parallel where possible.", params()),
+    , INT_MEMBER(tessedit_parallelize, 0, "Run in parallel where possible.", params())
+    , INT_MEMBER(thread_budget, 0,
+                 "Maximum number of threads this engine may use at the same time, "
+                 "including the calling thread. 0 means as many as the process "
+                 "thread budget allows.",
+                 params()),
       BOOL_MEMBER(preserve_interword_spaces, false, "When `true`: preserve multiple inter-word spaces as-is, or when `false`: compress multiple inter-word spaces to a single space character.",
                   params())
     , STRING_MEMBER(page_separator, "\f", "Page separator (default is form feed control character)",
@@ -447,6 +470,41 @@ Tesseract::Tesseract(Tesseract *parent)
                  "lstm_choice_mode. Note that lstm_choice_mode must be set to a "
                  "value greater than 0 to produce results.",
                  params())
+    , INT_MEMBER(lstm_batch_size, 16,
+                 "Maximum number of words or lines that the LSTM recognizer "
+                 "packs into a single batched forward pass. Values below 2 "
+                 "run the network once per word.",
+                 params())
+    , BOOL_MEMBER(lstm_parallel_lines, false,
+                  "Run the LSTM network on the lines of a page in parallel, on up to "
+                  "thread_budget threads, each with its own copy of the network. The "
+                  "lines are still decoded one after another, in reading order.",
+                  params())
+    , INT_MEMBER(lstm_scratch_limit_mb, 256,
+                 "Memory in MB that the LSTM recognizer may keep in reusable "
+                 "buffers from one line to the next. This is a soft cap, "
+                 "checked after each line. 0 means no limit.",
+                 params())
+    , INT_MEMBER(lstm_beam_min_width, 5,
+                 "Beam width of the LSTM beam search at timesteps where the "
+                 "network output is (almost) one-hot. 0 selects the fixed "
+                 "default width of 5.",
+                 params())
+    , INT_MEMBER(lstm_beam_max_width, 5,
+                 "Beam width of the LSTM beam search at timesteps where the "
+                 "best two network outputs are close. Timesteps in between get "
+                 "a width in between. This is also the number of best outputs "
+                 "considered at every timestep. 0 selects the fixed default "
+                 "width of 5.",
+                 params())
+    , DOUBLE_MEMBER(lstm_beam_confident_margin, 0.9,
+                    "Margin between the two best LSTM outputs of a timestep at "
+                    "or above which it gets lstm_beam_min_width.",
+                    params())
+    , DOUBLE_MEMBER(lstm_beam_ambiguous_margin, 0.3,
+                    "Margin between the two best LSTM outputs of a timestep at "
+                    "or below which it gets lstm_beam_max_width.",
+                    params())
     , DOUBLE_MEMBER(lstm_rating_coefficient, 5,
                     "Sets the rating coefficient for the lstm choices. The smaller the "
                     "coefficient, the better are the ratings for each choice and less "
@@ -955,6 +1013,28 @@ bool Tesseract::AnyLSTMLang() const {
   return false;
 }
 
+// Returns the LSTM recognizer of the model source for the given language.
+LSTMRecognizer *Tesseract::FindSharedLSTMRecognizer(const std::string &lang) const {
+  // Sub-languages are initialized by the primary language instance.
+  const Tesseract *root = this;
+  while (root->parent_instance_ != nullptr) {
+    root = root->parent_instance_;
+  }
+  const Tesseract *source = root->model_source_;
+  if (source == nullptr) {
+    return nullptr;
+  }
+  if (source->lang_ == lang) {
+    return source->lstm_recognizer_;
+  }
+  for (auto &lang_ref : source->sub_langs_) {
+    if (lang_ref->lang_ == lang) {
+      return lang_ref->lstm_recognizer_;
+    }
+  }
+  return nullptr;
+}
+
 // debug PDF output helper methods:
 void Tesseract::AddPixDebugPage(const Image &pix, const char *title) {
   if (pix == nullptr)
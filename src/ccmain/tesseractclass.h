@@ -38,6 +38,7 @@
 #include <tesseract/params.h>          // for BOOL_VAR_H, BoolParam, DoubleParam
 #include "points.h"          // for FCOORD
 #include "ratngs.h"          // for ScriptPos, WERD_CHOICE (ptr only)
+#include "taskscheduler.h"   // for TaskScheduler
 #include "tessdatamanager.h" // for TessdataManager
 #include "textord.h"         // for Textord
 #include "wordrec.h"         // for Wordrec
@@ -336,6 +337,13 @@ public:
   }
   Tesseract *get_sub_lang(int index) const;
 
+  // Returns the scheduler for the parallel work of this engine, with its
+  // thread budget updated from thread_budget.
+  const TaskScheduler &scheduler() {
+    scheduler_.set_max_threads(thread_budget);
+    return scheduler_;
+  }
+
   // Returns true if any language uses Tesseract (as opposed to LSTM).
   bool AnyTessLang() const;
   // Returns true if any language uses the LSTM.
@@ -394,6 +402,15 @@ public:
   // is also returned to enable calculation of output bounding boxes.
   ImageData *GetRectImage(const TBOX &box, const BLOCK &block, int padding,
                           TBOX *revised_box) const;
+  // Returns the image that LSTMRecognizeWord feeds to the network for the
+  // given word, with the box it covers in *word_box, or nullptr on failure.
+  ImageData *GetLSTMWordImage(const BLOCK &block, ROW *row, WERD_RES *word,
+                              TBOX *word_box) const;
+  // Runs the LSTM network over words [start, end) in batched forward passes,
+  // (see lstm_batch_size) so that the LSTMRecognizeWord calls that follow for
+  // those words only have to decode the outputs.
+  void LSTMPrefetchWords(const std::vector<WordData> &words, unsigned start,
+                         unsigned end);
   // Recognizes a word or group of words, converting to WERD_RES in *words.
   // Analogous to classify_word_pass1, but can handle a group of words as well.
   void LSTMRecognizeWord(const BLOCK &block, ROW *row, WERD_RES *word,
@@ -876,6 +893,8 @@ public:
   BOOL_VAR_H(tessedit_train_line_recognizer);
   BOOL_VAR_H(tessedit_dump_pageseg_images);
   DOUBLE_VAR_H(invert_threshold);
+  DOUBLE_VAR_H(invert_polarity_margin);
+  BOOL_VAR_H(invert_concurrently);
   INT_VAR_H(tessedit_pageseg_mode);
   INT_VAR_H(preprocess_graynorm_mode);
   INT_VAR_H(thresholding_method);
@@ -897,6 +916,8 @@ public:
   INT_VAR_H(bidi_debug);
   INT_VAR_H(applybox_debug);
   INT_VAR_H(applybox_page);
+  BOOL_VAR_H(lstmf_indexed);
+  BOOL_VAR_H(lstmf_compressed);
   STRING_VAR_H(applybox_exposure_pattern);
   BOOL_VAR_H(applybox_learn_chars_and_char_frags_mode);
   BOOL_VAR_H(applybox_learn_ngrams_mode);
@@ -1085,10 +1106,18 @@ public:
   DOUBLE_VAR_H(textord_tabfind_vertical_text_ratio);
   DOUBLE_VAR_H(textord_tabfind_aligned_gap_fraction);
   INT_VAR_H(tessedit_parallelize);
+  INT_VAR_H(thread_budget);
   BOOL_VAR_H(preserve_interword_spaces);
   STRING_VAR_H(page_separator);
   INT_VAR_H(lstm_choice_mode);
   INT_VAR_H(lstm_choice_iterations);
+  INT_VAR_H(lstm_batch_size);
+  BOOL_VAR_H(lstm_parallel_lines);
+  INT_VAR_H(lstm_scratch_limit_mb);
+  INT_VAR_H(lstm_beam_min_width);
+  INT_VAR_H(lstm_beam_max_width);
+  DOUBLE_VAR_H(lstm_beam_confident_margin);
+  DOUBLE_VAR_H(lstm_beam_ambiguous_margin);
   DOUBLE_VAR_H(lstm_rating_coefficient);
   BOOL_VAR_H(pageseg_apply_music_mask);
   DOUBLE_VAR_H(max_page_gradient_recognize);
@@ -1184,8 +1213,27 @@ public:
     return parent_instance_;
   }
 
+  // Sets the instance whose loaded models are shared instead of loaded anew
+  // by the next init_tesseract() call, for every language that both
+  // instances load. Only needed during initialization; pass nullptr after.
+  void set_model_source(Tesseract *source) {
+    model_source_ = source;
+  }
+
+protected:
+  // Returns the LSTM recognizer of the model source (see set_model_source)
+  // for the given language, or nullptr if there is none.
+  LSTMRecognizer *FindSharedLSTMRecognizer(const std::string &lang) const;
+
+#if !DISABLED_LEGACY_ENGINE
+  // The fonts of a language become known once its classifier templates have
+  // been loaded, so the universal font ids have to be set up again.
+  void DeferredTemplatesLoaded() override;
+#endif
+
 protected:
   Tesseract* parent_instance_;      // reference to parent tesseract instance for sub-languages. Used, f.e., to allow using a single DebugPixa diagnostic channel for all languages tested on the input.
+  Tesseract* model_source_;         // instance to share loaded models with during init; see set_model_source().
 
 private:
   // The filename of a backup config file. If not null, then we currently
@@ -1246,6 +1294,8 @@ private:
 #endif // !DISABLED_LEGACY_ENGINE
   // LSTM recognizer, if available.
   LSTMRecognizer *lstm_recognizer_;
+  // Runs the parallel loops of this engine and its LSTM recognizer.
+  TaskScheduler scheduler_;
   // Output "page" number (actually line number) using TrainLineRecognizer.
   int train_line_page_num_;
   /// internal use to help the (re)initialization process after a previous run.
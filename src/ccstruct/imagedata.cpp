@@ -26,14 +26,22 @@
 #include "scrollview.h" // for ScrollView, Diagnostics::CYAN, Diagnostics::NONE
 #include <tesseract/tprintf.h>    // for tprintf
 
-#include "helpers.h"  // for IntCastRounded, TRand, ClipToRange, Modulo
-#include "serialis.h" // for TFile
+#include "helpers.h"    // for IntCastRounded, TRand, ClipToRange, Modulo
+#include "mappedfile.h" // for MappedFile
+#include "serialis.h"   // for TFile
 
 #include <leptonica/allheaders.h> // for pixDestroy, pixGetHeight, pixGetWidth, lept_...
 
-#include <algorithm>    // for max, min
-#include <cinttypes>    // for PRId64
-#include <fstream>      // for std::ifstream
+#include <algorithm>          // for max, min
+#include <chrono>             // for std::chrono::steady_clock
+#include <cinttypes>          // for PRId64
+#include <condition_variable> // for std::condition_variable
+#include <cstring>            // for memcmp, memcpy
+#include <deque>              // for std::deque
+#include <fstream>            // for std::ifstream
+#include <list>               // for std::list
+#include <map>                // for std::map
+#include <set>                // for std::set
 
 #undef min
 #undef max
@@ -43,6 +51,147 @@ namespace tesseract {
 // Number of documents to read ahead while training. Doesn't need to be very
 // large.
 const int kMaxReadAhead = 8;
+// Number of consecutive pages of a document that a prefetch thread reads at
+// once, as it has to read through a plain document file to get to them.
+const int kPrefetchChunkPages = 32;
+
+// An indexed document file starts with kIndexedDocumentMagic, followed by the
+// format version and the number of pages as uint32_t, a PageIndexEntry for
+// each page, and the pages, each a serialized ImageData that may be
+// compressed with zlib. A plain document file starts with its number of
+// pages instead, which can't be mistaken for the magic.
+const char kIndexedDocumentMagic[8] = {'l', 's', 't', 'm', 'f', 'i', 'd', 'x'};
+const uint32_t kIndexedDocumentVersion = 1;
+const size_t kIndexedDocumentHeaderSize = sizeof(kIndexedDocumentMagic) + 2 * sizeof(uint32_t);
+
+// Where to find a page of an indexed document file.
+struct PageIndexEntry {
+  // Offset of the page from the start of the file.
+  uint64_t offset;
+  // Stored size of the page, 0 for a null page.
+  uint32_t size;
+  // Size of the page before compression, 0 if it isn't compressed.
+  uint32_t uncompressed_size;
+};
+const size_t kPageIndexEntrySize = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+// The contents of a document file, memory mapped if possible, so that the
+// pages of an indexed document can be read in any order without reading the
+// rest of it.
+class DocumentFile {
+public:
+  // Maps the file, or reads it with reader if that isn't the default reader
+  // or mapping fails. Returns false on error.
+  bool Open(const std::string &name, FileReader reader) {
+    name_ = name;
+    std::shared_ptr<const MappedFile> mapped;
+    if (reader == nullptr || reader == static_cast<FileReader>(LoadDataFromFile)) {
+      mapped = MappedFile::Open(name.c_str());
+    }
+    if (mapped != nullptr) {
+      data_ = mapped->data();
+      size_ = mapped->size();
+      owner_ = mapped;
+    } else {
+      auto bytes = std::make_shared<std::vector<char>>();
+      if (!(reader == nullptr ? LoadDataFromFile(name.c_str(), bytes.get())
+                              : (*reader)(name.c_str(), bytes.get()))) {
+        return false;
+      }
+      data_ = bytes->data();
+      size_ = bytes->size();
+      owner_ = bytes;
+    }
+    indexed_ = size_ >= kIndexedDocumentHeaderSize &&
+               memcmp(data_, kIndexedDocumentMagic, sizeof(kIndexedDocumentMagic)) == 0;
+    if (!indexed_) {
+      return true;
+    }
+    uint32_t version;
+    memcpy(&version, data_ + sizeof(kIndexedDocumentMagic), sizeof(version));
+    memcpy(&num_pages_, data_ + sizeof(kIndexedDocumentMagic) + sizeof(version),
+           sizeof(num_pages_));
+    if (version != kIndexedDocumentVersion) {
+      tprintError("Unsupported version {} of indexed document {}\n", version, name);
+      return false;
+    }
+    if (num_pages_ > INT32_MAX ||
+        (size_ - kIndexedDocumentHeaderSize) / kPageIndexEntrySize < num_pages_) {
+      tprintError("Truncated index of document {}\n", name);
+      return false;
+    }
+    return true;
+  }
+
+  // True if the file is an indexed document.
+  bool is_indexed() const {
+    return indexed_;
+  }
+  // Number of pages of an indexed document.
+  int num_pages() const {
+    return num_pages_;
+  }
+
+  // Opens fp on the whole file, to read a plain document from it.
+  void OpenView(TFile *fp) const {
+    fp->OpenView(data_, size_, owner_);
+  }
+
+  // Reads the page with the given index of an indexed document into *page,
+  // which is nullptr for a null page. Returns false on error.
+  bool ReadPage(int index, std::unique_ptr<ImageData> *page) const {
+    const char *index_entry = data_ + kIndexedDocumentHeaderSize + index * kPageIndexEntrySize;
+    PageIndexEntry entry;
+    memcpy(&entry.offset, index_entry, sizeof(entry.offset));
+    memcpy(&entry.size, index_entry + sizeof(entry.offset), sizeof(entry.size));
+    memcpy(&entry.uncompressed_size, index_entry + sizeof(entry.offset) + sizeof(entry.size),
+           sizeof(entry.uncompressed_size));
+    page->reset();
+    if (entry.size == 0) {
+      return true; // Null page.
+    }
+    if (entry.offset > size_ || entry.size > size_ - entry.offset) {
+      tprintError("Page {} of document {} is out of bounds\n", index, name_);
+      return false;
+    }
+    const char *bytes = data_ + entry.offset;
+    TFile fp;
+    if (entry.uncompressed_size == 0) {
+      fp.OpenView(bytes, entry.size);
+    } else {
+      size_t size = 0;
+      l_uint8 *uncompressed =
+          zlibUncompress(reinterpret_cast<const l_uint8 *>(bytes), entry.size, &size);
+      if (uncompressed == nullptr || size != entry.uncompressed_size) {
+        lept_free(uncompressed);
+        tprintError("Failed to uncompress page {} of document {}\n", index, name_);
+        return false;
+      }
+      fp.Open(reinterpret_cast<const char *>(uncompressed), size);
+      lept_free(uncompressed);
+    }
+    auto image_data = std::make_unique<ImageData>();
+    if (!image_data->DeSerialize(&fp)) {
+      tprintError("Deserialize failed: page {} of document {}\n", index, name_);
+      return false;
+    }
+    if (image_data->imagefilename().empty()) {
+      image_data->set_imagefilename(name_);
+      image_data->set_page_number(index);
+    }
+    *page = std::move(image_data);
+    return true;
+  }
+
+private:
+  std::string name_;
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  // Keeps data_ alive.
+  std::shared_ptr<const void> owner_;
+  bool indexed_ = false;
+  uint32_t num_pages_ = 0;
+};
 
 ImageData::ImageData() : page_number_(-1), vertical_text_(false) {}
 // Takes ownership of the pix and destroys it.
@@ -428,6 +577,56 @@ bool DocumentData::SaveDocument(const char *filename, FileWriter writer) {
   return true;
 }
 
+// Writes all the pages to the given filename as an indexed document, whose
+// pages can be read in any order. If compress, pages that zlib makes smaller
+// are stored compressed. Returns false on error.
+bool DocumentData::SaveIndexedDocument(const char *filename, bool compress, FileWriter writer) {
+  std::lock_guard<std::mutex> lock(pages_mutex_);
+  // The pages are serialized first, as the index needs their sizes.
+  std::vector<std::vector<char>> records(pages_.size());
+  std::vector<uint32_t> uncompressed_sizes(pages_.size(), 0);
+  for (size_t i = 0; i < pages_.size(); ++i) {
+    if (pages_[i] == nullptr) {
+      continue;
+    }
+    TFile fp;
+    fp.OpenWrite(&records[i]);
+    if (!pages_[i]->Serialize(&fp) || records[i].size() > UINT32_MAX) {
+      tprintError("Serialize failed: {}\n", filename);
+      return false;
+    }
+    if (compress) {
+      size_t size = 0;
+      l_uint8 *compressed =
+          zlibCompress(reinterpret_cast<const l_uint8 *>(records[i].data()), records[i].size(), &size);
+      if (compressed != nullptr && size < records[i].size()) {
+        uncompressed_sizes[i] = records[i].size();
+        records[i].assign(compressed, compressed + size);
+      }
+      lept_free(compressed);
+    }
+  }
+  TFile fp;
+  fp.OpenWrite(nullptr);
+  uint32_t num_pages = records.size();
+  uint64_t offset = kIndexedDocumentHeaderSize + num_pages * kPageIndexEntrySize;
+  bool ok = fp.Serialize(kIndexedDocumentMagic, sizeof(kIndexedDocumentMagic)) &&
+            fp.Serialize(&kIndexedDocumentVersion) && fp.Serialize(&num_pages);
+  for (size_t i = 0; ok && i < records.size(); ++i) {
+    uint32_t size = records[i].size();
+    ok = fp.Serialize(&offset) && fp.Serialize(&size) && fp.Serialize(&uncompressed_sizes[i]);
+    offset += size;
+  }
+  for (size_t i = 0; ok && i < records.size(); ++i) {
+    ok = records[i].empty() || fp.Serialize(records[i].data(), records[i].size());
+  }
+  if (!ok || !fp.CloseWrite(filename, writer)) {
+    tprintError("Serialize failed: {}\n", filename);
+    return false;
+  }
+  return true;
+}
+
 // Adds the given page data to this document, counting up memory.
 void DocumentData::AddPageToDocument(ImageData *page) {
   std::lock_guard<std::mutex> lock(pages_mutex_);
@@ -540,6 +739,98 @@ void DocumentData::Shuffle() {
   }
 }
 
+// Reads up to count pages of the document file, starting at first modulo the
+// number of pages, to *pages, without caching them in *this.
+bool DocumentData::ReadPages(int first, int count, std::vector<std::unique_ptr<ImageData>> *pages,
+                             int *total_pages) const {
+  std::string name;
+  FileReader reader;
+  {
+    std::lock_guard<std::mutex> lock(general_mutex_);
+    name = document_name_;
+    reader = reader_;
+  }
+  pages->clear();
+#if !defined(TESSERACT_IMAGEDATA_AS_PIX)
+  if (name.ends_with(".png")) {
+    // PNG image given instead of LSTMF file.
+    std::string gt_name = name.substr(0, name.length() - 3) + "gt.txt";
+    std::ifstream t(gt_name);
+    std::string line;
+    std::getline(t, line);
+    std::unique_ptr<ImageData> image_data(
+        ImageData::Build(name.c_str(), 0, "", nullptr, 0, line.c_str(), nullptr));
+    image_data->SetPix(pixRead(name.c_str()));
+    pages->push_back(std::move(image_data));
+    *total_pages = 1;
+    return true;
+  }
+#endif
+  DocumentFile file;
+  TFile fp;
+  int num_pages = 0;
+  if (file.Open(name, reader)) {
+    if (file.is_indexed()) {
+      num_pages = file.num_pages();
+    } else {
+      file.OpenView(&fp);
+      if (!fp.DeSerializeSize(&num_pages)) {
+        num_pages = 0;
+      }
+    }
+  }
+  if (num_pages <= 0) {
+    tprintError("Deserialize header failed: {}\n", name);
+    return false;
+  }
+  *total_pages = num_pages;
+  first = Modulo(first, num_pages);
+  int end = std::min(first + count, num_pages);
+  if (file.is_indexed()) {
+    // Only the wanted pages are read.
+    for (int page = first; page < end; ++page) {
+      std::unique_ptr<ImageData> image_data;
+      if (!file.ReadPage(page, &image_data)) {
+        pages->clear();
+        return false;
+      }
+      pages->push_back(std::move(image_data));
+    }
+    return true;
+  }
+  for (int page = 0; page < end; ++page) {
+    uint8_t non_null;
+    if (!fp.DeSerialize(&non_null)) {
+      break;
+    }
+    if (page < first) {
+      if (non_null && !ImageData::SkipDeSerialize(&fp)) {
+        break;
+      }
+      continue;
+    }
+    std::unique_ptr<ImageData> image_data;
+    if (non_null) {
+      image_data = std::make_unique<ImageData>();
+      if (!image_data->DeSerialize(&fp)) {
+        break;
+      }
+      if (image_data->imagefilename().empty()) {
+        image_data->set_imagefilename(name);
+        image_data->set_page_number(page);
+      }
+    }
+    pages->push_back(std::move(image_data));
+  }
+  if (first + static_cast<int>(pages->size()) < end) {
+    tprintError("Deserialize failed: {} read {}/{} lines\n", name,
+                first + pages->size(), num_pages);
+    pages->clear();
+    return false;
+  }
+  return true;
+}
+
 // Locks the pages_mutex_ and loads as many pages as will fit into max_memory_
 // starting at index pages_offset_.
 bool DocumentData::ReCachePages() {
@@ -576,41 +867,70 @@ bool DocumentData::ReCachePages() {
     return !pages_.empty();
   }
 #endif
+  DocumentFile file;
   TFile fp;
-  if (!fp.Open(document_name_.c_str(), reader_) ||
-      !fp.DeSerializeSize(&loaded_pages) || loaded_pages <= 0) {
+  if (file.Open(document_name_, reader_)) {
+    if (file.is_indexed()) {
+      loaded_pages = file.num_pages();
+    } else {
+      file.OpenView(&fp);
+      if (!fp.DeSerializeSize(&loaded_pages)) {
+        loaded_pages = 0;
+      }
+    }
+  }
+  if (loaded_pages <= 0) {
     tprintError("Deserialize header failed: {}\n", document_name_);
     return false;
   }
   pages_offset_ %= loaded_pages;
-  // Skip pages before the first one we want, and load the rest until max
-  // memory and skip the rest after that.
   int page;
-  for (page = 0; page < loaded_pages; ++page) {
-    uint8_t non_null;
-    if (!fp.DeSerialize(&non_null)) {
-      break;
+  if (file.is_indexed()) {
+    // Read the pages from the first one we want until max memory, without
+    // touching the others.
+    for (page = pages_offset_; page < loaded_pages; ++page) {
+      if (max_memory_ > 0 && memory_used() > max_memory_) {
+        page = loaded_pages;
+        break;
+      }
+      std::unique_ptr<ImageData> image_data;
+      if (!file.ReadPage(page, &image_data)) {
+        break;
+      }
+      if (image_data != nullptr) {
+        set_memory_used(memory_used() + image_data->MemoryUsed());
+      }
+      pages_.push_back(image_data.release());
     }
-    if (page < pages_offset_ ||
-        (max_memory_ > 0 && memory_used() > max_memory_)) {
-      if (non_null && !ImageData::SkipDeSerialize(&fp)) {
+  } else {
+    // Skip pages before the first one we want, and load the rest until max
+    // memory and skip the rest after that.
+    for (page = 0; page < loaded_pages; ++page) {
+      uint8_t non_null;
+      if (!fp.DeSerialize(&non_null)) {
         break;
       }
-    } else {
-      ImageData *image_data = nullptr;
-      if (non_null) {
-        image_data = new ImageData;
-        if (!image_data->DeSerialize(&fp)) {
-          delete image_data;
+      if (page < pages_offset_ ||
+          (max_memory_ > 0 && memory_used() > max_memory_)) {
+        if (non_null && !ImageData::SkipDeSerialize(&fp)) {
           break;
         }
+      } else {
+        ImageData *image_data = nullptr;
+        if (non_null) {
+          image_data = new ImageData;
+          if (!image_data->DeSerialize(&fp)) {
+            delete image_data;
+            break;
+          }
+        }
+        pages_.push_back(image_data);
+        if (image_data->imagefilename().empty()) {
+          image_data->set_imagefilename(document_name_);
+          image_data->set_page_number(page);
+        }
+        set_memory_used(memory_used() + image_data->MemoryUsed());
       }
-      pages_.push_back(image_data);
-      if (image_data->imagefilename().empty()) {
-        image_data->set_imagefilename(document_name_);
-        image_data->set_page_number(page);
-      }
-      set_memory_used(memory_used() + image_data->MemoryUsed());
     }
   }
   if (page < loaded_pages) {
@@ -630,13 +950,254 @@ bool DocumentData::ReCachePages() {
   return !pages_.empty();
 }
 
+// Reads the pages of the documents of a DocumentCache ahead of the caller of
+// GetPage on a pool of threads, and keeps them in a least recently used cache
+// that is bounded by a number of bytes.
+// Pages are identified by the index of their document and their index in the
+// document, modulo its number of pages once that is known. The threads read
+// chunks of kPrefetchChunkPages consecutive pages.
+class PagePrefetcher {
+public:
+  // documents must outlive *this. num_pages_per_doc is only used for
+  // CS_SEQUENTIAL. max_memory <= 0 means no limit.
+  PagePrefetcher(const std::vector<DocumentData *> &documents, CachingStrategy cache_strategy,
+                 int num_pages_per_doc, int num_threads, int read_ahead, int64_t max_memory)
+      : documents_(documents),
+        cache_strategy_(cache_strategy),
+        num_pages_per_doc_(num_pages_per_doc),
+        read_ahead_(read_ahead),
+        max_memory_(max_memory),
+        doc_pages_(documents.size(), -1) {
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.emplace_back(&PagePrefetcher::Run, this);
+    }
+  }
+
+  ~PagePrefetcher() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_.notify_all();
+    for (auto &thread : threads_) {
+      thread.join();
+    }
+  }
+
+  // Returns the page with the given serial number, which stays valid until
+  // the next call, and queues the pages of the following serial numbers.
+  const ImageData *GetPage(int serial) {
+    int doc, page;
+    PageOfSerial(serial, &doc, &page);
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto start = std::chrono::steady_clock::now();
+    bool stalled = false;
+    for (;;) {
+      page = NormalizedPage(doc, page);
+      auto it = index_.find({doc, page});
+      if (it != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        current_ = it->second->page;
+        break;
+      }
+      stalled = true;
+      Chunk chunk{doc, page - page % kPrefetchChunkPages};
+      if (pending_.count(chunk) > 0) {
+        loaded_.wait(lock);
+        continue;
+      }
+      // Nobody is loading the page, so load it here, and take it straight
+      // from the chunk in case the memory limit doesn't let it stay.
+      pending_.insert(chunk);
+      lock.unlock();
+      std::vector<std::unique_ptr<ImageData>> pages;
+      int total_pages = 0;
+      bool ok = documents_[doc]->ReadPages(chunk.second, kPrefetchChunkPages, &pages, &total_pages);
+      lock.lock();
+      current_ = AddChunk(chunk, ok, total_pages, pages, page);
+      if (ok && NormalizedPage(doc, page) != page) {
+        // Now that the number of pages is known, page turns out to be in
+        // another chunk.
+        continue;
+      }
+      break;
+    }
+    if (stalled) {
+      ++stats_.stalls;
+      stats_.stall_seconds +=
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } else {
+      ++stats_.hits;
+    }
+    QueueReadAhead(serial);
+    return current_.get();
+  }
+
+  PrefetchStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+private:
+  // A document index and the first page of a chunk of it.
+  using Chunk = std::pair<int, int>;
+  struct Entry {
+    std::pair<int, int> key;
+    std::shared_ptr<ImageData> page;
+    int64_t memory;
+  };
+
+  // Maps serial to a document and page as DocumentCache does.
+  void PageOfSerial(int serial, int *doc, int *page) const {
+    int num_docs = documents_.size();
+    if (cache_strategy_ == CS_SEQUENTIAL) {
+      *doc = serial / num_pages_per_doc_ % num_docs;
+      *page = serial % num_pages_per_doc_;
+    } else {
+      *doc = serial % num_docs;
+      *page = serial / num_docs;
+    }
+  }
+
+  // Returns page modulo the number of pages of doc, if known yet.
+  // Requires mutex_.
+  int NormalizedPage(int doc, int page) const {
+    int num_pages = doc_pages_[doc];
+    return num_pages > 0 ? Modulo(page, num_pages) : page;
+  }
+
+  // Queues the chunks of the pages of the read_ahead_ serial numbers after
+  // serial that are neither cached nor being loaded. Requires mutex_.
+  void QueueReadAhead(int serial) {
+    bool queued = false;
+    for (int s = serial + 1; s <= serial + read_ahead_; ++s) {
+      int doc, page;
+      PageOfSerial(s, &doc, &page);
+      page = NormalizedPage(doc, page);
+      if (index_.count({doc, page}) > 0) {
+        continue;
+      }
+      Chunk chunk{doc, page - page % kPrefetchChunkPages};
+      if (pending_.insert(chunk).second) {
+        queue_.push_back(chunk);
+        queued = true;
+      }
+    }
+    if (queued) {
+      work_.notify_all();
+    }
+  }
+
+  // Adds the pages read for chunk to the cache, evicting the least recently
+  // used pages that don't fit, and wakes up any waiting GetPage. Returns the
+  // page of the chunk with index wanted in the document, if any, even if it
+  // didn't fit. Requires mutex_.
+  std::shared_ptr<ImageData> AddChunk(const Chunk &chunk, bool ok, int total_pages,
+                                      std::vector<std::unique_ptr<ImageData>> &pages,
+                                      int wanted = -1) {
+    std::shared_ptr<ImageData> result;
+    pending_.erase(chunk);
+    if (ok) {
+      int doc = chunk.first;
+      doc_pages_[doc] = total_pages;
+      int first = Modulo(chunk.second, total_pages);
+      if (wanted >= 0) {
+        wanted = Modulo(wanted, total_pages);
+      }
+      for (size_t i = 0; i < pages.size(); ++i) {
+        std::pair<int, int> key{doc, first + static_cast<int>(i)};
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+          // Already read with another chunk.
+          if (key.second == wanted) {
+            result = it->second->page;
+          }
+          continue;
+        }
+        std::shared_ptr<ImageData> page(std::move(pages[i]));
+        int64_t memory = page != nullptr ? page->MemoryUsed() : 0;
+        lru_.push_front({key, page, memory});
+        index_[key] = lru_.begin();
+        memory_used_ += memory;
+        ++stats_.pages_loaded;
+        if (key.second == wanted) {
+          result = page;
+        }
+      }
+      while (max_memory_ > 0 && memory_used_ > max_memory_ && !lru_.empty()) {
+        memory_used_ -= lru_.back().memory;
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+        ++stats_.pages_evicted;
+      }
+    }
+    loaded_.notify_all();
+    return result;
+  }
+
+  // Loads the queued chunks until stopped.
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      work_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        return;
+      }
+      Chunk chunk = queue_.front();
+      queue_.pop_front();
+      lock.unlock();
+      std::vector<std::unique_ptr<ImageData>> pages;
+      int total_pages = 0;
+      bool ok = documents_[chunk.first]->ReadPages(chunk.second, kPrefetchChunkPages, &pages,
+                                                   &total_pages);
+      lock.lock();
+      AddChunk(chunk, ok, total_pages, pages);
+    }
+  }
+
+  const std::vector<DocumentData *> &documents_;
+  CachingStrategy cache_strategy_;
+  int num_pages_per_doc_;
+  int read_ahead_;
+  int64_t max_memory_;
+
+  // Protects all the members below.
+  mutable std::mutex mutex_;
+  // Signals the threads that there is work, or that they must stop.
+  std::condition_variable work_;
+  // Signals GetPage that a chunk has been loaded.
+  std::condition_variable loaded_;
+  bool stop_ = false;
+  // Number of pages of each document, -1 until the first chunk of it is read.
+  std::vector<int> doc_pages_;
+  // Cached pages, the most recently used first, and their index.
+  std::list<Entry> lru_;
+  std::map<std::pair<int, int>, std::list<Entry>::iterator> index_;
+  int64_t memory_used_ = 0;
+  // Chunks that are queued or being read.
+  std::set<Chunk> pending_;
+  std::deque<Chunk> queue_;
+  // The page returned by the last GetPage, which is kept even if evicted.
+  std::shared_ptr<ImageData> current_;
+  PrefetchStats stats_;
+  std::vector<std::thread> threads_;
+};
+
 // A collection of DocumentData that knows roughly how much memory it is using.
 DocumentCache::DocumentCache(int64_t max_memory) : max_memory_(max_memory) {}
 
 DocumentCache::~DocumentCache() {
+  Clear();
+}
+
+// Deletes all existing documents from the cache, and stops prefetching.
+void DocumentCache::Clear() {
+  prefetcher_.reset();
   for (auto *document : documents_) {
     delete document;
   }
+  documents_.clear();
+  num_pages_per_doc_ = 0;
 }
 
 // Adds all the documents in the list of filenames, counting memory.
@@ -667,8 +1228,10 @@ bool DocumentCache::LoadDocuments(const std::vector<std::string> &filenames,
   return false;
 }
 
-// Adds document to the cache.
+// Adds document to the cache. Stops prefetching, which only knows about the
+// documents it was started with.
 bool DocumentCache::AddToCache(DocumentData *data) {
+  prefetcher_.reset();
   documents_.push_back(data);
   return true;
 }
@@ -684,6 +1247,35 @@ DocumentData *DocumentCache::FindDocument(
   return nullptr;
 }
 
+// Starts num_threads threads that read the pages ahead of GetPageBySerial.
+void DocumentCache::StartPrefetch(int num_threads, int read_ahead) {
+  prefetcher_.reset();
+  if (num_threads <= 0 || documents_.empty()) {
+    return;
+  }
+  if (cache_strategy_ == CS_SEQUENTIAL && num_pages_per_doc_ == 0) {
+    GetPageSequential(0);
+  }
+  // The pages now live in the prefetcher, which gets all the memory.
+  for (auto *document : documents_) {
+    if (document->IsCached()) {
+      document->UnCache();
+    }
+  }
+  prefetcher_ = std::make_unique<PagePrefetcher>(documents_, cache_strategy_, num_pages_per_doc_,
+                                                 num_threads, read_ahead, max_memory_);
+}
+
+// Returns the counters of the prefetching since it was started.
+PrefetchStats DocumentCache::GetPrefetchStats() const {
+  return prefetcher_ != nullptr ? prefetcher_->stats() : PrefetchStats();
+}
+
+// Returns a page by serial number from the prefetcher.
+const ImageData *DocumentCache::GetPagePrefetched(int serial) {
+  return prefetcher_->GetPage(serial);
+}
+
 // Returns the total number of pages in an epoch. For CS_ROUND_ROBIN cache
 // strategy, could take a long time.
 int DocumentCache::TotalPages() {
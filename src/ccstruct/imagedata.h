@@ -22,6 +22,7 @@
 #include "image.h"
 #include "points.h" // for FCOORD
 
+#include <memory> // for std::unique_ptr
 #include <mutex>  // for std::mutex
 #include <thread> // for std::thread
 
@@ -32,6 +33,7 @@ namespace tesseract {
 class TFile;
 class ScrollView;
 class TBOX;
+class PagePrefetcher;
 
 // Amount of padding to apply in output pixels in feature mode.
 const int kFeaturePadding = 2;
@@ -182,6 +184,14 @@ public:
   // Writes all the pages to the given filename. Returns false on error.
   TESS_API
   bool SaveDocument(const char *filename, FileWriter writer);
+  // Writes all the pages to the given filename as an indexed document, which
+  // starts with the offset of each page, so that a single page can be read
+  // without reading the pages before it, straight from a memory mapped file.
+  // If compress, the pages that zlib makes smaller are stored compressed.
+  // LoadDocument and ReadPages read both kinds of document. Returns false on
+  // error.
+  TESS_API
+  bool SaveIndexedDocument(const char *filename, bool compress, FileWriter writer);
 
   // Adds the given page data to this document, counting up memory.
   TESS_API
@@ -237,6 +247,14 @@ public:
   // Removes all pages from memory and frees the memory, but does not forget
   // the document metadata. Returns the memory saved.
   int64_t UnCache();
+  // Reads up to count pages of the document file, starting at first modulo
+  // the number of pages, to *pages, without caching them in *this, and sets
+  // *total_pages to the number of pages of the document. Pages that the file
+  // holds as null are nullptr. May run on several threads at once. Returns
+  // false on error.
+  TESS_API
+  bool ReadPages(int first, int count, std::vector<std::unique_ptr<ImageData>> *pages,
+                 int *total_pages) const;
   // Shuffles all the pages in the document.
   void Shuffle();
 
@@ -280,6 +298,18 @@ private:
   std::thread thread;
 };
 
+// Counters of the page prefetching of a DocumentCache.
+struct PrefetchStats {
+  // Pages that were loaded before they were asked for.
+  int64_t hits = 0;
+  // Pages that the caller had to wait for, and the time it waited.
+  int64_t stalls = 0;
+  double stall_seconds = 0.0;
+  // Pages read from the documents, and dropped again to stay within memory.
+  int64_t pages_loaded = 0;
+  int64_t pages_evicted = 0;
+};
+
 // A collection of DocumentData that knows roughly how much memory it is using.
 // Note that while it supports background read-ahead, it assumes that a single
 // thread is accessing documents, ie it is not safe for multiple threads to
@@ -292,21 +322,16 @@ public:
   TESS_API
   ~DocumentCache();
 
-  // Deletes all existing documents from the cache.
-  void Clear() {
-    for (auto *document : documents_) {
-      delete document;
-    }
-    documents_.clear();
-    num_pages_per_doc_ = 0;
-  }
+  // Deletes all existing documents from the cache, and stops prefetching.
+  TESS_API
+  void Clear();
   // Adds all the documents in the list of filenames, counting memory.
   // The reader is used to read the files.
   TESS_API
   bool LoadDocuments(const std::vector<std::string> &filenames, CachingStrategy cache_strategy,
                      FileReader reader);
 
-  // Adds document to the cache.
+  // Adds document to the cache, and stops prefetching.
   bool AddToCache(DocumentData *data);
 
   // Finds and returns a document by name.
@@ -315,6 +340,9 @@ public:
   // Returns a page by serial number using the current cache_strategy_ to
   // determine the mapping from serial number to page.
   const ImageData *GetPageBySerial(int serial) {
+    if (prefetcher_ != nullptr) {
+      return GetPagePrefetched(serial);
+    }
     if (cache_strategy_ == CS_SEQUENTIAL) {
       return GetPageSequential(serial);
     } else {
@@ -330,7 +358,23 @@ public:
   TESS_API
   int TotalPages();
 
+  // Starts num_threads threads that read the pages that GetPageBySerial will
+  // return for the next read_ahead serial numbers ahead of the caller. The
+  // pages are then kept in a least recently used cache within the max_memory
+  // of *this, instead of in the documents, and a page that GetPageBySerial
+  // returns stays valid until its next call. num_threads 0 stops
+  // prefetching. Must be called after LoadDocuments.
+  TESS_API
+  void StartPrefetch(int num_threads, int read_ahead);
+  // Returns the counters of the prefetching since it was started.
+  TESS_API
+  PrefetchStats GetPrefetchStats() const;
+
 private:
+  // Returns a page by serial number from the prefetcher.
+  TESS_API
+  const ImageData *GetPagePrefetched(int serial);
+
   // Returns a page by serial number, selecting them in a round-robin fashion
   // from all the documents. Highly disk-intensive, but doesn't need samples
   // to be shuffled between files to begin with.
@@ -355,6 +399,8 @@ private:
   int num_pages_per_doc_ = 0;
   // Max memory allowed in this cache.
   int64_t max_memory_ = 0;
+  // Reads the pages ahead of GetPageBySerial if prefetching.
+  std::unique_ptr<PagePrefetcher> prefetcher_;
 };
 
 } // namespace tesseract
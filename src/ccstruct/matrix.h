@@ -147,6 +147,16 @@ public:
     }
   }
 
+  // Frees the allocated memory, leaving an empty 0x0 array.
+  // (Resize* only ever grows the allocation.)
+  void Release() {
+    delete[] array_;
+    array_ = nullptr;
+    dim1_ = 0;
+    dim2_ = 0;
+    size_allocated_ = 0;
+  }
+
   // -----------------------------------------------------------
   // Serialization & Deserialization to disk uses specific Storage Types (ST)
   // which MAY not be identical to the run-time Type (T).
@@ -259,6 +269,11 @@ public:
   virtual int num_elements() const {
     return dim1_ * dim2_;
   }
+  // Returns the number of bytes allocated for the elements, which may be
+  // more than num_elements() needs.
+  size_t memory_size() const {
+    return static_cast<size_t>(size_allocated_) * sizeof(T);
+  }
 
   // Expression to select a specific location in the matrix. The matrix is
   // stored COLUMN-major, so the left-most index is the most significant.
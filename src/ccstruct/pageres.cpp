@@ -44,6 +44,7 @@
 
 #include <cstdint> // for INT32_MAX
 #include <cstring> // for strlen
+#include <mutex>   // for std::mutex
 
 #undef min
 #undef max
@@ -1197,6 +1198,36 @@ void WERD_RES::ClearRatings() {
   }
 }
 
+// Guards lstm_choice_source and the switch to the choices it makes in all
+// WERD_RES, so several iterators may read the same word at once.
+static std::mutex lstm_choices_mutex;
+
+void WERD_RES::EnsureLSTMChoices() {
+  std::shared_ptr<LSTMChoiceSource> source;
+  {
+    std::lock_guard<std::mutex> lock(lstm_choices_mutex);
+    source = lstm_choice_source;
+  }
+  if (source == nullptr) {
+    return;
+  }
+  std::vector<std::vector<std::pair<const char *, float>>> symbol_choices;
+  std::vector<std::vector<std::vector<std::pair<const char *, float>>>> segments;
+  source->GetChoices(lstm_choice_start, end, &symbol_choices, &segments);
+  std::lock_guard<std::mutex> lock(lstm_choices_mutex);
+  if (lstm_choice_source != source) {
+    return; // Another thread got there first.
+  }
+  CTC_symbol_choices = std::move(symbol_choices);
+  segmented_timesteps = std::move(segments);
+  timesteps.clear();
+  for (auto &segment : segmented_timesteps) {
+    timesteps.insert(timesteps.end(), segment.begin(), segment.end());
+  }
+  // The source goes once the last word of its line has taken its choices.
+  lstm_choice_source.reset();
+}
+
 int PAGE_RES_IT::cmp(const PAGE_RES_IT &other) const {
   ASSERT_HOST(page_res == other.page_res);
   if (other.block_res == nullptr) {
@@ -35,6 +35,7 @@
 
 #include <cstdint>    // for int32_t, int16_t
 #include <functional> // for std::function
+#include <memory>     // for std::shared_ptr
 #include <set>        // for std::pair
 #include <vector>     // for std::vector
 
@@ -161,6 +162,21 @@ public:
  *************************************************************************/
 enum CRUNCH_MODE { CR_NONE, CR_KEEP_SPACE, CR_LOOSE_SPACE, CR_DELETE };
 
+// Makes the alternative symbol choices of the characters of a line, as the
+// LSTM recognizer does in lstm_choice_mode, when they are first asked for.
+// The WERD_RES of the words of the line share one instance.
+class TESS_API LSTMChoiceSource {
+public:
+  virtual ~LSTMChoiceSource() = default;
+  // Sets *symbol_choices and *segmented_timesteps to the choices of the count
+  // characters of the line from index start on.
+  virtual void GetChoices(
+      int start, int count,
+      std::vector<std::vector<std::pair<const char *, float>>> *symbol_choices,
+      std::vector<std::vector<std::vector<std::pair<const char *, float>>>>
+          *segmented_timesteps) = 0;
+};
+
 // WERD_RES is a collection of publicly accessible members that gathers
 // information about a word result.
 class TESS_API WERD_RES : public ELIST_LINK {
@@ -228,6 +244,11 @@ public:
   bool leading_space = false;
   // Stores value when the word ends
   int end = 0;
+  // While set, timesteps, segmented_timesteps and CTC_symbol_choices are yet
+  // to be made by EnsureLSTMChoices from this source, in which the word
+  // starts at character lstm_choice_start.
+  std::shared_ptr<LSTMChoiceSource> lstm_choice_source;
+  int lstm_choice_start = 0;
   // Ratings matrix contains classifier choices for each classified combination
   // of blobs. The dimension is the same as the number of blobs in chopped_word
   // and the leading diagonal corresponds to classifier results of the blobs
@@ -441,6 +462,10 @@ public:
   void Clear();
   void ClearResults();
   void ClearWordChoices();
+  // Makes timesteps, segmented_timesteps and CTC_symbol_choices if they are
+  // still pending in lstm_choice_source. Call before using any of them.
+  // Thread-safe, also for several callers on the same word.
+  void EnsureLSTMChoices();
   void ClearRatings();
 
   // Deep copies everything except the ratings MATRIX.
@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////
+// File:        mappedfile.cpp
+// Description: Read-only memory mapped file.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include <tesseract/preparation.h> // compiler config, etc.
+
+#include "mappedfile.h"
+
+#include <cstdint> // SIZE_MAX
+
+#if defined(_WIN32)
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#  include "winutils.h"
+#elif defined(__unix__) || defined(__APPLE__)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  define TESS_HAVE_MMAP 1
+#endif
+
+namespace tesseract {
+
+MappedFile::~MappedFile() {
+#if defined(_WIN32)
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_ != nullptr) {
+    CloseHandle(mapping_);
+  }
+#elif defined(TESS_HAVE_MMAP)
+  if (data_ != nullptr) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+#endif
+}
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const char *filename) {
+#if defined(HAVE_MUPDF)
+  // Files may live in a virtual file system: leave it to fopenUtf8.
+  (void)filename;
+  return nullptr;
+#elif defined(_WIN32)
+  HANDLE file = CreateFileW(winutils::Utf8ToUtf16(filename).c_str(), GENERIC_READ,
+                            FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return nullptr;
+  }
+  LARGE_INTEGER file_size;
+  std::shared_ptr<MappedFile> result;
+  if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 &&
+      static_cast<unsigned long long>(file_size.QuadPart) <= SIZE_MAX) {
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping != nullptr) {
+      result.reset(new MappedFile);
+      result->mapping_ = mapping;
+      result->data_ = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+      result->size_ = static_cast<size_t>(file_size.QuadPart);
+      if (result->data_ == nullptr) {
+        result.reset();
+      }
+    }
+  }
+  // The mapping keeps the file open.
+  CloseHandle(file);
+  return result;
+#elif defined(TESS_HAVE_MMAP)
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  std::shared_ptr<MappedFile> result;
+  struct stat st;
+  // Directories and other special files can't be mapped.
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr != MAP_FAILED) {
+      result.reset(new MappedFile);
+      result->data_ = static_cast<const char *>(addr);
+      result->size_ = st.st_size;
+    }
+  }
+  // The mapping stays valid after closing the descriptor.
+  close(fd);
+  return result;
+#else
+  (void)filename;
+  return nullptr;
+#endif
+}
+
+} // namespace tesseract
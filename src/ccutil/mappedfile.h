@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////////////////////////
+// File:        mappedfile.h
+// Description: Read-only memory mapped file.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#ifndef TESSERACT_CCUTIL_MAPPEDFILE_H_
+#define TESSERACT_CCUTIL_MAPPEDFILE_H_
+
+#include <cstddef> // size_t
+#include <memory>  // std::shared_ptr
+
+namespace tesseract {
+
+// Maps a whole file read-only into memory. The pages are backed by the
+// page cache, so several processes mapping the same file share them.
+// Instances are neither copyable nor movable: hold them by shared_ptr and
+// keep that alive for as long as anything points into data().
+class MappedFile {
+public:
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Maps the given (UTF-8) filename. Returns nullptr if the file could not
+  // be opened or mapped, or if memory mapping is not supported on this
+  // platform, in which case the caller should fall back to reading it.
+  static std::shared_ptr<const MappedFile> Open(const char *filename);
+
+  const char *data() const {
+    return data_;
+  }
+  size_t size() const {
+    return size_;
+  }
+
+private:
+  MappedFile() = default;
+
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+#if defined(_WIN32)
+  void *mapping_ = nullptr;
+#endif
+};
+
+} // namespace tesseract
+
+#endif // TESSERACT_CCUTIL_MAPPEDFILE_H_
@@ -78,7 +78,7 @@ bool TFile::DeSerializeSize(int32_t *pSize) {
   if (FReadEndian(&size, sizeof(size), 1) != 1) {
     return false;
   }
-  if (size > data_->size() / 4) {
+  if (size > read_size_ / 4) {
     // Reverse endianness.
     swap_ = !swap_;
     ReverseN(&size, 4);
@@ -149,11 +149,9 @@ bool TFile::Open(const char *filename, FileReader reader) {
   offset_ = 0;
   is_writing_ = false;
   swap_ = false;
-  if (reader == nullptr) {
-    return LoadDataFromFile(filename, data_);
-  } else {
-    return (*reader)(filename, data_);
-  }
+  bool result = reader == nullptr ? LoadDataFromFile(filename, data_) : (*reader)(filename, data_);
+  ReadFromData();
+  return result;
 }
 
 bool TFile::Open(const char *data, size_t size) {
@@ -166,6 +164,20 @@ bool TFile::Open(const char *data, size_t size) {
   swap_ = false;
   data_->resize(size); // TODO: optimize no init
   memcpy(&(*data_)[0], data, size);
+  ReadFromData();
+  return true;
+}
+
+bool TFile::OpenView(const char *data, size_t size, std::shared_ptr<const void> owner) {
+  offset_ = 0;
+  is_writing_ = false;
+  swap_ = false;
+  if (data_is_owned_) {
+    data_->clear();
+  }
+  read_data_ = data;
+  read_size_ = size;
+  view_owner_ = std::move(owner);
   return true;
 }
 
@@ -193,25 +205,27 @@ bool TFile::Open(FILE *fp, int64_t end_offset) {
     data_is_owned_ = true;
   }
   data_->resize(size); // TODO: optimize no init
-  return fread(&(*data_)[0], 1, size, fp) == size;
+  bool result = fread(&(*data_)[0], 1, size, fp) == size;
+  ReadFromData();
+  return result;
 }
 
 std::vector<char> TFile::ReadAllRemainingContent() {
   ASSERT_HOST(!is_writing_);
-  if (offset_ >= data_->size()) {
+  if (offset_ >= read_size_) {
     return {};
   }
-  const char *p = data_->data();
-  std::vector<char> s(p + offset_, p + data_->size());
+  const char *p = read_data_;
+  std::vector<char> s(p + offset_, p + read_size_);
   return s;
 }
 
 char *TFile::FGets(char *buffer, int buffer_size) {
   ASSERT_HOST(!is_writing_);
   int size = 0;
-  while (size + 2 < buffer_size && offset_ < data_->size()) {
-    buffer[size++] = (*data_)[offset_++];
-    if ((*data_)[offset_ - 1] == '\n') {
+  while (size + 2 < buffer_size && offset_ < read_size_) {
+    buffer[size++] = read_data_[offset_++];
+    if (read_data_[offset_ - 1] == '\n') {
       break;
     }
   }
@@ -238,15 +252,15 @@ size_t TFile::FRead(void *buffer, size_t size, size_t count) {
   size_t required_size;
   if (SIZE_MAX / size <= count) {
     // Avoid integer overflow.
-    required_size = data_->size() - offset_;
+    required_size = read_size_ - offset_;
   } else {
     required_size = size * count;
-    if (data_->size() - offset_ < required_size) {
-      required_size = data_->size() - offset_;
+    if (read_size_ - offset_ < required_size) {
+      required_size = read_size_ - offset_;
     }
   }
   if (required_size > 0 && buffer != nullptr) {
-    memcpy(buffer, &(*data_)[offset_], required_size);
+    memcpy(buffer, read_data_ + offset_, required_size);
   }
   offset_ += required_size;
   return required_size / size;
@@ -272,6 +286,9 @@ void TFile::OpenWrite(std::vector<char> *data) {
   is_writing_ = true;
   swap_ = false;
   data_->clear();
+  read_data_ = nullptr;
+  read_size_ = 0;
+  view_owner_.reset();
 }
 
 bool TFile::CloseWrite(const char *filename, FileWriter writer) {
@@ -24,6 +24,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory> // std::shared_ptr
 #include <type_traits>
 #include <vector> // std::vector
 #include "tesstypes.h"
@@ -122,6 +123,10 @@ public:
   bool Open(const char *filename, FileReader reader);
   // From an existing memory buffer.
   bool Open(const char *data, size_t size);
+  // From an existing memory buffer, without copying it. The buffer must stay
+  // valid while the TFile reads from it: owner (if any) is held until the
+  // TFile is reopened or destroyed.
+  bool OpenView(const char *data, size_t size, std::shared_ptr<const void> owner = nullptr);
   // From an open file and an end offset.
   bool Open(FILE *fp, int64_t end_offset);
   // Sets the value of the swap flag, so that FReadEndian does the right thing.
@@ -332,8 +337,21 @@ public:
   size_t FWrite(const void *buffer, size_t size, size_t count);
 
 private:
+  // Makes the read cursor use the contents of data_.
+  void ReadFromData() {
+    read_data_ = data_->data();
+    read_size_ = data_->size();
+    view_owner_.reset();
+  }
+
   // The buffered data from the file.
   std::vector<char> *data_ = nullptr;
+  // The bytes being read: either the contents of data_ or a view of
+  // memory owned by someone else.
+  const char *read_data_ = nullptr;
+  size_t read_size_ = 0;
+  // Keeps the memory of a view alive.
+  std::shared_ptr<const void> view_owner_;
   // The number of bytes used so far.
   unsigned offset_ = 0;
   // True if the data_ pointer is owned by *this.
@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////////////////
+// File:        taskscheduler.cpp
+// Description: Thread budget and parallel loops shared by all engines.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include <tesseract/preparation.h> // compiler config, etc.
+
+#include "taskscheduler.h"
+
+#include <algorithm>          // std::min
+#include <condition_variable> // std::condition_variable
+#include <deque>              // std::deque
+#include <mutex>              // std::mutex
+#include <thread>             // std::thread
+#include <vector>             // std::vector
+
+namespace tesseract {
+
+// Returns the default process thread budget.
+static int HardwareThreads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// The worker threads of the process. They are started on first use, so
+// processes that never run a parallel loop with more than one thread don't
+// pay for them.
+class WorkerPool {
+public:
+  static WorkerPool &Get() {
+    static WorkerPool pool;
+    return pool;
+  }
+
+  ~WorkerPool() {
+    Stop();
+  }
+
+  int budget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return budget_;
+  }
+
+  // Stops the current workers, after they have finished their queued tasks,
+  // and sets the budget for the workers started on next use.
+  void SetBudget(int budget) {
+    std::lock_guard<std::mutex> resize_lock(resize_mutex_);
+    Stop();
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budget;
+  }
+
+  // Hands task(0) ... task(k - 1) to k idle workers, with k at most
+  // max_tasks, and returns k. Never queues a task behind busy workers.
+  int Dispatch(int max_tasks, const std::function<void(int)> &task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return 0;
+    }
+    if (workers_.empty() && budget_ > 1) {
+      idle_ = budget_ - 1;
+      for (int i = 0; i < idle_; ++i) {
+        workers_.emplace_back(&WorkerPool::Run, this);
+      }
+    }
+    int num_tasks = std::min(max_tasks, idle_);
+    idle_ -= num_tasks;
+    for (int i = 0; i < num_tasks; ++i) {
+      queue_.emplace_back([task, i]() { task(i); });
+    }
+    if (num_tasks > 0) {
+      wakeup_.notify_all();
+    }
+    return num_tasks;
+  }
+
+private:
+  WorkerPool() : budget_(HardwareThreads()) {}
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      wakeup_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      auto task = std::move(queue_.front());
+      queue_.pop_front();
+      lock.unlock();
+      task();
+      lock.lock();
+      ++idle_;
+    }
+  }
+
+  void Stop() {
+    std::vector<std::thread> workers;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+      workers.swap(workers_);
+    }
+    wakeup_.notify_all();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = false;
+    idle_ = 0;
+  }
+
+  // Serializes SetBudget calls.
+  std::mutex resize_mutex_;
+  // Protects all of the following.
+  mutable std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> queue_;
+  // Number of workers that are neither running nor assigned a task.
+  int idle_ = 0;
+  int budget_;
+  bool stopping_ = false;
+};
+
+int TaskScheduler::MaxConcurrency() const {
+  int budget = WorkerPool::Get().budget();
+  if (max_threads_ > 0) {
+    budget = std::min(budget, max_threads_);
+  }
+  return std::max(1, budget);
+}
+
+void TaskScheduler::ParallelFor(int n,
+                                const std::function<void(int slot, int start, int end)> &fn) const {
+  if (n <= 0) {
+    return;
+  }
+  int max_chunks = std::min(n, MaxConcurrency());
+  if (max_chunks == 1) {
+    fn(0, 0, n);
+    return;
+  }
+  // The chunks are only known once the helpers are, so the helpers wait
+  // until the caller has published them.
+  std::mutex mutex;
+  std::condition_variable done;
+  int num_chunks = 0;
+  int remaining = 0;
+  auto chunk_start = [&](int chunk) {
+    return static_cast<int>(static_cast<long long>(n) * chunk / num_chunks);
+  };
+  std::unique_lock<std::mutex> lock(mutex);
+  int num_helpers = WorkerPool::Get().Dispatch(max_chunks - 1, [&](int helper) {
+    int chunk = helper + 1;
+    {
+      std::lock_guard<std::mutex> wait_for_start(mutex);
+    }
+    fn(chunk, chunk_start(chunk), chunk_start(chunk + 1));
+    std::lock_guard<std::mutex> finished(mutex);
+    if (--remaining == 0) {
+      done.notify_one();
+    }
+  });
+  num_chunks = num_helpers + 1;
+  remaining = num_helpers;
+  lock.unlock();
+  fn(0, 0, chunk_start(1));
+  lock.lock();
+  done.wait(lock, [&]() { return remaining == 0; });
+}
+
+void TaskScheduler::SetProcessThreadBudget(int num_threads) {
+  WorkerPool::Get().SetBudget(num_threads > 0 ? num_threads : HardwareThreads());
+}
+
+int TaskScheduler::ProcessThreadBudget() {
+  return WorkerPool::Get().budget();
+}
+
+const TaskScheduler &TaskScheduler::Default() {
+  static const TaskScheduler scheduler;
+  return scheduler;
+}
+
+} // namespace tesseract
@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////
+// File:        taskscheduler.h
+// Description: Thread budget and parallel loops shared by all engines.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#ifndef TESSERACT_CCUTIL_TASKSCHEDULER_H_
+#define TESSERACT_CCUTIL_TASKSCHEDULER_H_
+
+#include <tesseract/export.h>
+
+#include <functional> // std::function
+
+namespace tesseract {
+
+// Runs parallel loops on a pool of worker threads that is shared by all the
+// engines of the process.
+// The process thread budget is the number of threads that may work on
+// parallel loops at the same time: the pool holds one worker less, as the
+// thread that calls ParallelFor always takes part.
+// Each engine (Tesseract instance) owns a TaskScheduler with its own thread
+// budget, which limits how many of those threads a single loop may occupy.
+// Workers are only handed to a loop when they are idle, so when many engines
+// run at once, each of them degrades gracefully to running on its own thread
+// instead of oversubscribing the CPUs, and nested loops can never deadlock.
+class TESS_API TaskScheduler {
+public:
+  // max_threads limits the threads used by a single ParallelFor, including
+  // the calling thread. 0 means no limit other than the process budget.
+  explicit TaskScheduler(int max_threads = 0) : max_threads_(max_threads) {}
+
+  int max_threads() const {
+    return max_threads_;
+  }
+  void set_max_threads(int max_threads) {
+    max_threads_ = max_threads;
+  }
+
+  // Returns the maximum number of calls of a ParallelFor function that can
+  // run at the same time, which is at least 1.
+  int MaxConcurrency() const;
+
+  // Calls fn(slot, start, end) for contiguous ranges [start, end) that
+  // together cover [0, n), and returns when all calls are done.
+  // Calls that run at the same time get different slots, all less than
+  // MaxConcurrency(), so fn can use the slot to index per-thread scratch
+  // space. One of the calls always runs on the calling thread.
+  void ParallelFor(int n, const std::function<void(int slot, int start, int end)> &fn) const;
+
+  // Sets the process thread budget. 0 selects the number of hardware
+  // threads, which is also the default.
+  static void SetProcessThreadBudget(int num_threads);
+  static int ProcessThreadBudget();
+
+  // Scheduler used by code that runs outside any engine, for instance
+  // training. It has no budget of its own.
+  static const TaskScheduler &Default();
+
+private:
+  int max_threads_;
+};
+
+} // namespace tesseract
+
+#endif // TESSERACT_CCUTIL_TASKSCHEDULER_H_
@@ -36,18 +36,22 @@
 #include <tesseract/version.h>
 #include "errcode.h"
 #include "helpers.h"
+#include "mappedfile.h"
 #include <tesseract/params.h>
 #include "serialis.h"
 #include <tesseract/tprintf.h>
 
 namespace tesseract {
 
-TessdataManager::TessdataManager() : reader_(nullptr), is_loaded_(false), swap_(false) {
+BOOL_VAR(tessdata_use_mmap, true, "Memory map traineddata files instead of reading them into memory, so that processes share the model pages through the page cache.");
+
+TessdataManager::TessdataManager()
+    : reader_(nullptr), is_loaded_(false), swap_(false), use_mmap_(tessdata_use_mmap) {
   SetVersionString(TESSERACT_VERSION_STR);
 }
 
 TessdataManager::TessdataManager(FileReader reader)
-    : reader_(reader), is_loaded_(false), swap_(false) {
+    : reader_(reader), is_loaded_(false), swap_(false), use_mmap_(tessdata_use_mmap) {
   SetVersionString(TESSERACT_VERSION_STR);
 }
 
@@ -101,11 +105,12 @@ bool TessdataManager::SaveArchiveFile(const char *filename) const{
     archive_entry_set_filetype(ae, AE_IFREG);
     archive_entry_set_perm(ae, 333);
     for (unsigned i = 0; i < TESSDATA_NUM_ENTRIES; ++i) {
-      if (!entries_[i].empty()) {
+      auto type = static_cast<TessdataType>(i);
+      if (EntrySize(type) != 0) {
         archive_entry_set_pathname(ae, (filename_str + kTessdataFileSuffixes[i]).c_str());
-        archive_entry_set_size(ae, entries_[i].size());
+        archive_entry_set_size(ae, EntrySize(type));
         archive_write_header(a, ae);
-        archive_write_data(a, &entries_[i][0], entries_[i].size());
+        archive_write_data(a, EntryData(type), EntrySize(type));
       }
     }
     result = archive_write_close(a) == ARCHIVE_OK;
@@ -124,6 +129,12 @@ bool TessdataManager::Init(const char *data_file_name) {
       return true;
     }
 #endif
+    if (use_mmap_) {
+      auto mapped = MappedFile::Open(data_file_name);
+      if (mapped != nullptr) {
+        return LoadBuffer(data_file_name, mapped->data(), mapped->size(), mapped);
+      }
+    }
     if (!LoadDataFromFile(data_file_name, &data)) {
       return false;
     }
@@ -137,11 +148,16 @@ bool TessdataManager::Init(const char *data_file_name) {
 
 // Loads from the given memory buffer as if a file.
 bool TessdataManager::LoadMemBuffer(const char *name, const char *data, int size) {
+  return LoadBuffer(name, data, size, nullptr);
+}
+
+bool TessdataManager::LoadBuffer(const char *name, const char *data, size_t size,
+                                 std::shared_ptr<const MappedFile> mapped) {
   // TODO: This method supports only the proprietary file format.
   Clear();
   data_file_name_ = name;
   TFile fp;
-  fp.Open(data, size);
+  fp.OpenView(data, size);
   uint32_t num_entries;
   if (!fp.DeSerialize(&num_entries)) {
     return false;
@@ -161,7 +177,7 @@ bool TessdataManager::LoadMemBuffer(const char *name, const char *data, int size
   }
   for (unsigned i = 0; i < num_entries && i < TESSDATA_NUM_ENTRIES; ++i) {
     if (offset_table[i] >= 0) {
-      int64_t entry_size = size - offset_table[i];
+      int64_t entry_size = static_cast<int64_t>(size) - offset_table[i];
       unsigned j = i + 1;
       while (j < num_entries && offset_table[j] == -1) {
         ++j;
@@ -169,13 +185,25 @@ bool TessdataManager::LoadMemBuffer(const char *name, const char *data, int size
       if (j < num_entries) {
         entry_size = offset_table[j] - offset_table[i];
       }
+      if (mapped != nullptr) {
+        if (entry_size < 0 || offset_table[i] > static_cast<int64_t>(size) - entry_size) {
+          Clear();
+          return false;
+        }
+        mapped_entries_[i].data = data + offset_table[i];
+        mapped_entries_[i].size = entry_size;
+        continue;
+      }
       entries_[i].resize(entry_size);
       if (!fp.DeSerialize(&entries_[i][0], entry_size)) {
         return false;
       }
     }
   }
-  if (entries_[TESSDATA_VERSION].empty()) {
+  if (mapped != nullptr) {
+    mapped_file_ = std::move(mapped);
+  }
+  if (EntrySize(TESSDATA_VERSION) == 0) {
     SetVersionString("Pre-4.0.0");
   }
   is_loaded_ = true;
@@ -185,6 +213,7 @@ bool TessdataManager::LoadMemBuffer(const char *name, const char *data, int size
 // Overwrites a single entry of the given type.
 void TessdataManager::OverwriteEntry(TessdataType type, const char *data, int size) {
   is_loaded_ = true;
+  mapped_entries_[type] = MappedEntry();
   entries_[type].resize(size);
   memcpy(&entries_[type][0], data, size);
 }
@@ -214,11 +243,12 @@ void TessdataManager::Serialize(std::vector<char> *data) const {
   int64_t offset_table[TESSDATA_NUM_ENTRIES];
   int64_t offset = sizeof(int32_t) + sizeof(offset_table);
   for (unsigned i = 0; i < TESSDATA_NUM_ENTRIES; ++i) {
-    if (entries_[i].empty()) {
+    auto size = EntrySize(static_cast<TessdataType>(i));
+    if (size == 0) {
       offset_table[i] = -1;
     } else {
       offset_table[i] = offset;
-      offset += entries_[i].size();
+      offset += size;
     }
   }
   data->resize(offset, 0);
@@ -227,9 +257,10 @@ void TessdataManager::Serialize(std::vector<char> *data) const {
   fp.OpenWrite(data);
   fp.Serialize(&num_entries);
   fp.Serialize(&offset_table[0], countof(offset_table));
-  for (const auto &entry : entries_) {
-    if (!entry.empty()) {
-      fp.Serialize(&entry[0], entry.size());
+  for (unsigned i = 0; i < TESSDATA_NUM_ENTRIES; ++i) {
+    auto type = static_cast<TessdataType>(i);
+    if (EntrySize(type) != 0) {
+      fp.Serialize(EntryData(type), EntrySize(type));
     }
   }
 }
@@ -239,18 +270,36 @@ void TessdataManager::Clear() {
   for (auto &entry : entries_) {
     entry.clear();
   }
+  for (auto &entry : mapped_entries_) {
+    entry = MappedEntry();
+  }
+  mapped_file_.reset();
   is_loaded_ = false;
 }
 
+// Copies all the mapped components into owned memory and releases the
+// mapping.
+void TessdataManager::DetachMappedFile() {
+  for (unsigned i = 0; i < TESSDATA_NUM_ENTRIES; ++i) {
+    const MappedEntry &entry = mapped_entries_[i];
+    if (entry.data != nullptr) {
+      entries_[i].assign(entry.data, entry.data + entry.size);
+      mapped_entries_[i] = MappedEntry();
+    }
+  }
+  mapped_file_.reset();
+}
+
 // Prints a directory of contents.
 void TessdataManager::Directory() const {
   tprintInfo("Version:{}\n", VersionString());
   auto offset = TESSDATA_NUM_ENTRIES * sizeof(int64_t);
   for (unsigned i = 0; i < TESSDATA_NUM_ENTRIES; ++i) {
-    if (!entries_[i].empty()) {
-      tprintInfo("{}:{}:size={}, offset={}\n", i, kTessdataFileSuffixes[i], entries_[i].size(),
+    auto size = EntrySize(static_cast<TessdataType>(i));
+    if (size != 0) {
+      tprintInfo("{}:{}:size={}, offset={}\n", i, kTessdataFileSuffixes[i], size,
               offset);
-      offset += entries_[i].size();
+      offset += size;
     }
   }
 }
@@ -269,21 +318,44 @@ bool TessdataManager::GetComponent(TessdataType type, TFile *fp) {
 // loaded.
 bool TessdataManager::GetComponent(TessdataType type, TFile *fp) const {
   ASSERT_HOST(is_loaded_);
-  if (entries_[type].empty()) {
+  if (EntrySize(type) == 0) {
     return false;
   }
-  fp->Open(&entries_[type][0], entries_[type].size());
+  if (mapped_entries_[type].data != nullptr) {
+    // Zero copy: the TFile keeps the mapping alive while reading from it.
+    fp->OpenView(mapped_entries_[type].data, mapped_entries_[type].size, mapped_file_);
+  } else {
+    fp->Open(&entries_[type][0], entries_[type].size());
+  }
   fp->set_swap(swap_);
   return true;
 }
 
+// Returns a view of the contents of the given component.
+bool TessdataManager::GetComponentView(TessdataType type, const char **data, size_t *size,
+                                       std::shared_ptr<const void> *owner) const {
+  ASSERT_HOST(is_loaded_);
+  if (EntrySize(type) == 0) {
+    return false;
+  }
+  *data = EntryData(type);
+  *size = EntrySize(type);
+  if (mapped_entries_[type].data != nullptr) {
+    *owner = mapped_file_;
+  } else {
+    owner->reset();
+  }
+  return true;
+}
+
 // Returns the current version string.
 std::string TessdataManager::VersionString() const {
-  return std::string(&entries_[TESSDATA_VERSION][0], entries_[TESSDATA_VERSION].size());
+  return std::string(EntryData(TESSDATA_VERSION), EntrySize(TESSDATA_VERSION));
 }
 
 // Sets the version string to the given v_str.
 void TessdataManager::SetVersionString(const std::string &v_str) {
+  mapped_entries_[TESSDATA_VERSION] = MappedEntry();
   entries_[TESSDATA_VERSION].resize(v_str.size());
   memcpy(&entries_[TESSDATA_VERSION][0], v_str.data(), v_str.size());
 }
@@ -299,6 +371,7 @@ bool TessdataManager::CombineDataFiles(const char *language_data_path_prefix,
     FILE *fp = fopen(filename.c_str(), "rb");
     if (fp != nullptr) {
       fclose(fp);
+      mapped_entries_[type] = MappedEntry();
       if (!LoadDataFromFile(filename.c_str(), &entries_[type])) {
         tprintError("Load of file {} failed!\n", filename.c_str());
         return false;
@@ -319,6 +392,8 @@ bool TessdataManager::CombineDataFiles(const char *language_data_path_prefix,
 
 bool TessdataManager::OverwriteComponents(const char *new_traineddata_filename,
                                           const char **component_filenames, int num_new_components) {
+  // The output may well be the file we have mapped.
+  DetachMappedFile();
   // Open the files with the new components.
   // TODO: This method supports only the proprietary file format.
   for (int i = 0; i < num_new_components; ++i) {
@@ -338,9 +413,13 @@ bool TessdataManager::OverwriteComponents(const char *new_traineddata_filename,
 bool TessdataManager::ExtractToFile(const char *filename) {
   TessdataType type = TESSDATA_NUM_ENTRIES;
   ASSERT_HOST(tesseract::TessdataManager::TessdataTypeFromFileName(filename, &type));
-  if (entries_[type].empty()) {
+  if (EntrySize(type) == 0) {
     return false;
   }
+  if (mapped_entries_[type].data != nullptr) {
+    const char *data = EntryData(type);
+    return SaveDataToFile(std::vector<char>(data, data + EntrySize(type)), filename);
+  }
   return SaveDataToFile(entries_[type], filename);
 }
 
@@ -20,6 +20,7 @@
 #define TESSERACT_CCUTIL_TESSDATAMANAGER_H_
 
 #include <tesseract/baseapi.h> // FileReader
+#include <memory>              // std::shared_ptr
 #include <string>              // std::string
 #include <vector>              // std::vector
 #include "serialis.h"          // FileWriter
@@ -52,9 +53,12 @@ static const char kLSTMNumberDawgFileSuffix[] = "lstm-number-dawg";
 static const char kLSTMUnicharsetFileSuffix[] = "lstm-unicharset";
 static const char kLSTMRecoderFileSuffix[] = "lstm-recoder";
 static const char kVersionFileSuffix[] = "version";
+static const char kLSTMShapedWeightsFileSuffix[] = "lstm-shaped-weights";
 
 namespace tesseract {
 
+class MappedFile;
+
 enum TessdataType {
   TESSDATA_LANG_CONFIG,        // 0
   TESSDATA_UNICHARSET,         // 1
@@ -80,6 +84,7 @@ enum TessdataType {
   TESSDATA_LSTM_UNICHARSET,    // 21
   TESSDATA_LSTM_RECODER,       // 22
   TESSDATA_VERSION,            // 23
+  TESSDATA_LSTM_SHAPED_WEIGHTS, // 24
 
   TESSDATA_NUM_ENTRIES
 };
@@ -113,6 +118,7 @@ static const char *const kTessdataFileSuffixes[] = {
     kLSTMUnicharsetFileSuffix,   // 21
     kLSTMRecoderFileSuffix,      // 22
     kVersionFileSuffix,          // 23
+    kLSTMShapedWeightsFileSuffix, // 24
 };
 
 /**
@@ -142,12 +148,23 @@ public:
   bool is_loaded() const {
     return is_loaded_;
   }
+  // True if the components are read straight from a memory mapped file.
+  bool is_mapped() const {
+    return mapped_file_ != nullptr;
+  }
+  // Enables/disables memory mapping the data file in Init, when no
+  // FileReader was given. Defaults to tessdata_use_mmap.
+  void set_use_mmap(bool value) {
+    use_mmap_ = value;
+  }
 
   // Lazily loads from the given filename. Won't actually read the file
   // until it needs it.
   void LoadFileLater(const char *data_file_name);
   /**
    * Opens and reads the given data file right now.
+   * If memory mapping is enabled, the file is mapped instead of read and
+   * the components are handed out as views of the mapping, without copying.
    * @return true on success.
    */
   bool Init(const char *data_file_name);
@@ -169,7 +186,7 @@ public:
 
   // Returns true if the component requested is present.
   bool IsComponentAvailable(TessdataType type) const {
-    return !entries_[type].empty();
+    return EntrySize(type) != 0;
   }
   // Opens the given TFile pointer to the given component type.
   // Returns false in case of failure.
@@ -178,6 +195,13 @@ public:
   // loaded.
   bool GetComponent(TessdataType type, TFile *fp) const;
 
+  // Sets *data and *size to the contents of the given component, without
+  // copying them, and *owner to the mapping that holds them, if any. Without
+  // an owner, the contents are only valid until *this is changed or
+  // destroyed. Returns false if the component is not present.
+  bool GetComponentView(TessdataType type, const char **data, size_t *size,
+                        std::shared_ptr<const void> *owner) const;
+
   // Returns the current version string.
   std::string VersionString() const;
   // Sets the version string to the given v_str.
@@ -185,12 +209,12 @@ public:
 
   // Returns true if the base Tesseract components are present.
   bool IsBaseAvailable() const {
-    return !entries_[TESSDATA_UNICHARSET].empty() && !entries_[TESSDATA_INTTEMP].empty();
+    return EntrySize(TESSDATA_UNICHARSET) != 0 && EntrySize(TESSDATA_INTTEMP) != 0;
   }
 
   // Returns true if the LSTM components are present.
   bool IsLSTMAvailable() const {
-    return !entries_[TESSDATA_LSTM].empty();
+    return EntrySize(TESSDATA_LSTM) != 0;
   }
 
   // Return the name of the underlying data file.
@@ -226,6 +250,23 @@ public:
   bool ExtractToFile(const char *filename);
 
 private:
+  // Returns the contents of the given entry, which is either owned or a view
+  // of the mapped file.
+  const char *EntryData(TessdataType type) const {
+    return mapped_entries_[type].data != nullptr ? mapped_entries_[type].data : entries_[type].data();
+  }
+  size_t EntrySize(TessdataType type) const {
+    return mapped_entries_[type].data != nullptr ? mapped_entries_[type].size : entries_[type].size();
+  }
+  // Parses the proprietary file format from the given buffer. If mapped is
+  // not null, the components are recorded as views of data, which must
+  // point into the mapping, otherwise they are copied.
+  bool LoadBuffer(const char *name, const char *data, size_t size,
+                  std::shared_ptr<const MappedFile> mapped);
+  // Copies all the mapped components into owned memory and releases the
+  // mapping, so the underlying file may be overwritten.
+  void DetachMappedFile();
+
   // Use libarchive.
   bool LoadArchiveFile(const char *filename);
   bool SaveArchiveFile(const char *filename) const;
@@ -252,8 +293,18 @@ private:
   bool is_loaded_ = false;
   // True if the bytes need swapping.
   bool swap_ = false;
+  // True if Init may memory map the file.
+  bool use_mmap_;
   // Contents of each element of the traineddata file.
   std::vector<char> entries_[TESSDATA_NUM_ENTRIES];
+  // The mapped data file, if any, and the elements which are views of it.
+  // A view takes precedence over the (then empty) owned entry.
+  struct MappedEntry {
+    const char *data = nullptr;
+    size_t size = 0;
+  };
+  std::shared_ptr<const MappedFile> mapped_file_;
+  MappedEntry mapped_entries_[TESSDATA_NUM_ENTRIES];
 };
 
 } // namespace tesseract
@@ -204,6 +204,7 @@ void SetAdaptiveThreshold(float Threshold);
  */
 void Classify::AdaptiveClassifier(TBLOB *Blob, BLOB_CHOICE_LIST *Choices) {
   assert(Choices != nullptr);
+  EnsureTemplatesLoaded();
   auto *Results = new ADAPT_RESULTS;
   Results->Initialize();
 
@@ -266,6 +267,7 @@ void Classify::LearnWord(const char *fontname, WERD_RES *word) {
   if (word_len == 0) {
     return;
   }
+  EnsureTemplatesLoaded();
 
   float *thresholds = nullptr;
   if (fontname == nullptr) {
@@ -392,6 +394,7 @@ void Classify::LearnPieces(const char *fontname, int start, int length, float th
   if (segmentation != CST_WHOLE && (segmentation != CST_FRAGMENT || disable_character_fragments)) {
     return;
   }
+  EnsureTemplatesLoaded();
 
   if (length > 1) {
     SEAM::JoinPieces(word->seam_array, word->chopped_word->blobs, start, start + length - 1);
@@ -508,6 +511,7 @@ void Classify::EndAdaptiveClassifier() {
   shape_table_ = nullptr;
   delete static_classifier_;
   static_classifier_ = nullptr;
+  deferred_templates_.reset();
 } /* EndAdaptiveClassifier */
 
 /*---------------------------------------------------------------------------*/
@@ -516,18 +520,19 @@ void Classify::EndAdaptiveClassifier() {
  * information needed by the adaptive classifier
  * and saves it into global variables.
  *  Parameters:
- *      load_pre_trained_templates  Indicates whether the pre-trained
- *                     templates (inttemp, normproto and pffmtable components)
- *                     should be loaded. Should only be set to true if the
- *                     necessary classifier components are present in the
- *                     [lang].traineddata file.
+ *      mgr            If not null, the pre-trained templates (inttemp,
+ *                     normproto and pffmtable components) are loaded from
+ *                     it. Should only be given if the necessary classifier
+ *                     components are present in the [lang].traineddata file.
+ *      defer_templates  Keep (a cheap copy of) mgr and load the pre-trained
+ *                     templates on first use instead of right now.
  *  Globals:
  *      BuiltInTemplatesFile  file to get built-in temps from
  *      BuiltInCutoffsFile    file to get avg. feat per class from
  *      classify_use_pre_adapted_templates
  *                            enables use of pre-adapted templates
  */
-void Classify::InitAdaptiveClassifier(TessdataManager *mgr) {
+void Classify::InitAdaptiveClassifier(TessdataManager *mgr, bool defer_templates) {
 
 #if !DISABLED_LEGACY_ENGINE
 
@@ -544,25 +549,12 @@ void Classify::InitAdaptiveClassifier(TessdataManager *mgr) {
   // If there is no language_data_path_prefix, the classifier will be
   // adaptive only.
   if (language_data_path_prefix_.length() > 0 && mgr != nullptr) {
-    TFile fp;
-    ASSERT_HOST(mgr->GetComponent(TESSDATA_INTTEMP, &fp));
-    PreTrainedTemplates = ReadIntTemplates(&fp);
-
-    if (mgr->GetComponent(TESSDATA_SHAPE_TABLE, &fp)) {
-      shape_table_ = new ShapeTable(unicharset_);
-      if (!shape_table_->DeSerialize(&fp)) {
-        tprintError("Error loading shape table!\n");
-        delete shape_table_;
-        shape_table_ = nullptr;
-      }
+    // Pre-adapted templates are matched against the cutoffs right below.
+    if (defer_templates && !classify_use_pre_adapted_templates) {
+      deferred_templates_ = std::make_unique<TessdataManager>(*mgr);
+    } else {
+      LoadPreTrainedTemplates(mgr);
     }
-
-    ASSERT_HOST(mgr->GetComponent(TESSDATA_PFFMTABLE, &fp));
-    ReadNewCutoffs(&fp, CharNormCutoffs);
-
-    ASSERT_HOST(mgr->GetComponent(TESSDATA_NORMPROTO, &fp));
-    NormProtos = ReadNormProtos(&fp);
-    static_classifier_ = new TessClassifier(false, this);
   }
 
   InitIntegerFX();
@@ -605,6 +597,38 @@ void Classify::InitAdaptiveClassifier(TessdataManager *mgr) {
 
 } /* InitAdaptiveClassifier */
 
+void Classify::LoadPreTrainedTemplates(TessdataManager *mgr) {
+  TFile fp;
+  ASSERT_HOST(mgr->GetComponent(TESSDATA_INTTEMP, &fp));
+  PreTrainedTemplates = ReadIntTemplates(&fp);
+
+  if (mgr->GetComponent(TESSDATA_SHAPE_TABLE, &fp)) {
+    shape_table_ = new ShapeTable(unicharset_);
+    if (!shape_table_->DeSerialize(&fp)) {
+      tprintError("Error loading shape table!\n");
+      delete shape_table_;
+      shape_table_ = nullptr;
+    }
+  }
+
+  ASSERT_HOST(mgr->GetComponent(TESSDATA_PFFMTABLE, &fp));
+  ReadNewCutoffs(&fp, CharNormCutoffs);
+
+  ASSERT_HOST(mgr->GetComponent(TESSDATA_NORMPROTO, &fp));
+  NormProtos = ReadNormProtos(&fp);
+  static_classifier_ = new TessClassifier(false, this);
+}
+
+void Classify::LoadDeferredTemplates() {
+  // Release the data before the callback, so it can't recurse.
+  std::unique_ptr<TessdataManager> mgr = std::move(deferred_templates_);
+  if (classify_debug_level > 0) {
+    tprintDebug("Loading the deferred classifier templates of {}\n", mgr->GetDataFileName());
+  }
+  LoadPreTrainedTemplates(mgr.get());
+  DeferredTemplatesLoaded();
+}
+
 void Classify::ResetAdaptiveClassifierInternal() {
   if (classify_learning_debug_level > 0) {
     tprintDebug("Resetting adaptive classifier (NumAdaptationsFailed={})\n", NumAdaptationsFailed);
@@ -1300,6 +1324,7 @@ int Classify::CharNormClassifier(TBLOB *blob, const TrainingSample &sample,
 // a vector of ShapeRating without conversion to classes.
 int Classify::CharNormTrainingSample(bool pruner_only, int keep_this, const TrainingSample &sample,
                                      std::vector<UnicharRating> *results) {
+  EnsureTemplatesLoaded();
   results->clear();
   std::unique_ptr<ADAPT_RESULTS> adapt_results(new ADAPT_RESULTS());
   adapt_results->Initialize();
@@ -63,8 +63,11 @@ private:
 #  include "normalis.h"
 #  include "ocrfeatures.h"
 #  include "ratngs.h"
+#  include "tessdatamanager.h"
 #  include "unicity_table.h"
 
+#  include <memory> // std::unique_ptr
+
 namespace tesseract {
 
 class ScrollView;
@@ -169,7 +172,23 @@ public:
   // provided to explicitly clarify the character segmentation.
   void LearnPieces(const char *fontname, int start, int length, float threshold,
                    CharSegmentationType segmentation, const char *correct_text, WERD_RES *word);
-  void InitAdaptiveClassifier(TessdataManager *mgr);
+  // Initializes the adaptive classifier, loading the pre-trained templates
+  // from mgr if given. If defer_templates is true, mgr is kept and the
+  // templates are only loaded by the first classification that needs them.
+  // Tesseract only defers them when mgr is memory mapped (see
+  // TessdataManager::is_mapped), as the copy of mgr is cheap then.
+  void InitAdaptiveClassifier(TessdataManager *mgr, bool defer_templates = false);
+  // Returns true if the pre-trained templates are still waiting to be
+  // loaded on first use.
+  bool HasDeferredTemplates() const {
+    return deferred_templates_ != nullptr;
+  }
+  // Loads the pre-trained templates now, if they have been deferred.
+  void EnsureTemplatesLoaded() {
+    if (deferred_templates_ != nullptr) {
+      LoadDeferredTemplates();
+    }
+  }
   void InitAdaptedClass(TBLOB *Blob, CLASS_ID ClassId, int FontinfoId, ADAPT_CLASS_STRUCT *Class,
                         ADAPT_TEMPLATES_STRUCT *Templates);
   void AmbigClassifier(const std::vector<INT_FEATURE_STRUCT> &int_features,
@@ -326,13 +345,18 @@ public:
                            int *shape_id);
   void ShowMatchDisplay();
   /* font detection ***********************************************************/
+  // The font tables come with the pre-trained templates, so these load any
+  // deferred templates first (see EnsureTemplatesLoaded). The const overload
+  // can't: its table stays empty until the templates have been loaded.
   UnicityTable<FontInfo> &get_fontinfo_table() {
+    EnsureTemplatesLoaded();
     return fontinfo_table_;
   }
   const UnicityTable<FontInfo> &get_fontinfo_table() const {
     return fontinfo_table_;
   }
   UnicityTable<FontSet> &get_fontset_table() {
+    EnsureTemplatesLoaded();
     return fontset_table_;
   }
   /* mfoutline.cpp ***********************************************************/
@@ -448,6 +472,10 @@ public:
   UnicityTable<FontSet> fontset_table_;
 
 protected:
+  // Called after deferred pre-trained templates have been loaded, so that
+  // derived classes can update anything derived from the font tables.
+  virtual void DeferredTemplatesLoaded() {}
+
   IntegerMatcher im_;
   FEATURE_DEFS_STRUCT feature_defs_;
   // If a shape_table_ is present, it is used to remap classifier output in
@@ -457,8 +485,15 @@ protected:
   ShapeTable *shape_table_ = nullptr;
 
 private:
+  // Reads the inttemp, shapetable, pffmtable and normproto components.
+  void LoadPreTrainedTemplates(TessdataManager *mgr);
+  void LoadDeferredTemplates();
+
   // The currently active static classifier.
   ShapeClassifier *static_classifier_ = nullptr;
+  // The traineddata to load the pre-trained templates from on first use,
+  // or nullptr if they have been loaded (or are not used).
+  std::unique_ptr<TessdataManager> deferred_templates_;
 #if !GRAPHICS_DISABLED
   ScrollViewReference learn_debug_win_ = nullptr;
   ScrollViewReference learn_fragmented_word_debug_win_ = nullptr;
@@ -54,25 +54,36 @@ void Convolve::Forward(bool debug, const NetworkIO &input, const TransposedArray
                        NetworkScratch *scratch, NetworkIO *output) {
   output->Resize(input, no_);
   int y_scale = 2 * half_y_ + 1;
-  StrideMap::Index dest_index(output->stride_map());
+  // Each row of the output is the patch around its timestep, so the layer
+  // that follows can multiply all the patches as one contiguous matrix.
+  // The neighbours are found from the strides of the map rather than by
+  // moving an index around, but in the same order, so the random fill
+  // outside the image doesn't change.
+  const StrideMap &stride_map = output->stride_map();
+  int x_stride = stride_map.Stride(FD_WIDTH);
+  int y_stride = stride_map.Stride(FD_HEIGHT);
+  StrideMap::Index dest_index(stride_map);
   do {
     // Stack x_scale groups of y_scale * ni_ inputs together.
     int t = dest_index.t();
+    int x = dest_index.index(FD_WIDTH);
+    int y = dest_index.index(FD_HEIGHT);
+    int max_x = dest_index.MaxIndexOfDim(FD_WIDTH);
+    int max_y = dest_index.MaxIndexOfDim(FD_HEIGHT);
     int out_ix = 0;
-    for (int x = -half_x_; x <= half_x_; ++x, out_ix += y_scale * ni_) {
-      StrideMap::Index x_index(dest_index);
-      if (!x_index.AddOffset(x, FD_WIDTH)) {
+    for (int dx = -half_x_; dx <= half_x_; ++dx, out_ix += y_scale * ni_) {
+      if (x + dx < 0 || x + dx > max_x) {
         // This x is outside the image.
         output->Randomize(t, out_ix, y_scale * ni_, randomizer_);
       } else {
         int out_iy = out_ix;
-        for (int y = -half_y_; y <= half_y_; ++y, out_iy += ni_) {
-          StrideMap::Index y_index(x_index);
-          if (!y_index.AddOffset(y, FD_HEIGHT)) {
+        for (int dy = -half_y_; dy <= half_y_; ++dy, out_iy += ni_) {
+          if (y + dy < 0 || y + dy > max_y) {
             // This y is outside the image.
             output->Randomize(t, out_iy, ni_, randomizer_);
           } else {
-            output->CopyTimeStepGeneral(t, out_iy, ni_, input, y_index.t(), 0);
+            output->CopyTimeStepGeneral(t, out_iy, ni_, input, t + dx * x_stride + dy * y_stride,
+                                        0);
           }
         }
       }
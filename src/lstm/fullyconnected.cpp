@@ -17,92 +17,28 @@
 
 #include <tesseract/preparation.h> // compiler config, etc.
 
-#if defined(HAVE_MUPDF) || defined(BUILD_MONOLITHIC)
-#include "mupdf/fitz.h"
-#include "mupdf/helpers/cpu.h"
-#include "mupdf/assertions.h"     // for ASSERT
-#else
-static const int fz_get_cpu_core_count()
-{
-	return 1;   // TODO/HACK
-}
-#endif
-
 #include "fullyconnected.h"
 
-// 21843 ms
-#undef _OPENMP
-
-#ifdef _OPENMP
-#  include <omp.h>
-#endif
+#include <algorithm> // for std::min
 #include <cstdio>
 #include <cstdlib>
 
 #include "functions.h"
 #include "networkscratch.h"
 
-// Number of threads to use for parallel calculation of Forward and Backward.
-#define THREADPOOL
-#if defined(THREADPOOL)
-#include <atomic> // for std::atomic
-#include <thread_pool.hpp>
-// no thread pool // 22540 ms
-//const int kNumThreads = 2; // 30602 ms
-//const int kNumThreads = 4; // 26940 ms
-//const int kNumThreads = 4; // 21829 ms
-//const int kNumThreads = 4; // 23965 ms
-//const int kNumThreads = 8; // 26253 ms
-//const int kNumThreads = 8; // 22506 ms
-//const int kNumThreads = 8; // 22121 ms
-//const int kNumThreads = 16; // 25916 ms
-//const int kNumThreads = 16; // 21497 ms
-//const int kNumThreads = 16; // 21668 ms
-//const int kNumThreads = 24; // 21497 ms
-//const int kNumThreads = 24; // 20761 ms
-//const int kNumThreads = 24; // 20938 ms
-//static const size_t kNumThreads = 24; // 20640 ms
-//const int kNumThreads = 48; // 22425 ms
-//
-// While the above, setting kNumThreads to 24, may have worked for Stefan on EPYC or similar UniMannheim hardware, the key take-away
-// from the threadpool benchmarks (vanilla and augmented) is that the number of threads SHOULD equal your number CPU (virtual) cores on
-// lightly loaded machines. The augmented benchmark shows that you're often even better off (if only a little) when you limit your threads
-// to "one less" so your regular (large core count) machine, which has other jobs to do alongside this, has one core left for "other stuff"
-// (like running an app, GUI and OS). The augmented threadpool code would get this encoded as...
-//static const int kNumThreads = -1;
-// ... but we're going for broke here and expect benchmarks to usually run on otherwise unburdened heavy-duty hardware, so as to optimize
-// for those, we just say TAKE IT ALL:
-static const int kNumThreads = std::max(1, fz_get_cpu_core_count());
-static BS::thread_pool *pool = nullptr;
-static int pool_ref_count = 0;
-#elif defined(_OPENMP)
-static const int kNumThreads = 4;
-#else
-static const int kNumThreads = 1;
-#endif
-
 namespace tesseract {
 
+// Number of timesteps that Forward multiplies by the weights at once.
+const int kTimeStepBlockSize = 16;
+
 FullyConnected::FullyConnected(const std::string &name, int ni, int no,
                                NetworkType type)
     : Network(type, name, ni, no),
       external_source_(nullptr),
       int_mode_(false) {
-    if (!pool) {
-        pool = new BS::thread_pool(kNumThreads);
-        pool_ref_count = 1;
-    }
-    else {
-        pool_ref_count++;
-    }
 }
 
-FullyConnected::~FullyConnected() {
-    if (pool && --pool_ref_count == 0) {
-        delete pool;
-        pool = nullptr;
-    }
-}
+FullyConnected::~FullyConnected() = default;
 
 // Returns the shape output from the network given an input shape (which may
 // be partially unknown ie zero).
@@ -166,6 +102,11 @@ void FullyConnected::ConvertToInt() {
   weights_.ConvertToInt();
 }
 
+// Makes the weights a read-only view of those of src.
+void FullyConnected::ShareWeights(const Network &src) {
+  weights_.ShareWeights(static_cast<const FullyConnected &>(src).weights_);
+}
+
 // Provides debug output on the weights.
 void FullyConnected::DebugWeights() {
   weights_.Debug2D(name_.c_str());
@@ -199,111 +140,68 @@ void FullyConnected::Forward(bool debug, const NetworkIO &input,
     output->Resize(input, no_);
   }
   SetupForward(input, input_transpose);
-#if defined(THREADPOOL)
-  ASSERT0(kNumThreads > 0);
-  std::vector<NetworkScratch::FloatVec> local_scratch(2 * kNumThreads);
-  auto *curr_input = &local_scratch[0];
-  auto *temp_lines = &local_scratch[kNumThreads];
+  // The time steps are independent, so they are spread over the threads of
+  // the engine, each with its own temporary storage.
+  const TaskScheduler &scheduler = scratch->scheduler();
+  int num_slots = scheduler.MaxConcurrency();
   int ro = no_;
   if (IntSimdMatrix::intSimdMatrix) {
     ro = IntSimdMatrix::intSimdMatrix->RoundOutputs(ro);
   }
-  for (unsigned i = 0; i < kNumThreads; ++i) {
-    temp_lines[i].Init(ro, scratch);
-    curr_input[i].Init(ni_, scratch);
-  }
-  std::atomic<int> num_threads = 0;
-  if (input.int_mode()) {
-    pool->parallelize_loop(0, width,
-      [this, &input, &output, &num_threads, &temp_lines](const int &start, const int &end) {
-      // Thread-local pointer to temporary storage.
-      int thread_id = num_threads++;
-      TFloat *temp_line = temp_lines[thread_id];
-      bool needsCopyTimeStepFrom = IsTraining() && type_ != NT_SOFTMAX;
-      for (int t = start; t < end; t++) {
-        ForwardTimeStep(input.i(t), t, temp_line);
-        output->WriteTimeStep(t, temp_line);
-        if (needsCopyTimeStepFrom) {
-          acts_.CopyTimeStepFrom(t, *output, t);
-        }
+  if (!IsTraining()) {
+    // Nothing is recorded per timestep, so blocks of timesteps go through the
+    // weights in one multiply, with the blocks spread over the threads.
+    std::vector<NetworkScratch::FloatVec> in_blocks(num_slots);
+    std::vector<NetworkScratch::FloatVec> out_blocks(num_slots);
+    for (int i = 0; i < num_slots; ++i) {
+      if (!input.int_mode()) {
+        in_blocks[i].Init(kTimeStepBlockSize * ni_, scratch);
       }
-    }).get();
-	pool->wait_for_tasks();
-  } else if (IsTraining() && type_ != NT_SOFTMAX) {
-    pool->parallelize_loop(0, width,
-      [this, &input, &output, &num_threads, &temp_lines, &curr_input](const int &start, const int &end) {
-      // Thread-local pointer to temporary storage.
-      int thread_id = num_threads++;
-      TFloat *temp_line = temp_lines[thread_id];
-      for (int t = start; t < end; t++) {
-        input.ReadTimeStep(t, curr_input[thread_id]);
-        ForwardTimeStep(curr_input[thread_id], t, temp_line);
-        output->WriteTimeStep(t, temp_line);
-        acts_.CopyTimeStepFrom(t, *output, t);
+      out_blocks[i].Init(kTimeStepBlockSize * ro, scratch);
+    }
+    scheduler.ParallelFor(width, [&](int slot, int start, int end) {
+      TFloat *out_block = out_blocks[slot];
+      for (int t = start; t < end; t += kTimeStepBlockSize) {
+        int block_size = std::min(kTimeStepBlockSize, end - t);
+        if (input.int_mode()) {
+          weights_.MatrixDotVectors(block_size, input.i(t), input.NumFeatures(), out_block, ro);
+        } else {
+          TFloat *in_block = in_blocks[slot];
+          for (int b = 0; b < block_size; ++b) {
+            input.ReadTimeStep(t + b, in_block + b * ni_);
+          }
+          weights_.MatrixDotVectors(block_size, in_block, ni_, out_block, ro);
+        }
+        for (int b = 0; b < block_size; ++b) {
+          ForwardTimeStep(t + b, out_block + b * ro);
+          output->WriteTimeStep(t + b, out_block + b * ro);
+        }
       }
-    }).get();
-	pool->wait_for_tasks();
+    });
   } else {
-    pool->parallelize_loop(0, width,
-      [this, &input, &output, &num_threads, &temp_lines, &curr_input](const int &start, const int &end) {
-      // Thread-local pointer to temporary storage.
-      int thread_id = num_threads++;
-      TFloat *temp_line = temp_lines[thread_id];
-      for (int t = start; t < end; t++) {
-        input.ReadTimeStep(t, curr_input[thread_id]);
-        ForwardTimeStep(curr_input[thread_id], t, temp_line);
+    std::vector<NetworkScratch::FloatVec> curr_input(num_slots);
+    std::vector<NetworkScratch::FloatVec> temp_lines(num_slots);
+    for (int i = 0; i < num_slots; ++i) {
+      temp_lines[i].Init(ro, scratch);
+      curr_input[i].Init(ni_, scratch);
+    }
+    bool copy_acts = type_ != NT_SOFTMAX;
+    scheduler.ParallelFor(width, [&](int slot, int start, int end) {
+      TFloat *temp_line = temp_lines[slot];
+      for (int t = start; t < end; ++t) {
+        if (input.int_mode()) {
+          ForwardTimeStep(input.i(t), t, temp_line);
+        } else {
+          input.ReadTimeStep(t, curr_input[slot]);
+          ForwardTimeStep(curr_input[slot], t, temp_line);
+        }
         output->WriteTimeStep(t, temp_line);
+        if (copy_acts) {
+          acts_.CopyTimeStepFrom(t, *output, t);
+        }
       }
-    }).get();
-	pool->wait_for_tasks();
-  }
-#else // THREADPOOL
-  ASSERT0(kNumThreads > 0);
-  std::vector<NetworkScratch::FloatVec> local_scratch(2 * kNumThreads);
-  auto *curr_input = &local_scratch[0];
-  auto *temp_lines = &local_scratch[kNumThreads];
-  int ro = no_;
-  if (IntSimdMatrix::intSimdMatrix) {
-    ro = IntSimdMatrix::intSimdMatrix->RoundOutputs(ro);
-  }
-  for (int i = 0; i < kNumThreads; ++i) {
-    temp_lines[i].Init(ro, scratch);
-    curr_input[i].Init(ni_, scratch);
-  }
-#ifdef _OPENMP
-#  pragma omp parallel for num_threads(kNumThreads)
-  for (int t = 0; t < width; ++t) {
-    // Thread-local pointer to temporary storage.
-    int thread_id = omp_get_thread_num();
-    TFloat *temp_line = temp_lines[thread_id];
-    if (input.int_mode()) {
-      ForwardTimeStep(input.i(t), t, temp_line);
-    } else {
-      input.ReadTimeStep(t, curr_input[thread_id]);
-      ForwardTimeStep(curr_input[thread_id], t, temp_line);
-    }
-    output->WriteTimeStep(t, temp_line);
-    if (IsTraining() && type_ != NT_SOFTMAX) {
-      acts_.CopyTimeStepFrom(t, *output, t);
-    }
-  }
-#else // _OPENMP
-  const unsigned int thread_id = 0;
-  TFloat *temp_line = temp_lines[thread_id];
-  for (int t = 0; t < width; ++t) {
-    if (input.int_mode()) {
-      ForwardTimeStep(input.i(t), t, temp_line);
-    } else {
-      input.ReadTimeStep(t, curr_input[thread_id]);
-      ForwardTimeStep(curr_input[thread_id], t, temp_line);
-    }
-    output->WriteTimeStep(t, temp_line);
-    if (IsTraining() && type_ != NT_SOFTMAX) {
-      acts_.CopyTimeStepFrom(t, *output, t);
-    }
+    });
   }
-#endif // _OPENMP
-#endif // THREADPOOL
   // Zero all the elements that are in the padding around images that allows
   // multiple different-sized images to exist in a single array.
   // acts_ is only used if this is not a softmax op.
@@ -382,84 +280,33 @@ bool FullyConnected::Backward(bool debug, const NetworkIO &fwd_deltas,
   }
 #endif
   back_deltas->Resize(fwd_deltas, ni_);
-  std::vector<NetworkScratch::FloatVec> errors(kNumThreads);
-  for (int i = 0; i < kNumThreads; ++i) {
+  const TaskScheduler &scheduler = scratch->scheduler();
+  int num_slots = scheduler.MaxConcurrency();
+  std::vector<NetworkScratch::FloatVec> errors(num_slots);
+  std::vector<NetworkScratch::FloatVec> temp_backprops;
+  for (int i = 0; i < num_slots; ++i) {
     errors[i].Init(no_, scratch);
   }
-  int width = fwd_deltas.Width();
-  NetworkScratch::GradientStore errors_t;
-  errors_t.Init(no_, width, scratch);
-#if defined(THREADPOOL)
-  std::atomic<unsigned> num_threads = 0;
   if (needs_to_backprop_) {
-    std::vector<NetworkScratch::FloatVec> temp_backprops(kNumThreads);
-    pool->parallelize_loop(0, width,
-      [this, &back_deltas, &fwd_deltas, &temp_backprops, &errors, &errors_t, &num_threads](const unsigned &start, const unsigned &end) {
-      // Thread-local pointer to temporary storage.
-      unsigned thread_id = num_threads++;
-      TFloat *curr_errors = errors[thread_id];
-      TFloat *backprop = temp_backprops[thread_id];
-      for (unsigned t = start; t < end; t++) {
-        BackwardTimeStep(fwd_deltas, t, curr_errors, errors_t.get(), backprop);
-        back_deltas->WriteTimeStep(t, backprop);
-      }
-    }).get();
-	pool->wait_for_tasks();
-  } else {
-    pool->parallelize_loop(0, width,
-      [this, &fwd_deltas, &errors, &errors_t, &num_threads](const unsigned &start, const unsigned &end) {
-      // Thread-local pointer to temporary storage.
-      unsigned thread_id = num_threads++;
-      TFloat *curr_errors = errors[thread_id];
-      for (unsigned t = start; t < end; t++) {
-        BackwardTimeStep(fwd_deltas, t, curr_errors, errors_t.get(), nullptr);
-      }
-    }).get();
-	pool->wait_for_tasks();
-  }
-#else
-#ifdef _OPENMP
-  std::vector<NetworkScratch::FloatVec> temp_backprops;
-  if (needs_to_backprop_) {
-    temp_backprops.resize(kNumThreads);
-    for (int i = 0; i < kNumThreads; ++i) {
+    temp_backprops.resize(num_slots);
+    for (int i = 0; i < num_slots; ++i) {
       temp_backprops[i].Init(ni_, scratch);
     }
   }
-#  pragma omp parallel for num_threads(kNumThreads)
-  for (int t = 0; t < width; ++t) {
-    int thread_id = omp_get_thread_num();
-    TFloat *backprop = nullptr;
-    if (needs_to_backprop_) {
-      backprop = temp_backprops[thread_id];
-    }
-    TFloat *curr_errors = errors[thread_id];
-    BackwardTimeStep(fwd_deltas, t, curr_errors, errors_t.get(), backprop);
-    if (backprop != nullptr) {
-      back_deltas->WriteTimeStep(t, backprop);
-    }
-  }
-#else // _OPENMP
-  int thread_id = 0;
-  TFloat *curr_errors = errors[thread_id];
-  if (needs_to_backprop_) {
-    std::vector<NetworkScratch::FloatVec> temp_backprops(kNumThreads);
-    for (int i = 0; i < kNumThreads; ++i) {
-      temp_backprops[i].Init(ni_, scratch);
-    }
-    TFloat *backprop = temp_backprops[thread_id];
-    for (int t = 0; t < width; ++t) {
+  int width = fwd_deltas.Width();
+  NetworkScratch::GradientStore errors_t;
+  errors_t.Init(no_, width, scratch);
+  scheduler.ParallelFor(width, [&](int slot, int start, int end) {
+    TFloat *curr_errors = errors[slot];
+    TFloat *backprop = needs_to_backprop_ ? static_cast<TFloat *>(temp_backprops[slot]) : nullptr;
+    for (int t = start; t < end; ++t) {
       BackwardTimeStep(fwd_deltas, t, curr_errors, errors_t.get(), backprop);
-      back_deltas->WriteTimeStep(t, backprop);
-    }
-  } else {
-    for (int t = 0; t < width; ++t) {
-      BackwardTimeStep(fwd_deltas, t, curr_errors, errors_t.get(), nullptr);
+      if (backprop != nullptr) {
+        back_deltas->WriteTimeStep(t, backprop);
+      }
     }
-  }
-#endif // _OPENMP
-#endif // THREADPOOL
-  FinishBackward(*errors_t.get());
+  });
+  FinishBackward(*errors_t.get(), scheduler);
   if (needs_to_backprop_) {
     back_deltas->ZeroInvalidElements();
 #if DEBUG_DETAIL > 0
@@ -498,11 +345,12 @@ void FullyConnected::BackwardTimeStep(const NetworkIO &fwd_deltas, int t,
   errors_t->WriteStrided(t, curr_errors);
 }
 
-void FullyConnected::FinishBackward(const TransposedArray &errors_t) {
+void FullyConnected::FinishBackward(const TransposedArray &errors_t,
+                                    const TaskScheduler &scheduler) {
   if (external_source_ == nullptr) {
-    weights_.SumOuterTransposed(errors_t, source_t_, true);
+    weights_.SumOuterTransposed(errors_t, source_t_, &scheduler);
   } else {
-    weights_.SumOuterTransposed(errors_t, *external_source_, true);
+    weights_.SumOuterTransposed(errors_t, *external_source_, &scheduler);
   }
 }
 
@@ -523,4 +371,14 @@ void FullyConnected::CountAlternators(const Network &other, TFloat *same,
   weights_.CountAlternators(fc->weights_, same, changed);
 }
 
+// Replaces the weight deltas by the sum of those of replicas.
+void FullyConnected::SumDeltas(const std::vector<const Network *> &replicas) {
+  std::vector<const WeightMatrix *> weights;
+  for (const auto *replica : replicas) {
+    ASSERT_HOST(replica->type() == type_);
+    weights.push_back(&static_cast<const FullyConnected *>(replica)->weights_);
+  }
+  weights_.SumDeltas(weights);
+}
+
 } // namespace tesseract.
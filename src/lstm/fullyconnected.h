@@ -77,6 +77,24 @@ public:
   // Converts a float network to an int network.
   void ConvertToInt() override;
 
+  // Makes the weights a read-only view of those of src.
+  void ShareWeights(const Network &src) override;
+
+  // Provides read-only access to the weights.
+  const WeightMatrix &weights() const {
+    return weights_;
+  }
+
+  // Appends the shape of the weight matrix.
+  void GetMatrixShapes(std::vector<MatrixShape> *shapes) const override {
+    shapes->push_back(weights_.Shape());
+  }
+
+  // Shapes the weights if that was deferred.
+  void ShapeWeights() override {
+    weights_.ShapeWeights();
+  }
+
   // Provides debug output on the weights.
   void DebugWeights() override;
 
@@ -104,7 +122,7 @@ public:
   // Components of Backward so FullyConnected can be reused inside LSTM.
   void BackwardTimeStep(const NetworkIO &fwd_deltas, int t, TFloat *curr_errors,
                         TransposedArray *errors_t, TFloat *backprop);
-  void FinishBackward(const TransposedArray &errors_t);
+  void FinishBackward(const TransposedArray &errors_t, const TaskScheduler &scheduler);
 
   // Updates the weights using the given learning rate, momentum and adam_beta.
   // num_samples is used in the adam computation iff use_adam_ is true.
@@ -115,6 +133,8 @@ public:
   // *changed.
   void CountAlternators(const Network &other, TFloat *same,
                         TFloat *changed) const override;
+  // Replaces the weight deltas by the sum of those of replicas.
+  void SumDeltas(const std::vector<const Network *> &replicas) override;
 
 protected:
   // Weight arrays of size [no, ni + 1].
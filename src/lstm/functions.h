@@ -19,6 +19,7 @@
 #define TESSERACT_LSTM_FUNCTIONS_H_
 
 #include "helpers.h"
+#include "simddetect.h" // for TableActivation
 #include "tesstypes.h"
 
 // Setting this to 1 or more causes massive dumps of debug data: weights,
@@ -35,6 +36,8 @@ namespace tesseract {
 constexpr int kTableSize = 4096;
 // Scale factor for float arg to int index.
 constexpr TFloat kScaleFactor = 256.0;
+static_assert(kTableSize == kActivationTableSize && kScaleFactor == kActivationScale,
+              "The vectorized sigmoid functions use the same tables");
 
 // Generated lookup tables.
 extern const TFloat TanhTable[];
@@ -176,6 +179,34 @@ inline void FuncMultiply(const TFloat *u, const TFloat *v, int n, TFloat *out) {
     out[i] = f(u[i]) * v[i];
   }
 }
+// The table based sigmoid functions are applied to whole vectors by the best
+// SIMD implementation available, see activations.h.
+template <>
+inline void FuncInplace<GFunc>(int n, TFloat *inout) {
+  TableActivation(TanhTable, true, n, inout);
+}
+template <>
+inline void FuncInplace<FFunc>(int n, TFloat *inout) {
+  TableActivation(LogisticTable, false, n, inout);
+}
+template <>
+inline void FuncMultiply<HFunc>(const TFloat *u, const TFloat *v, int n, TFloat *out) {
+  if (out == v) {
+    // The vector version needs out as scratch space.
+    HFunc f;
+    for (int i = 0; i < n; ++i) {
+      out[i] = f(u[i]) * v[i];
+    }
+    return;
+  }
+  if (out != u) {
+    memcpy(out, u, n * sizeof(out[0]));
+  }
+  TableActivation(TanhTable, true, n, out);
+  for (int i = 0; i < n; ++i) {
+    out[i] *= v[i];
+  }
+}
 // Applies the Softmax function in-place to inout, of size n.
 template <typename T>
 inline void SoftmaxInPlace(int n, T *inout) {
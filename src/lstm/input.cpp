@@ -99,15 +99,13 @@ Image Input::PrepareLSTMInputs(const ImageData &image_data, const Network *netwo
   return pix;
 }
 
-// Converts the given pix to a NetworkIO of height and depth appropriate to the
-// given StaticShape:
-// If depth == 3, convert to 24 bit color, otherwise normalized grey.
-// Scale to target height, if the shape's height is > 1, or its depth if the
-// height == 1. If height == 0 then no scaling.
+// Converts the given pix to a new Pix of height and depth appropriate to the
+// given StaticShape, as described for PreparePixInput. The caller owns the
+// result.
 // NOTE: It isn't safe for multiple threads to call this on the same pix.
 /* static */
-void Input::PreparePixInput(Tesseract *tess, const StaticShape &shape, const Image pix, TRand *randomizer,
-                            NetworkIO *input, const TBOX &line_box, float scale_factor) {
+Image Input::NormalizePix(Tesseract *tess, const StaticShape &shape, const Image pix,
+                          const TBOX &line_box, float scale_factor) {
   bool color = shape.depth() == 3;
   Image var_pix = pix;
   int depth = pixGetDepth(var_pix);
@@ -148,8 +146,41 @@ void Input::PreparePixInput(Tesseract *tess, const StaticShape &shape, const Ima
   {
       tess->AddPixCompedOverOrigDebugPage(normed_pix, fmt::format("LSTM normed input image: prepare to recognize one line of text. (height:{}, target_height:{}, scale_factor:{}, position box:{})", height, target_height, scale_factor, line_box.print_to_str()));
   }
+  return normed_pix;
+}
+
+// Converts the given pix to a NetworkIO of height and depth appropriate to the
+// given StaticShape:
+// If depth == 3, convert to 24 bit color, otherwise normalized grey.
+// Scale to target height, if the shape's height is > 1, or its depth if the
+// height == 1. If height == 0 then no scaling.
+// NOTE: It isn't safe for multiple threads to call this on the same pix.
+/* static */
+void Input::PreparePixInput(Tesseract *tess, const StaticShape &shape, const Image pix, TRand *randomizer,
+                            NetworkIO *input, const TBOX &line_box, float scale_factor) {
+  Image normed_pix = NormalizePix(tess, shape, pix, line_box, scale_factor);
   input->FromPix(shape, normed_pix, randomizer);
   normed_pix.destroy();
 }
 
+// As PreparePixInput, but packs all the given pixes into a single batched
+// NetworkIO, one batch element per pix, padded to the widest of them.
+/* static */
+void Input::PreparePixBatchInput(Tesseract *tess, const StaticShape &shape,
+                                 const std::vector<Image> &pixes,
+                                 const std::vector<TBOX> &line_boxes,
+                                 const std::vector<float> &scale_factors,
+                                 TRand *randomizer, NetworkIO *input) {
+  std::vector<Image> normed_pixes;
+  normed_pixes.reserve(pixes.size());
+  for (size_t i = 0; i < pixes.size(); ++i) {
+    normed_pixes.push_back(
+        NormalizePix(tess, shape, pixes[i], line_boxes[i], scale_factors[i]));
+  }
+  input->FromPixes(shape, normed_pixes, randomizer);
+  for (auto &normed_pix : normed_pixes) {
+    normed_pix.destroy();
+  }
+}
+
 } // namespace tesseract.
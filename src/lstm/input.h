@@ -95,8 +95,22 @@ public:
   static void PreparePixInput(Tesseract *tess, const StaticShape &shape, const Image pix,
                               TRand *randomizer, NetworkIO *input,
                               const TBOX &line_box, float scale_factor);
+  // As PreparePixInput, but packs all the given pixes into a single batched
+  // NetworkIO, one batch element per pix, padded to the widest of them.
+  // line_boxes and scale_factors are only used for debug output and must
+  // have the same size as pixes.
+  static void PreparePixBatchInput(Tesseract *tess, const StaticShape &shape,
+                                   const std::vector<Image> &pixes,
+                                   const std::vector<TBOX> &line_boxes,
+                                   const std::vector<float> &scale_factors,
+                                   TRand *randomizer, NetworkIO *input);
 
 private:
+  // Returns a new Pix converted to the depth and height required by shape.
+  static Image NormalizePix(Tesseract *tess, const StaticShape &shape,
+                            const Image pix, const TBOX &line_box,
+                            float scale_factor);
+
   void DebugWeights() override {
     tprintError("Must override Network::DebugWeights for type {}\n", type_);
   }
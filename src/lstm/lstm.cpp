@@ -104,6 +104,7 @@ LSTM::LSTM(const std::string &name, int ni, int ns, int no, bool two_dimensional
     , ns_(ns)
     , nf_(0)
     , is_2d_(two_dimensional)
+    , split_weights_(false)
     , softmax_(nullptr)
     , input_width_(0) {
   if (two_dimensional) {
@@ -155,6 +156,8 @@ void LSTM::SetEnableTraining(TrainingState state) {
     }
   } else {
     if (state == TS_ENABLED && training_ != TS_ENABLED) {
+      // The weights are about to change.
+      JoinSplitWeights();
       for (int w = 0; w < WT_COUNT; ++w) {
         if (w == GFS && !Is2D()) {
           continue;
@@ -199,6 +202,8 @@ int LSTM::RemapOutputs(int old_no, const std::vector<int> &code_map) {
 
 // Converts a float network to an int network.
 void LSTM::ConvertToInt() {
+  bool split = split_weights_;
+  JoinSplitWeights();
   for (int w = 0; w < WT_COUNT; ++w) {
     if (w == GFS && !Is2D()) {
       continue;
@@ -208,6 +213,132 @@ void LSTM::ConvertToInt() {
   if (softmax_ != nullptr) {
     softmax_->ConvertToInt();
   }
+  if (split) {
+    SplitGateWeights();
+  }
+}
+
+// Makes the gate (and softmax) weights read-only views of those of src.
+void LSTM::ShareWeights(const Network &src) {
+  const auto &lstm = static_cast<const LSTM &>(src);
+  for (int w = 0; w < WT_COUNT; ++w) {
+    if (w == GFS && !Is2D()) {
+      continue;
+    }
+    if (lstm.split_weights_) {
+      gate_weights_[w].Clear();
+      input_weights_[w].ShareWeights(lstm.input_weights_[w]);
+      recurrent_weights_[w].ShareWeights(lstm.recurrent_weights_[w]);
+    } else {
+      gate_weights_[w].ShareWeights(lstm.gate_weights_[w]);
+    }
+  }
+  if (!lstm.split_weights_) {
+    ClearSplitWeights();
+  }
+  split_weights_ = lstm.split_weights_;
+  if (softmax_ != nullptr) {
+    ASSERT_HOST(lstm.softmax_ != nullptr);
+    softmax_->ShareWeights(*lstm.softmax_);
+  }
+}
+
+// Appends the shapes of the gate (and softmax) weight matrices.
+void LSTM::GetMatrixShapes(std::vector<MatrixShape> *shapes) const {
+  for (int w = 0; w < WT_COUNT; ++w) {
+    if (w == GFS && !Is2D()) {
+      continue;
+    }
+    if (split_weights_) {
+      shapes->push_back(input_weights_[w].Shape());
+      shapes->push_back(recurrent_weights_[w].Shape());
+    } else {
+      shapes->push_back(gate_weights_[w].Shape());
+    }
+  }
+  if (softmax_ != nullptr) {
+    softmax_->GetMatrixShapes(shapes);
+  }
+}
+
+// Shapes the softmax and gate weights, in the order of DeSerialize, which
+// splits the gates after loading the softmax.
+void LSTM::ShapeWeights() {
+  if (softmax_ != nullptr) {
+    softmax_->ShapeWeights();
+  }
+  for (int w = 0; w < WT_COUNT; ++w) {
+    if (w == GFS && !Is2D()) {
+      continue;
+    }
+    if (split_weights_) {
+      input_weights_[w].ShapeWeights();
+      recurrent_weights_[w].ShapeWeights();
+    } else {
+      gate_weights_[w].ShapeWeights();
+    }
+  }
+}
+
+// Replaces gate_weights_ with input_weights_ and recurrent_weights_.
+void LSTM::SplitGateWeights() {
+  for (int w = 0; w < WT_COUNT; ++w) {
+    if (w == GFS && !Is2D()) {
+      continue;
+    }
+    input_weights_[w].InitFromColumns(gate_weights_[w], 0, ni_, true);
+    recurrent_weights_[w].InitFromColumns(gate_weights_[w], ni_, na_, false);
+    gate_weights_[w].Clear();
+  }
+  split_weights_ = true;
+}
+
+// Rebuilds gate_weights_ from input_weights_ and recurrent_weights_, if
+// split, and frees the latter.
+void LSTM::JoinSplitWeights() {
+  if (split_weights_) {
+    for (int w = 0; w < WT_COUNT; ++w) {
+      if (w == GFS && !Is2D()) {
+        continue;
+      }
+      gate_weights_[w].InitFromJoin(input_weights_[w], recurrent_weights_[w]);
+    }
+  }
+  ClearSplitWeights();
+}
+
+// Returns gate_weights_[w], or, if split, a copy of it rebuilt in *joined.
+const WeightMatrix &LSTM::GateWeights(int w, WeightMatrix *joined) const {
+  if (!split_weights_) {
+    return gate_weights_[w];
+  }
+  joined->InitFromJoin(input_weights_[w], recurrent_weights_[w]);
+  return *joined;
+}
+
+// Frees input_weights_ and recurrent_weights_.
+void LSTM::ClearSplitWeights() {
+  for (int w = 0; w < WT_COUNT; ++w) {
+    input_weights_[w].Clear();
+    recurrent_weights_[w].Clear();
+  }
+  split_weights_ = false;
+}
+
+// Computes the product of gate w with the source vector of the current
+// timestep into result, adding input_part if not null.
+void LSTM::GateProduct(WeightType w, bool int_mode, const int8_t *int_source,
+                       const TFloat *float_source, const TFloat *input_part,
+                       TFloat *result) const {
+  const WeightMatrix &weights = input_part != nullptr ? recurrent_weights_[w] : gate_weights_[w];
+  if (int_mode) {
+    weights.MatrixDotVector(int_source, result);
+  } else {
+    weights.MatrixDotVector(float_source, result);
+  }
+  if (input_part != nullptr) {
+    AccumulateVector(ns_, input_part, result);
+  }
 }
 
 // Sets up the network for training using the given weight_range.
@@ -218,7 +349,8 @@ void LSTM::DebugWeights() {
     }
     std::ostringstream msg;
     msg << name_ << " Gate weights " << w;
-    gate_weights_[w].Debug2D(msg.str().c_str());
+    WeightMatrix joined;
+    GateWeights(w, &joined).Debug2D(msg.str().c_str());
   }
   if (softmax_ != nullptr) {
     softmax_->DebugWeights();
@@ -237,7 +369,13 @@ bool LSTM::Serialize(TFile *fp) const {
     if (w == GFS && !Is2D()) {
       continue;
     }
-    if (!gate_weights_[w].Serialize(IsTraining(), fp)) {
+    // Split weights that are shared are written as a reference, which is
+    // the same for a part as for the whole, so they needn't be joined.
+    WeightMatrix joined;
+    const WeightMatrix &weights = split_weights_ && input_weights_[w].is_shared()
+                                      ? input_weights_[w]
+                                      : GateWeights(w, &joined);
+    if (!weights.Serialize(IsTraining(), fp)) {
       return false;
     }
   }
@@ -265,7 +403,8 @@ bool LSTM::DeSerialize(TFile *fp) {
     if (w == GFS && !Is2D()) {
       continue;
     }
-    if (!gate_weights_[w].DeSerialize(IsTraining(), fp)) {
+    // At inference the weights are split below, and only the parts are used.
+    if (!gate_weights_[w].DeSerialize(IsTraining(), fp, IsTraining())) {
       return false;
     }
     if (w == CI) {
@@ -282,6 +421,10 @@ bool LSTM::DeSerialize(TFile *fp) {
   } else {
     softmax_ = nullptr;
   }
+  // References to shared weights get the split parts from ShareWeights.
+  if (!IsTraining() && !gate_weights_[CI].awaits_weights()) {
+    SplitGateWeights();
+  }
   return true;
 }
 
@@ -289,6 +432,22 @@ bool LSTM::DeSerialize(TFile *fp) {
 // See NetworkCpp for a detailed discussion of the arguments.
 void LSTM::Forward(bool debug, const NetworkIO &input, const TransposedArray *input_transpose,
                    NetworkScratch *scratch, NetworkIO *output) {
+  RunForward(debug, input, scratch, output, false);
+}
+
+// Runs Forward on the input with its x-direction reversed, and reverses the
+// result back, without making the reversed copies.
+void LSTM::ForwardXReversed(bool debug, const NetworkIO &input, NetworkScratch *scratch,
+                            NetworkIO *output) {
+  ASSERT_HOST(CanRunXReversed());
+  RunForward(debug, input, scratch, output, true);
+}
+
+// Implements Forward, visiting the timesteps of each row from right to left
+// if x_reversed. As the rows are independent, that gives the same result as
+// running forward on a copy of the input with every row reversed.
+void LSTM::RunForward(bool debug, const NetworkIO &input, NetworkScratch *scratch,
+                      NetworkIO *output, bool x_reversed) {
   input_map_ = input.stride_map();
   input_width_ = input.Width();
   if (softmax_ != nullptr) {
@@ -335,7 +494,7 @@ void LSTM::Forward(bool debug, const NetworkIO &input, const TransposedArray *in
   if (softmax_ != nullptr) {
     softmax_output.Init(no_, scratch);
     ZeroVector<TFloat>(no_, softmax_output);
-    int rounded_softmax_inputs = gate_weights_[CI].RoundInputs(ns_);
+    int rounded_softmax_inputs = CellWeights().RoundInputs(ns_);
     if (input.int_mode()) {
       int_output.Resize2d(true, 1, rounded_softmax_inputs, scratch);
     }
@@ -343,7 +502,42 @@ void LSTM::Forward(bool debug, const NetworkIO &input, const TransposedArray *in
   }
   NetworkScratch::FloatVec curr_input;
   curr_input.Init(na_, scratch);
+  // With split weights, the product of the input part of the source with the
+  // gate weights is computed for all timesteps here, so only the recurrent
+  // part remains in the sequential loop. source_ is not needed then.
+  bool split = split_weights_ && !IsTraining();
+  NetworkScratch::FloatVec input_parts[WT_COUNT];
+  NetworkScratch::IO int_recurrent;
+  if (split) {
+    // Each gate multiplies the whole sequence at once. The int inputs are
+    // read in place, and the float inputs are copied once for all the gates.
+    NetworkScratch::FloatVec float_inputs;
+    if (!input.int_mode()) {
+      float_inputs.Init(input_width_ * ni_, scratch);
+      for (int t = 0; t < input_width_; ++t) {
+        input.ReadTimeStep(t, float_inputs + t * ni_);
+      }
+    }
+    for (int w = 0; w < WT_COUNT; ++w) {
+      if (w == GFS && !Is2D()) {
+        continue;
+      }
+      input_parts[w].Init(input_width_ * ro, scratch);
+      if (input.int_mode()) {
+        input_weights_[w].MatrixDotVectors(input_width_, input.i(0), input.NumFeatures(),
+                                           input_parts[w], ro);
+      } else {
+        input_weights_[w].MatrixDotVectors(input_width_, float_inputs, ni_, input_parts[w], ro);
+      }
+    }
+    if (source_.int_mode()) {
+      int_recurrent.Resize2d(true, 1, na_ - ni_, scratch);
+    }
+  }
   StrideMap::Index src_index(input_map_);
+  if (x_reversed) {
+    src_index.InitToLast();
+  }
   // Used only by NT_LSTM_SUMMARY.
   StrideMap::Index dest_index(output->stride_map());
   do {
@@ -358,17 +552,54 @@ void LSTM::Forward(bool debug, const NetworkIO &input, const TransposedArray *in
     }
     // Index of the 2-D revolving buffers (outputs, states).
     int mod_t = Modulo(t, buf_width); // Current timestep.
-    // Setup the padded input in source.
-    source_.CopyTimeStepGeneral(t, 0, ni_, input, t, 0);
-    if (softmax_ != nullptr) {
-      source_.WriteTimeStepPart(t, ni_, nf_, softmax_output);
-    }
-    source_.WriteTimeStepPart(t, ni_ + nf_, ns_, curr_output);
-    if (Is2D()) {
-      source_.WriteTimeStepPart(t, ni_ + nf_ + ns_, ns_, outputs[mod_t]);
+    bool int_mode = source_.int_mode();
+    // The vectors to multiply with the gate weights.
+    const int8_t *int_source = nullptr;
+    const TFloat *float_source = curr_input;
+    if (split) {
+      // Setup just the recurrent part of the source, which is the part of
+      // source_ after the ni_ inputs.
+      if (int_mode) {
+        if (softmax_ != nullptr) {
+          int_recurrent->WriteTimeStepPart(0, 0, nf_, softmax_output);
+        }
+        int_recurrent->WriteTimeStepPart(0, nf_, ns_, curr_output);
+        if (Is2D()) {
+          int_recurrent->WriteTimeStepPart(0, nf_ + ns_, ns_, outputs[mod_t]);
+        }
+        int_source = int_recurrent->i(0);
+      } else {
+        if (softmax_ != nullptr) {
+          CopyVector(nf_, softmax_output, curr_input);
+        }
+        CopyVector(ns_, curr_output, curr_input + nf_);
+        if (Is2D()) {
+          CopyVector(ns_, outputs[mod_t], curr_input + nf_ + ns_);
+        }
+      }
+    } else {
+      // Setup the padded input in source.
+      source_.CopyTimeStepGeneral(t, 0, ni_, input, t, 0);
+      if (softmax_ != nullptr) {
+        source_.WriteTimeStepPart(t, ni_, nf_, softmax_output);
+      }
+      source_.WriteTimeStepPart(t, ni_ + nf_, ns_, curr_output);
+      if (Is2D()) {
+        source_.WriteTimeStepPart(t, ni_ + nf_ + ns_, ns_, outputs[mod_t]);
+      }
+      if (int_mode) {
+        int_source = source_.i(t);
+      } else {
+        source_.ReadTimeStep(t, curr_input);
+      }
     }
-    if (!source_.int_mode()) {
-      source_.ReadTimeStep(t, curr_input);
+    const TFloat *input_part[WT_COUNT] = {};
+    if (split) {
+      for (int w = 0; w < WT_COUNT; ++w) {
+        if (w != GFS || Is2D()) {
+          input_part[w] = input_parts[w] + t * ro;
+        }
+      }
     }
     // Matrix multiply the inputs with the source.
     PARALLEL_IF_OPENMP(GFS)
@@ -376,48 +607,28 @@ void LSTM::Forward(bool debug, const NetworkIO &input, const TransposedArray *in
     // alternative of putting the parallel outside the t loop, a single around
     // the t-loop and then tasks in place of the sections is a *lot* slower.
     // Cell inputs.
-    if (source_.int_mode()) {
-      gate_weights_[CI].MatrixDotVector(source_.i(t), temp_lines[CI]);
-    } else {
-      gate_weights_[CI].MatrixDotVector(curr_input, temp_lines[CI]);
-    }
+    GateProduct(CI, int_mode, int_source, float_source, input_part[CI], temp_lines[CI]);
     FuncInplace<GFunc>(ns_, temp_lines[CI]);
 
     SECTION_IF_OPENMP
     // Input Gates.
-    if (source_.int_mode()) {
-      gate_weights_[GI].MatrixDotVector(source_.i(t), temp_lines[GI]);
-    } else {
-      gate_weights_[GI].MatrixDotVector(curr_input, temp_lines[GI]);
-    }
+    GateProduct(GI, int_mode, int_source, float_source, input_part[GI], temp_lines[GI]);
     FuncInplace<FFunc>(ns_, temp_lines[GI]);
 
     SECTION_IF_OPENMP
     // 1-D forget gates.
-    if (source_.int_mode()) {
-      gate_weights_[GF1].MatrixDotVector(source_.i(t), temp_lines[GF1]);
-    } else {
-      gate_weights_[GF1].MatrixDotVector(curr_input, temp_lines[GF1]);
-    }
+    GateProduct(GF1, int_mode, int_source, float_source, input_part[GF1], temp_lines[GF1]);
     FuncInplace<FFunc>(ns_, temp_lines[GF1]);
 
     // 2-D forget gates.
     if (Is2D()) {
-      if (source_.int_mode()) {
-        gate_weights_[GFS].MatrixDotVector(source_.i(t), temp_lines[GFS]);
-      } else {
-        gate_weights_[GFS].MatrixDotVector(curr_input, temp_lines[GFS]);
-      }
+      GateProduct(GFS, int_mode, int_source, float_source, input_part[GFS], temp_lines[GFS]);
       FuncInplace<FFunc>(ns_, temp_lines[GFS]);
     }
 
     SECTION_IF_OPENMP
     // Output gates.
-    if (source_.int_mode()) {
-      gate_weights_[GO].MatrixDotVector(source_.i(t), temp_lines[GO]);
-    } else {
-      gate_weights_[GO].MatrixDotVector(curr_input, temp_lines[GO]);
-    }
+    GateProduct(GO, int_mode, int_source, float_source, input_part[GO], temp_lines[GO]);
     FuncInplace<FFunc>(ns_, temp_lines[GO]);
     END_PARALLEL_IF_OPENMP
 
@@ -481,11 +692,11 @@ void LSTM::Forward(bool debug, const NetworkIO &input, const TransposedArray *in
     }
     // Always zero the states at the end of every row, but only for the major
     // direction. The 2-D state remains intact.
-    if (src_index.IsLast(FD_WIDTH)) {
+    if (x_reversed ? src_index.index(FD_WIDTH) == 0 : src_index.IsLast(FD_WIDTH)) {
       ZeroVector<TFloat>(ns_, curr_state);
       ZeroVector<TFloat>(ns_, curr_output);
     }
-  } while (src_index.Increment());
+  } while (x_reversed ? src_index.Decrement() : src_index.Increment());
 #if DEBUG_DETAIL > 0
   tprintf("Source:{}\n", name_);
   source_.Print(10);
@@ -719,17 +930,16 @@ bool LSTM::Backward(bool debug, const NetworkIO &fwd_deltas, NetworkScratch *scr
   source_.Transpose(source_t.get());
   state_t.Init(ns_, width, scratch);
   state_.Transpose(state_t.get());
-#ifdef _OPENMP
-#  pragma omp parallel for num_threads(GFS) if (!Is2D())
-#endif
-  for (int w = 0; w < WT_COUNT; ++w) {
-    if (w == GFS && !Is2D()) {
-      continue;
+  // The gates are independent, so their updates can run in parallel, and
+  // each of them uses the workers that are still idle for its rows.
+  const TaskScheduler &scheduler = scratch->scheduler();
+  scheduler.ParallelFor(Is2D() ? WT_COUNT : GFS, [&](int, int start, int end) {
+    for (int w = start; w < end; ++w) {
+      gate_weights_[w].SumOuterTransposed(*gate_errors_t[w], *source_t, &scheduler);
     }
-    gate_weights_[w].SumOuterTransposed(*gate_errors_t[w], *source_t, false);
-  }
+  });
   if (softmax_ != nullptr) {
-    softmax_->FinishBackward(*softmax_errors_t);
+    softmax_->FinishBackward(*softmax_errors_t, scheduler);
   }
   return needs_to_backprop_;
 }
@@ -771,6 +981,32 @@ void LSTM::CountAlternators(const Network &other, TFloat *same, TFloat *changed)
   }
 }
 
+// Replaces the weight deltas by the sum of those of replicas.
+void LSTM::SumDeltas(const std::vector<const Network *> &replicas) {
+  std::vector<const LSTM *> lstms;
+  for (const auto *replica : replicas) {
+    ASSERT_HOST(replica->type() == type_);
+    lstms.push_back(static_cast<const LSTM *>(replica));
+  }
+  for (int w = 0; w < WT_COUNT; ++w) {
+    if (w == GFS && !Is2D()) {
+      continue;
+    }
+    std::vector<const WeightMatrix *> weights;
+    for (const auto *lstm : lstms) {
+      weights.push_back(&lstm->gate_weights_[w]);
+    }
+    gate_weights_[w].SumDeltas(weights);
+  }
+  if (softmax_ != nullptr) {
+    std::vector<const Network *> softmaxes;
+    for (const auto *lstm : lstms) {
+      softmaxes.push_back(lstm->softmax_);
+    }
+    softmax_->SumDeltas(softmaxes);
+  }
+}
+
 #if DEBUG_DETAIL > 3
 
 // Prints the weights for debug purposes.
@@ -839,7 +1075,7 @@ void LSTM::PrintDW() {
 
 // Resizes forward data to cope with an input image of the given width.
 void LSTM::ResizeForward(const NetworkIO &input) {
-  int rounded_inputs = gate_weights_[CI].RoundInputs(na_);
+  int rounded_inputs = CellWeights().RoundInputs(na_);
   source_.Resize(input, rounded_inputs);
   which_fg_.ResizeNoInit(input.Width(), ns_);
   if (IsTraining()) {
@@ -86,6 +86,15 @@ public:
   // Converts a float network to an int network.
   void ConvertToInt() override;
 
+  // Makes the gate (and softmax) weights read-only views of those of src.
+  void ShareWeights(const Network &src) override;
+
+  // Appends the shapes of the gate (and softmax) weight matrices.
+  void GetMatrixShapes(std::vector<MatrixShape> *shapes) const override;
+
+  // Shapes the softmax and gate weights if that was deferred.
+  void ShapeWeights() override;
+
   // Provides debug output on the weights.
   void DebugWeights() override;
 
@@ -98,6 +107,15 @@ public:
   // See Network for a detailed discussion of the arguments.
   void Forward(bool debug, const NetworkIO &input, const TransposedArray *input_transpose,
                NetworkScratch *scratch, NetworkIO *output) override;
+  // Runs Forward on the input with its x-direction reversed, and reverses the
+  // result back, without making the reversed copies. Only valid for a 1-D,
+  // non-summarizing LSTM that isn't training (see CanRunXReversed).
+  void ForwardXReversed(bool debug, const NetworkIO &input, NetworkScratch *scratch,
+                        NetworkIO *output);
+  // Returns true if ForwardXReversed may be used.
+  bool CanRunXReversed() const {
+    return type_ == NT_LSTM && !Is2D() && !IsTraining();
+  }
 
   // Runs backward propagation of errors on the deltas line.
   // See Network for a detailed discussion of the arguments.
@@ -110,6 +128,8 @@ public:
   // positive (same direction) in *same and negative (different direction) in
   // *changed.
   void CountAlternators(const Network &other, TFloat *same, TFloat *changed) const override;
+  // Replaces the weight deltas by the sum of those of replicas.
+  void SumDeltas(const std::vector<const Network *> &replicas) override;
   // Prints the weights for debug purposes.
   void PrintW();
   // Prints the weight deltas for debug purposes.
@@ -121,8 +141,32 @@ public:
   }
 
 private:
+  // Implements Forward, visiting the timesteps of each row from right to
+  // left if x_reversed.
+  void RunForward(bool debug, const NetworkIO &input, NetworkScratch *scratch,
+                  NetworkIO *output, bool x_reversed);
   // Resizes forward data to cope with an input image of the given width.
   void ResizeForward(const NetworkIO &input);
+  // Replaces gate_weights_ with input_weights_ and recurrent_weights_.
+  void SplitGateWeights();
+  // Rebuilds gate_weights_ from input_weights_ and recurrent_weights_, if
+  // split, and frees the latter.
+  void JoinSplitWeights();
+  // Frees input_weights_ and recurrent_weights_.
+  void ClearSplitWeights();
+  // Returns gate_weights_[w], or, if split, a copy of it rebuilt in *joined.
+  const WeightMatrix &GateWeights(int w, WeightMatrix *joined) const;
+  // Returns a matrix with the int mode of the cell input gate.
+  const WeightMatrix &CellWeights() const {
+    return split_weights_ ? recurrent_weights_[CI] : gate_weights_[CI];
+  }
+  // Computes the product of gate w with the source vector of the current
+  // timestep into result. If input_part is not null, the source is only the
+  // recurrent part of the input and input_part holds the precomputed product
+  // of input_weights_[w] with the rest.
+  void GateProduct(WeightType w, bool int_mode, const int8_t *int_source,
+                   const TFloat *float_source, const TFloat *input_part,
+                   TFloat *result) const;
 
 private:
   // Size of padded input to weight matrices = ni_ + no_ for 1-D operation
@@ -139,8 +183,16 @@ private:
   // Flag indicating 2-D operation.
   bool is_2d_;
 
-  // Gate weight arrays of size [na + 1, no].
+  // Gate weight arrays of size [na + 1, no]. Empty if split_weights_.
   WeightMatrix gate_weights_[WT_COUNT];
+  // At inference, gate_weights_ split into the columns for the ni_ inputs
+  // (plus the bias) and the columns for the recurrent feedback, so the
+  // weights are held only once. The input part of every timestep is
+  // independent of the recurrence, so Forward computes it for the whole line
+  // before the sequential loop. Only valid if split_weights_.
+  WeightMatrix input_weights_[WT_COUNT];
+  WeightMatrix recurrent_weights_[WT_COUNT];
+  bool split_weights_;
   // Used only if this is a softmax LSTM.
   FullyConnected *softmax_;
   // Input padded with previous output of size [width, na].
@@ -32,10 +32,16 @@
 #include "ratngs.h"
 #include "recodebeam.h"
 #include "scrollview.h"
+#include "shapedweights.h"
+#include "simddetect.h"
 #include "statistc.h"
 #include <tesseract/tprintf.h>
 #include "tlog.h"
 
+#include <algorithm> // for std::sort
+#include <atomic>    // for std::atomic
+#include <memory>    // for std::make_shared, std::unique_ptr
+#include <mutex>     // for std::call_once
 #include <unordered_set>
 #include <vector>
 
@@ -69,26 +75,43 @@ LSTMRecognizer::LSTMRecognizer(Tesseract *tess)
 {}
 
 LSTMRecognizer::~LSTMRecognizer() {
-  if (network_ != nullptr) {
-    network_->Clean();
-  }
-
-  delete network_;
+  ClearPrecomputedLines();
+  ReleaseChoiceSources();
+  ReleaseNetwork();
   delete dict_;
   delete search_;
 }
 
 void LSTMRecognizer::Clean() {
-  network_->Clean();
-
-  delete network_;
-  network_ = nullptr;
+  ClearPrecomputedLines();
+  ReleaseChoiceSources();
+  ReleaseNetwork();
   delete dict_;
   dict_ = nullptr;
   delete search_;
   search_ = nullptr;
 }
 
+void LSTMRecognizer::ReleaseNetwork() {
+  // The copies go first, as they may refer to the weights of shared_model_.
+  delete inverted_network_;
+  inverted_network_ = nullptr;
+  line_networks_.clear();
+  if (network_ != nullptr && (shared_model_ == nullptr || network_ != shared_model_->network)) {
+    network_->Clean();
+    delete network_;
+  }
+  network_ = nullptr;
+  shared_model_.reset();
+}
+
+LSTMRecognizer::SharedModel::~SharedModel() {
+  if (network != nullptr) {
+    network->Clean();
+    delete network;
+  }
+}
+
 // Loads a model from mgr, including the dictionary only if lang is not empty.
 bool LSTMRecognizer::Load(const ParamsVectorSet &params, const std::string &lang,
                           TessdataManager *mgr) {
@@ -96,8 +119,30 @@ bool LSTMRecognizer::Load(const ParamsVectorSet &params, const std::string &lang
   if (!mgr->GetComponent(TESSDATA_LSTM, &fp)) {
     return false;
   }
-  if (!DeSerialize(mgr, &fp)) {
-    return false;
+  bool autotune = SIMDDetect::IsAutotunePending();
+  if (autotune) {
+    // The implementations must be chosen before any weights are shaped for
+    // them, so the weights are shaped once the network has given its shapes.
+    ShapedWeights deferred(ShapedWeights::kDefer);
+    if (!DeSerialize(mgr, &fp)) {
+      return false;
+    }
+    std::vector<MatrixShape> shapes;
+    network_->GetMatrixShapes(&shapes);
+    SIMDDetect::Autotune(shapes);
+  }
+  {
+    // Saves reshaping the int weights if the model comes with them.
+    ShapedWeights shaped(*mgr);
+    if (autotune) {
+      network_->ShapeWeights();
+    } else if (!DeSerialize(mgr, &fp)) {
+      return false;
+    }
+    if (mgr->IsComponentAvailable(TESSDATA_LSTM_SHAPED_WEIGHTS) && !shaped.is_complete()) {
+      tprintDebug("Ignoring the {} component of {}, which doesn't match the model or this CPU.\n",
+                  kLSTMShapedWeightsFileSuffix, mgr->GetDataFileName());
+    }
   }
   if (lang.empty()) {
     return true;
@@ -149,7 +194,8 @@ bool LSTMRecognizer::Serialize(const TessdataManager *mgr, TFile *fp) const {
 
 // Reads from the given file. Returns false in case of error.
 bool LSTMRecognizer::DeSerialize(const TessdataManager *mgr, TFile *fp) {
-  delete network_;
+  ReleaseChoiceSources();
+  ReleaseNetwork();
   network_ = Network::CreateFromFile(fp);
   if (network_ == nullptr) {
     return false;
@@ -191,6 +237,51 @@ bool LSTMRecognizer::DeSerialize(const TessdataManager *mgr, TFile *fp) {
   }
   network_->SetRandomizer(&randomizer_);
   network_->CacheXScaleFactor(network_->XScaleFactor());
+  // Only affects Forward while not training, so it is safe for the trainer.
+  network_->OptimizeForInference(true);
+  return true;
+}
+
+// Duplicates src, sharing its weights.
+bool LSTMRecognizer::ShareModelFrom(LSTMRecognizer &src) {
+  if (src.network_ == nullptr) {
+    return false;
+  }
+  if (src.shared_model_ != nullptr) {
+    // The structure comes without the weights, which are then shared.
+    const SharedModel &model = *src.shared_model_;
+    TFile in;
+    if (!in.Open(&model.structure[0], model.structure.size()) || !DeSerialize(nullptr, &in)) {
+      return false;
+    }
+    network_->ShareWeights(*model.network);
+    shared_model_ = src.shared_model_;
+    return true;
+  }
+  // The first time, a round trip through memory duplicates the network
+  // structure and all the small stuff. The weights copied along with it are
+  // dropped right after, and the copy, which then refers to the weights of
+  // src, is serialized without them for the later calls.
+  std::vector<char> data;
+  TFile out;
+  out.OpenWrite(&data);
+  if (!src.Serialize(nullptr, &out)) {
+    return false;
+  }
+  TFile in;
+  if (!in.Open(&data[0], data.size()) || !DeSerialize(nullptr, &in)) {
+    return false;
+  }
+  network_->ShareWeights(*src.network_);
+  auto model = std::make_shared<SharedModel>();
+  TFile structure;
+  structure.OpenWrite(&model->structure);
+  if (!Serialize(nullptr, &structure)) {
+    return false;
+  }
+  model->network = src.network_;
+  src.shared_model_ = model;
+  shared_model_ = std::move(model);
   return true;
 }
 
@@ -241,6 +332,7 @@ bool LSTMRecognizer::LoadRecoder(TFile *fp) {
 // Some parameters have to be passed in (from langdata/config/api via Tesseract)
 bool LSTMRecognizer::LoadDictionary(const ParamsVectorSet &params, const std::string &lang,
                                     TessdataManager *mgr) {
+  ReleaseChoiceSources();
   delete dict_;
   dict_ = new Dict(&ccutil_);
   dict_->user_words_file.ResetToDefault(params);
@@ -258,8 +350,98 @@ bool LSTMRecognizer::LoadDictionary(const ParamsVectorSet &params, const std::st
   return false;
 }
 
+LSTMLineChoices::LSTMLineChoices(const UnicharCompress &recoder, int null_char, bool simple_text,
+                                 Dict *dict, const UNICHARSET *unicharset, int debug_level,
+                                 int min_beam_width, int max_beam_width,
+                                 float confident_margin, float ambiguous_margin, double dict_ratio,
+                                 double cert_offset, double worst_dict_cert, int lstm_choice_mode,
+                                 int lstm_choice_amount, const NetworkIO &outputs,
+                                 const std::vector<int> &character_boundaries)
+    : recoder_(&recoder)
+    , null_char_(null_char)
+    , simple_text_(simple_text)
+    , dict_(dict)
+    , unicharset_(unicharset)
+    , debug_level_(debug_level)
+    , min_beam_width_(min_beam_width)
+    , max_beam_width_(max_beam_width)
+    , confident_margin_(confident_margin)
+    , ambiguous_margin_(ambiguous_margin)
+    , dict_ratio_(dict_ratio)
+    , cert_offset_(cert_offset)
+    , worst_dict_cert_(worst_dict_cert)
+    , lstm_choice_mode_(lstm_choice_mode)
+    , lstm_choice_amount_(lstm_choice_amount)
+    , outputs_(new NetworkIO)
+    , character_boundaries_(character_boundaries) {
+  outputs_->ResizeFloat(outputs, outputs.NumFeatures());
+  outputs_->CopyAll(outputs);
+}
+
+void LSTMLineChoices::GetChoices(
+    int start, int count,
+    std::vector<std::vector<std::pair<const char *, float>>> *symbol_choices,
+    std::vector<std::vector<std::vector<std::pair<const char *, float>>>>
+        *segmented_timesteps) {
+  std::call_once(computed_, [this] { Compute(); });
+  symbol_choices->clear();
+  segmented_timesteps->clear();
+  for (int c = start; c < start + count; ++c) {
+    if (static_cast<unsigned>(c) < ctc_choices_.size()) {
+      symbol_choices->push_back(ctc_choices_[c]);
+    }
+    if (static_cast<unsigned>(c) < segmented_timesteps_.size()) {
+      segmented_timesteps->push_back(segmented_timesteps_[c]);
+    }
+  }
+}
+
+void LSTMLineChoices::Detach() {
+  std::call_once(computed_, [] {});
+  outputs_.reset();
+  character_boundaries_.clear();
+  recoder_ = nullptr;
+  dict_ = nullptr;
+  unicharset_ = nullptr;
+}
+
+void LSTMLineChoices::Compute() {
+  RecodeBeamSearch search(*recoder_, null_char_, simple_text_, dict_);
+  search.SetDebug(debug_level_);
+  search.SetBeamWidthBounds(min_beam_width_, max_beam_width_, confident_margin_,
+                            ambiguous_margin_);
+  search.Decode(*outputs_, dict_ratio_, cert_offset_, worst_dict_cert_, unicharset_,
+                lstm_choice_mode_);
+  // The characters are those of the words made by RecognizeLine.
+  search.character_boundaries_ = character_boundaries_;
+  search.extractSymbolChoices(unicharset_);
+  for (int i = 0; i < lstm_choice_amount_; ++i) {
+    search.DecodeSecondaryBeams(*outputs_, dict_ratio_, cert_offset_, worst_dict_cert_,
+                                unicharset_);
+    search.extractSymbolChoices(unicharset_);
+  }
+  search.segmentTimestepsByCharacters();
+  ctc_choices_ = std::move(search.ctc_choices);
+  segmented_timesteps_ = std::move(search.segmentedTimesteps);
+  // Only the choices are needed from now on.
+  outputs_.reset();
+  character_boundaries_.clear();
+  character_boundaries_.shrink_to_fit();
+}
+
+void LSTMRecognizer::ReleaseChoiceSources() {
+  for (auto &source : choice_sources_) {
+    if (auto choices = source.lock()) {
+      choices->Detach();
+    }
+  }
+  choice_sources_.clear();
+}
+
 // Recognizes the line image, contained within image_data, returning the
 // ratings matrix and matching box_word for each WERD_RES in the output.
+// In lstm_choice_mode, the alternative symbol choices of the words are only
+// made when they are first asked for. See WERD_RES::EnsureLSTMChoices.
 void LSTMRecognizer::RecognizeLine(const ImageData &image_data,
                                    float invert_threshold,
                                    double worst_dict_cert, const TBOX &line_box,
@@ -275,33 +457,34 @@ void LSTMRecognizer::RecognizeLine(const ImageData &image_data,
     search_ = new RecodeBeamSearch(recoder_, null_char_, SimpleTextOutput(), dict_);
 	search_->SetDebug(GetDebugLevel() - 1);
   }
+  search_->SetBeamWidthBounds(min_beam_width_, max_beam_width_, confident_margin_,
+                              ambiguous_margin_);
   search_->excludedUnichars.clear();
-  search_->Decode(outputs, kDictRatio, kCertOffset, worst_dict_cert, &GetUnicharset(), lstm_choice_mode);
+  search_->Decode(outputs, kDictRatio, kCertOffset, worst_dict_cert, &GetUnicharset(), 0);
   search_->ExtractBestPathAsWords(line_box, scale_factor, &GetUnicharset(), words);
-  if (lstm_choice_mode) {
-    search_->extractSymbolChoices(&GetUnicharset());
-    for (int i = 0; i < lstm_choice_amount; ++i) {
-      search_->DecodeSecondaryBeams(outputs, kDictRatio, kCertOffset, worst_dict_cert, &GetUnicharset());
-      search_->extractSymbolChoices(&GetUnicharset());
-    }
-    search_->segmentTimestepsByCharacters();
-    unsigned char_it = 0;
+  if (lstm_choice_mode && !words->empty()) {
+    auto choices = std::make_shared<LSTMLineChoices>(
+        recoder_, null_char_, SimpleTextOutput(), dict_, &GetUnicharset(),
+        search_->HasDebug(), min_beam_width_, max_beam_width_, confident_margin_,
+        ambiguous_margin_, kDictRatio, kCertOffset,
+        worst_dict_cert, lstm_choice_mode, lstm_choice_amount, outputs,
+        search_->character_boundaries_);
+    if (choice_sources_.size() == choice_sources_.capacity()) {
+      // Forget the sources of the lines that are gone before growing.
+      choice_sources_.erase(std::remove_if(choice_sources_.begin(), choice_sources_.end(),
+                                           [](const std::weak_ptr<LSTMLineChoices> &source) {
+                                             return source.expired();
+                                           }),
+                            choice_sources_.end());
+    }
+    choice_sources_.push_back(choices);
+    int char_start = 0;
     for (size_t i = 0; i < words->size(); ++i) {
-      for (int j = 0; j < words->at(i)->end; ++j) {
-        if (char_it < search_->ctc_choices.size()) {
-          words->at(i)->CTC_symbol_choices.push_back(search_->ctc_choices[char_it]);
-        }
-        if (char_it < search_->segmentedTimesteps.size()) {
-          words->at(i)->segmented_timesteps.push_back(search_->segmentedTimesteps[char_it]);
-        }
-        ++char_it;
-      }
-      words->at(i)->timesteps =
-          search_->combineSegmentedTimesteps(&words->at(i)->segmented_timesteps);
+      WERD_RES *word = words->at(i);
+      word->lstm_choice_source = choices;
+      word->lstm_choice_start = char_start;
+      char_start += word->end;
     }
-    search_->segmentedTimesteps.clear();
-    search_->ctc_choices.clear();
-    search_->excludedUnichars.clear();
   }
 }
 
@@ -339,35 +522,75 @@ bool LSTMRecognizer::RecognizeLine(const ImageData &image_data,
                                    NetworkIO *inputs, NetworkIO *outputs) {
   // This ensures consistent recognition results.
   SetRandomSeed();
-  int min_width = network_->XScaleFactor();
-  Image pix = Input::PrepareLSTMInputs(image_data, network_, min_width, &randomizer_, scale_factor);
-  if (pix == nullptr) {
-    tprintError("Line cannot be recognized!!\n");
-    return false;
-  }
-  // Maximum width of image to train on.
-  const int kMaxImageWidth = 128 * pixGetHeight(pix);
-  if (network_->IsTraining() && pixGetWidth(pix) > kMaxImageWidth) {
-    tprintError("Image too large to learn!! Size = {}x{}\n", pixGetWidth(pix), pixGetHeight(pix));
-    pix.destroy();
-    return false;
-  }
-  if (upside_down) {
-    pixRotate180(pix, pix);
+  Image pix;
+  bool inverted = false;
+  bool polarity_known = false;
+  // ForwardLines may already have prepared the line and run the network.
+  PrecomputedLine line;
+  bool have_outputs = !upside_down && TakePrecomputedLine(line_box, &line);
+  if (have_outputs) {
+    pix = line.pix;
+    *scale_factor = line.scale_factor;
+    inverted = line.inverted;
+    polarity_known = line.polarity_known;
+    *inputs = std::move(line.inputs);
+    *outputs = std::move(line.outputs);
+  } else {
+    int min_width = network_->XScaleFactor();
+    pix = Input::PrepareLSTMInputs(image_data, network_, min_width, &randomizer_, scale_factor);
+    if (pix == nullptr) {
+      tprintError("Line cannot be recognized!!\n");
+      return false;
+    }
+    // Maximum width of image to train on.
+    const int kMaxImageWidth = 128 * pixGetHeight(pix);
+    if (network_->IsTraining() && pixGetWidth(pix) > kMaxImageWidth) {
+      tprintError("Image too large to learn!! Size = {}x{}\n", pixGetWidth(pix), pixGetHeight(pix));
+      pix.destroy();
+      return false;
+    }
+    if (upside_down) {
+      pixRotate180(pix, pix);
+    }
+    // Reduction factor from image to coords.
+    *scale_factor = min_width / *scale_factor;
   }
-  // Reduction factor from image to coords.
-  *scale_factor = min_width / *scale_factor;
   inputs->set_int_mode(IsIntMode());
   if (HasDebug()) {
     tprintDebug("Scale_factor:{}, upside_down:{}, invert_threshold:{}, int_mode:{}\n",
         *scale_factor, upside_down, invert_threshold, inputs->int_mode());
   }
-  SetRandomSeed();
-  Input::PreparePixInput(tesseract_, network_->InputShape(), pix, &randomizer_, inputs, line_box, *scale_factor);
-  // warning C4800: Implicit conversion from 'int' to bool. Possible information loss
-  network_->Forward(HasDebug(), *inputs, nullptr, &scratch_space_, outputs);
+  // Outside training, the polarity of the line may be clear from its image.
+  // It is then run in that polarity first, and the other one is only tried
+  // if the result is poor, as usual.
+  bool try_inverted = invert_threshold > 0.0f;
+  if (!have_outputs && try_inverted && !network_->IsTraining()) {
+    LinePolarity polarity = EstimatePolarity(pix);
+    if (polarity != LinePolarity::kUnknown) {
+      polarity_known = true;
+      inverted = polarity == LinePolarity::kInverted;
+      if (inverted) {
+        pixInvert(pix, pix);
+      }
+      if (HasDebug()) {
+        tprintDebug("Line polarity is clear from the image: {}\n", inverted ? "inverted" : "normal");
+      }
+    }
+  }
+  if (!have_outputs && try_inverted && !polarity_known && concurrent_invert_ &&
+      !network_->IsTraining() && !HasDebug() &&
+      ForwardBothPolarities(pix, line_box, *scale_factor, inputs, outputs)) {
+    have_outputs = true;
+    try_inverted = false;
+  }
+  if (!have_outputs) {
+    SetRandomSeed();
+    Input::PreparePixInput(tesseract_, network_->InputShape(), pix, &randomizer_, inputs, line_box, *scale_factor);
+    // warning C4800: Implicit conversion from 'int' to bool. Possible information loss
+    network_->Forward(HasDebug(), *inputs, nullptr, &scratch_space_, outputs);
+  }
   // Check for auto inversion.
-  if (invert_threshold > 0.0f) {
+  if (try_inverted) {
     float pos_min, pos_mean, pos_sd;
     OutputStats(*outputs, &pos_min, &pos_mean, &pos_sd);
     if (HasDebug()) {
@@ -413,9 +636,292 @@ bool LSTMRecognizer::RecognizeLine(const ImageData &image_data,
 #endif
     DebugActivationPath(*outputs, labels, coords);
   }
+  scratch_space_.Trim();
+  return true;
+}
+
+// Estimates the polarity of the given line image from its grey levels. The
+// background of a text line covers most of it, so normal (dark on light) text
+// has most of its pixels on the light side of the midpoint between the dark
+// and light extremes, and inverted text on the dark side. The polarity is
+// only decided if the image has enough contrast and the fraction of light
+// pixels differs from 1/2 by at least polarity_margin_, which must be above 0.
+LSTMRecognizer::LinePolarity LSTMRecognizer::EstimatePolarity(Image pix) const {
+  // Fraction of the pixels ignored at either end of the grey range as noise.
+  const double kExtremeFraction = 0.02;
+  // Minimum difference of the dark and light extremes.
+  const int kMinContrast = 48;
+  if (polarity_margin_ <= 0.0f || polarity_margin_ >= 0.5f) {
+    return LinePolarity::kUnknown;
+  }
+  Image grey;
+  if (pixGetDepth(pix) == 8 && pixGetColormap(pix) == nullptr) {
+    grey = pix.clone();
+  } else {
+    grey = pixConvertTo8(pix, false);
+  }
+  if (grey == nullptr) {
+    return LinePolarity::kUnknown;
+  }
+  int width = pixGetWidth(grey);
+  int height = pixGetHeight(grey);
+  int wpl = pixGetWpl(grey);
+  const l_uint32 *data = pixGetData(grey);
+  int histogram[256] = {};
+  for (int y = 0; y < height; ++y, data += wpl) {
+    for (int x = 0; x < width; ++x) {
+      ++histogram[GET_DATA_BYTE(data, x)];
+    }
+  }
+  grey.destroy();
+  int total = width * height;
+  int extreme = static_cast<int>(total * kExtremeFraction);
+  int dark = 0;
+  for (int count = histogram[0]; count <= extreme && dark < 255; count += histogram[++dark]) {
+  }
+  int light = 255;
+  for (int count = histogram[255]; count <= extreme && light > 0; count += histogram[--light]) {
+  }
+  if (light - dark < kMinContrast) {
+    return LinePolarity::kUnknown;
+  }
+  int mid = (dark + light) / 2;
+  int num_light = 0;
+  for (int level = mid + 1; level < 256; ++level) {
+    num_light += histogram[level];
+  }
+  double light_fraction = static_cast<double>(num_light) / total;
+  if (light_fraction >= 0.5 + polarity_margin_) {
+    return LinePolarity::kNormal;
+  }
+  if (light_fraction <= 0.5 - polarity_margin_) {
+    return LinePolarity::kInverted;
+  }
+  return LinePolarity::kUnknown;
+}
+
+// Runs the network on pix and on its inverted image at the same time.
+bool LSTMRecognizer::ForwardBothPolarities(Image pix, const TBOX &line_box, float scale_factor,
+                                           NetworkIO *inputs, NetworkIO *outputs) {
+  Network *inverted_network = InvertedNetwork();
+  if (inverted_network == nullptr) {
+    return false;
+  }
+  // The inputs are prepared up front, as that uses the randomizer and
+  // tesseract_, neither of which may be shared between threads.
+  NetworkIO inv_inputs, inv_outputs;
+  inv_inputs.set_int_mode(IsIntMode());
+  SetRandomSeed();
+  Input::PreparePixInput(tesseract_, network_->InputShape(), pix, &randomizer_, inputs, line_box,
+                         scale_factor);
+  Image inv_pix = pixInvert(nullptr, pix);
+  SetRandomSeed();
+  Input::PreparePixInput(tesseract_, network_->InputShape(), inv_pix, &randomizer_, &inv_inputs,
+                         line_box, scale_factor);
+  inv_pix.destroy();
+  scratch_space_.scheduler().ParallelFor(2, [&](int, int start, int end) {
+    for (int i = start; i < end; ++i) {
+      if (i == 0) {
+        network_->Forward(false, *inputs, nullptr, &scratch_space_, outputs);
+      } else {
+        inverted_network->Forward(false, inv_inputs, nullptr, &scratch_space_, &inv_outputs);
+      }
+    }
+  });
+  float pos_min, pos_mean, pos_sd;
+  OutputStats(*outputs, &pos_min, &pos_mean, &pos_sd);
+  float inv_min, inv_mean, inv_sd;
+  OutputStats(inv_outputs, &inv_min, &inv_mean, &inv_sd);
+  if (inv_mean > pos_mean) {
+    *outputs = std::move(inv_outputs);
+    *inputs = std::move(inv_inputs);
+  }
   return true;
 }
 
+// Returns a copy of network_ that shares its weights.
+Network *LSTMRecognizer::InvertedNetwork() {
+  if (inverted_network_ == nullptr) {
+    inverted_network_ = CopyNetwork(&inverted_randomizer_);
+  }
+  return inverted_network_;
+}
+
+// Returns a new copy of network_ that shares its weights.
+Network *LSTMRecognizer::CopyNetwork(TRand *randomizer) const {
+  // As in ShareModelFrom, a round trip through memory duplicates the
+  // structure. If network_ shares its weights, they are left out of it,
+  // otherwise the weights copied along with it are dropped right after.
+  std::vector<char> data;
+  TFile out;
+  out.OpenWrite(&data);
+  if (!network_->Serialize(&out)) {
+    return nullptr;
+  }
+  TFile in;
+  if (!in.Open(&data[0], data.size())) {
+    return nullptr;
+  }
+  Network *network = Network::CreateFromFile(&in);
+  if (network == nullptr) {
+    return nullptr;
+  }
+  network->ShareWeights(*network_);
+  network->SetRandomizer(randomizer);
+  network->CacheXScaleFactor(network_->XScaleFactor());
+  network->OptimizeForInference(true);
+  return network;
+}
+
+// Makes the missing copies of network_ for ForwardLines, which can use one
+// thread more than there are copies, as the calling thread runs network_.
+int LSTMRecognizer::PrepareLineNetworks(int num_threads) {
+  while (line_networks_.size() + 1 < static_cast<size_t>(num_threads)) {
+    auto copy = std::make_unique<NetworkCopy>();
+    copy->network.reset(CopyNetwork(&copy->randomizer));
+    if (copy->network == nullptr) {
+      break;
+    }
+    line_networks_.push_back(std::move(copy));
+  }
+  return std::min(num_threads, static_cast<int>(line_networks_.size()) + 1);
+}
+
+// Runs the network over all the given line images in as few forward passes
+// as possible, packing lines of similar width into batches of at most
+// max_batch_size lines, and keeps the outputs so that a subsequent
+// RecognizeLine of the same image and line_box can use them instead of
+// running the network again.
+void LSTMRecognizer::ForwardLines(const std::vector<const ImageData *> &images,
+                                  const std::vector<TBOX> &line_boxes, float invert_threshold,
+                                  int max_batch_size) {
+  // Lines are only packed together if the widest is no more than this
+  // multiple of the narrowest, to limit the work wasted on padding.
+  const int kMaxBatchWidthRatio = 2;
+  ClearPrecomputedLines();
+  if ((max_batch_size < 2 && !parallel_lines_) || network_ == nullptr ||
+      network_->IsTraining() || HasDebug()) {
+    return;
+  }
+  max_batch_size = std::max(max_batch_size, 1);
+  struct PreparedLine {
+    Image pix;
+    size_t index;
+    float scale_factor;
+    bool inverted;
+    bool polarity_known;
+  };
+  std::vector<PreparedLine> lines;
+  int min_width = network_->XScaleFactor();
+  for (size_t i = 0; i < images.size(); ++i) {
+    if (images[i] == nullptr) {
+      continue;
+    }
+    float scale_factor = 0.0f;
+    SetRandomSeed();
+    Image pix = Input::PrepareLSTMInputs(*images[i], network_, min_width, &randomizer_, &scale_factor);
+    if (pix != nullptr) {
+      // Run the line in the polarity that RecognizeLine will try first.
+      LinePolarity polarity =
+          invert_threshold > 0.0f ? EstimatePolarity(pix) : LinePolarity::kUnknown;
+      bool inverted = polarity == LinePolarity::kInverted;
+      if (inverted) {
+        pixInvert(pix, pix);
+      }
+      lines.push_back(
+          {pix, i, min_width / scale_factor, inverted, polarity != LinePolarity::kUnknown});
+    }
+  }
+  std::sort(lines.begin(), lines.end(), [](const PreparedLine &a, const PreparedLine &b) {
+    return pixGetWidth(a.pix) < pixGetWidth(b.pix);
+  });
+  // The inputs of all batches are prepared up front, as that uses the
+  // randomizer and tesseract_, neither of which may be shared between threads.
+  struct Batch {
+    size_t start;
+    size_t end;
+    std::vector<TBOX> boxes;
+    NetworkIO inputs;
+    NetworkIO outputs;
+  };
+  std::vector<Batch> batches;
+  for (size_t start = 0; start < lines.size();) {
+    size_t end = start + 1;
+    int max_width = kMaxBatchWidthRatio * pixGetWidth(lines[start].pix);
+    while (end < lines.size() && end - start < static_cast<size_t>(max_batch_size) &&
+           pixGetWidth(lines[end].pix) <= max_width) {
+      ++end;
+    }
+    Batch batch;
+    batch.start = start;
+    batch.end = end;
+    std::vector<Image> pixes;
+    std::vector<float> scale_factors;
+    for (size_t i = start; i < end; ++i) {
+      pixes.push_back(lines[i].pix);
+      batch.boxes.push_back(line_boxes[lines[i].index]);
+      scale_factors.push_back(lines[i].scale_factor);
+    }
+    batch.inputs.set_int_mode(IsIntMode());
+    SetRandomSeed();
+    Input::PreparePixBatchInput(tesseract_, network_->InputShape(), pixes, batch.boxes,
+                                scale_factors, &randomizer_, &batch.inputs);
+    batches.push_back(std::move(batch));
+    start = end;
+  }
+  int num_threads = 1;
+  if (parallel_lines_ && batches.size() > 1) {
+    num_threads = PrepareLineNetworks(
+        std::min(static_cast<int>(batches.size()), scratch_space_.scheduler().MaxConcurrency()));
+  }
+  if (num_threads > 1) {
+    // Each thread takes the next batch when it is done with its last, widest
+    // first, which balances the threads better than fixed ranges of batches.
+    std::atomic<size_t> next_batch{0};
+    scratch_space_.scheduler().ParallelFor(num_threads, [&](int slot, int, int) {
+      ASSERT_HOST(static_cast<size_t>(slot) <= line_networks_.size());
+      Network *network = slot == 0 ? network_ : line_networks_[slot - 1]->network.get();
+      for (size_t b = next_batch++; b < batches.size(); b = next_batch++) {
+        Batch &batch = batches[batches.size() - 1 - b];
+        network->Forward(false, batch.inputs, nullptr, &scratch_space_, &batch.outputs);
+      }
+    });
+  } else {
+    for (auto &batch : batches) {
+      network_->Forward(false, batch.inputs, nullptr, &scratch_space_, &batch.outputs);
+    }
+  }
+  for (auto &batch : batches) {
+    for (size_t i = batch.start; i < batch.end; ++i) {
+      PrecomputedLine line;
+      line.line_box = batch.boxes[i - batch.start];
+      line.pix = lines[i].pix;
+      line.scale_factor = lines[i].scale_factor;
+      line.inverted = lines[i].inverted;
+      line.polarity_known = lines[i].polarity_known;
+      line.inputs.CopyBatchElement(batch.inputs, i - batch.start);
+      line.outputs.CopyBatchElement(batch.outputs, i - batch.start);
+      precomputed_lines_.push_back(std::move(line));
+    }
+  }
+  // The prepared images now belong to precomputed_lines_.
+  scratch_space_.Trim();
+}
+
+// If ForwardLines has already run the network on the line of the given
+// line_box, moves it to *line, whose pix the caller must destroy, and
+// returns true.
+bool LSTMRecognizer::TakePrecomputedLine(const TBOX &line_box, PrecomputedLine *line) {
+  for (auto it = precomputed_lines_.begin(); it != precomputed_lines_.end(); ++it) {
+    if (it->line_box == line_box) {
+      *line = std::move(*it);
+      precomputed_lines_.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
 // Converts an array of labels to utf-8, whether or not the labels are
 // augmented with character boundaries.
 std::string LSTMRecognizer::DecodeLabels(const std::vector<int> &labels) {
@@ -566,6 +1072,8 @@ void LSTMRecognizer::LabelsViaReEncode(const NetworkIO &output, std::vector<int>
     search_ = new RecodeBeamSearch(recoder_, null_char_, SimpleTextOutput(), dict_);
 	search_->SetDebug(GetDebugLevel() - 1);
   }
+  // Training labels are always made with the fixed beam width.
+  search_->SetBeamWidthBounds(0, 0);
   search_->Decode(output, 1.0, 0.0, RecodeBeamSearch::kMinCertainty, nullptr /* unicharset */, 2);
   search_->ExtractBestPathAsLabels(labels, xcoords);
 }
@@ -23,17 +23,21 @@
 #include "matrix.h"
 #include "network.h"
 #include "networkscratch.h"
+#include "pageres.h" // for LSTMChoiceSource
 #include <tesseract/params.h>
 #include "recodebeam.h"
+#include "rect.h" // for TBOX
 #include "series.h"
 #include "unicharcompress.h"
 #include "genericvector.h"     // for PointerVector (ptr only)
 
+#include <memory> // for std::shared_ptr, std::unique_ptr, std::weak_ptr
+#include <mutex>  // for std::once_flag
+
 class BLOB_CHOICE_IT;
 struct Pix;
 class ROW_RES;
 class ScrollView;
-class TBOX;
 class WERD_RES;
 
 namespace tesseract {
@@ -47,6 +51,59 @@ enum TrainingFlags {
   TF_COMPRESS_UNICHARSET = 64,
 };
 
+// The alternative symbol choices of a line in lstm_choice_mode. Only the
+// network outputs and the character boundaries of the best path are kept
+// until the choices are first asked for, when the beam search is run again
+// to make them for the whole line.
+// The choices are made with the charsets and dictionary of the recognizer
+// that made the line, which detaches (see Detach) all its choice sources
+// before any of those go away or change.
+class TESS_API LSTMLineChoices : public LSTMChoiceSource {
+public:
+  LSTMLineChoices(const UnicharCompress &recoder, int null_char, bool simple_text, Dict *dict,
+                  const UNICHARSET *unicharset, int debug_level, int min_beam_width,
+                  int max_beam_width, float confident_margin, float ambiguous_margin,
+                  double dict_ratio, double cert_offset,
+                  double worst_dict_cert, int lstm_choice_mode, int lstm_choice_amount,
+                  const NetworkIO &outputs, const std::vector<int> &character_boundaries);
+
+  // Safe to call from several threads at once: the choices are made once.
+  void GetChoices(
+      int start, int count,
+      std::vector<std::vector<std::pair<const char *, float>>> *symbol_choices,
+      std::vector<std::vector<std::vector<std::pair<const char *, float>>>>
+          *segmented_timesteps) override;
+
+  // Drops the outputs and all references to the recognizer. If the choices
+  // have not been made yet, GetChoices will return none from now on.
+  void Detach();
+
+private:
+  void Compute();
+
+  const UnicharCompress *recoder_;
+  int null_char_;
+  bool simple_text_;
+  Dict *dict_;
+  const UNICHARSET *unicharset_;
+  int debug_level_;
+  int min_beam_width_;
+  int max_beam_width_;
+  float confident_margin_;
+  float ambiguous_margin_;
+  double dict_ratio_;
+  double cert_offset_;
+  double worst_dict_cert_;
+  int lstm_choice_mode_;
+  int lstm_choice_amount_;
+  std::unique_ptr<NetworkIO> outputs_;
+  std::vector<int> character_boundaries_;
+  // Set by whichever of Compute and Detach runs first.
+  std::once_flag computed_;
+  std::vector<std::vector<std::pair<const char *, float>>> ctc_choices_;
+  std::vector<std::vector<std::vector<std::pair<const char *, float>>>> segmented_timesteps_;
+};
+
 // Top-level line recognizer class for LSTM-based networks.
 // Note that a sub-class, LSTMTrainer is used for training.
 class TESS_API LSTMRecognizer {
@@ -235,6 +292,17 @@ public:
   // otherwise, they are part of the serialization in fp.
   bool DeSerialize(const TessdataManager *mgr, TFile *fp);
   
+  // Makes this recognizer a lightweight twin of src for use on another
+  // thread: the network structure, charsets and all per-instance state are
+  // duplicated, but every weight matrix refers to the weights of src. Those
+  // are held by a SharedModel, which the first call for src makes from it,
+  // and which is kept alive by shared ownership, so src may be destroyed
+  // first. Only that first call copies the weights, briefly. Later ones
+  // copy the structure from the SharedModel without them.
+  // The dictionary is not copied; use LoadDictionary as usual.
+  // Returns false in case of error.
+  bool ShareModelFrom(LSTMRecognizer &src);
+
   // Loads the charsets from mgr.
   bool LoadCharsets(const TessdataManager *mgr);
   // Loads the Recoder.
@@ -278,6 +346,75 @@ public:
   bool RecognizeLine(const ImageData &image_data, float invert_threshold, bool re_invert,
                      bool upside_down, const TBOX &line_box, float *scale_factor, NetworkIO *inputs, NetworkIO *outputs);
 
+  // Runs the network over all the given line images in as few forward passes
+  // as possible, packing lines of similar width into batches of at most
+  // max_batch_size lines, and keeps the prepared images and the outputs so
+  // that a subsequent RecognizeLine of the same line_box can use them instead
+  // of preparing the image and running the network again. As the lines are
+  // looked up by line_box alone, RecognizeLine must be given the same image
+  // for it. images and line_boxes must be the same size;
+  // null images are skipped. invert_threshold must be the one that will be
+  // given to RecognizeLine, so lines can be run in the polarity that it will
+  // choose for them. The batches run in parallel if SetParallelLines asked
+  // for it. Does nothing when training or debugging, or if max_batch_size is
+  // below 2 and the batches don't run in parallel.
+  void ForwardLines(const std::vector<const ImageData *> &images,
+                    const std::vector<TBOX> &line_boxes, float invert_threshold,
+                    int max_batch_size);
+  // Discards any lines kept by ForwardLines that were not used.
+  void ClearPrecomputedLines() {
+    for (auto &line : precomputed_lines_) {
+      line.pix.destroy();
+    }
+    precomputed_lines_.clear();
+  }
+  // Sets the scheduler that runs the parallel parts of the network, which
+  // is borrowed from the engine. nullptr selects the process default.
+  void SetScheduler(const TaskScheduler *scheduler) {
+    scratch_space_.set_scheduler(scheduler);
+  }
+  // Returns the number of bytes held by the reusable scratch buffers of the
+  // network.
+  size_t ScratchMemoryUsage() const {
+    return scratch_space_.MemoryUsage();
+  }
+  // Limits the memory that the scratch buffers keep between lines, 0 for no
+  // limit.
+  void SetScratchMemoryLimit(size_t bytes) {
+    scratch_space_.set_memory_limit(bytes);
+  }
+  // Sets how RecognizeLine treats lines that it may have to run inverted
+  // (see invert_threshold). Outside training, lines whose polarity is clear
+  // from their grey levels (see EstimatePolarity) are run in that polarity
+  // first, and in the other one only if the result is below
+  // invert_threshold; a polarity_margin of 0, or of 0.5 or more, disables the
+  // check.
+  // If concurrent, the remaining lines are run in both polarities at once,
+  // on two threads of the scheduler, instead of inverted after the normal
+  // run turned out poor.
+  void SetInvertOptions(float polarity_margin, bool concurrent) {
+    polarity_margin_ = polarity_margin;
+    concurrent_invert_ = concurrent;
+  }
+  // If parallel, ForwardLines runs its batches of lines at the same time on
+  // the threads of the scheduler, each thread on its own copy of the network
+  // that shares its weights. The beam search of each line is still run by
+  // RecognizeLine on the calling thread, as it consults the dictionary, whose
+  // state belongs to the engine.
+  void SetParallelLines(bool parallel) {
+    parallel_lines_ = parallel;
+  }
+  // Sets the bounds of the adaptive beam width of the beam search used by
+  // RecognizeLine. See RecodeBeamSearch::SetBeamWidthBounds.
+  void SetBeamWidthBounds(int min_width, int max_width,
+                          float confident_margin = RecodeBeamSearch::kConfidentMargin,
+                          float ambiguous_margin = RecodeBeamSearch::kAmbiguousMargin) {
+    min_beam_width_ = min_width;
+    max_beam_width_ = max_width;
+    confident_margin_ = confident_margin;
+    ambiguous_margin_ = ambiguous_margin;
+  }
+
   // Converts an array of labels to utf-8, whether or not the labels are
   // augmented with character boundaries.
   std::string DecodeLabels(const std::vector<int> &labels);
@@ -339,12 +476,72 @@ protected:
   // a default of ".." for part of a multi-label unichar-id.
   const char *DecodeSingleLabel(int label);
 
+  // A line already prepared and run by ForwardLines: the prepared image,
+  // in the polarity that RecognizeLine tries first, with its reduction
+  // factor from image to coords and the network inputs and outputs.
+  struct PrecomputedLine {
+    TBOX line_box;
+    Image pix;
+    float scale_factor;
+    bool inverted;
+    bool polarity_known;
+    NetworkIO inputs;
+    NetworkIO outputs;
+  };
+  // If ForwardLines has already run the network on the line of the given
+  // line_box, moves it to *line, whose pix the caller must destroy, and
+  // returns true.
+  bool TakePrecomputedLine(const TBOX &line_box, PrecomputedLine *line);
+
+  // Polarity of a line image.
+  enum class LinePolarity { kNormal, kInverted, kUnknown };
+  // Estimates the polarity of the given line image from its grey levels,
+  // using polarity_margin_.
+  LinePolarity EstimatePolarity(Image pix) const;
+  // Runs the network on pix and on its inverted image at the same time, and
+  // leaves the inputs and outputs of the better of the two in inputs and
+  // outputs. Returns false if it could not run them.
+  bool ForwardBothPolarities(Image pix, const TBOX &line_box, float scale_factor,
+                             NetworkIO *inputs, NetworkIO *outputs);
+  // Returns a copy of network_ that shares its weights, for running the
+  // inverted image of a line at the same time as the normal one, or nullptr
+  // if it could not be made.
+  Network *InvertedNetwork();
+  // Returns a new copy of network_ that shares its weights and uses the given
+  // randomizer, or nullptr if it could not be made.
+  Network *CopyNetwork(TRand *randomizer) const;
+  // Makes sure that there are copies of network_ for ForwardLines to run on
+  // num_threads threads, and returns the number of threads that it can use.
+  int PrepareLineNetworks(int num_threads);
+
+  // Deletes network_, unless it is owned by shared_model_, and drops the
+  // reference to any shared model. Also deletes inverted_network_ and
+  // line_networks_.
+  void ReleaseNetwork();
+  // Detaches all the choice sources handed out by RecognizeLine that are
+  // still alive, as they refer to recoder_, ccutil_.unicharset and dict_.
+  void ReleaseChoiceSources();
+
 protected:
   // OPTIONAL reference to the active Tesseract instance where LSTM/Input
   // internal diagnostics should be sent to.
   Tesseract *tesseract_;
   // The network hierarchy.
   Network *network_;
+  // A loaded model that recognizers share (see ShareModelFrom). It is not
+  // changed once made, and is freed with the last recognizer that uses it.
+  struct SharedModel {
+    ~SharedModel();
+    // Owns the weights. It is network_ of the recognizer that the model was
+    // made from, and the networks of the others refer to its weights.
+    Network *network = nullptr;
+    // A recognizer serialized with references in place of its weights,
+    // from which each recognizer that shares the model copies its network
+    // structure, charsets and settings.
+    std::vector<char> structure;
+  };
+  // Set once the model is shared with other recognizers.
+  std::shared_ptr<const SharedModel> shared_model_;
   // The unicharset. Only the unicharset element is serialized.
   // Has to be a CCUtil, so Dict can point to it.
   CCUtil ccutil_;
@@ -378,6 +575,30 @@ protected:
   Dict *dict_;
   // Beam search held between uses to optimize memory allocation/use.
   RecodeBeamSearch *search_;
+  // Lines already run by ForwardLines, keyed by line box.
+  std::vector<PrecomputedLine> precomputed_lines_;
+  // See SetInvertOptions.
+  float polarity_margin_ = 0.0f;
+  bool concurrent_invert_ = false;
+  // See SetBeamWidthBounds. 0 selects the fixed default width.
+  int min_beam_width_ = 0;
+  int max_beam_width_ = 0;
+  float confident_margin_ = RecodeBeamSearch::kConfidentMargin;
+  float ambiguous_margin_ = RecodeBeamSearch::kAmbiguousMargin;
+  // See InvertedNetwork. Owned.
+  Network *inverted_network_ = nullptr;
+  TRand inverted_randomizer_;
+  // See SetParallelLines.
+  bool parallel_lines_ = false;
+  // Copies of network_ that ForwardLines runs on threads other than the
+  // calling one. See PrepareLineNetworks.
+  struct NetworkCopy {
+    std::unique_ptr<Network> network;
+    TRand randomizer;
+  };
+  std::vector<std::unique_ptr<NetworkCopy>> line_networks_;
+  // The choice sources handed out by RecognizeLine. See ReleaseChoiceSources.
+  std::vector<std::weak_ptr<LSTMLineChoices>> choice_sources_;
 
   // == Debugging parameters.==
   int debug___ = 0;
@@ -20,6 +20,7 @@
 
 #include "network.h"
 
+#include <atomic>
 #include <cstdlib>
 
 // This base class needs to know about all its sub-classes because of the
@@ -78,6 +79,9 @@ static char const *const kTypeNames[NT_COUNT] = {
     "TensorFlow",
 };
 
+// The profiler of all layers run by a Plumbing, if any.
+static std::atomic<ForwardProfiler *> forward_profiler{nullptr};
+
 Network::Network()
     : type_(NT_NONE)
     , training_(TS_ENABLED)
@@ -218,6 +222,14 @@ static NetworkType getNetworkType(TFile *fp) {
   return static_cast<NetworkType>(data);
 }
 
+void Network::SetForwardProfiler(ForwardProfiler *profiler) {
+  forward_profiler.store(profiler);
+}
+
+ForwardProfiler *Network::GetForwardProfiler() {
+  return forward_profiler.load(std::memory_order_relaxed);
+}
+
 // Reads from the given file. Returns nullptr in case of error.
 // Determines the type of the serialized class and calls its DeSerialize
 // on a new object of the appropriate type, which is returned.
@@ -22,6 +22,7 @@
 #include "matrix.h"
 #include "networkio.h"
 #include "serialis.h"
+#include "simddetect.h"
 #include "static_shape.h"
 #include "scrollview.h"
 #include <tesseract/tprintf.h>
@@ -39,6 +40,7 @@ namespace tesseract {
 class ScrollView;
 class TBOX;
 class ImageData;
+class Network;
 class NetworkScratch;
 
 // Enum to store the run-time type of a Network. Keep in sync with kTypeNames.
@@ -106,6 +108,15 @@ enum TrainingState {
   TS_RE_ENABLE,    // Re-Enable from TS_TEMP_DISABLE, but not TS_DISABLED.
 };
 
+// Receives the time taken by the Forward of each layer that is run by a
+// Plumbing, for benchmarking. Record may be called from several threads at
+// once, as some plumbing runs its layers in parallel.
+class TESS_API ForwardProfiler {
+public:
+  virtual ~ForwardProfiler() = default;
+  virtual void Record(const Network *layer, double seconds) = 0;
+};
+
 // Base class for network types. Not quite an abstract base class, but almost.
 // Most of the time no isolated Network exists, except prior to
 // deserialization.
@@ -202,6 +213,27 @@ public:
   // Converts a float network to an int network.
   virtual void ConvertToInt() {}
 
+  // Makes all weight matrices of this network read-only views of those of
+  // src, which must be a network of identical structure (e.g. deserialized
+  // from the same model) and must outlive this. The per-network forward
+  // state is not shared, so both networks may run Forward concurrently.
+  virtual void ShareWeights([[maybe_unused]] const Network &src) {}
+
+  // Appends the shapes of the weight matrices that Forward multiplies with
+  // when not training, for SIMDDetect::Autotune.
+  virtual void GetMatrixShapes([[maybe_unused]] std::vector<MatrixShape> *shapes) const {}
+
+  // Shapes the int weights for the current IntSimdMatrix, if that was
+  // deferred while deserializing (see ShapedWeights::kDefer). The matrices
+  // are visited in the order in which they were deserialized.
+  virtual void ShapeWeights() {}
+
+  // Lets Forward fuse adjacent layers and skip copies where that doesn't
+  // change the results, or stops it from doing so if !enable. The unfused
+  // layers still run whenever the network is training or Forward is asked
+  // to debug, so the intermediate results remain available there.
+  virtual void OptimizeForInference([[maybe_unused]] bool enable) {}
+
   // Provides a pointer to a TRand for any networks that care to use it.
   // Note that randomizer is a borrowed pointer that should outlive the network
   // and should not be deleted by any of the networks.
@@ -249,12 +281,24 @@ public:
   virtual void CountAlternators([[maybe_unused]] const Network &other,
                                 [[maybe_unused]] TFloat *same,
                                 [[maybe_unused]] TFloat *changed) const {}
+  // Replaces the weight deltas of *this by the sum of those of replicas,
+  // networks of identical structure that share the weights of *this (see
+  // ShareWeights) and have each run Backward on a different sample, so that
+  // a single Update applies all of their gradients. See
+  // WeightMatrix::SumDeltas for why they are summed rather than averaged.
+  virtual void SumDeltas([[maybe_unused]] const std::vector<const Network *> &replicas) {}
 
   // Reads from the given file. Returns nullptr in case of error.
   // Determines the type of the serialized class and calls its DeSerialize
   // on a new object of the appropriate type, which is returned.
   static Network *CreateFromFile(TFile *fp);
 
+  // Sets the profiler that receives the forward time of all layers run by a
+  // Plumbing, in all networks of the process, or removes it if nullptr.
+  // The profiler is borrowed and must outlive its use.
+  static void SetForwardProfiler(ForwardProfiler *profiler);
+  static ForwardProfiler *GetForwardProfiler();
+
   // Runs forward propagation of activations on the input line.
   // Note that input and output are both 2-d arrays.
   // The 1st index is the time element. In a 1-d network, it might be the pixel
@@ -223,6 +223,9 @@ void NetworkIO::FromPixes(const StaticShape &shape, const std::vector<Image> &pi
 // of input channels, the height is the height of the image, and the width
 // is the width of the image, or truncated/padded with noise if the width
 // is a fixed size.
+// Only the valid height and width of the batch element are written. The rest,
+// up to the size of the largest element, is left zero by ResizeToMap, so the
+// element gets the same inputs whatever it is batched with.
 void NetworkIO::Copy2DImage(int batch, Image pix, float black, float contrast, TRand *randomizer) {
   int width = pixGetWidth(pix);
   int height = pixGetHeight(pix);
@@ -230,15 +233,16 @@ void NetworkIO::Copy2DImage(int batch, Image pix, float black, float contrast, T
   StrideMap::Index index(stride_map_);
   index.AddOffset(batch, FD_BATCH);
   int t = index.t();
-  int target_height = stride_map_.Size(FD_HEIGHT);
-  int target_width = stride_map_.Size(FD_WIDTH);
+  int target_height = index.MaxIndexOfDim(FD_HEIGHT) + 1;
+  int target_width = index.MaxIndexOfDim(FD_WIDTH) + 1;
+  int full_width = stride_map_.Size(FD_WIDTH);
   int num_features = NumFeatures();
   bool color = num_features == 3;
   if (width > target_width) {
     width = target_width;
   }
   uint32_t *line = pixGetData(pix);
-  for (int y = 0; y < target_height; ++y, line += wpl) {
+  for (int y = 0; y < target_height; ++y, line += wpl, t += full_width - target_width) {
     int x = 0;
     if (y < height) {
       for (x = 0; x < width; ++x, ++t) {
@@ -273,7 +277,8 @@ void NetworkIO::Copy1DGreyImage(int batch, Image pix, float black, float contras
   StrideMap::Index index(stride_map_);
   index.AddOffset(batch, FD_BATCH);
   int t = index.t();
-  int target_width = stride_map_.Size(FD_WIDTH);
+  // As in Copy2DImage, only the valid width of the batch element is written.
+  int target_width = index.MaxIndexOfDim(FD_WIDTH) + 1;
   if (width > target_width) {
     width = target_width;
   }
@@ -920,6 +925,41 @@ void NetworkIO::CopyWithXReversal(const NetworkIO &src) {
   } while (b_index.AddOffset(1, FD_BATCH));
 }
 
+// Copies the given batch element of src to *this, which becomes a batch of
+// 1 with the true height and width of that element.
+void NetworkIO::CopyBatchElement(const NetworkIO &src, int batch) {
+  StrideMap::Index b_index(src.stride_map_, batch, 0, 0);
+  int height = b_index.MaxIndexOfDim(FD_HEIGHT) + 1;
+  int width = b_index.MaxIndexOfDim(FD_WIDTH) + 1;
+  StrideMap stride_map;
+  stride_map.SetStride({{height, width}});
+  ResizeToMap(src.int_mode(), stride_map, src.NumFeatures());
+  int t = 0;
+  StrideMap::Index y_index(b_index);
+  do {
+    StrideMap::Index x_index(y_index);
+    do {
+      CopyTimeStepFrom(t++, src, x_index.t());
+    } while (x_index.AddOffset(1, FD_WIDTH));
+  } while (y_index.AddOffset(1, FD_HEIGHT));
+}
+
+// Copies src, a batch of 1, to the given batch element of *this.
+void NetworkIO::WriteBatchElement(int batch, const NetworkIO &src) {
+  StrideMap::Index b_index(stride_map_, batch, 0, 0);
+  int height = b_index.MaxIndexOfDim(FD_HEIGHT) + 1;
+  int width = b_index.MaxIndexOfDim(FD_WIDTH) + 1;
+  ASSERT_HOST(height * width == src.Width());
+  int t = 0;
+  StrideMap::Index y_index(b_index);
+  do {
+    StrideMap::Index x_index(y_index);
+    do {
+      CopyTimeStepFrom(x_index.t(), src, t++);
+    } while (x_index.AddOffset(1, FD_WIDTH));
+  } while (y_index.AddOffset(1, FD_HEIGHT));
+}
+
 // Copies src to *this with independent transpose of the x and y dimensions.
 void NetworkIO::CopyWithXYTranspose(const NetworkIO &src) {
   int num_features = src.NumFeatures();
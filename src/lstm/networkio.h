@@ -128,6 +128,10 @@ public:
   const StrideMap &stride_map() const {
     return stride_map_;
   }
+  // Returns the number of bytes allocated for the data.
+  size_t MemoryUsage() const {
+    return f_.memory_size() + i_.memory_size();
+  }
   void set_stride_map(const StrideMap &map) {
     stride_map_ = map;
   }
@@ -240,6 +244,12 @@ public:
   void CopyWithXReversal(const NetworkIO &src);
   // Copies src to *this with independent transpose of the x and y dimensions.
   void CopyWithXYTranspose(const NetworkIO &src);
+  // Copies the given batch element of src to *this, which becomes a batch of
+  // 1 with the true height and width of that element.
+  void CopyBatchElement(const NetworkIO &src, int batch);
+  // The reverse of CopyBatchElement: copies src, a batch of 1, to the given
+  // batch element of *this, which must have the same size as src.
+  void WriteBatchElement(int batch, const NetworkIO &src);
   // Copies src to *this, at the given feature_offset, returning the total
   // feature offset after the copy. Multiple calls will stack outputs from
   // multiple sources in feature space.
@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////
+// File:        networkscratch.cpp
+// Description: Scratch space for Network layers that hides distinction
+//              between float/int implementations.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include <tesseract/preparation.h> // compiler config, etc.
+
+#include "networkscratch.h"
+
+#include <algorithm> // for std::remove_if
+#include <atomic>    // for std::atomic
+
+namespace tesseract {
+
+// Source of NetworkScratch::id_.
+static std::atomic<uint64_t> next_scratch_id(1);
+
+// The arenas that the calling thread has taken from NetworkScratch
+// instances. When the thread exits, each goes back, with its buffers freed,
+// to its NetworkScratch if that is still alive.
+class NetworkScratch::ThreadArenas {
+public:
+  ~ThreadArenas() {
+    for (auto &entry : entries_) {
+      if (auto arenas = entry.arenas.lock()) {
+        std::lock_guard<std::mutex> lock(arenas->mutex);
+        entry.arena->int_stack.Clear();
+        entry.arena->float_stack.Clear();
+        entry.arena->vec_stack.Clear();
+        entry.arena->array_stack.Clear();
+        entry.arena->in_use = false;
+      }
+    }
+  }
+
+  // Returns the arena of the NetworkScratch with the given id, or nullptr.
+  Arena *Find(uint64_t id) const {
+    for (auto &entry : entries_) {
+      if (entry.id == id) {
+        return entry.arena;
+      }
+    }
+    return nullptr;
+  }
+
+  void Add(uint64_t id, const std::shared_ptr<Arenas> &arenas, Arena *arena) {
+    // Forget the instances that have been deleted in the meantime.
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                  [](const Entry &entry) { return entry.arenas.expired(); }),
+                   entries_.end());
+    entries_.push_back({id, arenas, arena});
+  }
+
+private:
+  struct Entry {
+    uint64_t id;
+    std::weak_ptr<Arenas> arenas;
+    Arena *arena;
+  };
+  std::vector<Entry> entries_;
+};
+
+NetworkScratch::NetworkScratch()
+    : int_mode_(false)
+    , scheduler_(nullptr)
+    , memory_limit_(0)
+    , id_(next_scratch_id++)
+    , arenas_(std::make_shared<Arenas>()) {}
+
+NetworkScratch::~NetworkScratch() = default;
+
+NetworkScratch::Arena *NetworkScratch::ThreadArena() {
+  thread_local ThreadArenas thread_arenas;
+  Arena *arena = thread_arenas.Find(id_);
+  if (arena != nullptr) {
+    return arena;
+  }
+  {
+    std::lock_guard<std::mutex> lock(arenas_->mutex);
+    for (auto &candidate : arenas_->list) {
+      if (!candidate->in_use) {
+        arena = candidate.get();
+        break;
+      }
+    }
+    if (arena == nullptr) {
+      arenas_->list.emplace_back(new Arena);
+      arena = arenas_->list.back().get();
+    }
+    arena->in_use = true;
+  }
+  thread_arenas.Add(id_, arenas_, arena);
+  return arena;
+}
+
+size_t NetworkScratch::NumArenas() const {
+  std::lock_guard<std::mutex> lock(arenas_->mutex);
+  return arenas_->list.size();
+}
+
+size_t NetworkScratch::MemoryUsage() const {
+  auto io_size = [](const NetworkIO &io) {
+    return io.MemoryUsage();
+  };
+  auto vec_size = [](const std::vector<TFloat> &vec) {
+    return vec.capacity() * sizeof(TFloat);
+  };
+  auto array_size = [](const TransposedArray &array) {
+    return array.memory_size();
+  };
+  size_t total = 0;
+  std::lock_guard<std::mutex> lock(arenas_->mutex);
+  for (auto &arena : arenas_->list) {
+    total += arena->int_stack.MemoryUsage(io_size);
+    total += arena->float_stack.MemoryUsage(io_size);
+    total += arena->vec_stack.MemoryUsage(vec_size);
+    total += arena->array_stack.MemoryUsage(array_size);
+  }
+  return total;
+}
+
+void NetworkScratch::Trim() {
+  if (memory_limit_ == 0 || MemoryUsage() <= memory_limit_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(arenas_->mutex);
+  for (auto &arena : arenas_->list) {
+    // Buffers that are in use stay, together with the rest of their stack.
+    if (!arena->int_stack.InUse()) {
+      arena->int_stack.Clear();
+    }
+    if (!arena->float_stack.InUse()) {
+      arena->float_stack.Clear();
+    }
+    if (!arena->vec_stack.InUse()) {
+      arena->vec_stack.Clear();
+    }
+    if (!arena->array_stack.InUse()) {
+      arena->array_stack.Clear();
+    }
+  }
+}
+
+} // namespace tesseract.
@@ -19,9 +19,14 @@
 #ifndef TESSERACT_LSTM_NETWORKSCRATCH_H_
 #define TESSERACT_LSTM_NETWORKSCRATCH_H_
 
+#include <cstddef> // for size_t
+#include <cstdint> // for uint64_t
+#include <memory>  // for std::unique_ptr
 #include <mutex>
+#include <vector>
 #include "matrix.h"
 #include "networkio.h"
+#include "taskscheduler.h"
 
 namespace tesseract {
 
@@ -30,10 +35,25 @@ namespace tesseract {
 // scratch space that auto-frees after use. The aim here is to provide a set
 // of temporary buffers to network layers that can be reused between layers
 // and don't have to be reallocated on each call.
+// Each thread that uses the scratch space gets its own arena of buffers, so
+// borrowing and returning takes no locks. A buffer must be returned by the
+// thread that borrowed it, which the scoped IO, FloatVec and GradientStore
+// objects below guarantee. The buffers keep their memory between calls, and
+// so between lines and pages, until Trim finds that they exceed the memory
+// limit. When a thread exits, its arena is freed and kept for the next new
+// thread, so the number of arenas never exceeds the number of threads that
+// use the scratch space at the same time.
 class NetworkScratch {
+private:
+  struct Arena;
+  struct Arenas;
+  class ThreadArenas;
+
 public:
-  NetworkScratch() : int_mode_(false) {}
-  ~NetworkScratch() = default;
+  NetworkScratch();
+  ~NetworkScratch();
+  NetworkScratch(const NetworkScratch &) = delete;
+  NetworkScratch &operator=(const NetworkScratch &) = delete;
 
   // Sets the network representation. If the representation is integer, then
   // default (integer) NetworkIOs are separated from the always-float variety.
@@ -44,59 +64,77 @@ public:
     int_mode_ = int_mode;
   }
 
+  // Sets the scheduler that runs the parallel loops of the network layers.
+  // The scheduler is borrowed and must outlive its use. nullptr selects the
+  // process default.
+  void set_scheduler(const TaskScheduler *scheduler) {
+    scheduler_ = scheduler;
+  }
+  const TaskScheduler &scheduler() const {
+    return scheduler_ != nullptr ? *scheduler_ : TaskScheduler::Default();
+  }
+
+  // Returns the number of bytes held by the buffers of all threads.
+  size_t MemoryUsage() const;
+  // Returns the number of thread arenas, whether in use or kept for reuse.
+  size_t NumArenas() const;
+  // Sets the limit for MemoryUsage() that Trim enforces, 0 for no limit.
+  // This is a soft cap: it is only checked when Trim is called, between
+  // lines, and buffers that are in use are never freed, so a single line
+  // may use more.
+  void set_memory_limit(size_t bytes) {
+    memory_limit_ = bytes;
+  }
+  size_t memory_limit() const {
+    return memory_limit_;
+  }
+  // Frees all buffers if they use more than the memory limit. Must not be
+  // called while a network is running on this scratch space.
+  void Trim();
+
   // Class that acts like a NetworkIO (by having an implicit cast operator),
   // yet actually holds a pointer to NetworkIOs in the source NetworkScratch,
   // and knows how to unstack the borrowed pointers on destruction.
   class IO {
   public:
     // The NetworkIO should be sized after construction.
-    IO(const NetworkIO &src, NetworkScratch *scratch)
-        : int_mode_(scratch->int_mode_ && src.int_mode()), scratch_space_(scratch) {
-      network_io_ =
-          int_mode_ ? scratch_space_->int_stack_.Borrow() : scratch_space_->float_stack_.Borrow();
+    IO(const NetworkIO &src, NetworkScratch *scratch) : network_io_(nullptr), arena_(nullptr) {
+      Borrow(scratch->int_mode_ && src.int_mode(), scratch);
     }
     // Default constructor for arrays. Use one of the Resize functions
     // below to initialize and size.
-    IO() : int_mode_(false), network_io_(nullptr), scratch_space_(nullptr) {}
+    IO() : int_mode_(false), network_io_(nullptr), arena_(nullptr) {}
 
     ~IO() {
-      if (scratch_space_ == nullptr) {
+      if (arena_ == nullptr) {
         ASSERT_HOST(network_io_ == nullptr);
       } else if (int_mode_) {
-        scratch_space_->int_stack_.Return(network_io_);
+        arena_->int_stack.Return(network_io_);
       } else {
-        scratch_space_->float_stack_.Return(network_io_);
+        arena_->float_stack.Return(network_io_);
       }
     }
     // Resizes the array (and stride), avoiding realloc if possible, to the
     // size from various size specs:
     // Same time size, given number of features.
     void Resize(const NetworkIO &src, int num_features, NetworkScratch *scratch) {
-      if (scratch_space_ == nullptr) {
-        int_mode_ = scratch->int_mode_ && src.int_mode();
-        scratch_space_ = scratch;
-        network_io_ =
-            int_mode_ ? scratch_space_->int_stack_.Borrow() : scratch_space_->float_stack_.Borrow();
+      if (arena_ == nullptr) {
+        Borrow(scratch->int_mode_ && src.int_mode(), scratch);
       }
       network_io_->Resize(src, num_features);
     }
     // Resizes to a specific size as a temp buffer. No batches, no y-dim.
     void Resize2d(bool int_mode, int width, int num_features, NetworkScratch *scratch) {
-      if (scratch_space_ == nullptr) {
-        int_mode_ = scratch->int_mode_ && int_mode;
-        scratch_space_ = scratch;
-        network_io_ =
-            int_mode_ ? scratch_space_->int_stack_.Borrow() : scratch_space_->float_stack_.Borrow();
+      if (arena_ == nullptr) {
+        Borrow(scratch->int_mode_ && int_mode, scratch);
       }
       network_io_->Resize2d(int_mode, width, num_features);
     }
     // Resize forcing a float representation with the width of src and the given
     // number of features.
     void ResizeFloat(const NetworkIO &src, int num_features, NetworkScratch *scratch) {
-      if (scratch_space_ == nullptr) {
-        int_mode_ = false;
-        scratch_space_ = scratch;
-        network_io_ = scratch_space_->float_stack_.Borrow();
+      if (arena_ == nullptr) {
+        Borrow(false, scratch);
       }
       network_io_->ResizeFloat(src, num_features);
     }
@@ -114,13 +152,19 @@ public:
     }
 
   private:
+    void Borrow(bool int_mode, NetworkScratch *scratch) {
+      int_mode_ = int_mode;
+      arena_ = scratch->ThreadArena();
+      network_io_ = int_mode_ ? arena_->int_stack.Borrow() : arena_->float_stack.Borrow();
+    }
+
     // True if this is from the always-float stack, otherwise the default stack.
     bool int_mode_;
-    // The NetworkIO that we have borrowed from the scratch_space_.
+    // The NetworkIO that we have borrowed from the arena_.
     NetworkIO *network_io_;
-    // The source scratch_space_. Borrowed pointer, used to free the
+    // The arena of the borrowing thread. Borrowed pointer, used to free the
     // NetworkIO. Don't delete!
-    NetworkScratch *scratch_space_;
+    Arena *arena_;
   }; // class IO.
 
   // Class that acts like a fixed array of float, yet actually uses space
@@ -129,27 +173,28 @@ public:
   class FloatVec {
   public:
     // The array will have size elements in it, uninitialized.
-    FloatVec(int size, NetworkScratch *scratch) : vec_(nullptr), scratch_space_(scratch) {
+    FloatVec(int size, NetworkScratch *scratch) : vec_(nullptr), arena_(nullptr) {
       Init(size, scratch);
     }
     // Default constructor is for arrays. Use Init to setup.
-    FloatVec() : vec_(nullptr), data_(nullptr), scratch_space_(nullptr) {}
+    FloatVec() : vec_(nullptr), data_(nullptr), arena_(nullptr) {}
     ~FloatVec() {
-      if (scratch_space_ != nullptr) {
-        scratch_space_->vec_stack_.Return(vec_);
+      if (arena_ != nullptr) {
+        arena_->vec_stack.Return(vec_);
       }
     }
 
     void Init(int /*size*/, int reserve, NetworkScratch *scratch) {
-      if (scratch_space_ != nullptr && vec_ != nullptr) {
-        scratch_space_->vec_stack_.Return(vec_);
+      if (arena_ != nullptr && vec_ != nullptr) {
+        arena_->vec_stack.Return(vec_);
       }
-      scratch_space_ = scratch;
-      vec_ = scratch_space_->vec_stack_.Borrow();
-      // TODO: optimize.
-      vec_->resize(reserve);
-      // use vector.at(0) to make sure we do not trigger UB on an empty vector
-      data_ = &vec_->at(0);
+      arena_ = scratch->ThreadArena();
+      vec_ = arena_->vec_stack.Borrow();
+      // Only grows the vector, so its memory is reused from the last time.
+      if (vec_->size() < static_cast<size_t>(reserve)) {
+        vec_->resize(reserve);
+      }
+      data_ = vec_->data();
     }
 
     void Init(int size, NetworkScratch *scratch) {
@@ -170,9 +215,9 @@ public:
     std::vector<TFloat> *vec_;
     // Short-cut pointer to the underlying array.
     TFloat *data_;
-    // The source scratch_space_. Borrowed pointer, used to free the
+    // The arena of the borrowing thread. Borrowed pointer, used to free the
     // vector. Don't delete!
-    NetworkScratch *scratch_space_;
+    Arena *arena_;
   }; // class FloatVec
 
   // Class that acts like a 2-D array of TFloat, yet actually uses space
@@ -181,19 +226,19 @@ public:
   class GradientStore {
   public:
     // Default constructor is for arrays. Use Init to setup.
-    GradientStore() : array_(nullptr), scratch_space_(nullptr) {}
+    GradientStore() : array_(nullptr), arena_(nullptr) {}
     ~GradientStore() {
-      if (scratch_space_ != nullptr) {
-        scratch_space_->array_stack_.Return(array_);
+      if (arena_ != nullptr) {
+        arena_->array_stack.Return(array_);
       }
     }
 
     void Init(int size1, int size2, NetworkScratch *scratch) {
-      if (scratch_space_ != nullptr && array_ != nullptr) {
-        scratch_space_->array_stack_.Return(array_);
+      if (arena_ != nullptr && array_ != nullptr) {
+        arena_->array_stack.Return(array_);
       }
-      scratch_space_ = scratch;
-      array_ = scratch_space_->array_stack_.Borrow();
+      arena_ = scratch->ThreadArena();
+      array_ = arena_->array_stack.Borrow();
       array_->Resize(size1, size2, 0.0);
     }
 
@@ -208,35 +253,27 @@ public:
   private:
     // Array borrowed from the scratch space. Use Return to free it.
     TransposedArray *array_;
-    // The source scratch_space_. Borrowed pointer, used to free the
-    // vector. Don't delete!
-    NetworkScratch *scratch_space_;
+    // The arena of the borrowing thread. Borrowed pointer, used to free the
+    // array. Don't delete!
+    Arena *arena_;
   }; // class GradientStore
 
+private:
   // Class that does the work of holding a stack of objects, a stack pointer
   // and a vector of in-use flags, so objects can be returned out of order.
-  // It is safe to attempt to Borrow/Return in multiple threads.
+  // Each Stack is only used by a single thread, so it needs no locking.
   template <typename T>
   class Stack {
   public:
-    Stack() = default;
-
-    ~Stack() {
-      for (auto data : stack_) {
-        delete data;
-      }
-    }
-
     // Lends out the next free item, creating one if none available, sets
     // the used flags and increments the stack top.
     T *Borrow() {
-      std::lock_guard<std::mutex> lock(mutex_);
       if (stack_top_ == stack_.size()) {
-        stack_.push_back(new T);
+        stack_.emplace_back(new T);
         flags_.push_back(false);
       }
       flags_[stack_top_] = true;
-      return stack_[stack_top_++];
+      return stack_[stack_top_++].get();
     }
     // Takes back the given item, and marks it free. Item does not have to be
     // the most recently lent out, but free slots don't get re-used until the
@@ -244,10 +281,9 @@ public:
     // small, temporary variations from true stack use. (Determined by the order
     // of destructors within a local scope.)
     void Return(T *item) {
-      std::lock_guard<std::mutex> lock(mutex_);
       // Linear search will do.
       int index = stack_top_;
-      while (--index >= 0 && stack_[index] != item) {
+      while (--index >= 0 && stack_[index].get() != item) {
       }
       if (index >= 0) {
         flags_[index] = false;
@@ -257,22 +293,69 @@ public:
       }
     }
 
+    bool InUse() const {
+      return stack_top_ > 0;
+    }
+    // Returns the number of bytes held by the items, given a function that
+    // measures one of them.
+    template <typename Size>
+    size_t MemoryUsage(Size size) const {
+      size_t total = 0;
+      for (auto &item : stack_) {
+        total += size(*item);
+      }
+      return total;
+    }
+    // Deletes all items. None may be in use.
+    void Clear() {
+      stack_.clear();
+      flags_.clear();
+      stack_top_ = 0;
+    }
+
   private:
-    std::vector<T *> stack_;
+    std::vector<std::unique_ptr<T>> stack_;
     std::vector<bool> flags_;
     unsigned stack_top_ = 0;
-    std::mutex mutex_;
   }; // class Stack.
 
-private:
+  // The buffers of one thread.
+  struct Arena {
+    // Stacks of NetworkIO and vector<float>. Once allocated, they are not
+    // deleted until the NetworkScratch is deleted or trimmed.
+    Stack<NetworkIO> int_stack;
+    Stack<NetworkIO> float_stack;
+    Stack<std::vector<TFloat>> vec_stack;
+    Stack<TransposedArray> array_stack;
+    // True while a thread owns the arena, false once it has exited.
+    bool in_use = false;
+  };
+  // The arenas of all threads. They are shared with the threads that took
+  // them, so a thread that exits can give its arena back, even while the
+  // NetworkScratch is being deleted.
+  struct Arenas {
+    // Protects list, which only changes when a thread uses the scratch
+    // space for the first time or exits.
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Arena>> list;
+  };
+
+  // Returns the arena of the calling thread, taking the arena of an exited
+  // thread or creating one on first use. Only the first use by each thread
+  // takes a lock.
+  Arena *ThreadArena();
+
   // If true, the network weights are int8_t, if false, float.
   bool int_mode_;
-  // Stacks of NetworkIO and vector<float>. Once allocated, they are not
-  // deleted until the NetworkScratch is deleted.
-  Stack<NetworkIO> int_stack_;
-  Stack<NetworkIO> float_stack_;
-  Stack<std::vector<TFloat>> vec_stack_;
-  Stack<TransposedArray> array_stack_;
+  // Scheduler for parallel loops, owned by the engine. nullptr means
+  // TaskScheduler::Default().
+  const TaskScheduler *scheduler_;
+  // Limit for MemoryUsage() enforced by Trim, 0 for no limit.
+  size_t memory_limit_;
+  // Identifies this instance in the per-thread arena lists. Unlike the
+  // address, it is never reused by another instance.
+  uint64_t id_;
+  std::shared_ptr<Arenas> arenas_;
 };
 
 } // namespace tesseract.
@@ -19,11 +19,7 @@
 
 #include "parallel.h"
 
-#ifdef _OPENMP
-#  include <omp.h>
-#endif
-
-#include "functions.h" // For conditional undef of _OPENMP.
+#include "functions.h"
 #include "networkscratch.h"
 
 namespace tesseract {
@@ -63,12 +59,11 @@ void Parallel::Forward(bool debug, const NetworkIO &input, const TransposedArray
     for (int i = 0; i < stack_size; ++i) {
       results[i].Resize(input, stack_[i]->NumOutputs(), scratch);
     }
-#ifdef _OPENMP
-#  pragma omp parallel for num_threads(stack_size)
-#endif
-    for (int i = 0; i < stack_size; ++i) {
-      stack_[i]->Forward(debug, input, nullptr, scratch, results[i]);
-    }
+    scratch->scheduler().ParallelFor(stack_size, [&](int, int start, int end) {
+      for (int i = start; i < end; ++i) {
+        ForwardStack(i, debug, input, nullptr, scratch, results[i]);
+      }
+    });
     // Now pack all the results (serially) into the output.
     int out_offset = 0;
     output->Resize(*results[0], NumOutputs());
@@ -89,7 +84,7 @@ void Parallel::Forward(bool debug, const NetworkIO &input, const TransposedArray
     // Run each network, putting the outputs into result.
     int out_offset = 0;
     for (int i = 0; i < stack_size; ++i) {
-      stack_[i]->Forward(debug, input, src_transpose, scratch, result);
+      ForwardStack(i, debug, input, src_transpose, scratch, result);
       // All networks must have the same output width
       if (i == 0) {
         output->Resize(*result, NumOutputs());
@@ -132,12 +127,11 @@ bool Parallel::Backward(bool debug, const NetworkIO &fwd_deltas, NetworkScratch
       in_deltas[i]->CopyUnpacking(fwd_deltas, feature_offset, num_features);
       feature_offset += num_features;
     }
-#ifdef _OPENMP
-#  pragma omp parallel for num_threads(stack_size)
-#endif
-    for (unsigned i = 0; i < stack_size; ++i) {
-      stack_[i]->Backward(debug, *in_deltas[i], scratch, i == 0 ? back_deltas : out_deltas[i]);
-    }
+    scratch->scheduler().ParallelFor(stack_size, [&](int, int start, int end) {
+      for (int i = start; i < end; ++i) {
+        stack_[i]->Backward(debug, *in_deltas[i], scratch, i == 0 ? back_deltas : out_deltas[i]);
+      }
+    });
     if (needs_to_backprop_) {
       for (unsigned i = 1; i < stack_size; ++i) {
         back_deltas->AddAllToFloat(*out_deltas[i]);
@@ -20,6 +20,8 @@
 
 #include "plumbing.h"
 
+#include <chrono> // for std::chrono::steady_clock
+
 namespace tesseract {
 
 // ni_ and no_ will be set by AddToStack.
@@ -73,6 +75,36 @@ void Plumbing::ConvertToInt() {
   }
 }
 
+// Shares the weights of each sub-network with its counterpart in src.
+void Plumbing::ShareWeights(const Network &src) {
+  const auto &plumbing = static_cast<const Plumbing &>(src);
+  ASSERT_HOST(plumbing.stack_.size() == stack_.size());
+  for (size_t i = 0; i < stack_.size(); ++i) {
+    stack_[i]->ShareWeights(*plumbing.stack_[i]);
+  }
+}
+
+// Passes the request on to each sub-network.
+void Plumbing::OptimizeForInference(bool enable) {
+  for (auto &i : stack_) {
+    i->OptimizeForInference(enable);
+  }
+}
+
+// Appends the matrix shapes of each sub-network.
+void Plumbing::GetMatrixShapes(std::vector<MatrixShape> *shapes) const {
+  for (auto *i : stack_) {
+    i->GetMatrixShapes(shapes);
+  }
+}
+
+// Shapes the weights of each sub-network.
+void Plumbing::ShapeWeights() {
+  for (auto *i : stack_) {
+    i->ShapeWeights();
+  }
+}
+
 // Provides a pointer to a TRand for any networks that care to use it.
 // Note that randomizer is a borrowed pointer that should outlive the network
 // and should not be deleted by any of the networks.
@@ -99,6 +131,21 @@ void Plumbing::AddToStack(Network *network) {
   stack_.push_back(network);
 }
 
+// Runs the Forward of stack_[index], timing it only when profiling.
+void Plumbing::ForwardStack(int index, bool debug, const NetworkIO &input,
+                            const TransposedArray *input_transpose, NetworkScratch *scratch,
+                            NetworkIO *output) {
+  ForwardProfiler *profiler = GetForwardProfiler();
+  if (profiler == nullptr) {
+    stack_[index]->Forward(debug, input, input_transpose, scratch, output);
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  stack_[index]->Forward(debug, input, input_transpose, scratch, output);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  profiler->Record(stack_[index], elapsed.count());
+}
+
 // Sets needs_to_backprop_ to needs_backprop and calls on sub-network
 // according to needs_backprop || any weights in this network.
 bool Plumbing::SetupNeedsBackprop(bool needs_backprop) {
@@ -266,4 +313,19 @@ void Plumbing::CountAlternators(const Network &other, TFloat *same, TFloat *chan
   }
 }
 
+// Replaces the weight deltas of each sub-network by the sum of those of its
+// counterparts in replicas.
+void Plumbing::SumDeltas(const std::vector<const Network *> &replicas) {
+  for (size_t i = 0; i < stack_.size(); ++i) {
+    std::vector<const Network *> sub_replicas;
+    for (const auto *replica : replicas) {
+      ASSERT_HOST(replica->type() == type_);
+      const auto *plumbing = static_cast<const Plumbing *>(replica);
+      ASSERT_HOST(plumbing->stack_.size() == stack_.size());
+      sub_replicas.push_back(plumbing->stack_[i]);
+    }
+    stack_[i]->SumDeltas(sub_replicas);
+  }
+}
+
 } // namespace tesseract.
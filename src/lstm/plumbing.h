@@ -78,6 +78,18 @@ public:
   // Converts a float network to an int network.
   void ConvertToInt() override;
 
+  // Shares the weights of each sub-network with its counterpart in src.
+  void ShareWeights(const Network &src) override;
+
+  // Passes the request on to each sub-network.
+  void OptimizeForInference(bool enable) override;
+
+  // Appends the matrix shapes of each sub-network.
+  void GetMatrixShapes(std::vector<MatrixShape> *shapes) const override;
+
+  // Shapes the weights of each sub-network.
+  void ShapeWeights() override;
+
   // Provides a pointer to a TRand for any networks that care to use it.
   // Note that randomizer is a borrowed pointer that should outlive the network
   // and should not be deleted by any of the networks.
@@ -149,8 +161,16 @@ public:
   // positive (same direction) in *same and negative (different direction) in
   // *changed.
   void CountAlternators(const Network &other, TFloat *same, TFloat *changed) const override;
+  // Replaces the weight deltas by the sum of those of replicas.
+  void SumDeltas(const std::vector<const Network *> &replicas) override;
 
 protected:
+  // Runs the Forward of stack_[index], and reports its time to the forward
+  // profiler if there is one.
+  void ForwardStack(int index, bool debug, const NetworkIO &input,
+                    const TransposedArray *input_transpose, NetworkScratch *scratch,
+                    NetworkIO *output);
+
   // The networks.
   std::vector<Network *> stack_;
   // Layer-specific learning rate iff network_flags_ & NF_LAYER_SPECIFIC_LR.
@@ -21,6 +21,7 @@
 
 #include "recodebeam.h"
 
+#include "helpers.h"
 #include "networkio.h"
 #include "pageres.h"
 #include "unicharcompress.h"
@@ -72,6 +73,7 @@ RecodeBeamSearch::RecodeBeamSearch(const UnicharCompress &recoder,
   if (dict_ != nullptr && !dict_->IsSpaceDelimitedLang()) {
     space_delimited_ = false;
   }
+  SetBeamWidthBounds(0, 0);
 }
 
 RecodeBeamSearch::~RecodeBeamSearch() {
@@ -83,17 +85,28 @@ RecodeBeamSearch::~RecodeBeamSearch() {
   }
 }
 
+void RecodeBeamSearch::SetBeamWidthBounds(int min_width, int max_width,
+                                          float confident_margin, float ambiguous_margin) {
+  min_beam_width_ = min_width > 0 ? min_width : kBeamWidths[0];
+  max_beam_width_ = max_width > 0 ? max_width : kBeamWidths[0];
+  max_beam_width_ = std::max(max_beam_width_, min_beam_width_);
+  confident_margin_ = confident_margin;
+  ambiguous_margin_ = std::min(ambiguous_margin, confident_margin);
+  beam_width_ = kBeamWidths[0];
+}
+
 // Decodes the set of network outputs, storing the lattice internally.
 void RecodeBeamSearch::Decode(const NetworkIO &output, double dict_ratio,
                               double cert_offset, double worst_dict_cert,
                               const UNICHARSET *charset, int lstm_choice_mode) {
   beam_size_ = 0;
+  dawg_pool_.Reset();
   int width = output.Width();
   if (lstm_choice_mode) {
     timesteps.clear();
   }
   for (int t = 0; t < width; ++t) {
-    ComputeTopN(output.f(t), output.NumFeatures(), kBeamWidths[0]);
+    ComputeTopN(output.f(t), output.NumFeatures(), max_beam_width_);
     DecodeStep(output.f(t), t, dict_ratio, cert_offset, worst_dict_cert,
                charset);
     if (lstm_choice_mode) {
@@ -106,9 +119,10 @@ void RecodeBeamSearch::Decode(const GENERIC_2D_ARRAY<float> &output,
                               double worst_dict_cert,
                               const UNICHARSET *charset) {
   beam_size_ = 0;
+  dawg_pool_.Reset();
   int width = output.dim1();
   for (int t = 0; t < width; ++t) {
-    ComputeTopN(output[t], output.dim2(), kBeamWidths[0]);
+    ComputeTopN(output[t], output.dim2(), max_beam_width_);
     DecodeStep(output[t], t, dict_ratio, cert_offset, worst_dict_cert, charset);
   }
 }
@@ -664,7 +678,8 @@ WERD_RES *RecodeBeamSearch::InitializeWord(bool leading_space,
 }
 
 // Fills top_n_flags_ with bools that are true iff the corresponding output
-// is one of the top_n.
+// is one of the top_n, where top_n is reduced to the adaptive beam width of
+// the timestep.
 void RecodeBeamSearch::ComputeTopN(const float *outputs, int num_outputs,
                                    int top_n) {
   top_n_flags_.clear();
@@ -681,23 +696,43 @@ void RecodeBeamSearch::ComputeTopN(const float *outputs, int num_outputs,
       }
     }
   }
+  top_codes_.clear();
   while (!top_heap_.empty()) {
     TopPair entry;
     top_heap_.Pop(&entry);
-    if (top_heap_.size() > 1) {
-      top_n_flags_[entry.data()] = TN_TOPN;
-    } else {
-      top_n_flags_[entry.data()] = TN_TOP2;
-      if (top_heap_.empty()) {
-        top_code_ = entry.data();
-      } else {
-        second_code_ = entry.data();
-      }
+    top_codes_.push_back(entry.data());
+  }
+  int num_codes = top_codes_.size();
+  if (num_codes > 0) {
+    top_code_ = top_codes_[num_codes - 1];
+    float margin = outputs[top_code_];
+    if (num_codes > 1) {
+      second_code_ = top_codes_[num_codes - 2];
+      margin -= outputs[second_code_];
+    }
+    // Only the best of the top_n are worth trying when the output is near
+    // one-hot, and the beams are cut down to match.
+    beam_width_ = AdaptiveBeamWidth(margin);
+    for (int rank = 0; rank < std::min(num_codes, beam_width_); ++rank) {
+      top_n_flags_[top_codes_[num_codes - 1 - rank]] = rank < 2 ? TN_TOP2 : TN_TOPN;
     }
+  } else {
+    beam_width_ = max_beam_width_;
   }
   top_n_flags_[null_char_] = TN_TOP2;
 }
 
+int RecodeBeamSearch::AdaptiveBeamWidth(float margin) const {
+  if (margin >= confident_margin_) {
+    return min_beam_width_;
+  }
+  if (margin <= ambiguous_margin_) {
+    return max_beam_width_;
+  }
+  float fraction = (confident_margin_ - margin) / (confident_margin_ - ambiguous_margin_);
+  return min_beam_width_ + IntCastRounded((max_beam_width_ - min_beam_width_) * fraction);
+}
+
 void RecodeBeamSearch::ComputeSecTopN(std::unordered_set<int> *exList,
                                       const float *outputs, int num_outputs,
                                       int top_n) {
@@ -731,6 +766,7 @@ void RecodeBeamSearch::ComputeSecTopN(std::unordered_set<int> *exList,
     }
   }
   top_n_flags_[null_char_] = TN_TOP2;
+  beam_width_ = kBeamWidths[0];
 }
 
 // Adds the computation for the current time-step to the beam. Call at each
@@ -802,8 +838,11 @@ void RecodeBeamSearch::DecodeStep(const float *outputs, int t,
       if (step->best_initial_dawgs_[c].code >= 0) {
         int index = BeamIndex(true, static_cast<NodeContinuation>(c), 0);
         RecodeHeap *dawg_heap = &step->beams_[index];
-        PushHeapIfBetter(kBeamWidths[0], &step->best_initial_dawgs_[c],
+        PushHeapIfBetter(BeamWidth(0), &step->best_initial_dawgs_[c],
                          dawg_heap);
+        // Unless it went to the heap, nothing refers to its dawgs.
+        dawg_pool_.Release(step->best_initial_dawgs_[c].dawgs);
+        step->best_initial_dawgs_[c].dawgs = nullptr;
       }
     }
   }
@@ -874,8 +913,11 @@ void RecodeBeamSearch::DecodeSecondaryStep(
       if (step->best_initial_dawgs_[c].code >= 0) {
         int index = BeamIndex(true, static_cast<NodeContinuation>(c), 0);
         RecodeHeap *dawg_heap = &step->beams_[index];
-        PushHeapIfBetter(kBeamWidths[0], &step->best_initial_dawgs_[c],
+        PushHeapIfBetter(BeamWidth(0), &step->best_initial_dawgs_[c],
                          dawg_heap);
+        // Unless it went to the heap, nothing refers to its dawgs.
+        dawg_pool_.Release(step->best_initial_dawgs_[c].dawgs);
+        step->best_initial_dawgs_[c].dawgs = nullptr;
       }
     }
   }
@@ -1023,7 +1065,7 @@ void RecodeBeamSearch::ContinueUnichar(int code, int unichar_id, float cert,
     }
   } else {
     RecodeHeap *nodawg_heap = &step->beams_[BeamIndex(false, cont, 0)];
-    PushHeapIfBetter(kBeamWidths[0], code, unichar_id, TOP_CHOICE_PERM, false,
+    PushHeapIfBetter(BeamWidth(0), code, unichar_id, TOP_CHOICE_PERM, false,
                      false, false, false, cert * dict_ratio, prev, nullptr,
                      nodawg_heap);
     if (dict_ != nullptr &&
@@ -1063,7 +1105,7 @@ void RecodeBeamSearch::ContinueDawg(int code, int unichar_id, float cert,
   RecodeHeap *dawg_heap = &step->beams_[BeamIndex(true, cont, 0)];
   RecodeHeap *nodawg_heap = &step->beams_[BeamIndex(false, cont, 0)];
   if (unichar_id == INVALID_UNICHAR_ID) {
-    PushHeapIfBetter(kBeamWidths[0], code, unichar_id, NO_PERM, false, false,
+    PushHeapIfBetter(BeamWidth(0), code, unichar_id, NO_PERM, false, false,
                      false, false, cert, prev, nullptr, dawg_heap);
     return;
   }
@@ -1072,9 +1114,9 @@ void RecodeBeamSearch::ContinueDawg(int code, int unichar_id, float cert,
   if (prev != nullptr) {
     score += prev->score;
   }
-  if (dawg_heap->size() >= kBeamWidths[0] &&
+  if (dawg_heap->size() >= BeamWidth(0) &&
       score <= dawg_heap->PeekTop().data().score &&
-      nodawg_heap->size() >= kBeamWidths[0] &&
+      nodawg_heap->size() >= BeamWidth(0) &&
       score <= nodawg_heap->PeekTop().data().score) {
     return;
   }
@@ -1091,7 +1133,7 @@ void RecodeBeamSearch::ContinueDawg(int code, int unichar_id, float cert,
       // space to the top choice beam.
       PushInitialDawgIfBetter(code, unichar_id, uni_prev->permuter, false,
                               false, cert, cont, prev, step);
-      PushHeapIfBetter(kBeamWidths[0], code, unichar_id, uni_prev->permuter,
+      PushHeapIfBetter(BeamWidth(0), code, unichar_id, uni_prev->permuter,
                        false, false, false, false, cert, prev, nullptr,
                        nodawg_heap);
     }
@@ -1102,25 +1144,26 @@ void RecodeBeamSearch::ContinueDawg(int code, int unichar_id, float cert,
              dict_->getUnicharset().IsSpaceDelimited(unichar_id)) {
     return; // Can't break words between space delimited chars.
   }
-  DawgPositionVector initial_dawgs;
-  auto *updated_dawgs = new DawgPositionVector;
-  DawgArgs dawg_args(&initial_dawgs, updated_dawgs, NO_PERM);
+  initial_dawgs_.clear();
+  DawgPositionVector *updated_dawgs = dawg_pool_.Get();
+  DawgArgs dawg_args(&initial_dawgs_, updated_dawgs, NO_PERM);
   bool word_start = false;
   if (uni_prev == nullptr) {
     // Starting from beginning of line.
-    dict_->default_dawgs(&initial_dawgs, false);
+    dict_->default_dawgs(&initial_dawgs_, false);
     word_start = true;
   } else if (uni_prev->dawgs != nullptr) {
     // Continuing a previous dict word.
     dawg_args.active_dawgs = uni_prev->dawgs;
     word_start = uni_prev->start_of_dawg;
   } else {
+    dawg_pool_.Release(updated_dawgs);
     return; // Can't continue if not a dict word.
   }
   auto permuter = static_cast<PermuterType>(dict_->def_letter_is_okay(
       &dawg_args, dict_->getUnicharset(), unichar_id, false));
   if (permuter != NO_PERM) {
-    PushHeapIfBetter(kBeamWidths[0], code, unichar_id, permuter, false,
+    PushHeapIfBetter(BeamWidth(0), code, unichar_id, permuter, false,
                      word_start, dawg_args.valid_end, false, cert, prev,
                      dawg_args.updated_dawgs, dawg_heap);
     if (dawg_args.valid_end && !space_delimited_) {
@@ -1129,12 +1172,12 @@ void RecodeBeamSearch::ContinueDawg(int code, int unichar_id, float cert,
       // since non-dict words can start here too.
       PushInitialDawgIfBetter(code, unichar_id, permuter, word_start, true,
                               cert, cont, prev, step);
-      PushHeapIfBetter(kBeamWidths[0], code, unichar_id, permuter, false,
+      PushHeapIfBetter(BeamWidth(0), code, unichar_id, permuter, false,
                        word_start, true, false, cert, prev, nullptr,
                        nodawg_heap);
     }
   } else {
-    delete updated_dawgs;
+    dawg_pool_.Release(updated_dawgs);
   }
 }
 
@@ -1153,11 +1196,12 @@ void RecodeBeamSearch::PushInitialDawgIfBetter(int code, int unichar_id,
     score += prev->score;
   }
   if (best_initial_dawg->code < 0 || score > best_initial_dawg->score) {
-    auto *initial_dawgs = new DawgPositionVector;
+    DawgPositionVector *initial_dawgs = dawg_pool_.Get();
     dict_->default_dawgs(initial_dawgs, false);
     RecodeNode node(code, unichar_id, permuter, true, start, end, false, cert,
                     score, prev, initial_dawgs,
                     ComputeCodeHash(code, false, prev));
+    dawg_pool_.Release(best_initial_dawg->dawgs);
     *best_initial_dawg = node;
   }
 }
@@ -1172,7 +1216,7 @@ void RecodeBeamSearch::PushDupOrNoDawgIfBetter(
   int index = BeamIndex(use_dawgs, cont, length);
   if (use_dawgs) {
     if (cert > worst_dict_cert) {
-      PushHeapIfBetter(kBeamWidths[length], code, unichar_id,
+      PushHeapIfBetter(BeamWidth(length), code, unichar_id,
                        prev ? prev->permuter : NO_PERM, false, false, false,
                        dup, cert, prev, nullptr, &step->beams_[index]);
     }
@@ -1180,7 +1224,7 @@ void RecodeBeamSearch::PushDupOrNoDawgIfBetter(
 	// non-dictionary word being processed: correct certainty by kDictRatio factor
     cert *= dict_ratio;
     if (cert >= kMinCertainty || code == null_char_) {
-      PushHeapIfBetter(kBeamWidths[length], code, unichar_id,
+      PushHeapIfBetter(BeamWidth(length), code, unichar_id,
                        prev ? prev->permuter : TOP_CHOICE_PERM, false, false,
                        false, dup, cert, prev, nullptr, &step->beams_[index]);
     }
@@ -1216,9 +1260,10 @@ void RecodeBeamSearch::PushHeapIfBetter(int max_size, int code, int unichar_id,
     ASSERT_HOST(entry.data().dawgs == nullptr);
     if (heap->size() > max_size) {
       heap->Pop(&entry);
+      dawg_pool_.Release(entry.data().dawgs);
     }
   } else {
-    delete d;
+    dawg_pool_.Release(d);
   }
 }
 
@@ -1235,6 +1280,7 @@ void RecodeBeamSearch::PushHeapIfBetter(int max_size, RecodeNode *node,
     ASSERT_HOST(entry.data().dawgs == nullptr);
     if (heap->size() > max_size) {
       heap->Pop(&entry);
+      dawg_pool_.Release(entry.data().dawgs);
     }
   }
 }
@@ -1255,9 +1301,13 @@ bool RecodeBeamSearch::UpdateHeapIfMatched(RecodeNode *new_node,
       if (new_node->score > node.score) {
         // The new one is better. Update the entire node in the heap and
         // reshuffle.
+        dawg_pool_.Release(node.dawgs);
         node = *new_node;
         i.key() = node.score;
         heap->Reshuffle(&i);
+      } else {
+        dawg_pool_.Release(new_node->dawgs);
+        new_node->dawgs = nullptr;
       }
       return true;
     }
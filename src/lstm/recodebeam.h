@@ -30,6 +30,7 @@
 #include "unicharcompress.h"
 #include "genericvector.h"     // for PointerVector (ptr only)
 
+#include <algorithm>     // for std::max
 #include <unordered_set> // for std::unordered_set
 #include <vector>        // for std::vector
 
@@ -89,6 +90,57 @@ enum TopNState {
   TN_COUNT
 };
 
+// Recycles the DawgPositionVectors of the lattice of a beam search. Once the
+// pool has grown to what the longest line needs, a dictionary search no
+// longer allocates any, and the vectors keep their capacity from one use to
+// the next.
+class DawgPositionVectorPool {
+public:
+  DawgPositionVectorPool() = default;
+  ~DawgPositionVectorPool() {
+    for (auto *vec : all_) {
+      delete vec;
+    }
+  }
+  DawgPositionVectorPool(const DawgPositionVectorPool &) = delete;
+  DawgPositionVectorPool &operator=(const DawgPositionVectorPool &) = delete;
+
+  // Returns an empty vector, which stays valid until it is released or the
+  // pool is reset.
+  DawgPositionVector *Get() {
+    DawgPositionVector *vec;
+    if (free_.empty()) {
+      vec = new DawgPositionVector;
+      all_.push_back(vec);
+    } else {
+      vec = free_.back();
+      free_.pop_back();
+      vec->clear();
+    }
+    return vec;
+  }
+  // Gives back a vector that nothing refers to any more. Ignores nullptr.
+  void Release(DawgPositionVector *vec) {
+    if (vec != nullptr) {
+      free_.push_back(vec);
+    }
+  }
+  // Gives back all the vectors at once.
+  void Reset() {
+    free_ = all_;
+  }
+  // Returns the number of vectors that the pool has allocated.
+  size_t size() const {
+    return all_.size();
+  }
+
+private:
+  // All the vectors of the pool. Owned.
+  std::vector<DawgPositionVector *> all_;
+  // The vectors that can be handed out.
+  std::vector<DawgPositionVector *> free_;
+};
+
 // Lattice element for Re-encode beam search.
 struct RecodeNode {
   RecodeNode()
@@ -121,24 +173,21 @@ struct RecodeNode {
       , code_hash(hash) {}
   // NOTE: If we could use C++11, then this would be a move constructor.
   // Instead we have copy constructor that does a move!! This is because we
-  // don't want to copy the whole DawgPositionVector each time, and true
-  // copying isn't necessary for this struct. It does get moved around a lot
-  // though inside the heap and during heap push, hence the move semantics.
+  // don't want two nodes to hold the same DawgPositionVector, as the beam
+  // search gives it back to its pool when the holder drops out of the beam.
+  // It does get moved around a lot though inside the heap and during heap
+  // push, hence the move semantics.
   RecodeNode(const RecodeNode &src) : dawgs(nullptr) {
     *this = src;
     ASSERT_HOST(src.dawgs == nullptr);
   }
   RecodeNode &operator=(const RecodeNode &src) {
     if (this != &src) {
-      delete dawgs;
       memcpy(this, &src, sizeof(src));
       src.dawgs = nullptr;
     }
     return *this;
   }
-  ~RecodeNode() {
-    delete dawgs;
-  }
   // Prints details of the node.
   std::string Print(int null_char, const UNICHARSET *unicharset, int depth) const;
 
@@ -170,7 +219,9 @@ struct RecodeNode {
   float score;
   // The previous node in this chain. Borrowed pointer.
   const RecodeNode *prev;
-  // The currently active dawgs at this position. Owned pointer.
+  // The currently active dawgs at this position. Borrowed from the
+  // DawgPositionVectorPool of the beam search, and only valid until it is
+  // reset.
   mutable DawgPositionVector *dawgs;
   // A hash of all codes in the prefix and this->code as well. Used for
   // duplicate path removal.
@@ -197,6 +248,27 @@ public:
   void DecodeSecondaryBeams(const NetworkIO &output, double dict_ratio, double cert_offset,
                             double worst_dict_cert, const UNICHARSET *charset);
 
+  // Returns the number of dawg vectors that the searches so far have
+  // allocated. They are reused by the next Decode.
+  size_t DawgPoolSize() const {
+    return dawg_pool_.size();
+  }
+
+  // Sets the bounds of the beam width that Decode uses at each timestep,
+  // depending on the margin between the two best outputs: timesteps with a
+  // margin of at least confident_margin get min_width, those with at most
+  // ambiguous_margin get max_width, and those in between a width that is
+  // interpolated linearly. The widths are those of the beams of single codes;
+  // the beams of longer code sequences scale with them. max_width is also the
+  // number of best outputs that ComputeTopN considers at each timestep.
+  // Widths <= 0 select the fixed default width, which is also what is used
+  // until this is called.
+  void SetBeamWidthBounds(int min_width, int max_width,
+                          float confident_margin = kConfidentMargin,
+                          float ambiguous_margin = kAmbiguousMargin);
+  // Returns the beam width for the given top-1 margin of a timestep.
+  int AdaptiveBeamWidth(float margin) const;
+
   // Returns the best path as labels/scores/xcoords similar to simple CTC.
   void ExtractBestPathAsLabels(std::vector<int> *labels, std::vector<int> *xcoords) const;
   // Returns the best path as unichar-ids/certs/ratings/xcoords skipping
@@ -317,8 +389,14 @@ private:
                            const std::vector<int> &xcoords, float scale_factor);
 
   // Fills top_n_flags_ with bools that are true iff the corresponding output
-  // is one of the top_n.
+  // is one of the top_n, where top_n is reduced to the adaptive beam width
+  // of the timestep, which is also set in beam_width_.
   void ComputeTopN(const float *outputs, int num_outputs, int top_n);
+  // Returns the maximum size of the beams of code sequences of the given
+  // length for the current timestep.
+  int BeamWidth(int length) const {
+    return std::max(1, kBeamWidths[length] * beam_width_ / kBeamWidths[0]);
+  }
 
   void ComputeSecTopN(std::unordered_set<int> *exList, const float *outputs, int num_outputs,
                       int top_n);
@@ -399,6 +477,13 @@ private:
                         const std::vector<float> &ratings, const std::vector<int> &xcoords) const;
 
   static const int kBeamWidths[RecodedCharID::kMaxCodeLen + 1];
+  // Default margins of SetBeamWidthBounds. The outputs are softmax
+  // probabilities, so a margin of 0.9 leaves at most 0.1 to share among all
+  // the alternatives of the best output, which are then not worth a wide
+  // beam. Below 0.3 the two best outputs are close enough for either to win
+  // once the dictionary and the context are taken into account.
+  static constexpr float kConfidentMargin = 0.9f;
+  static constexpr float kAmbiguousMargin = 0.3f;
 
   // The encoder/decoder that we will be using.
   const UnicharCompress &recoder_;
@@ -416,8 +501,21 @@ private:
   int second_code_;
   // Heap used to compute the top_n_flags_.
   GenericHeap<TopPair> top_heap_;
+  // The top-n codes of the current timestep in increasing order of output.
+  std::vector<int> top_codes_;
+  // Bounds of the adaptive beam width. See SetBeamWidthBounds.
+  int min_beam_width_;
+  int max_beam_width_;
+  float confident_margin_;
+  float ambiguous_margin_;
+  // Width of the single code beams at the current timestep.
+  int beam_width_;
   // Borrowed pointer to the dictionary to use in the search.
   Dict *dict_;
+  // The dawgs of all the nodes of the lattice, reset by Decode.
+  DawgPositionVectorPool dawg_pool_;
+  // Scratch space for the initial dawgs of ContinueDawg.
+  DawgPositionVector initial_dawgs_;
   // True if the language is space-delimited, which is true for most languages
   // except chi*, jpn, tha.
   bool space_delimited_;
@@ -21,6 +21,7 @@
 
 #include <cstdio>
 
+#include "lstm.h"
 #include "networkscratch.h"
 
 namespace tesseract {
@@ -53,13 +54,27 @@ void Reversed::SetNetwork(Network *network) {
 // See NetworkCpp for a detailed discussion of the arguments.
 void Reversed::Forward(bool debug, const NetworkIO &input, const TransposedArray *input_transpose,
                        NetworkScratch *scratch, NetworkIO *output) {
+  if (optimized_ && !debug && type_ == NT_XREVERSED && stack_[0]->type() == NT_LSTM) {
+    auto *lstm = static_cast<LSTM *>(stack_[0]);
+    if (lstm->CanRunXReversed()) {
+      lstm->ForwardXReversed(debug, input, scratch, output);
+      return;
+    }
+  }
   NetworkScratch::IO rev_input(input, scratch);
   ReverseData(input, rev_input);
   NetworkScratch::IO rev_output(input, scratch);
-  stack_[0]->Forward(debug, *rev_input, nullptr, scratch, rev_output);
+  ForwardStack(0, debug, *rev_input, nullptr, scratch, rev_output);
   ReverseData(*rev_output, output);
 }
 
+// Also lets Forward run an x-reversed LSTM backwards in place of reversing
+// its input and output.
+void Reversed::OptimizeForInference(bool enable) {
+  optimized_ = enable;
+  Plumbing::OptimizeForInference(enable);
+}
+
 // Runs backward propagation of errors on the deltas line.
 // See NetworkCpp for a detailed discussion of the arguments.
 bool Reversed::Backward(bool debug, const NetworkIO &fwd_deltas, NetworkScratch *scratch,
@@ -75,6 +75,10 @@ public:
   void Forward(bool debug, const NetworkIO &input, const TransposedArray *input_transpose,
                NetworkScratch *scratch, NetworkIO *output) override;
 
+  // Also lets Forward run an x-reversed LSTM backwards in place of reversing
+  // its input and output.
+  void OptimizeForInference(bool enable) override;
+
   // Runs backward propagation of errors on the deltas line.
   // See Network for a detailed discussion of the arguments.
   bool Backward(bool debug, const NetworkIO &fwd_deltas, NetworkScratch *scratch,
@@ -83,6 +87,9 @@ public:
 private:
   // Copies src to *dest with the reversal according to type_.
   void ReverseData(const NetworkIO &src, NetworkIO *dest) const;
+
+  // Set by OptimizeForInference.
+  bool optimized_ = false;
 };
 
 } // namespace tesseract.
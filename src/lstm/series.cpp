@@ -103,25 +103,37 @@ void Series::CacheXScaleFactor(int factor) {
   stack_[0]->CacheXScaleFactor(factor);
 }
 
+// Also lets Forward skip the copy made by a leading Input layer.
+void Series::OptimizeForInference(bool enable) {
+  optimized_ = enable;
+  Plumbing::OptimizeForInference(enable);
+}
+
 // Runs forward propagation of activations on the input line.
 // See NetworkCpp for a detailed discussion of the arguments.
 void Series::Forward(bool debug, const NetworkIO &input, const TransposedArray *input_transpose,
                      NetworkScratch *scratch, NetworkIO *output) {
   int stack_size = stack_.size();
   ASSERT_HOST(stack_size > 1);
+  // An Input layer only copies its input to its output, so when optimized
+  // for inference, the next layer takes the input directly.
+  int first = 0;
+  if (optimized_ && !debug && !IsTraining() && stack_[0]->type() == NT_INPUT) {
+    first = 1;
+  }
   // Revolving intermediate buffers.
   NetworkScratch::IO buffer1(input, scratch);
   NetworkScratch::IO buffer2(input, scratch);
   // Run each network in turn, giving the output of n as the input to n + 1,
   // with the final network providing the real output.
-  stack_[0]->Forward(debug, input, input_transpose, scratch, buffer1);
-  for (int i = 1; i < stack_size; i += 2) {
-    stack_[i]->Forward(debug, *buffer1, nullptr, scratch, i + 1 < stack_size ? buffer2 : output);
-    if (i + 1 == stack_size) {
-      return;
+  const NetworkIO *src = &input;
+  for (int i = first; i < stack_size; ++i) {
+    NetworkIO *dest = output;
+    if (i + 1 < stack_size) {
+      dest = (i - first) % 2 == 0 ? buffer1 : buffer2;
     }
-    stack_[i + 1]->Forward(debug, *buffer2, nullptr, scratch,
-                           i + 2 < stack_size ? buffer1 : output);
+    ForwardStack(i, debug, *src, src == &input ? input_transpose : nullptr, scratch, dest);
+    src = dest;
   }
 }
 
@@ -68,6 +68,9 @@ public:
   // input units) so they can determine how to scale bounding boxes.
   void CacheXScaleFactor(int factor) override;
 
+  // Also lets Forward skip the copy made by a leading Input layer.
+  void OptimizeForInference(bool enable) override;
+
   // Runs forward propagation of activations on the input line.
   // See Network for a detailed discussion of the arguments.
   void Forward(bool debug, const NetworkIO &input, const TransposedArray *input_transpose,
@@ -88,6 +91,10 @@ public:
   // deleting it.
   TESS_API
   void AppendSeries(Network *src);
+
+private:
+  // Set by OptimizeForInference.
+  bool optimized_ = false;
 };
 
 } // namespace tesseract.
@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////
+// File:        shapedweights.cpp
+// Description: Int weights of an LSTM model pre-shaped for IntSimdMatrix.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include <tesseract/preparation.h> // compiler config, etc.
+
+#include "shapedweights.h"
+
+#include "intsimdmatrix.h"   // for IntSimdMatrix
+#include "matrix.h"          // for GENERIC_2D_ARRAY
+#include "network.h"         // for Network
+#include "serialis.h"        // for TFile
+#include "tessdatamanager.h" // for TessdataManager
+
+#include <cstring> // for memcpy
+
+namespace tesseract {
+
+// Version of the component format, stored in its header.
+const uint32_t kShapedWeightsVersion = 1;
+// Number of int32_t values that describe the IntSimdMatrix layout.
+const int kLayoutSize = 4;
+// Size of the header of each matrix: num_out, num_in, rounded_num_out, size.
+const size_t kEntryHeaderSize = 3 * sizeof(int32_t) + sizeof(uint32_t);
+
+// The instance in effect on each thread.
+static thread_local ShapedWeights *active_shaped_weights = nullptr;
+
+// Returns the layout of the current IntSimdMatrix, which determines the
+// shaped weights along with the matrix.
+static std::vector<int32_t> CurrentLayout() {
+  const IntSimdMatrix *matrix = IntSimdMatrix::intSimdMatrix;
+  return {matrix->num_outputs_per_register_, matrix->max_output_registers_,
+          matrix->num_inputs_per_register_, matrix->num_inputs_per_group_};
+}
+
+// Returns a checksum of the given bytes, which identifies the model that the
+// shaped weights were made from. It reads 8 bytes at a time in the host byte
+// order, so a file made on a host of the other endianness is (safely) taken
+// as stale.
+static uint64_t Checksum(const char *data, size_t size) {
+  const uint64_t kPrime = 0x100000001b3ULL;
+  uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * kPrime;
+    hash ^= hash >> 29;
+  }
+  for (; i < size; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * kPrime;
+  }
+  return hash;
+}
+
+ShapedWeights::ShapedWeights(Mode mode)
+    : recording_(mode == kRecord)
+    , deferring_(mode == kDefer)
+    , valid_(mode == kRecord)
+    , previous_(active_shaped_weights) {
+  active_shaped_weights = this;
+}
+
+ShapedWeights::ShapedWeights(const TessdataManager &mgr)
+    : recording_(false), previous_(active_shaped_weights) {
+  active_shaped_weights = this;
+  const char *data;
+  size_t size;
+  std::shared_ptr<const void> owner;
+  const char *lstm_data;
+  size_t lstm_size;
+  std::shared_ptr<const void> lstm_owner;
+  if (IntSimdMatrix::intSimdMatrix == nullptr ||
+      !mgr.GetComponentView(TESSDATA_LSTM_SHAPED_WEIGHTS, &data, &size, &owner) ||
+      !mgr.GetComponentView(TESSDATA_LSTM, &lstm_data, &lstm_size, &lstm_owner)) {
+    return;
+  }
+  valid_ = Parse(data, size, mgr.swap(), Checksum(lstm_data, lstm_size));
+  if (valid_ && owner == nullptr) {
+    // The component is not memory mapped, so it only lives as long as mgr,
+    // which may be gone long before the weights.
+    auto copy = std::make_shared<std::vector<char>>(data, data + size);
+    for (auto &entry : entries_) {
+      entry.data = reinterpret_cast<const int8_t *>(
+          copy->data() + (reinterpret_cast<const char *>(entry.data) - data));
+    }
+    owner = copy;
+  }
+  owner_ = owner;
+}
+
+ShapedWeights::~ShapedWeights() {
+  active_shaped_weights = previous_;
+}
+
+ShapedWeights *ShapedWeights::Active() {
+  return active_shaped_weights;
+}
+
+bool ShapedWeights::Create(const TessdataManager &mgr, std::vector<char> *data) {
+  const char *lstm_data;
+  size_t lstm_size;
+  std::shared_ptr<const void> lstm_owner;
+  if (IntSimdMatrix::intSimdMatrix == nullptr ||
+      !mgr.GetComponentView(TESSDATA_LSTM, &lstm_data, &lstm_size, &lstm_owner)) {
+    return false;
+  }
+  // The network alone holds all the weight matrices, and is deserialized the
+  // same way by LSTMRecognizer::DeSerialize, so the matrices get recorded in
+  // the order in which they are loaded.
+  ShapedWeights recorder;
+  TFile fp;
+  fp.OpenView(lstm_data, lstm_size, lstm_owner);
+  fp.set_swap(mgr.swap());
+  std::unique_ptr<Network> network(Network::CreateFromFile(&fp));
+  if (network == nullptr || recorder.entries_.empty()) {
+    return false;
+  }
+  recorder.Serialize(Checksum(lstm_data, lstm_size), data);
+  return true;
+}
+
+bool ShapedWeights::Take(const GENERIC_2D_ARRAY<int8_t> &w, const int8_t **shaped,
+                         std::shared_ptr<const void> *owner, int32_t &rounded_num_out) {
+  if (recording_ || !valid_) {
+    return false;
+  }
+  if (next_ == entries_.size() || entries_[next_].num_out != w.dim1() ||
+      entries_[next_].num_in != w.dim2() - 1) {
+    // The model doesn't match after all, so the rest is useless too.
+    valid_ = false;
+    return false;
+  }
+  const Entry &entry = entries_[next_++];
+  *shaped = entry.data;
+  *owner = owner_;
+  rounded_num_out = entry.rounded_num_out;
+  return true;
+}
+
+void ShapedWeights::Record(const GENERIC_2D_ARRAY<int8_t> &w, const std::vector<int8_t> &shaped,
+                           int32_t rounded_num_out) {
+  if (!recording_) {
+    return;
+  }
+  recorded_.push_back(shaped);
+  Entry entry;
+  entry.num_out = w.dim1();
+  entry.num_in = w.dim2() - 1;
+  entry.rounded_num_out = rounded_num_out;
+  entry.size = shaped.size();
+  entry.data = nullptr;
+  entries_.push_back(entry);
+}
+
+// Component format, in the byte order of the traineddata file:
+// uint32_t version, int32_t layout[kLayoutSize], uint64_t lstm_checksum,
+// uint32_t num_entries, then for each matrix its int32_t num_out, num_in and
+// rounded_num_out and uint32_t size, followed by size bytes of weights.
+bool ShapedWeights::Parse(const char *data, size_t size, bool swap, uint64_t lstm_checksum) {
+  TFile fp;
+  fp.OpenView(data, size);
+  fp.set_swap(swap);
+  uint32_t version;
+  if (!fp.DeSerialize(&version) || version != kShapedWeightsVersion) {
+    return false;
+  }
+  std::vector<int32_t> layout(kLayoutSize);
+  if (!fp.DeSerialize(&layout[0], kLayoutSize) || layout != CurrentLayout()) {
+    return false;
+  }
+  uint64_t checksum;
+  uint32_t num_entries;
+  if (!fp.DeSerialize(&checksum) || checksum != lstm_checksum || !fp.DeSerialize(&num_entries)) {
+    return false;
+  }
+  size_t offset = sizeof(version) + kLayoutSize * sizeof(int32_t) + sizeof(checksum) +
+                  sizeof(num_entries);
+  const IntSimdMatrix *matrix = IntSimdMatrix::intSimdMatrix;
+  entries_.clear();
+  for (uint32_t e = 0; e < num_entries; ++e) {
+    Entry entry;
+    if (!fp.DeSerialize(&entry.num_out) || !fp.DeSerialize(&entry.num_in) ||
+        !fp.DeSerialize(&entry.rounded_num_out) || !fp.DeSerialize(&entry.size)) {
+      return false;
+    }
+    offset += kEntryHeaderSize;
+    // The size must be what IntSimdMatrix::Init makes.
+    if (entry.num_out <= 0 || entry.num_in < 0 ||
+        entry.rounded_num_out != matrix->RoundOutputs(entry.num_out) ||
+        entry.size != static_cast<uint32_t>(
+                          (IntSimdMatrix::Roundup(entry.num_in, matrix->num_inputs_per_group_) + 1) *
+                          entry.rounded_num_out) ||
+        !fp.Skip(entry.size)) {
+      return false;
+    }
+    entry.data = reinterpret_cast<const int8_t *>(data + offset);
+    offset += entry.size;
+    entries_.push_back(entry);
+  }
+  next_ = 0;
+  return offset == size;
+}
+
+void ShapedWeights::Serialize(uint64_t lstm_checksum, std::vector<char> *data) const {
+  TFile fp;
+  fp.OpenWrite(data);
+  fp.Serialize(&kShapedWeightsVersion);
+  std::vector<int32_t> layout = CurrentLayout();
+  fp.Serialize(&layout[0], kLayoutSize);
+  fp.Serialize(&lstm_checksum);
+  uint32_t num_entries = entries_.size();
+  fp.Serialize(&num_entries);
+  for (size_t e = 0; e < entries_.size(); ++e) {
+    const Entry &entry = entries_[e];
+    fp.Serialize(&entry.num_out);
+    fp.Serialize(&entry.num_in);
+    fp.Serialize(&entry.rounded_num_out);
+    fp.Serialize(&entry.size);
+    fp.Serialize(&recorded_[e][0], entry.size);
+  }
+}
+
+} // namespace tesseract.
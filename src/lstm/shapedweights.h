@@ -0,0 +1,132 @@
+///////////////////////////////////////////////////////////////////////
+// File:        shapedweights.h
+// Description: Int weights of an LSTM model pre-shaped for IntSimdMatrix.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#ifndef TESSERACT_LSTM_SHAPEDWEIGHTS_H_
+#define TESSERACT_LSTM_SHAPEDWEIGHTS_H_
+
+#include <tesseract/export.h>
+
+#include <cstddef> // for size_t
+#include <cstdint> // for int8_t, int32_t, uint64_t
+#include <memory>  // for std::shared_ptr
+#include <vector>  // for std::vector
+
+namespace tesseract {
+
+template <class T>
+class GENERIC_2D_ARRAY;
+class TessdataManager;
+
+// The int weight matrices of the LSTM model of a traineddata file, already
+// reordered by IntSimdMatrix::Init, as stored in the optional
+// TESSDATA_LSTM_SHAPED_WEIGHTS component. Loading a model with them saves
+// reshaping every matrix, and as the matrices point straight into the
+// component, a memory mapped traineddata file shares them between processes.
+// The component records the IntSimdMatrix layout it was made for and a
+// checksum of the TESSDATA_LSTM component it was made from, and is ignored if
+// either doesn't match.
+//
+// While an instance exists, it is the source (or, depending on its Mode, the
+// recorder) of the shaped weights of all WeightMatrix instances that are
+// deserialized on the calling thread, in the order in which they are
+// deserialized.
+class TESS_API ShapedWeights {
+public:
+  enum Mode {
+    // Records the shaped weights of the matrices deserialized from now on.
+    kRecord,
+    // Leaves the matrices deserialized from now on unshaped, for
+    // Network::ShapeWeights to shape them in the same order later, as when
+    // the IntSimdMatrix is yet to be chosen by SIMDDetect::Autotune.
+    kDefer
+  };
+  explicit ShapedWeights(Mode mode = kRecord);
+  // Provides the shaped weights from the component of mgr, if it has one and
+  // it is valid for the current IntSimdMatrix. mgr must not change while
+  // *this exists.
+  explicit ShapedWeights(const TessdataManager &mgr);
+  ~ShapedWeights();
+
+  ShapedWeights(const ShapedWeights &) = delete;
+  ShapedWeights &operator=(const ShapedWeights &) = delete;
+
+  // Returns the instance in effect on the calling thread, or nullptr.
+  static ShapedWeights *Active();
+
+  // Deserializes the LSTM model of mgr and serializes the shaped weights of
+  // its int matrices for the current IntSimdMatrix to *data. Returns false
+  // if there is nothing to store, for lack of an int model or of a SIMD
+  // implementation.
+  static bool Create(const TessdataManager &mgr, std::vector<char> *data);
+
+  // True if the component was loaded and all the matrices that were asked
+  // for so far were found in it.
+  bool is_valid() const {
+    return valid_;
+  }
+  // True if the matrices are to be left unshaped for now.
+  bool is_deferring() const {
+    return deferring_;
+  }
+  // True if all matrices of the component have been taken.
+  bool is_complete() const {
+    return valid_ && next_ == entries_.size();
+  }
+
+  // If *this provides the shaped weights, and the next matrix in the
+  // component matches w, sets *shaped to its data, which *owner keeps alive,
+  // sets rounded_num_out as IntSimdMatrix::Init would, and returns true.
+  // Otherwise returns false, and no further matrices will be provided.
+  bool Take(const GENERIC_2D_ARRAY<int8_t> &w, const int8_t **shaped,
+            std::shared_ptr<const void> *owner, int32_t &rounded_num_out);
+  // If *this records the shaped weights, adds the result of IntSimdMatrix::Init
+  // for w.
+  void Record(const GENERIC_2D_ARRAY<int8_t> &w, const std::vector<int8_t> &shaped,
+              int32_t rounded_num_out);
+
+private:
+  struct Entry {
+    int32_t num_out;
+    int32_t num_in;
+    int32_t rounded_num_out;
+    uint32_t size;
+    const int8_t *data;
+  };
+
+  // Parses the component in data, and checks that it matches the current
+  // IntSimdMatrix and the given checksum of the TESSDATA_LSTM component.
+  bool Parse(const char *data, size_t size, bool swap, uint64_t lstm_checksum);
+  // Serializes the recorded entries to *data.
+  void Serialize(uint64_t lstm_checksum, std::vector<char> *data) const;
+
+  // True if recording, false if providing or deferring.
+  bool recording_;
+  // True if deferring.
+  bool deferring_ = false;
+  bool valid_ = false;
+  std::vector<Entry> entries_;
+  // Index in entries_ of the next matrix to take.
+  size_t next_ = 0;
+  // Keeps the data of the entries alive when providing.
+  std::shared_ptr<const void> owner_;
+  // The weights of the entries when recording.
+  std::vector<std::vector<int8_t>> recorded_;
+  // The instance that was active before this one.
+  ShapedWeights *previous_;
+};
+
+} // namespace tesseract.
+
+#endif // TESSERACT_LSTM_SHAPEDWEIGHTS_H_
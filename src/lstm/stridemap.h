@@ -123,6 +123,10 @@ public:
   int Width() const {
     return t_increments_[FD_BATCH] * shape_[FD_BATCH];
   }
+  // Returns the difference in t between neighbours in the given dimension.
+  int Stride(FlexDimensions dimension) const {
+    return t_increments_[dimension];
+  }
 
 private:
   // Computes t_increments_ from shape_.
@@ -19,10 +19,14 @@
 
 #include "weightmatrix.h"
 
+#include <algorithm> // for std::min
 #include <cassert> // for assert
+#include <cstring> // for memcpy
 #include "intsimdmatrix.h"
-#include "simddetect.h" // for DotProduct
+#include "shapedweights.h" // for ShapedWeights
+#include "simddetect.h" // for DotProduct, DotProduct4, AdamStep
 #include "statistc.h"
+#include "taskscheduler.h" // for TaskScheduler
 #include <tesseract/tprintf.h>    // forTFloat
 #include "tesstypes.h"
 
@@ -38,6 +42,14 @@ static inline TFloat log2(TFloat n) {
 const int kAdamCorrectionIterations = 200000;
 // Epsilon in Adam to prevent division by zero.
 const TFloat kAdamEpsilon = 1e-8;
+// Number of vectors that MatrixDotVectors multiplies by each row of float
+// weights in turn.
+const int kVectorBlockSize = 8;
+// Number of rows of the deltas that SumOuterTransposed computes at once, which
+// is the number of rows of DotProduct4.
+const int kOuterRowBlock = 4;
+// Number of samples that SumOuterTransposed sums over at once.
+const int kOuterSampleBlock = 256;
 
 // Utility functions convert between double and float arrays.
 #ifdef FAST_FLOAT
@@ -148,6 +160,7 @@ int WeightMatrix::RemapOutputs(const std::vector<int> &code_map) {
 // Store a multiplicative scale factor (as a TFloat) that will reproduce
 // the original value, subject to rounding errors.
 void WeightMatrix::ConvertToInt() {
+  ASSERT_HOST(shared_ == nullptr);
   wi_.ResizeNoInit(wf_.dim1(), wf_.dim2());
   scales_.reserve(wi_.dim1());
   int dim2 = wi_.dim2();
@@ -173,15 +186,133 @@ void WeightMatrix::ConvertToInt() {
   wf_.Resize(1, 1, 0.0);
   int_mode_ = true;
   if (IntSimdMatrix::intSimdMatrix) {
-    int32_t rounded_num_out;
+    InitShapedWeights();
+  }
+}
+
+// Makes shaped_w_, or shaped_view_, the weights of wi_ in the order used by
+// IntSimdMatrix::intSimdMatrix, and pads scales_ to the rounded number of
+// outputs.
+void WeightMatrix::InitShapedWeights() {
+  int32_t rounded_num_out;
+  ShapedWeights *shaped = ShapedWeights::Active();
+  if (shaped != nullptr && shaped->is_deferring()) {
+    // ShapeWeights does it later.
+    return;
+  }
+  if (shaped != nullptr && shaped->Take(wi_, &shaped_view_, &shaped_owner_, rounded_num_out)) {
+    std::vector<int8_t>().swap(shaped_w_);
+  } else {
+    shaped_view_ = nullptr;
+    shaped_owner_.reset();
     IntSimdMatrix::intSimdMatrix->Init(wi_, shaped_w_, rounded_num_out);
-    scales_.resize(rounded_num_out);
+    if (shaped != nullptr) {
+      shaped->Record(wi_, shaped_w_, rounded_num_out);
+    }
+  }
+  scales_.resize(rounded_num_out);
+}
+
+// Turns this matrix into a read-only view of the weights of src, with deltas
+// of its own if src has them.
+void WeightMatrix::ShareWeights(const WeightMatrix &src) {
+  Clear();
+  shared_ = (src.shared_ != nullptr) ? src.shared_ : &src;
+  int_mode_ = src.int_mode_;
+  use_adam_ = src.use_adam_;
+  if (shared_->dw_.dim1() > 0) {
+    dw_.Resize(shared_->dw_.dim1(), shared_->dw_.dim2(), 0.0);
+  }
+}
+
+// Makes *this an inference-only copy of columns [start, end) of the weights
+// of src, followed by the bias of src if with_bias, or by a zero bias.
+void WeightMatrix::InitFromColumns(const WeightMatrix &src, int start, int end, bool with_bias) {
+  const WeightMatrix &full = (src.shared_ != nullptr) ? *src.shared_ : src;
+  Clear();
+  int_mode_ = full.int_mode_;
+  int num_outputs = full.NumOutputs();
+  int num_inputs = end - start;
+  if (int_mode_) {
+    int bias = full.wi_.dim2() - 1;
+    wi_.ResizeNoInit(num_outputs, num_inputs + 1);
+    for (int i = 0; i < num_outputs; ++i) {
+      memcpy(wi_[i], full.wi_[i] + start, num_inputs * sizeof(wi_[i][0]));
+      wi_[i][num_inputs] = with_bias ? full.wi_[i][bias] : 0;
+    }
+    scales_.assign(full.scales_.begin(), full.scales_.begin() + num_outputs);
+    if (IntSimdMatrix::intSimdMatrix) {
+      InitShapedWeights();
+    }
+  } else {
+    int bias = full.wf_.dim2() - 1;
+    wf_.ResizeNoInit(num_outputs, num_inputs + 1);
+    for (int i = 0; i < num_outputs; ++i) {
+      memcpy(wf_[i], full.wf_[i] + start, num_inputs * sizeof(wf_[i][0]));
+      wf_[i][num_inputs] = with_bias ? full.wf_[i][bias] : 0;
+    }
+  }
+}
+
+// Makes *this the columns of left followed by those of right, with the bias
+// of left.
+void WeightMatrix::InitFromJoin(const WeightMatrix &left, const WeightMatrix &right) {
+  const WeightMatrix &l = (left.shared_ != nullptr) ? *left.shared_ : left;
+  const WeightMatrix &r = (right.shared_ != nullptr) ? *right.shared_ : right;
+  Clear();
+  int_mode_ = l.int_mode_;
+  int num_outputs = l.NumOutputs();
+  int left_inputs = l.NumInputs();
+  int right_inputs = r.NumInputs();
+  ASSERT_HOST(r.int_mode_ == int_mode_ && r.NumOutputs() == num_outputs);
+  if (int_mode_) {
+    wi_.ResizeNoInit(num_outputs, left_inputs + right_inputs + 1);
+    for (int i = 0; i < num_outputs; ++i) {
+      memcpy(wi_[i], l.wi_[i], left_inputs * sizeof(wi_[i][0]));
+      memcpy(wi_[i] + left_inputs, r.wi_[i], right_inputs * sizeof(wi_[i][0]));
+      wi_[i][left_inputs + right_inputs] = l.wi_[i][left_inputs];
+    }
+    scales_ = l.scales_;
+  } else {
+    wf_.ResizeNoInit(num_outputs, left_inputs + right_inputs + 1);
+    for (int i = 0; i < num_outputs; ++i) {
+      memcpy(wf_[i], l.wf_[i], left_inputs * sizeof(wf_[i][0]));
+      memcpy(wf_[i] + left_inputs, r.wf_[i], right_inputs * sizeof(wf_[i][0]));
+      wf_[i][left_inputs + right_inputs] = l.wf_[i][left_inputs];
+    }
+  }
+}
+
+// Frees all the weights and deltas, leaving an empty matrix.
+void WeightMatrix::Clear() {
+  shared_ = nullptr;
+  referenced_num_outputs_ = 0;
+  int_mode_ = false;
+  use_adam_ = false;
+  wf_.Release();
+  wi_.Release();
+  wf_t_.Release();
+  std::vector<TFloat>().swap(scales_);
+  dw_.Release();
+  updates_.Release();
+  dw_sq_sum_.Release();
+  std::vector<int8_t>().swap(shaped_w_);
+  shaped_view_ = nullptr;
+  shaped_owner_.reset();
+}
+
+// Shapes the int weights if that was deferred when they were loaded.
+void WeightMatrix::ShapeWeights() {
+  if (int_mode_ && shared_ == nullptr && IntSimdMatrix::intSimdMatrix &&
+      shaped_view_ == nullptr && shaped_w_.empty()) {
+    InitShapedWeights();
   }
 }
 
 // Allocates any needed memory for running Backward, and zeroes the deltas,
 // thus eliminating any existing momentum.
 void WeightMatrix::InitBackward() {
+  ASSERT_HOST(shared_ == nullptr);
   int no = int_mode_ ? wi_.dim1() : wf_.dim1();
   int ni = int_mode_ ? wi_.dim2() : wf_.dim2();
   dw_.Resize(no, ni, 0.0);
@@ -196,6 +327,9 @@ void WeightMatrix::InitBackward() {
 const int kInt8Flag = 1;
 // Flag on mode to indicate that this weightmatrix uses adam.
 const int kAdamFlag = 4;
+// Flag on mode to indicate that the weights are left out, as they are shared
+// with another weightmatrix, and only the number of outputs follows.
+const int kReferenceFlag = 64;
 // Flag on mode to indicate that this weightmatrix uses TFloat. Set
 // independently of kInt8Flag as even in int mode the scales can
 // be float or TFloat.
@@ -205,10 +339,15 @@ const int kDoubleFlag = 128;
 bool WeightMatrix::Serialize(bool training, TFile *fp) const {
   // For backward compatibility, add kDoubleFlag to mode to indicate the doubles
   // format, without errs, so we can detect and read old format weight matrices.
-  uint8_t mode = (int_mode_ ? kInt8Flag : 0) | (use_adam_ ? kAdamFlag : 0) | kDoubleFlag;
+  uint8_t mode = (int_mode_ ? kInt8Flag : 0) | (use_adam_ ? kAdamFlag : 0) | kDoubleFlag |
+                 (shared_ != nullptr ? kReferenceFlag : 0);
   if (!fp->Serialize(&mode)) {
     return false;
   }
+  if (shared_ != nullptr) {
+    int32_t num_outputs = NumOutputs();
+    return fp->Serialize(&num_outputs);
+  }
   if (int_mode_) {
     if (!wi_.Serialize<int8_t>(fp)) {
       return false;
@@ -244,11 +383,18 @@ bool WeightMatrix::Serialize(bool training, TFile *fp) const {
 
 // Reads from the given file. Returns false in case of error.
 
-bool WeightMatrix::DeSerialize(bool training, TFile *fp) {
+bool WeightMatrix::DeSerialize(bool training, TFile *fp, bool shape) {
   uint8_t mode;
   if (!fp->DeSerialize(&mode)) {
     return false;
   }
+  if (mode & kReferenceFlag) {
+    Clear();
+    int_mode_ = (mode & kInt8Flag) != 0;
+    use_adam_ = (mode & kAdamFlag) != 0;
+    return fp->DeSerialize(&referenced_num_outputs_) && referenced_num_outputs_ > 0;
+  }
+  referenced_num_outputs_ = 0;
   int_mode_ = (mode & kInt8Flag) != 0;
   use_adam_ = (mode & kAdamFlag) != 0;
   if ((mode & kDoubleFlag) == 0) {
@@ -269,10 +415,8 @@ bool WeightMatrix::DeSerialize(bool training, TFile *fp) {
     for (auto &scale : scales_) {
       scale /= INT8_MAX;
     }
-    if (IntSimdMatrix::intSimdMatrix) {
-      int32_t rounded_num_out;
-      IntSimdMatrix::intSimdMatrix->Init(wi_, shaped_w_, rounded_num_out);
-      scales_.resize(rounded_num_out);
+    if (shape && IntSimdMatrix::intSimdMatrix) {
+      InitShapedWeights();
     }
   } else {
     if (!tesseract::DeSerialize(fp, wf_)) {
@@ -329,6 +473,10 @@ bool WeightMatrix::DeSerializeOld(bool training, TFile *fp) {
 // Asserts that the call matches what we have.
 void WeightMatrix::MatrixDotVector(const TFloat *u, TFloat *v) const {
   assert(!int_mode_);
+  if (shared_ != nullptr) {
+    shared_->MatrixDotVector(u, v);
+    return;
+  }
   int num_results = wf_.dim1();
   int extent = wf_.dim2() - 1;
   for (int i = 0; i < num_results; ++i) {
@@ -341,18 +489,69 @@ void WeightMatrix::MatrixDotVector(const TFloat *u, TFloat *v) const {
 
 void WeightMatrix::MatrixDotVector(const int8_t *u, TFloat *v) const {
   assert(int_mode_);
+  if (shared_ != nullptr) {
+    shared_->MatrixDotVector(u, v);
+    return;
+  }
   if (IntSimdMatrix::intSimdMatrix) {
-    IntSimdMatrix::intSimdMatrix->matrixDotVectorFunction(wi_.dim1(), wi_.dim2(), &shaped_w_[0],
+    IntSimdMatrix::intSimdMatrix->matrixDotVectorFunction(wi_.dim1(), wi_.dim2(), shaped_weights(),
                                                           &scales_[0], u, v);
   } else {
     IntSimdMatrix::MatrixDotVector(wi_, scales_, u, v);
   }
 }
 
+void WeightMatrix::MatrixDotVectors(int num_vectors, const TFloat *u, int u_stride, TFloat *v,
+                                    int v_stride) const {
+  assert(!int_mode_);
+  if (shared_ != nullptr) {
+    shared_->MatrixDotVectors(num_vectors, u, u_stride, v, v_stride);
+    return;
+  }
+  int num_results = wf_.dim1();
+  int extent = wf_.dim2() - 1;
+  for (int start = 0; start < num_vectors; start += kVectorBlockSize) {
+    int end = std::min(num_vectors, start + kVectorBlockSize);
+    for (int i = 0; i < num_results; ++i) {
+      const TFloat *wi = wf_[i];
+      for (int k = start; k < end; ++k) {
+        TFloat total = DotProduct(wi, u + k * u_stride, extent);
+        v[k * v_stride + i] = total + wi[extent]; // The bias value.
+      }
+    }
+  }
+}
+
+void WeightMatrix::MatrixDotVectors(int num_vectors, const int8_t *u, int u_stride, TFloat *v,
+                                    int v_stride) const {
+  assert(int_mode_);
+  if (shared_ != nullptr) {
+    shared_->MatrixDotVectors(num_vectors, u, u_stride, v, v_stride);
+    return;
+  }
+  const IntSimdMatrix *simd = IntSimdMatrix::intSimdMatrix;
+  if (simd == nullptr) {
+    IntSimdMatrix::MatrixDotVectors(wi_, scales_, num_vectors, u, u_stride, v, v_stride);
+  } else if (simd->matrixDotVectorsFunction != nullptr) {
+    simd->matrixDotVectorsFunction(wi_.dim1(), wi_.dim2(), shaped_weights(), &scales_[0],
+                                   num_vectors, u, u_stride, v, v_stride);
+  } else {
+    // The shaped weights at least stay in cache from one input to the next.
+    for (int k = 0; k < num_vectors; ++k) {
+      simd->matrixDotVectorFunction(wi_.dim1(), wi_.dim2(), shaped_weights(), &scales_[0],
+                                    u + k * u_stride, v + k * v_stride);
+    }
+  }
+}
+
 // MatrixDotVector for peep weights, MultiplyAccumulate adds the
 // component-wise products of *this[0] and v to inout.
-void WeightMatrix::MultiplyAccumulate(const TFloat *v, TFloat *inout) {
+void WeightMatrix::MultiplyAccumulate(const TFloat *v, TFloat *inout) const {
   assert(!int_mode_);
+  if (shared_ != nullptr) {
+    shared_->MultiplyAccumulate(v, inout);
+    return;
+  }
   assert(wf_.dim1() == 1);
   int n = wf_.dim2();
   const TFloat *u = wf_[0];
@@ -366,6 +565,10 @@ void WeightMatrix::MultiplyAccumulate(const TFloat *v, TFloat *inout) {
 // The last result is discarded, as v is assumed to have an imaginary
 // last value of 1, as with MatrixDotVector.
 void WeightMatrix::VectorDotMatrix(const TFloat *u, TFloat *v) const {
+  if (shared_ != nullptr) {
+    shared_->VectorDotMatrix(u, v);
+    return;
+  }
   assert(!int_mode_);
   // We are actually performing the backwards product on a
   // transposed matrix, so we need to drop the v output corresponding to the
@@ -383,9 +586,14 @@ void WeightMatrix::VectorDotMatrix(const TFloat *u, TFloat *v) const {
 // u and v. In terms of the neural network, u is the gradients and v is the
 // inputs.
 // Note that (matching MatrixDotVector) v[last][] is missing, presumed 1.0.
-// Runs parallel if requested. Note that u and v must be transposed.
+// Runs on the threads of scheduler, if given. Note that u and v must be
+// transposed.
+// The rows of dw_ are computed kOuterRowBlock at a time, so each part of a
+// row of v is loaded once for all of them, and the samples are taken
+// kOuterSampleBlock at a time, so the parts of the rows of v stay in the cache
+// while all the rows of dw_ of a thread use them.
 void WeightMatrix::SumOuterTransposed(const TransposedArray &u, const TransposedArray &v,
-                                      bool in_parallel) {
+                                      const TaskScheduler *scheduler) {
   assert(!int_mode_);
   int num_outputs = dw_.dim1();
   assert(u.dim1() == num_outputs);
@@ -394,23 +602,48 @@ void WeightMatrix::SumOuterTransposed(const TransposedArray &u, const Transposed
   int num_samples = u.dim2();
   // v is missing the last element in dim1.
   assert(v.dim1() == num_inputs);
-// 22508 ms
-//#undef _OPENMP
-#ifdef _OPENMP
-#  pragma omp parallel for num_threads(4) if (in_parallel)
-#endif
-  for (int i = 0; i < num_outputs; ++i) {
-    TFloat *dwi = dw_[i];
-    const TFloat *ui = u[i];
-    for (int j = 0; j < num_inputs; ++j) {
-      dwi[j] = DotProduct(ui, v[j], num_samples);
+  int num_row_blocks = (num_outputs + kOuterRowBlock - 1) / kOuterRowBlock;
+  auto sum_rows = [&](int /*slot*/, int start, int end) {
+    int row_begin = start * kOuterRowBlock;
+    int row_end = std::min(end * kOuterRowBlock, num_outputs);
+    for (int i = row_begin; i < row_end; ++i) {
+      std::fill(dw_[i], dw_[i] + num_inputs + 1, static_cast<TFloat>(0));
     }
-    // The last element of v is missing, presumed 1.0f.
-    TFloat total = 0.0;
-    for (int k = 0; k < num_samples; ++k) {
-      total += ui[k];
+    for (int s = 0; s < num_samples; s += kOuterSampleBlock) {
+      int n = std::min(kOuterSampleBlock, num_samples - s);
+      int i = row_begin;
+      for (; i + kOuterRowBlock <= row_end; i += kOuterRowBlock) {
+        const TFloat *ui[kOuterRowBlock] = {u[i] + s, u[i + 1] + s, u[i + 2] + s, u[i + 3] + s};
+        TFloat sums[kOuterRowBlock];
+        for (int j = 0; j < num_inputs; ++j) {
+          DotProduct4(ui, v[j] + s, n, sums);
+          for (int r = 0; r < kOuterRowBlock; ++r) {
+            dw_[i + r][j] += sums[r];
+          }
+        }
+      }
+      for (; i < row_end; ++i) {
+        const TFloat *ui = u[i] + s;
+        TFloat *dwi = dw_[i];
+        for (int j = 0; j < num_inputs; ++j) {
+          dwi[j] += DotProduct(ui, v[j] + s, n);
+        }
+      }
+      // The last element of v is missing, presumed 1.0f.
+      for (i = row_begin; i < row_end; ++i) {
+        const TFloat *ui = u[i] + s;
+        TFloat total = 0.0;
+        for (int k = 0; k < n; ++k) {
+          total += ui[k];
+        }
+        dw_[i][num_inputs] += total;
+      }
     }
-    dwi[num_inputs] = total;
+  };
+  if (scheduler != nullptr) {
+    scheduler->ParallelFor(num_row_blocks, sum_rows);
+  } else {
+    sum_rows(0, 0, num_row_blocks);
   }
 }
 
@@ -424,11 +657,11 @@ void WeightMatrix::Update(float learning_rate, float momentum, float adam_beta,
     learning_rate /= 1.0f - pow(momentum, num_samples);
   }
   if (use_adam_ && num_samples > 0 && momentum > 0.0f) {
-    dw_sq_sum_.SumSquares(dw_, adam_beta);
-    dw_ *= learning_rate * (1.0f - momentum);
-    updates_ *= momentum;
-    updates_ += dw_;
-    wf_.AdamUpdate(updates_, dw_sq_sum_, learning_rate * kAdamEpsilon);
+    // A single pass over all the arrays does what would otherwise be
+    // dw_sq_sum_.SumSquares(dw_, adam_beta), dw_ *= ..., updates_ *= momentum,
+    // updates_ += dw_ and wf_.AdamUpdate(...), with the same arithmetic.
+    AdamStep(dw_.dim1() * dw_.dim2(), adam_beta, learning_rate * (1.0f - momentum), momentum,
+             learning_rate * kAdamEpsilon, dw_[0], dw_sq_sum_[0], updates_[0], wf_[0]);
   } else {
     dw_ *= learning_rate;
     updates_ += dw_;
@@ -449,6 +682,15 @@ void WeightMatrix::AddDeltas(const WeightMatrix &other) {
   dw_ += other.dw_;
 }
 
+// Replaces the dw_ in *this by the sum of the dw_ in all of others.
+void WeightMatrix::SumDeltas(const std::vector<const WeightMatrix *> &others) {
+  assert(!others.empty());
+  dw_ = others[0]->dw_;
+  for (size_t i = 1; i < others.size(); ++i) {
+    AddDeltas(*others[i]);
+  }
+}
+
 // Sums the products of weight updates in *this and other, splitting into
 // positive (same direction) in *same and negative (different direction) in
 // *changed.
@@ -484,7 +726,7 @@ static void HistogramWeight(TFloat weight, STATS *histogram) {
   histogram->add(bucket, 1);
 }
 
-void WeightMatrix::Debug2D(const char *msg) {
+void WeightMatrix::Debug2D(const char *msg) const {
   STATS histogram(0, kHistogramBuckets - 1);
   if (int_mode_) {
     for (int i = 0; i < wi_.dim1(); ++i) {
@@ -22,11 +22,14 @@
 #include <vector>
 #include "intsimdmatrix.h"
 #include "matrix.h"
+#include "simddetect.h"
 #include "tesstypes.h"
 #include <tesseract/tprintf.h>
 
 namespace tesseract {
 
+class TaskScheduler;
+
 // Convenience instantiation of GENERIC_2D_ARRAY<TFloat> with additional
 // operations to write a strided vector, so the transposed form of the input
 // is memory-contiguous.
@@ -69,7 +72,7 @@ public:
 // backward steps with the matrix and updates to the weights.
 class WeightMatrix {
 public:
-  WeightMatrix() : int_mode_(false), use_adam_(false) {}
+  WeightMatrix() : int_mode_(false), use_adam_(false), shaped_view_(nullptr), shared_(nullptr) {}
   // Sets up the network for training. Initializes weights using weights of
   // scale `range` picked according to the random number generator `randomizer`.
   // Note the order is outputs, inputs, as this is the order of indices to
@@ -105,12 +108,41 @@ public:
     return int_mode_;
   }
   int NumOutputs() const {
+    if (shared_ != nullptr) {
+      return shared_->NumOutputs();
+    }
+    if (referenced_num_outputs_ > 0) {
+      return referenced_num_outputs_;
+    }
     return int_mode_ ? wi_.dim1() : wf_.dim1();
   }
-  // Provides one set of weights. Only used by peep weight maxpool.
+  // Returns the number of inputs, excluding the bias.
+  int NumInputs() const {
+    if (shared_ != nullptr) {
+      return shared_->NumInputs();
+    }
+    return (int_mode_ ? wi_.dim2() : wf_.dim2()) - 1;
+  }
+  // Returns the shape of the matrix, for SIMDDetect::Autotune.
+  MatrixShape Shape() const {
+    return {NumOutputs(), NumInputs(), int_mode_};
+  }
+  // Provides one set of weights.
   const TFloat *GetWeights(int index) const {
+    if (shared_ != nullptr) {
+      return shared_->GetWeights(index);
+    }
     return wf_[index];
   }
+  // True if the weights are those of another WeightMatrix, see ShareWeights.
+  bool is_shared() const {
+    return shared_ != nullptr;
+  }
+  // True if *this was read from a reference to shared weights (see
+  // Serialize), and has no weights until ShareWeights gives it them.
+  bool awaits_weights() const {
+    return referenced_num_outputs_ > 0;
+  }
   // Provides access to the deltas (dw_).
   TFloat GetDW(int i, int j) const {
     return dw_(i, j);
@@ -121,13 +153,45 @@ public:
   void InitBackward();
 
   // Writes to the given file. Returns false in case of error.
+  // If the weights are shared (see ShareWeights), only a reference to them is
+  // written, so that a copy of a network that shares its weights is made
+  // without copying them. The copy must be given them by ShareWeights before
+  // it is used, so such a network must not be written to a model file.
   bool Serialize(bool training, TFile *fp) const;
-  // Reads from the given file. Returns false in case of error.
-  bool DeSerialize(bool training, TFile *fp);
+  // Reads from the given file. Returns false in case of error. If !shape, int
+  // weights are not reordered for IntSimdMatrix, as they won't be multiplied
+  // before being split by InitFromColumns.
+  bool DeSerialize(bool training, TFile *fp, bool shape = true);
   // As DeSerialize, but reads an old (float) format WeightMatrix for
   // backward compatibility.
   bool DeSerializeOld(bool training, TFile *fp);
 
+  // Turns this matrix into a read-only view of the weights of src and frees
+  // its own copy, so that several networks can run on a single set of
+  // weights. src must outlive this. Only the inference functions
+  // (MatrixDotVector, MultiplyAccumulate) and Serialize may be used afterwards,
+  // unless src is being trained, in which case *this gets its own zeroed
+  // deltas, so VectorDotMatrix and SumOuterTransposed may be used too, and
+  // the deltas collected by SumDeltas on src. Only src may be updated.
+  void ShareWeights(const WeightMatrix &src);
+  // Makes *this an inference-only copy of columns [start, end) of the weights
+  // of src, followed by the bias of src if with_bias, or by a zero bias
+  // otherwise. As the int scales are per output, the products of the column
+  // slices of a matrix with the matching parts of an input vector sum to the
+  // product of the whole matrix, so the slices allow a product to be
+  // computed in independent parts.
+  void InitFromColumns(const WeightMatrix &src, int start, int end, bool with_bias);
+  // Inverse of InitFromColumns: makes *this the columns of left followed by
+  // those of right, with the bias of left. left and right must have the same
+  // outputs and scales. The result is not set up for IntSimdMatrix, so it is
+  // only good for Serialize, Debug2D or ConvertToInt.
+  void InitFromJoin(const WeightMatrix &left, const WeightMatrix &right);
+  // Frees all the weights and deltas, leaving an empty matrix.
+  void Clear();
+  // Shapes the int weights for IntSimdMatrix::intSimdMatrix, if that was
+  // deferred when they were loaded (see ShapedWeights::kDefer).
+  void ShapeWeights();
+
   // Computes matrix.vector v = Wu.
   // u is of size W.dim2() - 1 and the output v is of size W.dim1().
   // u is imagined to have an extra element at the end with value 1, to
@@ -135,9 +199,19 @@ public:
   // Asserts that the call matches what we have.
   void MatrixDotVector(const TFloat *u, TFloat *v) const;
   void MatrixDotVector(const int8_t *u, TFloat *v) const;
+  // Computes MatrixDotVector for num_vectors inputs at once, the k-th input
+  // at u + k * u_stride and its result at v + k * v_stride. The vectors are
+  // processed in blocks that use each row of weights while it is in cache.
+  // For int8_t inputs, u_stride may be less than the padded input size, as
+  // the over-read padding of one input is multiplied by zero weights, and
+  // v_stride must be at least the rounded number of outputs.
+  void MatrixDotVectors(int num_vectors, const TFloat *u, int u_stride, TFloat *v,
+                        int v_stride) const;
+  void MatrixDotVectors(int num_vectors, const int8_t *u, int u_stride, TFloat *v,
+                        int v_stride) const;
   // MatrixDotVector for peep weights, MultiplyAccumulate adds the
   // component-wise products of *this[0] and v to inout.
-  void MultiplyAccumulate(const TFloat *v, TFloat *inout);
+  void MultiplyAccumulate(const TFloat *v, TFloat *inout) const;
   // Computes vector.matrix v = uW.
   // u is of size W.dim1() and the output v is of size W.dim2() - 1.
   // The last result is discarded, as v is assumed to have an imaginary
@@ -146,21 +220,36 @@ public:
   // Fills dw_[i][j] with the dot product u[i][] . v[j][], using elements
   // from u and v, starting with u[i][offset] and v[j][offset].
   // Note that (matching MatrixDotVector) v[last][] is missing, presumed 1.0.
-  // Runs parallel if requested. Note that inputs must be transposed.
-  void SumOuterTransposed(const TransposedArray &u, const TransposedArray &v, bool parallel);
+  // Runs on the threads of scheduler, or serially if it is nullptr.
+  // Note that inputs must be transposed.
+  void SumOuterTransposed(const TransposedArray &u, const TransposedArray &v,
+                          const TaskScheduler *scheduler);
   // Updates the weights using the given learning rate, momentum and adam_beta.
   // num_samples is used in the Adam correction factor.
   void Update(float learning_rate, float momentum, float adam_beta, int num_samples);
   // Adds the dw_ in other to the dw_ is *this.
   void AddDeltas(const WeightMatrix &other);
+  // Replaces the dw_ in *this by the sum of the dw_ in all of others, which
+  // must not be empty. The deltas are summed, not averaged, as are those of
+  // the timesteps of a line and the lines of a batch, so a single Update
+  // with the sum moves the weights as far as one Update per delta would,
+  // give or take the changes of the weights in between.
+  void SumDeltas(const std::vector<const WeightMatrix *> &others);
   // Sums the products of weight updates in *this and other, splitting into
   // positive (same direction) in *same and negative (different direction) in
   // *changed.
   void CountAlternators(const WeightMatrix &other, TFloat *same, TFloat *changed) const;
 
-  void Debug2D(const char *msg);
+  void Debug2D(const char *msg) const;
 
 private:
+  // Sets the shaped weights for IntSimdMatrix::intSimdMatrix from wi_.
+  void InitShapedWeights();
+  // Returns the shaped weights.
+  const int8_t *shaped_weights() const {
+    return shaped_view_ != nullptr ? shaped_view_ : &shaped_w_[0];
+  }
+
   // Choice between float and 8 bit int implementations.
   GENERIC_2D_ARRAY<TFloat> wf_;
   GENERIC_2D_ARRAY<int8_t> wi_;
@@ -182,6 +271,17 @@ private:
   GENERIC_2D_ARRAY<TFloat> dw_sq_sum_;
   // The weights matrix reorganized in whatever way suits this instance.
   std::vector<int8_t> shaped_w_;
+  // If not null, used instead of shaped_w_: the reorganized weights as
+  // loaded from a TESSDATA_LSTM_SHAPED_WEIGHTS component (see ShapedWeights),
+  // which shaped_owner_ keeps alive.
+  const int8_t *shaped_view_;
+  std::shared_ptr<const void> shaped_owner_;
+  // If not null, the matrix which actually holds the weights used by this
+  // one; all of the above weight storage is then empty. Not owned.
+  const WeightMatrix *shared_;
+  // If not 0, the number of outputs of the shared weights that *this was
+  // read a reference to, until ShareWeights gives it them.
+  int32_t referenced_num_outputs_ = 0;
 };
 
 } // namespace tesseract.
@@ -243,6 +243,10 @@ static void PrintHelpExtra(const char *program) {
 #if !DISABLED_LEGACY_ENGINE
       "  --oem NUM             Specify OCR Engine mode.\n"
 #endif
+      "  --jobs NUM            OCR the pages of a multi-page TIFF or image list\n"
+      "                        on NUM engine instances in parallel. Output is\n"
+      "                        still produced in page order.\n"
+      "                        (Same as: -c page_worker_threads=NUM)\n"
       "  --visible-pdf-image PATH\n"
       "                        Specify path to source page image which will be\n"
       "                        used as image underlay in PDF output.\n"
@@ -601,6 +605,10 @@ static int ParseArgs(int argc, const char** argv,
       vars_vec->push_back("engine_mode");                   // [i_a] NEW :: tessedit_ocr_engine_mode
       PUSH_VALUE_OR_YAK();
       continue;
+    } else if (strcmp(argv[i], "--jobs") == 0) {
+      vars_vec->push_back("page_worker_threads");
+      PUSH_VALUE_OR_YAK();
+      continue;
     } else if (strcmp(verb, "--print-parameters") == 0) {
       cmd |= PRINT_PARAMETERS;
 	  continue;
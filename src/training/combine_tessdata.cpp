@@ -22,6 +22,7 @@
 
 #include "common/commontraining.h" // CheckSharedLibraryVersion
 #include "lstmrecognizer.h"
+#include "shapedweights.h"
 #include "tessdatamanager.h"
 
 #include <cerrno>
@@ -118,6 +119,12 @@ static int list_network(TessdataManager &tm, const char *filename, int tess_debu
 // This will create  /home/$USER/temp/eng.* files with individual tessdata
 // components from tessdata/eng.traineddata.
 //
+// Specify option -s to add the int LSTM weights in the order used by the
+// SIMD implementation of this machine, which saves reordering them when the
+// model is loaded on machines with the same SIMD implementation:
+//
+//   combine_tessdata -s tessdata/eng.traineddata
+//
 #if defined(TESSERACT_STANDALONE) && !defined(BUILD_MONOLITHIC)
 extern "C" int main(int argc, const char** argv)
 #else
@@ -166,6 +173,10 @@ extern "C" int tesseract_combine_tessdata_main(int argc, const char** argv)
         "Usage for compacting LSTM component to int:\n"
         "  {} -c traineddata_file\n\n",
         exename);
+    tprintInfo(
+        "Usage for adding LSTM weights pre-shaped for the SIMD implementation of this machine:\n"
+        "  {} -s traineddata_file\n\n",
+        exename);
     tprintInfo(
         "Usage for transforming the proprietary .traineddata file to a zip archive:\n"
         "  {} -t traineddata_file\n\n",
@@ -298,6 +309,23 @@ extern "C" int tesseract_combine_tessdata_main(int argc, const char** argv)
         return EXIT_FAILURE;
       }
     }
+    else if (argc == 3 && strcmp(argv[1], "-s") == 0) {
+      if (!tm.Init(argv[2])) {
+        tprintError("Failed to read {}\n", argv[2]);
+        return EXIT_FAILURE;
+      }
+      std::vector<char> shaped_data;
+      if (!tesseract::ShapedWeights::Create(tm, &shaped_data)) {
+        tprintError("No int LSTM component or no SIMD implementation for {}!\n", argv[2]);
+        return EXIT_FAILURE;
+      }
+      tm.OverwriteEntry(tesseract::TESSDATA_LSTM_SHAPED_WEIGHTS, &shaped_data[0],
+                        shaped_data.size());
+      if (!tm.SaveFile(argv[2], nullptr)) {
+        tprintError("Failed to write modified traineddata:{}!\n", argv[2]);
+        return EXIT_FAILURE;
+      }
+    }
     else if (argc == 3 && strcmp(argv[1], "-t") == 0) {
 #if defined(HAVE_LIBARCHIVE)
       if (!tm.Init(argv[2])) {
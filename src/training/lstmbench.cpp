@@ -0,0 +1,331 @@
+///////////////////////////////////////////////////////////////////////
+// File:        lstmbench.cpp
+// Description: Per-layer inference benchmark for LSTM-based networks.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include <tesseract/preparation.h> // compiler config, etc.
+
+#include "common/commontraining.h"
+#include "unicharset/fileio.h" // for LoadFileLinesToStrings
+#include "imagedata.h"         // for DocumentCache
+#include "lstmrecognizer.h"
+#include "network.h"
+#include "networkio.h"
+#include "recodebeam.h"
+#include "simddetect.h"
+#include "tessdatamanager.h"
+#include <tesseract/params.h>
+#include <tesseract/tprintf.h>
+
+#include <algorithm> // for std::count, std::max
+#include <atomic>    // for std::atomic
+#include <chrono>    // for std::chrono::steady_clock
+#include <cstdlib>   // for std::malloc, std::free
+#include <map>       // for std::map
+#include <mutex>     // for std::mutex
+#include <new>       // for std::bad_alloc
+#include <set>       // for std::set
+#include <sstream>   // for std::stringstream
+
+using namespace tesseract;
+
+FZ_HEAPDBG_TRACKER_SECTION_START_MARKER(_)
+
+STRING_VAR(lstmbench_model, "", "Name of the traineddata file to benchmark");
+STRING_VAR(lstmbench_eval_listfile, "", "File listing line images in lstmf training format.");
+STRING_VAR(lstmbench_dotproducts, "",
+           "Comma separated dotproduct values to run the benchmark with, "
+           "for instance generic,sse,avx2. Empty runs the current one.");
+BOOL_VAR(lstmbench_int_mode, false, "Convert a float model to int before running it.");
+INT_VAR(lstmbench_iterations, 1, "Number of passes over the line images.");
+INT_VAR(lstmbench_max_image_MB, 2000, "Max memory to use for images.");
+
+FZ_HEAPDBG_TRACKER_SECTION_END_MARKER(_)
+
+// Number of allocations made by operator new. Only counted when the benchmark
+// is its own program, as replacing operator new in a monolithic build would
+// replace it for all the other tools too.
+static std::atomic<uint64_t> num_allocations{0};
+
+#if defined(TESSERACT_STANDALONE) && !defined(BUILD_MONOLITHIC)
+
+static const bool kCountsAllocations = true;
+
+void *operator new(std::size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+#else
+
+static const bool kCountsAllocations = false;
+
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Returns the seconds since start.
+double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Sums the forward time of each layer.
+class LayerTimes : public ForwardProfiler {
+public:
+  struct Time {
+    int64_t calls = 0;
+    double seconds = 0.0;
+  };
+
+  void Record(const Network *layer, double seconds) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Time &time = times_[layer];
+    ++time.calls;
+    time.seconds += seconds;
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    times_.clear();
+  }
+
+  Time Get(const Network *layer) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = times_.find(layer);
+    return it == times_.end() ? Time() : it->second;
+  }
+
+private:
+  mutable std::mutex mutex_;
+  std::map<const Network *, Time> times_;
+};
+
+// Returns the ids of all layers of the recognizer in tree order, with the
+// plumbing before the layers it holds. EnumerateLayers only lists the leaves,
+// but the prefixes of their ids are the ids of the plumbing.
+std::vector<std::string> AllLayerIds(const LSTMRecognizer &recognizer) {
+  std::vector<std::string> ids;
+  std::set<std::string> seen;
+  for (const auto &leaf : recognizer.EnumerateLayers()) {
+    for (size_t end = leaf.find(':', 1); end != std::string::npos;
+         end = leaf.find(':', end + 1)) {
+      std::string prefix = leaf.substr(0, end);
+      if (seen.insert(prefix).second) {
+        ids.push_back(prefix);
+      }
+    }
+    ids.push_back(leaf);
+  }
+  return ids;
+}
+
+// Returns the list of dotproduct values to run with.
+std::vector<std::string> DotProducts() {
+  std::vector<std::string> result;
+  std::stringstream stream(lstmbench_dotproducts.c_str());
+  std::string name;
+  while (std::getline(stream, name, ',')) {
+    if (!name.empty()) {
+      result.push_back(name);
+    }
+  }
+  if (result.empty()) {
+    result.emplace_back();
+  }
+  return result;
+}
+
+// Loads the model the way the engine does, for the current SIMD choice, named
+// simd, and runs it over all the pages of data. Returns false if the model
+// won't load.
+bool RunBenchmark(const char *model, const char *simd, DocumentCache &data, LayerTimes &times) {
+  TessdataManager mgr;
+  LSTMRecognizer recognizer(nullptr);
+  if (!mgr.Init(model) || !recognizer.Load(ParamsVectorSet(), "", &mgr)) {
+    tprintError("Failed to load recognition model from {}!\n", model);
+    return false;
+  }
+  if (lstmbench_int_mode) {
+    recognizer.ConvertToInt();
+  }
+  RecodeBeamSearch search(recognizer.GetRecoder(), recognizer.null_char(),
+                          recognizer.SimpleTextOutput(), nullptr);
+  const TBOX line_box(0, 0, 100, 100);
+  const int num_pages = data.TotalPages();
+  int64_t num_lines = 0;
+  int64_t num_timesteps = 0;
+  // RecognizeLine also prepares the inputs of the network, so its time is
+  // more than the time of the network, which is summed from its layers.
+  double line_seconds = 0.0;
+  double search_seconds = 0.0;
+  uint64_t line_allocations = 0;
+  uint64_t search_allocations = 0;
+  // The first line grows the scratch space and the beam, which isn't counted.
+  for (int serial = -1; serial < num_pages * lstmbench_iterations; ++serial) {
+    const ImageData *image = data.GetPageBySerial(std::max(serial, 0));
+    if (image == nullptr) {
+      continue;
+    }
+    float scale_factor;
+    NetworkIO inputs;
+    NetworkIO outputs;
+    uint64_t allocations = num_allocations.load();
+    auto start = Clock::now();
+    if (!recognizer.RecognizeLine(*image, 0.0f, false, false, line_box, &scale_factor, &inputs,
+                                  &outputs)) {
+      continue;
+    }
+    double line = SecondsSince(start);
+    uint64_t line_allocs = num_allocations.load() - allocations;
+    allocations = num_allocations.load();
+    start = Clock::now();
+    search.Decode(outputs, 1.0, 0.0, RecodeBeamSearch::kMinCertainty,
+                  &recognizer.GetUnicharset(), 0);
+    double decode = SecondsSince(start);
+    uint64_t search_allocs = num_allocations.load() - allocations;
+    if (serial < 0) {
+      times.Clear();
+      continue;
+    }
+    ++num_lines;
+    num_timesteps += outputs.Width();
+    line_seconds += line;
+    search_seconds += decode;
+    line_allocations += line_allocs;
+    search_allocations += search_allocs;
+  }
+  if (num_lines == 0) {
+    tprintError("No lines could be recognized!\n");
+    return true;
+  }
+  const double ms_per_line = 1000.0 / num_lines;
+  tprintInfo("dotproduct {}, {} model, {} lines, {:.1f} timesteps per line\n", simd,
+             recognizer.IsIntMode() ? "int" : "float", num_lines,
+             static_cast<double>(num_timesteps) / num_lines);
+  const std::vector<std::string> ids = AllLayerIds(recognizer);
+  double network_seconds = 0.0;
+  for (const auto &id : ids) {
+    if (std::count(id.begin(), id.end(), ':') == 1) {
+      network_seconds += times.Get(recognizer.GetLayer(id)).seconds;
+    }
+  }
+  tprintInfo("{:<16} {:<24} {:>8} {:>10} {:>7}\n", "Layer", "Name", "Calls", "ms/line",
+             "network");
+  for (const auto &id : ids) {
+    const Network *layer = recognizer.GetLayer(id);
+    LayerTimes::Time time = times.Get(layer);
+    std::string indented = std::string(std::count(id.begin(), id.end(), ':') - 1, ' ') + id;
+    if (time.calls == 0) {
+      // Not run by a Plumbing, for instance an LSTM that its Reversed runs
+      // backwards itself.
+      tprintInfo("{:<16} {:<24} {:>8} {:>10} {:>7}\n", indented, layer->name(), "-", "-", "-");
+      continue;
+    }
+    tprintInfo("{:<16} {:<24} {:>8} {:>10.3f} {:>6.1f}%\n", indented, layer->name(),
+               time.calls, time.seconds * ms_per_line,
+               100.0 * time.seconds / network_seconds);
+  }
+  tprintInfo("Network: {:.3f} ms/line, input preparation: {:.3f} ms/line, "
+             "beam search: {:.3f} ms/line\n",
+             network_seconds * ms_per_line, (line_seconds - network_seconds) * ms_per_line,
+             search_seconds * ms_per_line);
+  if (kCountsAllocations) {
+    tprintInfo("Allocations: {:.1f} per line in RecognizeLine, {:.1f} per line in beam search\n",
+               static_cast<double>(line_allocations) / num_lines,
+               static_cast<double>(search_allocations) / num_lines);
+  }
+  return true;
+}
+
+} // namespace
+
+#if defined(TESSERACT_STANDALONE) && !defined(BUILD_MONOLITHIC)
+extern "C" int main(int argc, const char** argv)
+#else
+extern "C" int tesseract_lstm_bench_main(int argc, const char** argv)
+#endif
+{
+  tesseract::CheckSharedLibraryVersion();
+  (void)tesseract::SetConsoleModeToUTF8();
+
+  int rv = ParseArguments(&argc, &argv);
+  if (rv >= 0) {
+    return rv;
+  }
+  if (lstmbench_model.empty()) {
+    tprintError("Must provide a --model!\n");
+    return EXIT_FAILURE;
+  }
+  if (lstmbench_eval_listfile.empty()) {
+    tprintError("Must provide a --eval_listfile!\n");
+    return EXIT_FAILURE;
+  }
+  std::vector<std::string> filenames;
+  if (!LoadFileLinesToStrings(lstmbench_eval_listfile.c_str(), &filenames)) {
+    tprintError("Failed to load list of line images from {}\n", lstmbench_eval_listfile.c_str());
+    return EXIT_FAILURE;
+  }
+  DocumentCache data(static_cast<int64_t>(lstmbench_max_image_MB) * 1048576);
+  if (!data.LoadDocuments(filenames, CS_SEQUENTIAL, nullptr)) {
+    tprintError("Failed to load line images from {}\n", lstmbench_eval_listfile.c_str());
+    return EXIT_FAILURE;
+  }
+  auto *dotproduct = ParamUtils::FindParam<StringParam>("dotproduct", GlobalParams());
+  LayerTimes times;
+  Network::SetForwardProfiler(&times);
+  int result = EXIT_SUCCESS;
+  for (const auto &name : DotProducts()) {
+    if (!name.empty()) {
+      if (dotproduct == nullptr) {
+        tprintError("Can't select dotproduct {}\n", name);
+        result = EXIT_FAILURE;
+        break;
+      }
+      dotproduct->set_value(name.c_str());
+      SIMDDetect::Update();
+    }
+    const char *simd = dotproduct != nullptr ? dotproduct->c_str() : "auto";
+    if (!RunBenchmark(lstmbench_model.c_str(), simd, data, times)) {
+      result = EXIT_FAILURE;
+      break;
+    }
+  }
+  Network::SetForwardProfiler(nullptr);
+  return result;
+} /* main */
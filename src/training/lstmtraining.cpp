@@ -19,6 +19,7 @@
 
 #include <tesseract/debugheap.h>
 
+#include <algorithm> // for std::min
 #include <cerrno>
 #include <locale> // for std::locale::classic
 #if defined(__USE_GNU)
@@ -76,9 +77,23 @@ STRING_VAR(training_old_traineddata, "",
                          " character set that is to be replaced");
 BOOL_VAR(training_randomly_rotate, false,
                        "Train OSD and randomly turn training samples upside-down");
+INT_VAR(training_parallel_samples, 1,
+                      "Number of samples to train on in parallel, with a single"
+                      " weight update for all of them");
+INT_VAR(training_batch_size, 1,
+                      "Max number of lines of similar width to train on in a single"
+                      " forward and backward pass");
+INT_VAR(training_prefetch_threads, 0,
+                      "Number of threads that read training images ahead of the"
+                      " training, 0 to read them when needed");
+INT_VAR(training_prefetch_pages, 128,
+                      "Number of training images to read ahead when prefetching");
 
 // Number of training images to train between calls to MaintainCheckpoints.
 const int kNumPagesPerBatch = 100;
+// Number of mini-batches worth of training images that are sorted by width
+// to make up mini-batches of lines of similar width.
+const int kNumBatchesPerWidthSort = 4;
 
 FZ_HEAPDBG_TRACKER_SECTION_END_MARKER(_)
 
@@ -127,6 +142,10 @@ extern "C" int tesseract_lstm_training_main(int argc, const char** argv)
     tprintError("Must provide a --traineddata, see training documentation\n");
     return EXIT_FAILURE;
   }
+  if (training_batch_size > 1 && training_parallel_samples > 1) {
+    tprintError("--batch_size and --parallel_samples cannot be combined\n");
+    return EXIT_FAILURE;
+  }
 
   // Check write permissions.
   std::string test_file = training_model_output;
@@ -234,6 +253,8 @@ extern "C" int tesseract_lstm_training_main(int argc, const char** argv)
     tprintError("Load of images failed!!\n");
     return EXIT_FAILURE;
   }
+  trainer.mutable_training_data()->StartPrefetch(training_prefetch_threads,
+                                                 training_prefetch_pages);
 
   tesseract::LSTMTester tester(static_cast<int64_t>(training_max_image_MB) * 1048576);
   tesseract::TestCallback tester_callback = nullptr;
@@ -261,11 +282,27 @@ extern "C" int tesseract_lstm_training_main(int argc, const char** argv)
     for (int target_iteration = iteration + kNumPagesPerBatch;
          iteration < target_iteration && iteration < max_iterations;
          iteration = trainer.training_iteration()) {
-      trainer.TrainOnLine(&trainer, false);
+      // Samples that may be trained on at once without passing either target.
+      int remaining = std::min(target_iteration, max_iterations) - iteration;
+      if (training_batch_size > 1) {
+        trainer.TrainOnBatch(&trainer,
+                             std::min<int>(training_batch_size * kNumBatchesPerWidthSort, remaining),
+                             training_batch_size);
+      } else if (training_parallel_samples > 1) {
+        trainer.TrainOnLines(&trainer, std::min<int>(training_parallel_samples, remaining));
+      } else {
+        trainer.TrainOnLine(&trainer, false);
+      }
     }
     std::stringstream log_str;
     log_str.imbue(std::locale::classic());
     trainer.MaintainCheckpoints(tester_callback, log_str);
+    if (training_prefetch_threads > 0) {
+      tesseract::PrefetchStats stats = trainer.training_data().GetPrefetchStats();
+      log_str << "\nPrefetched images: " << stats.hits << " ready, " << stats.stalls
+              << " waited for (" << stats.stall_seconds << "s), " << stats.pages_loaded
+              << " read, " << stats.pages_evicted << " dropped";
+    }
     tprintDebug("{}\n", log_str.str());
   } while (trainer.best_error_rate() > training_target_error_rate &&
            (trainer.training_iteration() < max_iterations));
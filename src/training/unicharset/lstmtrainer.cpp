@@ -18,6 +18,7 @@
 // Include automatically generated configuration file if running autoconf.
 #include <tesseract/preparation.h> // compiler config, etc.
 
+#include <algorithm>           // for std::max, std::stable_sort
 #include <cmath>
 #include <iomanip>             // for std::setprecision
 #include <locale>              // for std::locale::classic
@@ -161,6 +162,7 @@ bool LSTMTrainer::InitNetwork(const char *network_spec, int append_index,
                               float learning_rate, float momentum,
                               float adam_beta) {
   mgr_.SetVersionString(mgr_.VersionString() + ":" + network_spec);
+  replicas_.clear();
   adam_beta_ = adam_beta;
   learning_rate_ = learning_rate;
   momentum_ = momentum;
@@ -505,6 +507,7 @@ bool LSTMTrainer::Serialize(SerializeAmount serialize_amount,
 // Reads from the given file. Returns false in case of error.
 // NOTE: It is assumed that the trainer is never read cross-endian.
 bool LSTMTrainer::DeSerialize(const TessdataManager *mgr, TFile *fp) {
+  replicas_.clear();
   if (!LSTMRecognizer::DeSerialize(mgr, fp)) {
     return false;
   }
@@ -865,6 +868,26 @@ bool LSTMTrainer::EncodeString(const std::string &str,
   return false;
 }
 
+// Returns a copy of the sample of samples_trainer with the given serial, or
+// nullptr if there is none. The cache may drop a page while fetching the
+// next one, so samples that are used together must be copies.
+static std::unique_ptr<ImageData> CopySample(LSTMTrainer *samples_trainer, int serial) {
+  const ImageData *image = samples_trainer->mutable_training_data()->GetPageBySerial(serial);
+  if (image == nullptr) {
+    return nullptr;
+  }
+  std::vector<char> data;
+  TFile writer;
+  writer.OpenWrite(&data);
+  TFile reader;
+  auto copy = std::make_unique<ImageData>();
+  if (!image->Serialize(&writer) || !reader.Open(&data[0], data.size()) ||
+      !copy->DeSerialize(&reader)) {
+    return nullptr;
+  }
+  return copy;
+}
+
 // Performs forward-backward on the given trainingdata.
 // Returns a Trainability enum to indicate the suitability of the sample.
 Trainability LSTMTrainer::TrainOnLine(const ImageData *trainingdata,
@@ -898,6 +921,235 @@ Trainability LSTMTrainer::TrainOnLine(const ImageData *trainingdata,
   return trainable;
 }
 
+// Trains on the next num_samples samples of samples_trainer, running the
+// forward and backward passes in parallel on replicas_, and applying the sum
+// of their deltas with a single Update. Without Adam, as the sum isn't
+// divided by the number of samples, the learning rate stays a rate per
+// sample. Adam normalizes the deltas by their running rms, so each Update
+// moves a weight by up to about the learning rate, however many samples it
+// sums: N samples per Update take N times fewer steps than TrainOnLine.
+void LSTMTrainer::TrainOnLines(LSTMTrainer *samples_trainer, int num_samples) {
+  if (num_samples < 2 || debug_interval_ != 0 || !network_->IsTraining() ||
+      !PrepareReplicas(num_samples)) {
+    for (int s = 0; s < num_samples; ++s) {
+      TrainOnLine(samples_trainer, false);
+    }
+    return;
+  }
+  struct Sample {
+    std::unique_ptr<ImageData> image;
+    Trainability trainable = UNENCODABLE;
+    bool backprop = false;
+    NetworkIO fwd_outputs;
+    NetworkIO targets;
+  };
+  std::vector<Sample> samples(num_samples);
+  for (int s = 0; s < num_samples; ++s) {
+    samples[s].image = CopySample(samples_trainer, sample_iteration_ + s);
+  }
+  const TaskScheduler &scheduler = scratch_space_.scheduler();
+  // Forward passes, each with the random seed that TrainOnLine would use.
+  scheduler.ParallelFor(num_samples, [&](int, int start, int end) {
+    for (int s = start; s < end; ++s) {
+      Sample &sample = samples[s];
+      if (sample.image == nullptr) {
+        continue;
+      }
+      LSTMTrainer &replica = *replicas_[s];
+      replica.sample_iteration_ = sample_iteration_ + s;
+      replica.training_iteration_ = training_iteration_;
+      sample.trainable =
+          replica.PrepareForBackward(sample.image.get(), &sample.fwd_outputs, &sample.targets);
+    }
+  });
+  // Record the errors and choose the samples to backprop in sample order, as
+  // the perfect sample delay depends on the previous samples.
+  int num_counted = 0;
+  for (int s = 0; s < num_samples; ++s) {
+    Sample &sample = samples[s];
+    if (sample.image == nullptr || sample.trainable == UNENCODABLE ||
+        sample.trainable == NOT_BOXED) {
+      ++sample_iteration_;
+      continue;
+    }
+    const LSTMTrainer &replica = *replicas_[s];
+    for (auto type : {ET_RMS, ET_DELTA, ET_WORD_RECERR, ET_CHAR_ERROR}) {
+      UpdateErrorBuffer(replica.NewSingleError(type), type);
+    }
+    UpdateErrorBuffer(sample_iteration_ - prev_sample_iteration_, ET_SKIP_RATIO);
+    ++sample_iteration_;
+    sample.backprop = sample.trainable != PERFECT ||
+                      training_iteration() > last_perfect_training_iteration_ + perfect_delay_;
+    RollErrorBuffers();
+    ++num_counted;
+  }
+  std::vector<int> backprop_samples;
+  std::vector<const Network *> backprop_networks;
+  for (int s = 0; s < num_samples; ++s) {
+    if (samples[s].backprop) {
+      backprop_samples.push_back(s);
+      backprop_networks.push_back(replicas_[s]->network_);
+    }
+  }
+  if (backprop_samples.empty()) {
+    return;
+  }
+  scheduler.ParallelFor(static_cast<int>(backprop_samples.size()), [&](int, int start, int end) {
+    for (int i = start; i < end; ++i) {
+      int s = backprop_samples[i];
+      LSTMTrainer &replica = *replicas_[s];
+      NetworkIO bp_deltas;
+      replica.network_->Backward(false, samples[s].targets, &replica.scratch_space_, &bp_deltas);
+    }
+  });
+  network_->SumDeltas(backprop_networks);
+  network_->Update(learning_rate_, momentum_, adam_beta_, AdamStepCount(num_counted));
+}
+
+// Trains on the next num_samples samples of samples_trainer in mini-batches of
+// lines of similar width, one forward and backward pass and Update for each.
+// The learning rate means the same as in TrainOnLines.
+void LSTMTrainer::TrainOnBatch(LSTMTrainer *samples_trainer, int num_samples,
+                               int max_batch_size) {
+  // Lines are only packed together if the widest is no more than this
+  // multiple of the narrowest, to limit the work wasted on padding.
+  const int kMaxBatchWidthRatio = 2;
+  // Maximum width of image to train on, as a multiple of its height, as in
+  // RecognizeLine.
+  const int kMaxImageWidthRatio = 128;
+  if (max_batch_size < 2 || debug_interval_ != 0 || !network_->IsTraining()) {
+    for (int s = 0; s < num_samples; ++s) {
+      TrainOnLine(samples_trainer, false);
+    }
+    return;
+  }
+  struct Line {
+    std::unique_ptr<ImageData> image;
+    int serial;
+    std::vector<int> truth_labels;
+    Image pix;
+    float scale_factor;
+    // Number of unusable samples between this and the previous usable one.
+    int skips;
+  };
+  const int first_serial = sample_iteration_;
+  // Number of unusable samples since the last one that was trained on.
+  int skips = sample_iteration_ - prev_sample_iteration_;
+  int min_width = network_->XScaleFactor();
+  std::vector<Line> lines;
+  for (int s = 0; s < num_samples; ++s) {
+    // Each sample gets the random seed that TrainOnLine would give it.
+    sample_iteration_ = first_serial + s;
+    Line line;
+    line.image = CopySample(samples_trainer, sample_iteration_);
+    if (line.image != nullptr && line.image->boxes().empty()) {
+      // Needs the polarity test of RecognizeLine, which is per line.
+      prev_sample_iteration_ = sample_iteration_ - skips;
+      Trainability trainable = TrainOnLine(line.image.get(), false);
+      skips = (trainable == UNENCODABLE || trainable == NOT_BOXED) ? skips + 1 : 0;
+      continue;
+    }
+    bool upside_down = false;
+    if (line.image == nullptr || !EncodeTruth(*line.image, &line.truth_labels, &upside_down)) {
+      ++skips;
+      continue;
+    }
+    SetRandomSeed();
+    line.pix = Input::PrepareLSTMInputs(*line.image, network_, min_width, &randomizer_,
+                                        &line.scale_factor);
+    if (line.pix == nullptr) {
+      tprintError("Image {} not trainable\n", line.image->imagefilename());
+      ++skips;
+      continue;
+    }
+    if (pixGetWidth(line.pix) > kMaxImageWidthRatio * pixGetHeight(line.pix)) {
+      tprintError("Image too large to learn!! Size = {}x{}\n", pixGetWidth(line.pix),
+                  pixGetHeight(line.pix));
+      line.pix.destroy();
+      ++skips;
+      continue;
+    }
+    if (upside_down) {
+      pixRotate180(line.pix, line.pix);
+    }
+    line.scale_factor = min_width / line.scale_factor;
+    line.serial = sample_iteration_;
+    line.skips = skips;
+    skips = 0;
+    lines.push_back(std::move(line));
+  }
+  const int trailing_skips = skips;
+  skips = 0;
+  std::stable_sort(lines.begin(), lines.end(), [](const Line &a, const Line &b) {
+    return pixGetWidth(a.pix) < pixGetWidth(b.pix);
+  });
+  for (size_t start = 0; start < lines.size();) {
+    size_t end = start + 1;
+    int max_width = kMaxBatchWidthRatio * pixGetWidth(lines[start].pix);
+    while (end < lines.size() && end - start < static_cast<size_t>(max_batch_size) &&
+           pixGetWidth(lines[end].pix) <= max_width) {
+      ++end;
+    }
+    std::vector<Image> pixes;
+    std::vector<TBOX> line_boxes;
+    std::vector<float> scale_factors;
+    for (size_t i = start; i < end; ++i) {
+      pixes.push_back(lines[i].pix);
+      line_boxes.emplace_back(0, 0, 100, 100);
+      scale_factors.push_back(lines[i].scale_factor);
+    }
+    NetworkIO inputs, outputs, targets;
+    inputs.set_int_mode(IsIntMode());
+    sample_iteration_ = lines[start].serial;
+    SetRandomSeed();
+    Input::PreparePixBatchInput(tesseract_, network_->InputShape(), pixes, line_boxes,
+                                scale_factors, &randomizer_, &inputs);
+    network_->Forward(false, inputs, nullptr, &scratch_space_, &outputs);
+    // The targets of lines that are not trained on stay zero, so they add
+    // nothing to the deltas.
+    targets.Resize(outputs, network_->NumOutputs());
+    targets.Zero();
+    bool backprop = false;
+    int num_counted = 0;
+    for (size_t i = start; i < end; ++i) {
+      Line &line = lines[i];
+      skips += line.skips;
+      // The targets are computed on each line alone, with its true width.
+      NetworkIO line_outputs, line_targets;
+      line_outputs.CopyBatchElement(outputs, i - start);
+      sample_iteration_ = line.serial;
+      prev_sample_iteration_ = sample_iteration_ - skips;
+      Trainability trainable =
+          PrepareTargets(*line.image, inputs, &line.truth_labels, &line_outputs, &line_targets);
+      if (trainable == UNENCODABLE || trainable == NOT_BOXED) {
+        ++skips;
+        continue;
+      }
+      skips = 0;
+      ++sample_iteration_;
+      if (trainable != PERFECT ||
+          training_iteration() > last_perfect_training_iteration_ + perfect_delay_) {
+        targets.WriteBatchElement(i - start, line_targets);
+        backprop = true;
+      }
+      RollErrorBuffers();
+      ++num_counted;
+    }
+    if (backprop) {
+      NetworkIO bp_deltas;
+      network_->Backward(false, targets, &scratch_space_, &bp_deltas);
+      network_->Update(learning_rate_, momentum_, adam_beta_, AdamStepCount(num_counted));
+    }
+    start = end;
+  }
+  for (auto &line : lines) {
+    line.pix.destroy();
+  }
+  sample_iteration_ = first_serial + num_samples;
+  prev_sample_iteration_ = sample_iteration_ - skips - trailing_skips;
+  scratch_space_.Trim();
+}
+
 // Prepares the ground truth, runs forward, and prepares the targets.
 // Returns a Trainability enum to indicate the suitability of the sample.
 Trainability LSTMTrainer::PrepareForBackward(const ImageData *trainingdata,
@@ -907,64 +1159,83 @@ Trainability LSTMTrainer::PrepareForBackward(const ImageData *trainingdata,
     tprintError("Null trainingdata.\n");
     return UNENCODABLE;
   }
-  // Ensure repeatability of random elements even across checkpoints.
-  bool debug =
-      debug_interval_ > 0 && training_iteration() % debug_interval_ == 0;
   std::vector<int> truth_labels;
-  if (!EncodeString(trainingdata->transcription(), &truth_labels)) {
-    tprintError("Can't encode transcription: '{}' in language '{}'\n",
-            trainingdata->transcription(),
-            trainingdata->language());
+  bool upside_down = false;
+  if (!EncodeTruth(*trainingdata, &truth_labels, &upside_down)) {
     return UNENCODABLE;
   }
-  bool upside_down = false;
+  float image_scale;
+  NetworkIO inputs;
+  bool invert = trainingdata->boxes().empty();
+  TBOX line_box(0, 0, 100, 100);
+  if (!RecognizeLine(*trainingdata, invert ? 0.5f : 0.0f, invert, upside_down, line_box, 
+                     &image_scale, &inputs, fwd_outputs)) {
+    tprintError("Image {} not trainable\n", trainingdata->imagefilename());
+    return UNENCODABLE;
+  }
+  return PrepareTargets(*trainingdata, inputs, &truth_labels, fwd_outputs, targets);
+}
+
+// Encodes the transcription of trainingdata as the truth labels, which are
+// reversed if randomly_rotate_ chooses to turn the line upside down.
+// Returns false if the transcription can't be used.
+bool LSTMTrainer::EncodeTruth(const ImageData &trainingdata, std::vector<int> *truth_labels,
+                              bool *upside_down) {
+  if (!EncodeString(trainingdata.transcription(), truth_labels)) {
+    tprintError("Can't encode transcription: '{}' in language '{}'\n",
+            trainingdata.transcription(),
+            trainingdata.language());
+    return false;
+  }
+  *upside_down = false;
   if (randomly_rotate_) {
     // This ensures consistent training results.
     SetRandomSeed();
-    upside_down = randomizer_.SignedRand(1.0) > 0.0;
-    if (upside_down) {
+    *upside_down = randomizer_.SignedRand(1.0) > 0.0;
+    if (*upside_down) {
       // Modify the truth labels to match the rotation:
       // Apart from space and null, increment the label. This changes the
       // script-id to the same script-id but upside-down.
       // The labels need to be reversed in order, as the first is now the last.
-      for (auto truth_label : truth_labels) {
+      for (auto truth_label : *truth_labels) {
         if (truth_label != UNICHAR_SPACE && truth_label != null_char_) {
           ++truth_label;
         }
       }
-      std::reverse(truth_labels.begin(), truth_labels.end());
+      std::reverse(truth_labels->begin(), truth_labels->end());
     }
   }
   unsigned w = 0;
-  while (w < truth_labels.size() &&
-         (truth_labels[w] == UNICHAR_SPACE || truth_labels[w] == null_char_)) {
+  while (w < truth_labels->size() &&
+         ((*truth_labels)[w] == UNICHAR_SPACE || (*truth_labels)[w] == null_char_)) {
     ++w;
   }
-  if (w == truth_labels.size()) {
-    tprintError("Blank transcription: {}\n", trainingdata->transcription());
-    return UNENCODABLE;
-  }
-  float image_scale;
-  NetworkIO inputs;
-  bool invert = trainingdata->boxes().empty();
-  TBOX line_box(0, 0, 100, 100);
-  if (!RecognizeLine(*trainingdata, invert ? 0.5f : 0.0f, invert, upside_down, line_box, 
-                     &image_scale, &inputs, fwd_outputs)) {
-    tprintError("Image {} not trainable\n", trainingdata->imagefilename());
-    return UNENCODABLE;
+  if (w == truth_labels->size()) {
+    tprintError("Blank transcription: {}\n", trainingdata.transcription());
+    return false;
   }
+  return true;
+}
+
+// Computes the targets for the fwd_outputs that the network produced from
+// inputs for trainingdata, with the given truth_labels, and records the
+// errors. Returns a Trainability enum to indicate the suitability of the
+// sample.
+Trainability LSTMTrainer::PrepareTargets(const ImageData &trainingdata, const NetworkIO &inputs,
+                                         std::vector<int> *truth_labels, NetworkIO *fwd_outputs,
+                                         NetworkIO *targets) {
   targets->Resize(*fwd_outputs, network_->NumOutputs());
   LossType loss_type = OutputLossType();
   if (loss_type == LT_SOFTMAX) {
-    if (!ComputeTextTargets(*fwd_outputs, truth_labels, targets)) {
+    if (!ComputeTextTargets(*fwd_outputs, *truth_labels, targets)) {
       tprintError("Compute simple targets failed for {}!\n",
-              trainingdata->imagefilename());
+              trainingdata.imagefilename());
       return UNENCODABLE;
     }
   } else if (loss_type == LT_CTC) {
-    if (!ComputeCTCTargets(truth_labels, fwd_outputs, targets)) {
+    if (!ComputeCTCTargets(*truth_labels, fwd_outputs, targets)) {
       tprintError("Compute CTC targets failed for {}!\n",
-              trainingdata->imagefilename());
+              trainingdata.imagefilename());
       return UNENCODABLE;
     }
   } else {
@@ -976,15 +1247,15 @@ Trainability LSTMTrainer::PrepareForBackward(const ImageData *trainingdata,
   LabelsFromOutputs(*fwd_outputs, &ocr_labels, &xcoords);
   // CTC does not produce correct target labels to begin with.
   if (loss_type != LT_CTC) {
-    LabelsFromOutputs(*targets, &truth_labels, &xcoords);
+    LabelsFromOutputs(*targets, truth_labels, &xcoords);
   }
-  if (!DebugLSTMTraining(inputs, *trainingdata, *fwd_outputs, truth_labels,
+  if (!DebugLSTMTraining(inputs, trainingdata, *fwd_outputs, *truth_labels,
                          *targets)) {
     tprintError("Input width was {}\n", inputs.Width());
     return UNENCODABLE;
   }
   std::string ocr_text = DecodeLabels(ocr_labels);
-  std::string truth_text = DecodeLabels(truth_labels);
+  std::string truth_text = DecodeLabels(*truth_labels);
   targets->SubtractAllFromFloat(*fwd_outputs);
   if (debug_interval_ != 0) {
     if (truth_text != ocr_text) {
@@ -992,12 +1263,12 @@ Trainability LSTMTrainer::PrepareForBackward(const ImageData *trainingdata,
               ocr_text.c_str());
     }
   }
-  double char_error = ComputeCharError(truth_labels, ocr_labels);
+  double char_error = ComputeCharError(*truth_labels, ocr_labels);
   double word_error = ComputeWordError(&truth_text, &ocr_text);
   double delta_error = ComputeErrorRates(*targets, char_error, word_error);
   if (debug_interval_ != 0) {
-    tprintDebug("File {} line {} {}:\n", trainingdata->imagefilename(),
-            trainingdata->page_number(), delta_error == 0.0 ? "(Perfect)" : "");
+    tprintDebug("File {} line {} {}:\n", trainingdata.imagefilename(),
+            trainingdata.page_number(), delta_error == 0.0 ? "(Perfect)" : "");
   }
   if (delta_error == 0.0) {
     return PERFECT;
@@ -1401,6 +1672,35 @@ void LSTMTrainer::UpdateErrorBuffer(double new_error, ErrorTypes type) {
   error_rates_[type] = IntCastRounded(100000.0 * mean) / 1000.0;
 }
 
+// Returns the step count for the bias correction of Adam in an Update of
+// samples_per_update samples. TrainOnLine, with one sample per Update, gives
+// training_iteration_ + 1 before RollErrorBuffers, which is the same.
+int LSTMTrainer::AdamStepCount(int samples_per_update) const {
+  return std::max(1, (training_iteration_ + samples_per_update - 1) / samples_per_update);
+}
+
+// Makes sure that replicas_ has at least num_replicas trainers whose networks
+// share the weights of network_.
+bool LSTMTrainer::PrepareReplicas(int num_replicas) {
+  if (replicas_.size() >= static_cast<size_t>(num_replicas)) {
+    return true;
+  }
+  std::vector<char> data;
+  if (!SaveTrainingDump(LIGHT, *this, &data)) {
+    return false;
+  }
+  while (replicas_.size() < static_cast<size_t>(num_replicas)) {
+    auto replica = std::make_unique<LSTMTrainer>();
+    if (!ReadTrainingDump(data, *replica)) {
+      return false;
+    }
+    replica->network_->ShareWeights(*network_);
+    replica->randomly_rotate_ = randomly_rotate_;
+    replicas_.push_back(std::move(replica));
+  }
+  return true;
+}
+
 // Rolls error buffers and reports the current means.
 void LSTMTrainer::RollErrorBuffers() {
   prev_sample_iteration_ = sample_iteration_;
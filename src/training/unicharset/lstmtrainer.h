@@ -284,6 +284,22 @@ public:
     return image;
   }
   Trainability TrainOnLine(const ImageData *trainingdata, bool batch);
+  // Trains on the next num_samples samples of samples_trainer, with the same
+  // effect on the counters and error rates as that many calls of the above
+  // TrainOnLine, but with the forward and backward passes run in parallel on
+  // replicas of the network that share its weights, and a single Update of
+  // the summed weight deltas of all the samples. Just calls TrainOnLine if
+  // num_samples < 2 or when debugging.
+  void TrainOnLines(LSTMTrainer *samples_trainer, int num_samples);
+  // Trains on the next num_samples samples of samples_trainer in mini-batches
+  // of up to max_batch_size lines of similar width, with a single forward and
+  // backward pass and Update for each mini-batch, which turns the products
+  // of the weight matrices with single vectors into products with blocks of
+  // vectors. The counters and error rates are updated as by TrainOnLine for
+  // each sample. Samples without boxes, for which TrainOnLine tries both
+  // polarities, still go through TrainOnLine, as does everything when
+  // debugging or if max_batch_size < 2.
+  void TrainOnBatch(LSTMTrainer *samples_trainer, int num_samples, int max_batch_size);
 
   // Prepares the ground truth, runs forward, and prepares the targets.
   // Returns a Trainability enum to indicate the suitability of the sample.
@@ -400,6 +416,29 @@ protected:
   // Rolls error buffers and reports the current means.
   void RollErrorBuffers();
 
+  // Encodes the transcription of trainingdata as the truth labels, which are
+  // reversed if randomly_rotate_ chooses to turn the line upside down.
+  // Returns false if the transcription can't be used.
+  bool EncodeTruth(const ImageData &trainingdata, std::vector<int> *truth_labels,
+                   bool *upside_down);
+  // Computes the targets for the fwd_outputs that the network produced from
+  // inputs for trainingdata, with the given truth_labels, and records the
+  // errors. Returns a Trainability enum to indicate the suitability of the
+  // sample.
+  Trainability PrepareTargets(const ImageData &trainingdata, const NetworkIO &inputs,
+                              std::vector<int> *truth_labels, NetworkIO *fwd_outputs,
+                              NetworkIO *targets);
+
+  // Makes sure that replicas_ has at least num_replicas trainers whose
+  // networks share the weights of network_. Returns false on failure.
+  bool PrepareReplicas(int num_replicas);
+  // Returns the step count for the bias correction of Adam in an Update of
+  // the summed deltas of samples_per_update samples, once training_iteration_
+  // has counted them. Adam takes one step per Update, not per sample, so this
+  // is the number of Updates so far, assuming that all were of as many
+  // samples.
+  int AdamStepCount(int samples_per_update) const;
+
   // Given that error_rate is either a new min or max, updates the best/worst
   // error rates, and record of progress.
   std::string UpdateErrorGraph(int iteration, double error_rate,
@@ -432,6 +471,9 @@ protected:
   std::string best_model_name_;
   // Number of available training stages.
   int num_training_stages_;
+  // Trainers that run the samples of TrainOnLines, on networks that share the
+  // weights of network_, so they must go whenever network_ is replaced.
+  std::vector<std::unique_ptr<LSTMTrainer>> replicas_;
 
   // ===Serialized data to ensure that a restart produces the same results.===
   // These members are only serialized when serialize_amount != LIGHT.
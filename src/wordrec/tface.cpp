@@ -37,9 +37,11 @@ namespace tesseract {
  * Initialize all the things in the program that need to be initialized.
  * init_permute determines whether to initialize the permute functions
  * and Dawg models.
+ * defer_classifier_templates postpones loading the classifier's pre-trained
+ * templates until they are first used.
  */
 void Wordrec::program_editup(const std::string &textbase, TessdataManager *init_classifier,
-                             TessdataManager *init_dict) {
+                             TessdataManager *init_dict, bool defer_classifier_templates) {
   if (!textbase.empty()) {
     if (textbase == "-" /* stdout */)
       imagefile_ = "tesseract-stdio-session";
@@ -48,7 +50,7 @@ void Wordrec::program_editup(const std::string &textbase, TessdataManager *init_
   }
 #if !DISABLED_LEGACY_ENGINE
   InitFeatureDefs(&feature_defs_);
-  InitAdaptiveClassifier(init_classifier);
+  InitAdaptiveClassifier(init_classifier, defer_classifier_templates);
   if (init_dict) {
     getDict().SetupForLoad(Dict::GlobalDawgCache());
     getDict().Load(lang_, init_dict);
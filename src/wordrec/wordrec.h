@@ -49,7 +49,7 @@ public:
 
   // tface.cpp
   void program_editup(const std::string &textbase, TessdataManager *init_classifier,
-                      TessdataManager *init_dict);
+                      TessdataManager *init_dict, bool defer_classifier_templates = false);
   void program_editdown(int32_t elapsed_time);
   int end_recog();
   int dict_word(const WERD_CHOICE &word);
@@ -243,7 +243,7 @@ public:
 
   // tface.cpp
   void program_editup(const std::string &textbase, TessdataManager *init_classifier,
-                      TessdataManager *init_dict);
+                      TessdataManager *init_dict, bool defer_classifier_templates = false);
   void cc_recog(WERD_RES *word);
   void program_editdown(int32_t elapsed_time);
   void set_pass1();
@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////
+// File:        activations_test.cc
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include "activations.h"
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include "functions.h"
+#include "include_gunit.h"
+#include "simddetect.h"
+
+namespace tesseract {
+
+class ActivationsTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::locale::global(std::locale(""));
+    // Random values covering the whole table, plus the special cases around
+    // zero and the end of the table. The odd size exercises the scalar tail.
+    inputs_.resize(1003);
+    for (auto &x : inputs_) {
+      x = random_.SignedRand(20.0);
+    }
+    const TFloat kEnd = (kTableSize - 1) / kScaleFactor;
+    const TFloat kSpecial[] = {0.0, -0.0, kEnd, -kEnd, kEnd - 0.001, 1e6, -1e6};
+    std::copy(std::begin(kSpecial), std::end(kSpecial), inputs_.begin());
+  }
+
+  // Compares the given implementation against the scalar Tanh and Logistic.
+  void ExpectEqualResults(TableActivationFunction function) {
+    std::vector<TFloat> tanh_result(inputs_);
+    function(TanhTable, true, tanh_result.size(), tanh_result.data());
+    std::vector<TFloat> logistic_result(inputs_);
+    function(LogisticTable, false, logistic_result.size(), logistic_result.data());
+    for (size_t i = 0; i < inputs_.size(); ++i) {
+      EXPECT_NEAR(Tanh(inputs_[i]), tanh_result[i], kTolerance) << "x=" << inputs_[i];
+      EXPECT_NEAR(Logistic(inputs_[i]), logistic_result[i], kTolerance) << "x=" << inputs_[i];
+    }
+  }
+
+  // The implementations all interpolate the same table entries, so they may
+  // only differ in the rounding of the interpolation.
+  static constexpr TFloat kTolerance = 1e-6;
+
+  std::vector<TFloat> inputs_;
+  TRand random_;
+};
+
+// Tests the implementation selected for this machine, as used by FuncInplace.
+TEST_F(ActivationsTest, Selected) {
+  ExpectEqualResults(TableActivation);
+}
+
+TEST_F(ActivationsTest, SSE) {
+  if (!SIMDDetect::IsSSEAvailable() || TableActivationSSE == nullptr) {
+    GTEST_LOG_(INFO) << "No SSE found! Not tested!";
+    GTEST_SKIP();
+  }
+  ExpectEqualResults(TableActivationSSE);
+}
+
+TEST_F(ActivationsTest, AVX2) {
+  if (!SIMDDetect::IsAVX2Available() || TableActivationAVX2 == nullptr) {
+    GTEST_LOG_(INFO) << "No AVX2 found! Not tested!";
+    GTEST_SKIP();
+  }
+  ExpectEqualResults(TableActivationAVX2);
+}
+
+TEST_F(ActivationsTest, AVX512F) {
+  if (!SIMDDetect::IsAVX512FAvailable() || TableActivationAVX512F == nullptr) {
+    GTEST_LOG_(INFO) << "No AVX512F found! Not tested!";
+    GTEST_SKIP();
+  }
+  ExpectEqualResults(TableActivationAVX512F);
+}
+
+TEST_F(ActivationsTest, NEON) {
+  if (!SIMDDetect::IsNEONAvailable() || TableActivationNEON == nullptr) {
+    GTEST_LOG_(INFO) << "No NEON found! Not tested!";
+    GTEST_SKIP();
+  }
+  ExpectEqualResults(TableActivationNEON);
+}
+
+// FuncMultiply<HFunc> must not depend on where its output goes.
+TEST_F(ActivationsTest, FuncMultiply) {
+  std::vector<TFloat> v(inputs_.size());
+  for (auto &x : v) {
+    x = random_.SignedRand(1.0);
+  }
+  std::vector<TFloat> product(inputs_.size());
+  FuncMultiply<HFunc>(inputs_.data(), v.data(), inputs_.size(), product.data());
+  std::vector<TFloat> in_place(v);
+  FuncMultiply<HFunc>(inputs_.data(), in_place.data(), inputs_.size(), in_place.data());
+  for (size_t i = 0; i < inputs_.size(); ++i) {
+    EXPECT_NEAR(Tanh(inputs_[i]) * v[i], product[i], kTolerance);
+    EXPECT_NEAR(product[i], in_place[i], kTolerance);
+  }
+}
+
+} // namespace tesseract
@@ -15,8 +15,10 @@
 #include "log.h"        // for LOG
 #include "ocrblock.h"   // for class BLOCK
 #include "pageres.h"
+#include "tesseractclass.h"
 
 #include <tesseract/baseapi.h>
+#include <tesseract/renderer.h>
 
 #include <leptonica/allheaders.h>
 #include "gmock/gmock-matchers.h"
@@ -301,6 +303,104 @@ TEST_F(TesseractTest, InitConfigOnlyTest) {
   }
 }
 
+#if !DISABLED_LEGACY_ENGINE
+// Tests that the legacy classifier templates of a memory mapped traineddata
+// are only loaded once something needs them.
+TEST_F(TesseractTest, DefersLegacyTemplates) {
+  {
+    tesseract::TessBaseAPI api;
+    if (api.Init(TessdataPath().c_str(), "eng", tesseract::OEM_TESSERACT_LSTM_COMBINED) == -1) {
+      // eng.traineddata not found.
+      GTEST_SKIP();
+    }
+    Tesseract &tess = api.tesseract();
+    if (!tess.HasDeferredTemplates()) {
+      // Not memory mapped: the templates are loaded at init.
+      GTEST_SKIP();
+    }
+    EXPECT_EQ(0, tess.fontinfo_table_.size());
+    // Reading the font table loads them.
+    EXPECT_LT(0, tess.get_fontinfo_table().size());
+    EXPECT_FALSE(tess.HasDeferredTemplates());
+  }
+  {
+    tesseract::TessBaseAPI api;
+    ASSERT_NE(-1, api.Init(TessdataPath().c_str(), "eng", tesseract::OEM_TESSERACT_ONLY));
+    Tesseract &tess = api.tesseract();
+    EXPECT_TRUE(tess.HasDeferredTemplates());
+    // So does the first classification.
+    Image src_pix = pixRead(TestDataNameToPath("HelloGoogle.tif").c_str());
+    CHECK(src_pix);
+    EXPECT_EQ("Hello Google", GetCleanedTextResult(&api, src_pix));
+    EXPECT_FALSE(tess.HasDeferredTemplates());
+    EXPECT_LT(0, tess.fontinfo_table_.size());
+    src_pix.destroy();
+  }
+}
+#endif // !DISABLED_LEGACY_ENGINE
+
+// Tests that a worker clone keeps working after the engine it was cloned
+// from is gone, as it owns a share of the LSTM weights.
+TEST_F(TesseractTest, CloneOutlivesSource) {
+  auto *api = new tesseract::TessBaseAPI();
+  if (api->Init(TessdataPath().c_str(), "eng", tesseract::OEM_LSTM_ONLY) == -1) {
+    // eng.traineddata not found.
+    delete api;
+    GTEST_SKIP();
+  }
+  Image src_pix = pixRead(TestDataNameToPath("HelloGoogle.tif").c_str());
+  CHECK(src_pix);
+  std::string expected = GetCleanedTextResult(api, src_pix);
+  std::unique_ptr<tesseract::TessBaseAPI> clone(api->CloneForWorker());
+  ASSERT_TRUE(clone != nullptr);
+  delete api;
+  EXPECT_EQ(expected, GetCleanedTextResult(clone.get(), src_pix));
+  src_pix.destroy();
+}
+
+// Tests that OCRing a document of several pages, a multi-page TIFF or a list
+// of image files, on several page workers gives exactly the same output as
+// OCRing its pages one after another.
+TEST_F(TesseractTest, PageWorkersMatchSerialOutput) {
+  const char *kPages[] = {"phototest.tif", "HelloGoogle.tif", "phototest.tif", "HelloGoogle.tif",
+                          "phototest.tif"};
+  std::string tiff_name = file::JoinPath(FLAGS_test_tmpdir, "pageworkers.tif");
+  std::string list_name = file::JoinPath(FLAGS_test_tmpdir, "pageworkers.txt");
+  std::string list;
+  const char *mode = "w";
+  for (auto page : kPages) {
+    Image pix = pixRead(TestDataNameToPath(page).c_str());
+    CHECK(pix);
+    CHECK_EQ(0, pixWriteTiff(tiff_name.c_str(), pix, IFF_TIFF_ZIP, mode));
+    pix.destroy();
+    mode = "a";
+    list += TestDataNameToPath(page) + "\n";
+  }
+  CHECK_OK(file::SetContents(list_name, list, file::Defaults()));
+
+  for (const auto &document : {tiff_name, list_name}) {
+    SCOPED_TRACE(document);
+    std::string outputs[2];
+    const int kWorkers[2] = {1, 3};
+    for (int i = 0; i < 2; ++i) {
+      tesseract::TessBaseAPI api;
+      if (api.Init(TessdataPath().c_str(), "eng", tesseract::OEM_LSTM_ONLY) == -1) {
+        // eng.traineddata not found.
+        GTEST_SKIP();
+      }
+      std::string output_base =
+          file::JoinPath(FLAGS_test_tmpdir, "pageworkers" + std::to_string(kWorkers[i]));
+      {
+        tesseract::TessTsvRenderer renderer(output_base.c_str());
+        EXPECT_TRUE(api.ProcessPages(document.c_str(), nullptr, 0, &renderer, kWorkers[i]));
+      }
+      CHECK_OK(file::GetContents(output_base + ".tsv", &outputs[i], file::Defaults()));
+    }
+    EXPECT_THAT(outputs[0], HasSubstr("Google"));
+    EXPECT_EQ(outputs[0], outputs[1]);
+  }
+}
+
 // Tests if two instances of Tesseract/LSTM can co-exist in the same thread.
 // NOTE: This is not an exhaustive test and current support for multiple
 // instances in Tesseract is fragile. This test is intended largely as a means
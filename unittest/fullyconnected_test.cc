@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////
+// File:        fullyconnected_test.cc
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include "fullyconnected.h"
+#include <vector>
+#include "helpers.h"
+#include "include_gunit.h"
+#include "networkio.h"
+#include "networkscratch.h"
+#include "taskscheduler.h"
+
+namespace tesseract {
+
+class FullyConnectedTest : public ::testing::Test {
+protected:
+  static const int kNumInputs = 37;
+  static const int kNumOutputs = 23;
+  // Not a multiple of the blocks of timesteps that Forward multiplies at
+  // once at inference.
+  static const int kWidth = 37;
+
+  void SetUp() override {
+    std::locale::global(std::locale(""));
+  }
+
+  // Runs a softmax layer of random weights on a random input of kWidth
+  // timesteps, first in training, which multiplies one timestep at a time,
+  // and then at inference, which multiplies blocks of timesteps, on the given
+  // scheduler. The outputs must be identical.
+  static void ExpectBlocksMatchTimeSteps(bool int_mode, const TaskScheduler &scheduler) {
+    TRand random;
+    FullyConnected layer("fc", kNumInputs, kNumOutputs, NT_SOFTMAX);
+    layer.InitWeights(1.0f, &random);
+    if (int_mode) {
+      layer.ConvertToInt();
+    }
+    NetworkIO input;
+    input.Resize2d(int_mode, kWidth, kNumInputs);
+    std::vector<TFloat> line(kNumInputs);
+    for (int t = 0; t < kWidth; ++t) {
+      for (auto &value : line) {
+        value = random.SignedRand(1.0);
+      }
+      input.WriteTimeStep(t, &line[0]);
+    }
+    NetworkScratch scratch;
+    scratch.set_scheduler(&scheduler);
+    NetworkIO per_timestep, blocked;
+    layer.Forward(false, input, nullptr, &scratch, &per_timestep);
+    layer.SetEnableTraining(TS_DISABLED);
+    layer.Forward(false, input, nullptr, &scratch, &blocked);
+    ASSERT_EQ(kWidth, blocked.Width());
+    ASSERT_EQ(per_timestep.NumFeatures(), blocked.NumFeatures());
+    for (int t = 0; t < kWidth; ++t) {
+      for (int i = 0; i < kNumOutputs; ++i) {
+        EXPECT_EQ(per_timestep.f(t)[i], blocked.f(t)[i]) << "t=" << t << " i=" << i;
+      }
+    }
+  }
+};
+
+TEST_F(FullyConnectedTest, FloatBlocksMatchTimeSteps) {
+  ExpectBlocksMatchTimeSteps(false, TaskScheduler(1));
+  ExpectBlocksMatchTimeSteps(false, TaskScheduler::Default());
+}
+
+// The int inputs are read in place, so the padding of each one overlaps the
+// next, but meets zero weights.
+TEST_F(FullyConnectedTest, IntBlocksMatchTimeSteps) {
+  ExpectBlocksMatchTimeSteps(true, TaskScheduler(1));
+  ExpectBlocksMatchTimeSteps(true, TaskScheduler::Default());
+}
+
+} // namespace tesseract
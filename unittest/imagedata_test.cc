@@ -87,6 +87,45 @@ TEST_F(ImagedataTest, CachesProperly) {
   }
 }
 
+TEST_F(ImagedataTest, ReadsIndexedDocs) {
+  // This test verifies that a document saved with an index, with and without
+  // compression, reads back the same pages in any order, both cached with
+  // limited memory and with ReadPages.
+  const int kNumPages = 12;
+  const int kMemoryAllowances[] = {2000000, 100000000, 0};
+  const int kPageReadOrder[] = {0, 1, 2, 3, 8, 4, 5, 6, 7, 11, 10, 9, -1};
+  std::vector<std::string> page_texts;
+  std::string filename = MakeFakeDoc(kNumPages, 0, &page_texts);
+  DocumentData plain_doc("My document");
+  EXPECT_TRUE(plain_doc.LoadDocument(filename.c_str(), 0, 0, nullptr));
+  for (bool compress : {false, true}) {
+    std::string indexed_name = file::JoinPath(FLAGS_test_tmpdir, "indexed.lstmf");
+    EXPECT_TRUE(plain_doc.SaveIndexedDocument(indexed_name.c_str(), compress, nullptr));
+    for (int m = 0; kMemoryAllowances[m] > 0; ++m) {
+      DocumentData read_doc("My document");
+      EXPECT_TRUE(read_doc.LoadDocument(indexed_name.c_str(), 0, kMemoryAllowances[m], nullptr));
+      EXPECT_EQ(kNumPages, read_doc.NumPages());
+      for (int p = 0; kPageReadOrder[p] >= 0; ++p) {
+        int page = kPageReadOrder[p];
+        const ImageData *imagedata = read_doc.GetPage(page);
+        ASSERT_NE(nullptr, imagedata);
+        EXPECT_STREQ(page_texts[page].c_str(), imagedata->transcription().c_str());
+      }
+    }
+    DocumentData read_doc("My document");
+    EXPECT_TRUE(read_doc.LoadDocument(indexed_name.c_str(), 0, 1, nullptr));
+    std::vector<std::unique_ptr<ImageData>> pages;
+    int total_pages = 0;
+    EXPECT_TRUE(read_doc.ReadPages(kNumPages + 7, 3, &pages, &total_pages));
+    EXPECT_EQ(kNumPages, total_pages);
+    ASSERT_EQ(3u, pages.size());
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_NE(nullptr, pages[i]);
+      EXPECT_STREQ(page_texts[7 + i].c_str(), pages[i]->transcription().c_str());
+    }
+  }
+}
+
 TEST_F(ImagedataTest, CachesMultiDocs) {
   // This test verifies that DocumentCache works to store multiple DocumentData
   // and the two caching strategies read images in the right order.
@@ -121,4 +160,36 @@ TEST_F(ImagedataTest, CachesMultiDocs) {
   }
 }
 
+TEST_F(ImagedataTest, PrefetchesMultiDocs) {
+  // This test verifies that a DocumentCache that prefetches its pages returns
+  // the same pages in the same order as one that doesn't, with both caching
+  // strategies, and also when it has to drop pages to stay within memory.
+  const std::vector<int> kNumPages = {6, 5, 7};
+  std::vector<std::string> filenames;
+  for (size_t d = 0; d < kNumPages.size(); ++d) {
+    std::vector<std::string> page_texts;
+    filenames.push_back(MakeFakeDoc(kNumPages[d], d, &page_texts));
+  }
+  for (auto strategy : {tesseract::CS_ROUND_ROBIN, tesseract::CS_SEQUENTIAL}) {
+    for (int64_t max_memory : {8000000, 1000000}) {
+      DocumentCache plain_cache(8000000);
+      plain_cache.LoadDocuments(filenames, strategy, nullptr);
+      DocumentCache prefetch_cache(max_memory);
+      prefetch_cache.LoadDocuments(filenames, strategy, nullptr);
+      prefetch_cache.StartPrefetch(2, 4);
+      for (int p = 0; p <= 40; ++p) {
+        const ImageData *plain_data = plain_cache.GetPageBySerial(p);
+        const ImageData *prefetch_data = prefetch_cache.GetPageBySerial(p);
+        CHECK(plain_data != nullptr);
+        CHECK(prefetch_data != nullptr);
+        EXPECT_STREQ(plain_data->transcription().c_str(), prefetch_data->transcription().c_str())
+            << "p=" << p;
+      }
+      PrefetchStats stats = prefetch_cache.GetPrefetchStats();
+      EXPECT_EQ(41, stats.hits + stats.stalls);
+      EXPECT_GT(stats.pages_loaded, 0);
+    }
+  }
+}
+
 } // namespace tesseract
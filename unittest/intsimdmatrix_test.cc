@@ -99,6 +99,44 @@ protected:
 #endif
   }
 
+  // Tests matrixDotVectorsFunction on an odd number of vectors, packed
+  // without padding except after the last one, against the generic version of
+  // MatrixDotVector for each vector.
+  void ExpectEqualMultiResults(const IntSimdMatrix &matrix) {
+    const int kNumVectors = 7;
+    for (int num_out : {1, 8, 23, 48, 96, 111}) {
+      for (int num_in : {1, 9, 48, 97}) {
+        GENERIC_2D_ARRAY<int8_t> w = InitRandom(num_out, num_in + 1);
+        std::vector<int8_t> u(kNumVectors * num_in + matrix.RoundInputs(num_in), 0);
+        for (int i = 0; i < kNumVectors * num_in; ++i) {
+          u[i] = static_cast<int8_t>(random_.SignedRand(INT8_MAX));
+        }
+        std::vector<TFloat> scales = RandomScales(num_out);
+        std::vector<int8_t> shaped_wi;
+        int32_t rounded_num_out;
+        matrix.Init(w, shaped_wi, rounded_num_out);
+        scales.resize(rounded_num_out);
+        std::vector<TFloat> test_result(kNumVectors * rounded_num_out);
+        if (matrix.matrixDotVectorsFunction) {
+          matrix.matrixDotVectorsFunction(w.dim1(), w.dim2(), &shaped_wi[0], &scales[0],
+                                          kNumVectors, &u[0], num_in, &test_result[0],
+                                          rounded_num_out);
+        } else {
+          IntSimdMatrix::MatrixDotVectors(w, scales, kNumVectors, &u[0], num_in, &test_result[0],
+                                          rounded_num_out);
+        }
+        std::vector<TFloat> base_result(num_out);
+        for (int k = 0; k < kNumVectors; ++k) {
+          IntSimdMatrix::MatrixDotVector(w, scales, &u[k * num_in], base_result.data());
+          for (int i = 0; i < num_out; ++i) {
+            EXPECT_FLOAT_EQ(base_result[i], test_result[k * rounded_num_out + i])
+                << "num_out=" << num_out << " num_in=" << num_in << " k=" << k << " i=" << i;
+          }
+        }
+      }
+    }
+  }
+
   TRand random_;
 };
 
@@ -108,6 +146,12 @@ TEST_F(IntSimdMatrixTest, C) {
   ExpectEqualResults(matrix);
 }
 
+// Test the C++ implementation of several vectors at once.
+TEST_F(IntSimdMatrixTest, CMultiVector) {
+  static const IntSimdMatrix matrix = {nullptr, 1, 1, 1, 1};
+  ExpectEqualMultiResults(matrix);
+}
+
 // Tests that the SSE implementation gets the same result as the vanilla.
 TEST_F(IntSimdMatrixTest, SSE) {
   if (!SIMDDetect::IsSSEAvailable()) {
@@ -126,6 +170,16 @@ TEST_F(IntSimdMatrixTest, AVX2) {
   ExpectEqualResults(*IntSimdMatrix::intSimdMatrixAVX2);
 }
 
+// Tests that the AVX2 implementation of several vectors at once gets the same
+// result as the vanilla.
+TEST_F(IntSimdMatrixTest, AVX2MultiVector) {
+  if (!SIMDDetect::IsAVX2Available()) {
+    GTEST_LOG_(INFO) << "No AVX2 found! Not tested!";
+    GTEST_SKIP();
+  }
+  ExpectEqualMultiResults(*IntSimdMatrix::intSimdMatrixAVX2);
+}
+
 // Tests that the AVX512VNNI implementation gets the same result as the vanilla.
 TEST_F(IntSimdMatrixTest, AVX512VNNI) {
 #if defined(HAVE_AVX512VNNI)
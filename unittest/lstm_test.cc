@@ -21,10 +21,38 @@
 // --fontlist "Arial" --maxpages 10
 //
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "fullyconnected.h"
 #include "lstm_test.h"
 
 namespace tesseract {
 
+// Returns a copy of the weights of the output layer of trainer.
+static std::vector<TFloat> OutputWeights(const LSTMTrainer &trainer) {
+  std::vector<std::string> layers = trainer.EnumerateLayers();
+  auto *output = static_cast<const FullyConnected *>(trainer.GetLayer(layers.back()));
+  const WeightMatrix &weights = output->weights();
+  std::vector<TFloat> values;
+  for (int i = 0; i < weights.NumOutputs(); ++i) {
+    const TFloat *row = weights.GetWeights(i);
+    values.insert(values.end(), row, row + weights.NumInputs() + 1);
+  }
+  return values;
+}
+
+// Returns the largest absolute difference between a weight in before and the
+// same one in after.
+static TFloat MaxWeightChange(const std::vector<TFloat> &before,
+                              const std::vector<TFloat> &after) {
+  TFloat max_change = 0;
+  for (size_t i = 0; i < before.size(); ++i) {
+    max_change = std::max(max_change, std::abs(after[i] - before[i]));
+  }
+  return max_change;
+}
+
 // Tests that some simple networks can learn Arial and meet accuracy targets.
 TEST_F(LSTMTrainerTest, BasicTest) {
   // A Convolver sliding window classifier without LSTM.
@@ -139,6 +167,52 @@ TEST_F(LSTMTrainerTest, DeterminismTest) {
   LOG(INFO) << "********** *** ************\n";
 }
 
+// Tests that training on batches of a single line through TrainOnBatch gets
+// the same results as training on the lines one at a time.
+TEST_F(LSTMTrainerTest, BatchOfOneMatchesTrainOnLine) {
+  const char kSpec[] = "[1,32,0,1 S4,2 L2xy16 Ct1,1,16 S8,1 Lbx100 O1c1]";
+  const int kSamples = 20;
+  SetupTrainerEng(kSpec, "2-D-2-layer-lstm", false, false);
+  for (int s = 0; s < kSamples; ++s) {
+    trainer_->TrainOnLine(trainer_.get(), false);
+  }
+  int iteration_a = trainer_->training_iteration();
+  double act_error_a = trainer_->ActivationError();
+  double char_error_a = trainer_->CharError();
+  SetupTrainerEng(kSpec, "2-D-2-layer-lstm", false, false);
+  for (int s = 0; s < kSamples; ++s) {
+    trainer_->TrainOnBatch(trainer_.get(), 1, 2);
+  }
+  EXPECT_EQ(iteration_a, trainer_->training_iteration());
+  EXPECT_FLOAT_EQ(act_error_a, trainer_->ActivationError());
+  EXPECT_FLOAT_EQ(char_error_a, trainer_->CharError());
+}
+
+// Tests that with Adam, the first Update moves a weight by at most about the
+// learning rate, and the most changed by about that much, whether it applies
+// the deltas of a single sample or the sum of those of several samples, as
+// TrainOnLines and TrainOnBatch do. The first lines of the training data are
+// of similar width, so TrainOnBatch puts them in a single mini-batch.
+TEST_F(LSTMTrainerTest, AdamStepDoesNotDependOnSamplesPerUpdate) {
+  const char kSpec[] = "[1,32,0,1 S4,2 L2xy16 Ct1,1,16 S8,1 Lbx100 O1c1]";
+  const int kSamples = 4;
+  for (int mode = 0; mode < 3; ++mode) {
+    SetupTrainerEng(kSpec, "2-D-2-layer-lstm", false, true);
+    std::vector<TFloat> before = OutputWeights(*trainer_);
+    if (mode == 0) {
+      trainer_->TrainOnLine(trainer_.get(), false);
+    } else if (mode == 1) {
+      trainer_->TrainOnLines(trainer_.get(), kSamples);
+    } else {
+      trainer_->TrainOnBatch(trainer_.get(), kSamples, kSamples);
+    }
+    float learning_rate = trainer_->learning_rate();
+    EXPECT_NEAR(learning_rate, MaxWeightChange(before, OutputWeights(*trainer_)),
+                learning_rate * 1e-3)
+        << "mode=" << mode;
+  }
+}
+
 // The baseline network against which to test the built-in softmax.
 TEST_F(LSTMTrainerTest, SoftmaxBaselineTest) {
   // A basic single-layer, single direction LSTM.
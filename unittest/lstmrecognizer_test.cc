@@ -0,0 +1,290 @@
+///////////////////////////////////////////////////////////////////////
+// File:        lstmrecognizer_test.cc
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include "lstmrecognizer.h"
+#include <leptonica/allheaders.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "imagedata.h"
+#include "include_gunit.h"
+#include "networkio.h"
+#include "tessdatamanager.h"
+
+#include "testdata.h"
+
+namespace tesseract {
+
+// Gives the tests access to the internals of LSTMRecognizer.
+class TestableLSTMRecognizer : public LSTMRecognizer {
+public:
+  TestableLSTMRecognizer() : LSTMRecognizer(nullptr) {}
+
+  using LSTMRecognizer::EstimatePolarity;
+  using LSTMRecognizer::ForwardBothPolarities;
+  using LSTMRecognizer::LinePolarity;
+
+  size_t NumPrecomputedLines() const {
+    return precomputed_lines_.size();
+  }
+
+  // Height of the line images that the network takes.
+  int InputHeight() const {
+    int height = network_->InputShape().height();
+    return height > 0 ? height : 48;
+  }
+};
+
+class LSTMRecognizerTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::locale::global(std::locale(""));
+  }
+
+  // Loads the eng model into recognizer. Returns false if it is not there.
+  static bool LoadEng(LSTMRecognizer *recognizer) {
+    std::string traineddata = file::JoinPath(TESSDATA_DIR, "eng.traineddata");
+    TessdataManager mgr;
+    return mgr.Init(traineddata.c_str()) && recognizer->Load(ParamsVectorSet(), "", &mgr);
+  }
+
+  // Makes an 8 bit line image of the given levels, with vertical dark
+  // strokes that cover dark_fraction of its width.
+  static Image MakeLine(int width, int height, double dark_fraction, int dark, int light) {
+    const int kPeriod = 10;
+    const int dark_width = static_cast<int>(dark_fraction * kPeriod + 0.5);
+    Image pix = pixCreate(width, height, 8);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        pixSetPixel(pix, x, y, x % kPeriod < dark_width ? dark : light);
+      }
+    }
+    return pix;
+  }
+
+  // Returns the text line of HelloGoogle.tif as the network takes it.
+  static Image HelloLine(const TestableLSTMRecognizer &recognizer) {
+    Image src = pixRead(file::JoinPath(TESTING_DIR, "HelloGoogle.tif").c_str());
+    CHECK(src);
+    Image grey = pixConvertTo8(src, false);
+    src.destroy();
+    float scale = static_cast<float>(recognizer.InputHeight()) / pixGetHeight(grey);
+    Image line = pixScale(grey, scale, scale);
+    grey.destroy();
+    return line;
+  }
+
+  static void ExpectEqualOutputs(NetworkIO &a, NetworkIO &b) {
+    ASSERT_EQ(a.Width(), b.Width());
+    ASSERT_EQ(a.NumFeatures(), b.NumFeatures());
+    for (int t = 0; t < a.Width(); ++t) {
+      for (int i = 0; i < a.NumFeatures(); ++i) {
+        EXPECT_EQ(a.f(t)[i], b.f(t)[i]) << "t=" << t << " i=" << i;
+      }
+    }
+  }
+};
+
+TEST_F(LSTMRecognizerTest, EstimatePolarity) {
+  TestableLSTMRecognizer recognizer;
+  recognizer.SetInvertOptions(0.2f, false);
+  using LinePolarity = TestableLSTMRecognizer::LinePolarity;
+
+  Image normal = MakeLine(200, 36, 0.2, 0, 255);
+  EXPECT_EQ(LinePolarity::kNormal, recognizer.EstimatePolarity(normal));
+  Image inverted = pixInvert(nullptr, normal);
+  EXPECT_EQ(LinePolarity::kInverted, recognizer.EstimatePolarity(inverted));
+  // As much dark as light.
+  Image ambiguous = MakeLine(200, 36, 0.5, 0, 255);
+  EXPECT_EQ(LinePolarity::kUnknown, recognizer.EstimatePolarity(ambiguous));
+  // Too little contrast to tell.
+  Image faint = MakeLine(200, 36, 0.2, 120, 150);
+  EXPECT_EQ(LinePolarity::kUnknown, recognizer.EstimatePolarity(faint));
+
+  // A margin of 1/2 turns the estimate off.
+  recognizer.SetInvertOptions(0.5f, false);
+  EXPECT_EQ(LinePolarity::kUnknown, recognizer.EstimatePolarity(normal));
+  EXPECT_EQ(LinePolarity::kUnknown, recognizer.EstimatePolarity(inverted));
+  // So does the default margin of 0.
+  recognizer.SetInvertOptions(0.0f, false);
+  EXPECT_EQ(LinePolarity::kUnknown, recognizer.EstimatePolarity(normal));
+  EXPECT_EQ(LinePolarity::kUnknown, recognizer.EstimatePolarity(inverted));
+
+  normal.destroy();
+  inverted.destroy();
+  ambiguous.destroy();
+  faint.destroy();
+}
+
+// ForwardBothPolarities must keep the better of the line and its inverse,
+// whichever of the two it is given.
+TEST_F(LSTMRecognizerTest, ForwardBothPolarities) {
+  TestableLSTMRecognizer recognizer;
+  if (!LoadEng(&recognizer)) {
+    // eng.traineddata not found.
+    GTEST_SKIP();
+  }
+  Image normal = HelloLine(recognizer);
+  Image inverted = pixInvert(nullptr, normal);
+  Image ambiguous = MakeLine(pixGetWidth(normal), pixGetHeight(normal), 0.5, 0, 255);
+  const TBOX line_box(0, 0, pixGetWidth(normal), pixGetHeight(normal));
+
+  NetworkIO inputs, outputs, inv_inputs, inv_outputs;
+  ASSERT_TRUE(recognizer.ForwardBothPolarities(normal, line_box, 1.0f, &inputs, &outputs));
+  ASSERT_TRUE(
+      recognizer.ForwardBothPolarities(inverted, line_box, 1.0f, &inv_inputs, &inv_outputs));
+  EXPECT_GT(outputs.Width(), 0);
+  ExpectEqualOutputs(outputs, inv_outputs);
+
+  NetworkIO amb_inputs, amb_outputs;
+  EXPECT_TRUE(
+      recognizer.ForwardBothPolarities(ambiguous, line_box, 1.0f, &amb_inputs, &amb_outputs));
+  EXPECT_GT(amb_outputs.Width(), 0);
+
+  normal.destroy();
+  inverted.destroy();
+  ambiguous.destroy();
+}
+
+// At inference the LSTM gate weights are held only as their input and
+// recurrent parts, which must join back to the same model when serialized.
+TEST_F(LSTMRecognizerTest, SplitWeightsSerialize) {
+  std::string traineddata = file::JoinPath(TESSDATA_DIR, "eng.traineddata");
+  TessdataManager mgr;
+  TestableLSTMRecognizer recognizer;
+  if (!mgr.Init(traineddata.c_str()) || !recognizer.Load(ParamsVectorSet(), "", &mgr)) {
+    // eng.traineddata not found.
+    GTEST_SKIP();
+  }
+  std::vector<char> data;
+  TFile fp;
+  fp.OpenWrite(&data);
+  ASSERT_TRUE(recognizer.Serialize(&mgr, &fp));
+
+  TestableLSTMRecognizer reloaded;
+  TFile in;
+  ASSERT_TRUE(in.Open(&data[0], data.size()));
+  ASSERT_TRUE(reloaded.DeSerialize(&mgr, &in));
+  std::vector<char> reloaded_data;
+  TFile out;
+  out.OpenWrite(&reloaded_data);
+  ASSERT_TRUE(reloaded.Serialize(&mgr, &out));
+  EXPECT_EQ(data, reloaded_data);
+
+  Image line = HelloLine(recognizer);
+  const TBOX line_box(0, 0, pixGetWidth(line), pixGetHeight(line));
+  NetworkIO inputs, outputs, reloaded_inputs, reloaded_outputs;
+  ASSERT_TRUE(recognizer.ForwardBothPolarities(line, line_box, 1.0f, &inputs, &outputs));
+  ASSERT_TRUE(reloaded.ForwardBothPolarities(line, line_box, 1.0f, &reloaded_inputs,
+                                             &reloaded_outputs));
+  ExpectEqualOutputs(outputs, reloaded_outputs);
+  line.destroy();
+}
+
+// Recognizers that share the model of another are copied from it without its
+// weights, which they refer to, and keep working after it is gone.
+TEST_F(LSTMRecognizerTest, SharedModelOutlivesSource) {
+  auto source = std::make_unique<TestableLSTMRecognizer>();
+  if (!LoadEng(source.get())) {
+    // eng.traineddata not found.
+    GTEST_SKIP();
+  }
+  Image line = HelloLine(*source);
+  const TBOX line_box(0, 0, pixGetWidth(line), pixGetHeight(line));
+  NetworkIO inputs, outputs;
+  ASSERT_TRUE(source->ForwardBothPolarities(line, line_box, 1.0f, &inputs, &outputs));
+  std::vector<char> source_data;
+  TFile source_fp;
+  source_fp.OpenWrite(&source_data);
+  ASSERT_TRUE(source->Serialize(nullptr, &source_fp));
+
+  // The first twin makes the shared model, the others copy it, including a
+  // twin of a twin.
+  TestableLSTMRecognizer first, second, third;
+  ASSERT_TRUE(first.ShareModelFrom(*source));
+  ASSERT_TRUE(second.ShareModelFrom(*source));
+  ASSERT_TRUE(third.ShareModelFrom(first));
+  // A twin serializes with references in place of the weights.
+  std::vector<char> twin_data;
+  TFile twin_fp;
+  twin_fp.OpenWrite(&twin_data);
+  ASSERT_TRUE(third.Serialize(nullptr, &twin_fp));
+  EXPECT_LT(twin_data.size() * 10, source_data.size());
+
+  source.reset();
+  for (auto *twin : {&first, &second, &third}) {
+    NetworkIO twin_inputs, twin_outputs;
+    ASSERT_TRUE(twin->ForwardBothPolarities(line, line_box, 1.0f, &twin_inputs, &twin_outputs));
+    ExpectEqualOutputs(outputs, twin_outputs);
+  }
+  line.destroy();
+}
+
+// Lines run in a batch by ForwardLines must be recognized exactly as if
+// RecognizeLine had run them one at a time. The padding of the narrower lines
+// up to the widest of the batch is left zero, and isn't read by the network.
+TEST_F(LSTMRecognizerTest, BatchedLinesMatchSingleOnes) {
+  TestableLSTMRecognizer recognizer;
+  if (!LoadEng(&recognizer)) {
+    // eng.traineddata not found.
+    GTEST_SKIP();
+  }
+  const float kInvertThreshold = 0.7f;
+  Image line = HelloLine(recognizer);
+  const int width = pixGetWidth(line);
+  const int height = pixGetHeight(line);
+  // Lines of different widths, to be padded to the widest of the batch.
+  std::vector<TBOX> boxes = {TBOX(0, 0, width, height), TBOX(0, 0, width * 2 / 3, height),
+                             TBOX(width / 3, 0, width, height)};
+  std::vector<ImageData *> images;
+  for (const auto &box : boxes) {
+    Box *clip = boxCreate(box.left(), 0, box.width(), box.height());
+    images.push_back(new ImageData(false, pixClipRectangle(line, clip, nullptr)));
+    boxDestroy(&clip);
+  }
+  line.destroy();
+
+  std::vector<std::vector<int>> single_labels;
+  std::vector<NetworkIO> single_outputs(images.size());
+  for (size_t i = 0; i < images.size(); ++i) {
+    float scale_factor;
+    NetworkIO inputs;
+    ASSERT_TRUE(recognizer.RecognizeLine(*images[i], kInvertThreshold, false, false, boxes[i],
+                                         &scale_factor, &inputs, &single_outputs[i]));
+    std::vector<int> labels, coords;
+    recognizer.LabelsFromOutputs(single_outputs[i], &labels, &coords);
+    single_labels.push_back(labels);
+  }
+
+  std::vector<const ImageData *> const_images(images.begin(), images.end());
+  recognizer.ForwardLines(const_images, boxes, kInvertThreshold, 16);
+  EXPECT_EQ(images.size(), recognizer.NumPrecomputedLines());
+  // In the reverse order, so that the lookup doesn't just take the first.
+  for (size_t i = images.size(); i-- > 0;) {
+    float scale_factor;
+    NetworkIO inputs, outputs;
+    ASSERT_TRUE(recognizer.RecognizeLine(*images[i], kInvertThreshold, false, false, boxes[i],
+                                         &scale_factor, &inputs, &outputs));
+    EXPECT_EQ(i, recognizer.NumPrecomputedLines());
+    std::vector<int> labels, coords;
+    recognizer.LabelsFromOutputs(outputs, &labels, &coords);
+    EXPECT_EQ(single_labels[i], labels) << "line " << i;
+    ExpectEqualOutputs(single_outputs[i], outputs);
+  }
+  for (auto image : images) {
+    delete image;
+  }
+}
+
+} // namespace tesseract
@@ -10,6 +10,8 @@
 // limitations under the License.
 
 #include "networkio.h"
+#include <utility>
+#include <vector>
 #include "include_gunit.h"
 #include "stridemap.h"
 #ifdef INCLUDE_TENSORFLOW
@@ -101,6 +103,47 @@ TEST_F(NetworkioTest, InitWithZeroFill) {
 #endif
 }
 
+// Tests that the elements of a batch of different sizes, copied out with
+// CopyBatchElement and written back with WriteBatchElement, end up where they
+// came from, in both float and int mode.
+TEST_F(NetworkioTest, BatchElementRoundTrip) {
+  const int kNumFeatures = 3;
+  const std::vector<std::pair<int, int>> kSizes = {{2, 5}, {3, 3}, {1, 7}};
+  StrideMap stride_map;
+  stride_map.SetStride(kSizes);
+  for (bool int_mode : {false, true}) {
+    NetworkIO src, dest;
+    src.ResizeToMap(int_mode, stride_map, kNumFeatures);
+    dest.ResizeToMap(int_mode, stride_map, kNumFeatures);
+    src.Zero();
+    dest.Zero();
+    // Distinct values at every valid position.
+    std::vector<TFloat> values(kNumFeatures);
+    StrideMap::Index index(stride_map);
+    int pos = 0;
+    do {
+      for (int f = 0; f < kNumFeatures; ++f, ++pos) {
+        values[f] = (pos % 100) / 100.0;
+      }
+      src.WriteTimeStep(index.t(), values.data());
+    } while (index.Increment());
+    for (int b = 0; b < static_cast<int>(kSizes.size()); ++b) {
+      NetworkIO element;
+      element.CopyBatchElement(src, b);
+      EXPECT_EQ(kSizes[b].first * kSizes[b].second, element.Width());
+      EXPECT_EQ(int_mode, element.int_mode());
+      dest.WriteBatchElement(b, element);
+    }
+    std::vector<TFloat> src_values(kNumFeatures), dest_values(kNumFeatures);
+    StrideMap::Index check_index(stride_map);
+    do {
+      src.ReadTimeStep(check_index.t(), src_values.data());
+      dest.ReadTimeStep(check_index.t(), dest_values.data());
+      EXPECT_EQ(src_values, dest_values) << "t=" << check_index.t() << " int=" << int_mode;
+    } while (check_index.Increment());
+  }
+}
+
 // Tests that CopyWithYReversal works.
 TEST_F(NetworkioTest, CopyWithYReversal) {
 #ifdef INCLUDE_TENSORFLOW
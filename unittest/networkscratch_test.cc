@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////
+// File:        networkscratch_test.cc
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include "networkscratch.h"
+#include <memory>
+#include "include_gunit.h"
+#include "taskscheduler.h"
+
+namespace tesseract {
+
+class NetworkScratchTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::locale::global(std::locale(""));
+  }
+  void TearDown() override {
+    TaskScheduler::SetProcessThreadBudget(0);
+  }
+
+  // Borrows a buffer from scratch on every thread of a loop of kThreads.
+  static void BorrowOnAllThreads(NetworkScratch *scratch) {
+    TaskScheduler().ParallelFor(kThreads, [scratch](int, int start, int end) {
+      for (int i = start; i < end; ++i) {
+        NetworkScratch::FloatVec vec(1000, scratch);
+        vec[0] = 1;
+      }
+    });
+  }
+
+  static const int kThreads = 3;
+};
+
+// Each restart of the worker pool replaces its threads. The arenas of the
+// threads that exit must be reused by the new ones rather than pile up.
+TEST_F(NetworkScratchTest, ArenasBoundedAcrossRestarts) {
+  NetworkScratch scratch;
+  for (int restart = 0; restart < 10; ++restart) {
+    TaskScheduler::SetProcessThreadBudget(kThreads);
+    BorrowOnAllThreads(&scratch);
+    EXPECT_LE(scratch.NumArenas(), static_cast<size_t>(kThreads)) << "restart " << restart;
+  }
+  EXPECT_GT(scratch.NumArenas(), 0u);
+  // The arenas of the exited workers have given back their memory.
+  TaskScheduler::SetProcessThreadBudget(kThreads);
+  EXPECT_LE(scratch.MemoryUsage(), 1000 * sizeof(TFloat));
+}
+
+// A thread may outlive the scratch spaces it has used.
+TEST_F(NetworkScratchTest, ThreadsOutliveScratch) {
+  TaskScheduler::SetProcessThreadBudget(kThreads);
+  for (int i = 0; i < 10; ++i) {
+    auto scratch = std::make_unique<NetworkScratch>();
+    BorrowOnAllThreads(scratch.get());
+    EXPECT_LE(scratch->NumArenas(), static_cast<size_t>(kThreads));
+  }
+  // The workers exit after the scratch spaces are gone.
+  TaskScheduler::SetProcessThreadBudget(kThreads);
+  auto scratch = std::make_unique<NetworkScratch>();
+  BorrowOnAllThreads(scratch.get());
+  EXPECT_LE(scratch->NumArenas(), static_cast<size_t>(kThreads));
+}
+
+} // namespace tesseract
@@ -0,0 +1,164 @@
+///////////////////////////////////////////////////////////////////////
+// File:        optimizeforinference_test.cc
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include <memory>
+#include <vector>
+#include "fullyconnected.h"
+#include "helpers.h"
+#include "include_gunit.h"
+#include "input.h"
+#include "lstm.h"
+#include "networkio.h"
+#include "networkscratch.h"
+#include "reversed.h"
+#include "serialis.h"
+#include "series.h"
+#include "stridemap.h"
+
+namespace tesseract {
+
+class OptimizeForInferenceTest : public ::testing::Test {
+protected:
+  static const int kNumInputs = 11;
+  static const int kNumStates = 9;
+  static const int kNumOutputs = 7;
+
+  void SetUp() override {
+    std::locale::global(std::locale(""));
+  }
+
+  // Gives the network random weights and returns two copies of it, as loaded
+  // for recognition, which splits the LSTM weights. The first is left as it
+  // is, and the second is optimized for inference.
+  static void MakeCopies(Network *network, bool int_mode, std::unique_ptr<Network> *plain,
+                         std::unique_ptr<Network> *optimized) {
+    TRand random;
+    network->InitWeights(1.0f, &random);
+    network->SetEnableTraining(TS_DISABLED);
+    if (int_mode) {
+      network->ConvertToInt();
+    }
+    std::vector<char> data;
+    TFile out;
+    out.OpenWrite(&data);
+    ASSERT_TRUE(network->Serialize(&out));
+    TFile in;
+    ASSERT_TRUE(in.Open(&data[0], data.size()));
+    plain->reset(Network::CreateFromFile(&in));
+    ASSERT_TRUE(*plain != nullptr);
+    ASSERT_TRUE(in.Open(&data[0], data.size()));
+    optimized->reset(Network::CreateFromFile(&in));
+    ASSERT_TRUE(*optimized != nullptr);
+    (*optimized)->OptimizeForInference(true);
+  }
+
+  // Runs both copies of the network on a random batch of two lines of
+  // different widths, and expects exactly the same outputs.
+  static void ExpectSameOutputs(Network *network, bool int_mode) {
+    std::unique_ptr<Network> plain, optimized;
+    MakeCopies(network, int_mode, &plain, &optimized);
+    if (HasFailure()) {
+      return;
+    }
+    TRand random;
+    StrideMap stride_map;
+    stride_map.SetStride({{1, 23}, {1, 17}});
+    NetworkIO input;
+    input.ResizeToMap(int_mode, stride_map, kNumInputs);
+    std::vector<TFloat> line(kNumInputs);
+    StrideMap::Index index(stride_map);
+    do {
+      for (auto &value : line) {
+        value = random.SignedRand(1.0);
+      }
+      input.WriteTimeStep(index.t(), &line[0]);
+    } while (index.Increment());
+    NetworkScratch scratch;
+    NetworkIO plain_output, optimized_output;
+    plain->Forward(false, input, nullptr, &scratch, &plain_output);
+    optimized->Forward(false, input, nullptr, &scratch, &optimized_output);
+    ASSERT_EQ(plain_output.Width(), optimized_output.Width());
+    ASSERT_EQ(plain_output.NumFeatures(), optimized_output.NumFeatures());
+    int num_features = plain_output.NumFeatures();
+    std::vector<TFloat> plain_line(num_features), optimized_line(num_features);
+    StrideMap::Index out_index(plain_output.stride_map());
+    do {
+      int t = out_index.t();
+      plain_output.ReadTimeStep(t, &plain_line[0]);
+      optimized_output.ReadTimeStep(t, &optimized_line[0]);
+      for (int i = 0; i < num_features; ++i) {
+        EXPECT_EQ(plain_line[i], optimized_line[i]) << "t=" << t << " i=" << i;
+      }
+    } while (out_index.Increment());
+  }
+
+  // Makes an x-reversed LSTM, which the optimized network runs backwards in
+  // place of reversing its input and output.
+  static Network *MakeReversedLSTM() {
+    auto *reversed = new Reversed("RevLSTM", NT_XREVERSED);
+    reversed->SetNetwork(
+        new LSTM("LSTM", kNumInputs, kNumStates, kNumStates, false, NT_LSTM));
+    return reversed;
+  }
+
+  // Makes a series that starts with an Input layer, whose copy the optimized
+  // network skips.
+  static Network *MakeSeriesWithInput() {
+    auto *series = new Series("Series");
+    series->AddToStack(new Input("Input", kNumInputs, kNumInputs));
+    series->AddToStack(new LSTM("LSTM", kNumInputs, kNumStates, kNumStates, false, NT_LSTM));
+    series->AddToStack(new FullyConnected("Output", kNumStates, kNumOutputs, NT_SOFTMAX));
+    return series;
+  }
+
+  // Makes an x-reversed layer that isn't an LSTM, so the optimized network
+  // still reverses its input and output.
+  static Network *MakeReversedFullyConnected() {
+    auto *reversed = new Reversed("RevFC", NT_XREVERSED);
+    reversed->SetNetwork(new FullyConnected("FC", kNumInputs, kNumOutputs, NT_TANH));
+    return reversed;
+  }
+};
+
+TEST_F(OptimizeForInferenceTest, ReversedLSTM) {
+  std::unique_ptr<Network> network(MakeReversedLSTM());
+  ExpectSameOutputs(network.get(), false);
+}
+
+TEST_F(OptimizeForInferenceTest, IntReversedLSTM) {
+  std::unique_ptr<Network> network(MakeReversedLSTM());
+  ExpectSameOutputs(network.get(), true);
+}
+
+TEST_F(OptimizeForInferenceTest, SeriesWithInput) {
+  std::unique_ptr<Network> network(MakeSeriesWithInput());
+  ExpectSameOutputs(network.get(), false);
+}
+
+TEST_F(OptimizeForInferenceTest, IntSeriesWithInput) {
+  std::unique_ptr<Network> network(MakeSeriesWithInput());
+  ExpectSameOutputs(network.get(), true);
+}
+
+TEST_F(OptimizeForInferenceTest, ReversedWithoutLSTM) {
+  std::unique_ptr<Network> network(MakeReversedFullyConnected());
+  ExpectSameOutputs(network.get(), false);
+}
+
+TEST_F(OptimizeForInferenceTest, IntReversedWithoutLSTM) {
+  std::unique_ptr<Network> network(MakeReversedFullyConnected());
+  ExpectSameOutputs(network.get(), true);
+}
+
+} // namespace tesseract
@@ -12,7 +12,9 @@
 #include "include_gunit.h"
 #include "log.h" // for LOG
 
+#include "lstmrecognizer.h"
 #include "matrix.h"
+#include "networkio.h"
 #include "normstrngs.h"
 #include "pageres.h"
 #include "ratngs.h"
@@ -106,6 +108,37 @@ protected:
     lstm_dict_.FinishLoad();
   }
 
+  // Loads the unicharset, recoder and dictionary of the LSTM model of the
+  // given language from TESSDATA_DIR. Returns false if they are not there.
+  bool LoadLSTMModel(const std::string &lang) {
+    std::string traineddata_file = file::JoinPath(TESSDATA_DIR, lang + ".traineddata");
+    tesseract::TessdataManager mgr;
+    TFile fp;
+    if (!mgr.Init(traineddata_file.c_str()) ||
+        !mgr.GetComponent(TESSDATA_LSTM_UNICHARSET, &fp) ||
+        !ccutil_.unicharset.load_from_file(&fp, false) ||
+        !mgr.GetComponent(TESSDATA_LSTM_RECODER, &fp) || !recoder_.DeSerialize(&fp)) {
+      return false;
+    }
+    unichar_null_char_ =
+        ccutil_.unicharset.has_special_codes() ? UNICHAR_BROKEN : ccutil_.unicharset.size();
+    RecodedCharID code;
+    recoder_.EncodeUnichar(unichar_null_char_, &code);
+    encoded_null_char_ = code(0);
+    lstm_dict_.SetupForLoad(nullptr);
+    lstm_dict_.LoadLSTM(lang.c_str(), &mgr);
+    return lstm_dict_.FinishLoad();
+  }
+
+  // Decodes output with the dictionary, and returns the best path.
+  void DecodeWithDict(const GENERIC_2D_ARRAY<float> &output, RecodeBeamSearch *beam_search,
+                      std::vector<int> *unichar_ids, std::vector<float> *certainties,
+                      std::vector<float> *ratings, std::vector<int> *xcoords) {
+    beam_search->Decode(output, 3.5, -0.125, -25.0, &ccutil_.unicharset);
+    beam_search->ExtractBestPathAsUnicharIds(false, &ccutil_.unicharset, unichar_ids,
+                                             certainties, ratings, xcoords);
+  }
+
   // Expects the appropriate results from the compressed_  ccutil_.unicharset.
   void ExpectCorrect(const GENERIC_2D_ARRAY<float> &output,
                      const std::vector<int> &transcription) {
@@ -427,6 +460,144 @@ TEST_F(RecodeBeamTest, DoesEnglish) {
   ExpectCorrect(outputs, transcription);
 }
 
+// Tests the beam width that each timestep gets from its top-1 margin.
+TEST_F(RecodeBeamTest, AdaptiveBeamWidth) {
+  RecodeBeamSearch search(recoder_, 0, false, nullptr);
+  // Until told otherwise, every timestep gets the fixed default width.
+  EXPECT_EQ(5, search.AdaptiveBeamWidth(1.0f));
+  EXPECT_EQ(5, search.AdaptiveBeamWidth(0.0f));
+
+  search.SetBeamWidthBounds(2, 8, 0.9f, 0.3f);
+  EXPECT_EQ(2, search.AdaptiveBeamWidth(1.0f));
+  EXPECT_EQ(2, search.AdaptiveBeamWidth(0.9f));
+  EXPECT_EQ(8, search.AdaptiveBeamWidth(0.3f));
+  EXPECT_EQ(8, search.AdaptiveBeamWidth(0.0f));
+  // Linear in between.
+  EXPECT_EQ(5, search.AdaptiveBeamWidth(0.6f));
+  EXPECT_EQ(3, search.AdaptiveBeamWidth(0.8f));
+  EXPECT_EQ(7, search.AdaptiveBeamWidth(0.4f));
+  int prev_width = search.AdaptiveBeamWidth(0.0f);
+  for (float margin = 0.0f; margin <= 1.0f; margin += 0.05f) {
+    int width = search.AdaptiveBeamWidth(margin);
+    EXPECT_LE(width, prev_width) << "margin=" << margin;
+    prev_width = width;
+  }
+
+  // Other margins move the interpolation.
+  search.SetBeamWidthBounds(2, 8, 0.5f, 0.1f);
+  EXPECT_EQ(2, search.AdaptiveBeamWidth(0.6f));
+  EXPECT_EQ(5, search.AdaptiveBeamWidth(0.3f));
+  EXPECT_EQ(8, search.AdaptiveBeamWidth(0.1f));
+  // A max below the min is raised to it.
+  search.SetBeamWidthBounds(6, 4);
+  EXPECT_EQ(6, search.AdaptiveBeamWidth(0.0f));
+  EXPECT_EQ(6, search.AdaptiveBeamWidth(1.0f));
+}
+
+// Tests that the symbol choices that LSTMLineChoices makes when first asked
+// for are the same as those of the beam search run in lstm_choice_mode.
+TEST_F(RecodeBeamTest, LazyChoicesMatchEagerOnes) {
+  LoadUnicharset("eng.unicharset");
+  GENERIC_2D_ARRAY<float> array =
+      GenerateSyntheticOutputs(kGWRTops, kGWRTopScores, kGWR2nds, kGWR2ndScores, nullptr);
+  NetworkIO outputs;
+  outputs.Resize2d(false, array.dim1(), array.dim2());
+  for (int t = 0; t < array.dim1(); ++t) {
+    std::copy(array[t], array[t] + array.dim2(), outputs.f(t));
+  }
+  const TBOX line_box(0, 0, 100, 10);
+  const int kChoiceAmount = 3;
+  for (int mode = 1; mode <= 2; ++mode) {
+    SCOPED_TRACE(mode);
+    RecodeBeamSearch eager(recoder_, encoded_null_char_, false, nullptr);
+    eager.Decode(outputs, 3.5, -0.125, -25.0, &ccutil_.unicharset, mode);
+    PointerVector<WERD_RES> words;
+    eager.ExtractBestPathAsWords(line_box, 1.0f, &ccutil_.unicharset, &words);
+    eager.extractSymbolChoices(&ccutil_.unicharset);
+    for (int i = 0; i < kChoiceAmount; ++i) {
+      eager.DecodeSecondaryBeams(outputs, 3.5, -0.125, -25.0, &ccutil_.unicharset);
+      eager.extractSymbolChoices(&ccutil_.unicharset);
+    }
+    eager.segmentTimestepsByCharacters();
+    ASSERT_FALSE(eager.ctc_choices.empty());
+    const int num_chars = eager.ctc_choices.size();
+
+    // RecognizeLine decodes without choices, and leaves them to LSTMLineChoices.
+    RecodeBeamSearch search(recoder_, encoded_null_char_, false, nullptr);
+    search.Decode(outputs, 3.5, -0.125, -25.0, &ccutil_.unicharset, 0);
+    search.ExtractBestPathAsWords(line_box, 1.0f, &ccutil_.unicharset, &words);
+    LSTMLineChoices lazy(recoder_, encoded_null_char_, false, nullptr, &ccutil_.unicharset, 0, 0,
+                         0, RecodeBeamSearch::kConfidentMargin,
+                         RecodeBeamSearch::kAmbiguousMargin, 3.5, -0.125, -25.0, mode,
+                         kChoiceAmount, outputs,
+                         search.character_boundaries_);
+    std::vector<std::vector<std::pair<const char *, float>>> choices;
+    std::vector<std::vector<std::vector<std::pair<const char *, float>>>> segments;
+    lazy.GetChoices(0, num_chars, &choices, &segments);
+    EXPECT_EQ(eager.ctc_choices, choices);
+    EXPECT_EQ(eager.segmentedTimesteps, segments);
+    // A word further along the line gets its own slice.
+    lazy.GetChoices(1, num_chars - 1, &choices, &segments);
+    ASSERT_EQ(static_cast<size_t>(num_chars - 1), choices.size());
+    EXPECT_EQ(eager.ctc_choices.back(), choices.back());
+
+    // Once detached from its recognizer, a source makes no more choices.
+    LSTMLineChoices detached(recoder_, encoded_null_char_, false, nullptr, &ccutil_.unicharset, 0,
+                             0, 0, RecodeBeamSearch::kConfidentMargin,
+                             RecodeBeamSearch::kAmbiguousMargin, 3.5, -0.125, -25.0, mode,
+                             kChoiceAmount, outputs,
+                             search.character_boundaries_);
+    detached.Detach();
+    detached.GetChoices(0, num_chars, &choices, &segments);
+    EXPECT_TRUE(choices.empty());
+    EXPECT_TRUE(segments.empty());
+  }
+}
+
+// The dawg vectors of a beam search are recycled from one line to the next.
+// A line decoded with a dictionary after another one must get exactly the same
+// result as from a new search, and decoding the lines again must not make the
+// pool allocate more vectors.
+TEST_F(RecodeBeamTest, DawgPoolIsReusedAcrossLines) {
+  if (!LoadLSTMModel("eng")) {
+    // eng.traineddata not found.
+    GTEST_SKIP();
+  }
+  TRand random;
+  GENERIC_2D_ARRAY<float> first_line =
+      GenerateSyntheticOutputs(kGWRTops, kGWRTopScores, kGWR2nds, kGWR2ndScores, nullptr);
+  GENERIC_2D_ARRAY<float> second_line =
+      GenerateSyntheticOutputs(kGWRTops, kGWRTopScores, kGWR2nds, kGWR2ndScores, &random);
+
+  RecodeBeamSearch fresh(recoder_, encoded_null_char_, false, &lstm_dict_);
+  std::vector<int> fresh_ids, fresh_xcoords;
+  std::vector<float> fresh_certainties, fresh_ratings;
+  DecodeWithDict(second_line, &fresh, &fresh_ids, &fresh_certainties, &fresh_ratings,
+                 &fresh_xcoords);
+  EXPECT_FALSE(fresh_ids.empty());
+
+  RecodeBeamSearch reused(recoder_, encoded_null_char_, false, &lstm_dict_);
+  std::vector<int> ids, xcoords;
+  std::vector<float> certainties, ratings;
+  size_t pool_size = 0;
+  for (int pass = 0; pass < 2; ++pass) {
+    SCOPED_TRACE(pass);
+    DecodeWithDict(first_line, &reused, &ids, &certainties, &ratings, &xcoords);
+    DecodeWithDict(second_line, &reused, &ids, &certainties, &ratings, &xcoords);
+    EXPECT_EQ(fresh_ids, ids);
+    EXPECT_EQ(fresh_certainties, certainties);
+    EXPECT_EQ(fresh_ratings, ratings);
+    EXPECT_EQ(fresh_xcoords, xcoords);
+    if (pass == 0) {
+      pool_size = reused.DawgPoolSize();
+      // The dictionary was used.
+      EXPECT_GT(pool_size, 0);
+    } else {
+      EXPECT_EQ(pool_size, reused.DawgPoolSize());
+    }
+  }
+}
+
 TEST_F(RecodeBeamTest, DISABLED_EngDictionary) {
   LOG(INFO) << "Testing eng dictionary"
             << "\n";
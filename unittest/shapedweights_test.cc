@@ -0,0 +1,174 @@
+///////////////////////////////////////////////////////////////////////
+// File:        shapedweights_test.cc
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include "shapedweights.h"
+#include <leptonica/allheaders.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "imagedata.h"
+#include "include_gunit.h"
+#include "intsimdmatrix.h"
+#include "lstmrecognizer.h"
+#include "network.h"
+#include "networkio.h"
+#include "tessdatamanager.h"
+
+#include "testdata.h"
+
+namespace tesseract {
+
+class ShapedWeightsTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::locale::global(std::locale(""));
+  }
+
+  // Loads eng.traineddata into mgr_ and makes its shaped weights component
+  // in shaped_data_. Returns false if either is not possible.
+  bool LoadEng() {
+    std::string traineddata = file::JoinPath(TESSDATA_DIR, "eng.traineddata");
+    return IntSimdMatrix::intSimdMatrix != nullptr && mgr_.Init(traineddata.c_str()) &&
+           ShapedWeights::Create(mgr_, &shaped_data_);
+  }
+
+  // Adds shaped_data_ to mgr_ as its shaped weights component.
+  void AddComponent() {
+    mgr_.OverwriteEntry(TESSDATA_LSTM_SHAPED_WEIGHTS, &shaped_data_[0],
+                        static_cast<int>(shaped_data_.size()));
+  }
+
+  // Deserializes the network of mgr_ while a ShapedWeights made from mgr_ is
+  // active. Sets *valid and *complete from it.
+  std::unique_ptr<Network> LoadNetwork(bool *valid, bool *complete) {
+    ShapedWeights shaped(mgr_);
+    TFile fp;
+    if (!mgr_.GetComponent(TESSDATA_LSTM, &fp)) {
+      return nullptr;
+    }
+    std::unique_ptr<Network> network(Network::CreateFromFile(&fp));
+    *valid = shaped.is_valid();
+    *complete = shaped.is_complete();
+    return network;
+  }
+
+  // Recognizes HelloGoogle.tif with a model loaded from mgr_, and returns
+  // the outputs of the network in *outputs.
+  void Recognize(NetworkIO *outputs) {
+    LSTMRecognizer recognizer;
+    ASSERT_TRUE(recognizer.Load(ParamsVectorSet(), "", &mgr_));
+    Image pix = pixRead(file::JoinPath(TESTING_DIR, "HelloGoogle.tif").c_str());
+    ASSERT_TRUE(pix != nullptr);
+    const TBOX line_box(0, 0, pixGetWidth(pix), pixGetHeight(pix));
+    ImageData image(false, pix);
+    float scale_factor;
+    NetworkIO inputs;
+    ASSERT_TRUE(recognizer.RecognizeLine(image, 0.7f, false, false, line_box, &scale_factor,
+                                         &inputs, outputs));
+  }
+
+  static void ExpectEqualOutputs(NetworkIO &a, NetworkIO &b) {
+    ASSERT_EQ(a.Width(), b.Width());
+    ASSERT_EQ(a.NumFeatures(), b.NumFeatures());
+    for (int t = 0; t < a.Width(); ++t) {
+      for (int i = 0; i < a.NumFeatures(); ++i) {
+        EXPECT_EQ(a.f(t)[i], b.f(t)[i]) << "t=" << t << " i=" << i;
+      }
+    }
+  }
+
+  TessdataManager mgr_;
+  std::vector<char> shaped_data_;
+};
+
+// A component made for the current IntSimdMatrix provides the weights of
+// every matrix of the model, which then recognizes as without it.
+TEST_F(ShapedWeightsTest, RoundTrip) {
+  if (!LoadEng()) {
+    // eng.traineddata not found, or no IntSimdMatrix.
+    GTEST_SKIP();
+  }
+  NetworkIO expected;
+  Recognize(&expected);
+  AddComponent();
+  bool valid, complete;
+  EXPECT_TRUE(LoadNetwork(&valid, &complete) != nullptr);
+  EXPECT_TRUE(valid);
+  EXPECT_TRUE(complete);
+  NetworkIO outputs;
+  Recognize(&outputs);
+  ExpectEqualOutputs(expected, outputs);
+}
+
+// A component made for another register geometry is ignored.
+TEST_F(ShapedWeightsTest, RejectsOtherGeometry) {
+  if (!LoadEng()) {
+    // eng.traineddata not found, or no IntSimdMatrix.
+    GTEST_SKIP();
+  }
+  AddComponent();
+  const IntSimdMatrix *matrix = IntSimdMatrix::intSimdMatrix;
+  IntSimdMatrix other = *matrix;
+  ++other.max_output_registers_;
+  IntSimdMatrix::intSimdMatrix = &other;
+  bool valid = true;
+  {
+    ShapedWeights shaped(mgr_);
+    valid = shaped.is_valid();
+  }
+  IntSimdMatrix::intSimdMatrix = matrix;
+  EXPECT_FALSE(valid);
+}
+
+// A component made from another lstm component is ignored, and the matrices
+// are shaped at load as without it.
+TEST_F(ShapedWeightsTest, FallsBackOnOtherModel) {
+  if (!LoadEng()) {
+    // eng.traineddata not found, or no IntSimdMatrix.
+    GTEST_SKIP();
+  }
+  NetworkIO expected;
+  Recognize(&expected);
+  // An extra byte at the end of the lstm component changes its checksum, but
+  // not the model.
+  const char *lstm_data;
+  size_t lstm_size;
+  std::shared_ptr<const void> owner;
+  ASSERT_TRUE(mgr_.GetComponentView(TESSDATA_LSTM, &lstm_data, &lstm_size, &owner));
+  std::vector<char> lstm(lstm_data, lstm_data + lstm_size);
+  lstm.push_back(0);
+  mgr_.OverwriteEntry(TESSDATA_LSTM, &lstm[0], static_cast<int>(lstm.size()));
+  AddComponent();
+  bool valid, complete;
+  EXPECT_TRUE(LoadNetwork(&valid, &complete) != nullptr);
+  EXPECT_FALSE(valid);
+  EXPECT_FALSE(complete);
+  NetworkIO outputs;
+  Recognize(&outputs);
+  ExpectEqualOutputs(expected, outputs);
+}
+
+// A truncated component is ignored.
+TEST_F(ShapedWeightsTest, RejectsTruncated) {
+  if (!LoadEng()) {
+    // eng.traineddata not found, or no IntSimdMatrix.
+    GTEST_SKIP();
+  }
+  shaped_data_.resize(shaped_data_.size() - 1);
+  AddComponent();
+  ShapedWeights shaped(mgr_);
+  EXPECT_FALSE(shaped.is_valid());
+}
+
+} // namespace tesseract
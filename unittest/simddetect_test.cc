@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////
+// File:        simddetect_test.cc
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include "simddetect.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "include_gunit.h"
+
+namespace tesseract {
+
+class SIMDDetectTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::locale::global(std::locale(""));
+    cache_file_ = file::JoinPath(FLAGS_test_tmpdir, "simd-autotune.txt");
+    std::remove(cache_file_.c_str());
+  }
+  void TearDown() override {
+    std::remove(cache_file_.c_str());
+  }
+
+  // Returns the lines of the cache file.
+  std::vector<std::string> CacheLines() const {
+    std::vector<std::string> lines;
+    std::ifstream in(cache_file_);
+    std::string line;
+    while (std::getline(in, line)) {
+      lines.push_back(line);
+    }
+    return lines;
+  }
+
+  std::string cache_file_;
+};
+
+// Entries are found by their whole key, and a new choice for a key replaces
+// the old one instead of piling up.
+TEST_F(SIMDDetectTest, CacheEntries) {
+  EXPECT_EQ("", SIMDDetect::ReadAutotuneCache(cache_file_, "cpu|8|16x32i*2"));
+  EXPECT_TRUE(SIMDDetect::WriteAutotuneCache(cache_file_, "cpu|8|16x32i*2", "avx2"));
+  EXPECT_TRUE(SIMDDetect::WriteAutotuneCache(cache_file_, "cpu|8|16x32i*2|8x16f*1", "sse"));
+  EXPECT_TRUE(SIMDDetect::WriteAutotuneCache(cache_file_, "cpu|8|16x32i*2", "avx512"));
+  EXPECT_EQ("avx512", SIMDDetect::ReadAutotuneCache(cache_file_, "cpu|8|16x32i*2"));
+  EXPECT_EQ("sse", SIMDDetect::ReadAutotuneCache(cache_file_, "cpu|8|16x32i*2|8x16f*1"));
+  // Neither a prefix nor an extension of a key matches it.
+  EXPECT_EQ("", SIMDDetect::ReadAutotuneCache(cache_file_, "cpu|8"));
+  EXPECT_EQ("", SIMDDetect::ReadAutotuneCache(cache_file_, "cpu|8|16x32i*2|"));
+  EXPECT_EQ(2u, CacheLines().size());
+}
+
+// Lines that aren't entries are ignored, and dropped when the file is
+// rewritten.
+TEST_F(SIMDDetectTest, CacheIgnoresGarbage) {
+  {
+    std::ofstream out(cache_file_);
+    out << "no tab here\n\ncpu|8|16x32i*2\tfma\n";
+  }
+  EXPECT_EQ("fma", SIMDDetect::ReadAutotuneCache(cache_file_, "cpu|8|16x32i*2"));
+  EXPECT_EQ("", SIMDDetect::ReadAutotuneCache(cache_file_, "no tab here"));
+  EXPECT_TRUE(SIMDDetect::WriteAutotuneCache(cache_file_, "other", "sse"));
+  std::vector<std::string> expected = {"cpu|8|16x32i*2\tfma", "other\tsse"};
+  EXPECT_EQ(expected, CacheLines());
+}
+
+// The key depends on the counts of the distinct shapes, not on their order.
+TEST_F(SIMDDetectTest, CacheKey) {
+  MatrixShape a = {16, 32, true};
+  MatrixShape b = {8, 16, false};
+  EXPECT_EQ(SIMDDetect::AutotuneCacheKey({a, b}), SIMDDetect::AutotuneCacheKey({b, a}));
+  EXPECT_NE(SIMDDetect::AutotuneCacheKey({a}), SIMDDetect::AutotuneCacheKey({a, a}));
+  EXPECT_NE(SIMDDetect::AutotuneCacheKey({a}), SIMDDetect::AutotuneCacheKey({b}));
+  MatrixShape float_a = {16, 32, false};
+  EXPECT_NE(SIMDDetect::AutotuneCacheKey({a}), SIMDDetect::AutotuneCacheKey({float_a}));
+}
+
+// The measured choice is one of the available ones, and is cached.
+TEST_F(SIMDDetectTest, ChoiceIsMeasuredAndCached) {
+  std::vector<MatrixShape> shapes = {{16, 32, true}, {16, 32, true}, {8, 16, false}};
+  std::vector<std::string> choices = SIMDDetect::AutotuneChoices(shapes);
+  std::string choice = SIMDDetect::AutotuneChoice(shapes, cache_file_);
+  if (choices.empty()) {
+    EXPECT_EQ("", choice);
+    // No SIMD implementation to choose from on this host.
+    GTEST_SKIP();
+  }
+  EXPECT_NE(choices.end(), std::find(choices.begin(), choices.end(), choice));
+  std::string key = SIMDDetect::AutotuneCacheKey(shapes);
+  EXPECT_EQ(choice, SIMDDetect::ReadAutotuneCache(cache_file_, key));
+  EXPECT_EQ(1u, CacheLines().size());
+  // Measuring again for the same shapes only rewrites the entry.
+  SIMDDetect::WriteAutotuneCache(cache_file_, key, "unavailable");
+  choice = SIMDDetect::AutotuneChoice(shapes, cache_file_);
+  EXPECT_NE(choices.end(), std::find(choices.begin(), choices.end(), choice));
+  EXPECT_EQ(choice, SIMDDetect::ReadAutotuneCache(cache_file_, key));
+  EXPECT_EQ(1u, CacheLines().size());
+}
+
+// An available choice in the cache is taken without measuring.
+TEST_F(SIMDDetectTest, CachedChoiceIsTaken) {
+  std::vector<MatrixShape> shapes = {{16, 32, false}};
+  std::vector<std::string> choices = SIMDDetect::AutotuneChoices(shapes);
+  if (choices.empty()) {
+    // No SIMD implementation to choose from on this host.
+    GTEST_SKIP();
+  }
+  std::string key = SIMDDetect::AutotuneCacheKey(shapes);
+  for (const auto &cached : choices) {
+    SIMDDetect::WriteAutotuneCache(cache_file_, key, cached);
+    EXPECT_EQ(cached, SIMDDetect::AutotuneChoice(shapes, cache_file_));
+  }
+  // An int model needs an IntSimdMatrix, which not all of them have.
+  std::vector<MatrixShape> int_shapes = {{16, 32, true}};
+  std::vector<std::string> int_choices = SIMDDetect::AutotuneChoices(int_shapes);
+  EXPECT_LE(int_choices.size(), choices.size());
+  // Without a cache file, the choice is still made.
+  if (!int_choices.empty()) {
+    std::string choice = SIMDDetect::AutotuneChoice(int_shapes, "");
+    EXPECT_NE(int_choices.end(), std::find(int_choices.begin(), int_choices.end(), choice));
+  }
+}
+
+} // namespace tesseract
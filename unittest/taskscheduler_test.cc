@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////
+// File:        taskscheduler_test.cc
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include "taskscheduler.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "include_gunit.h"
+
+namespace tesseract {
+
+class TaskSchedulerTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::locale::global(std::locale(""));
+    TaskScheduler::SetProcessThreadBudget(kProcessBudget);
+  }
+  void TearDown() override {
+    TaskScheduler::SetProcessThreadBudget(0);
+  }
+
+  // Runs a loop of size n on the scheduler and checks that every index is
+  // visited exactly once, with valid slots.
+  static void ExpectCompleteLoop(const TaskScheduler &scheduler, int n) {
+    std::vector<std::atomic<int>> visits(n);
+    std::atomic<bool> slots_valid(true);
+    scheduler.ParallelFor(n, [&](int slot, int start, int end) {
+      if (slot < 0 || slot >= scheduler.MaxConcurrency()) {
+        slots_valid = false;
+      }
+      for (int i = start; i < end; ++i) {
+        ++visits[i];
+      }
+    });
+    EXPECT_TRUE(slots_valid);
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(1, visits[i]) << "i=" << i;
+    }
+  }
+
+  static const int kProcessBudget = 4;
+};
+
+TEST_F(TaskSchedulerTest, Budgets) {
+  EXPECT_EQ(kProcessBudget, TaskScheduler::ProcessThreadBudget());
+  EXPECT_EQ(kProcessBudget, TaskScheduler().MaxConcurrency());
+  EXPECT_EQ(2, TaskScheduler(2).MaxConcurrency());
+  EXPECT_EQ(kProcessBudget, TaskScheduler(100).MaxConcurrency());
+  EXPECT_EQ(1, TaskScheduler(1).MaxConcurrency());
+}
+
+TEST_F(TaskSchedulerTest, CoversAllIndices) {
+  for (int n = 0; n < 50; ++n) {
+    ExpectCompleteLoop(TaskScheduler(), n);
+    ExpectCompleteLoop(TaskScheduler(1), n);
+  }
+}
+
+// Nested loops and several engines competing for the workers must neither
+// deadlock nor lose work.
+TEST_F(TaskSchedulerTest, NestedAndConcurrent) {
+  std::vector<std::thread> engines;
+  for (int e = 0; e < 8; ++e) {
+    engines.emplace_back([]() {
+      TaskScheduler scheduler(2);
+      for (int i = 0; i < 100; ++i) {
+        std::atomic<int> total(0);
+        scheduler.ParallelFor(10, [&](int, int start, int end) {
+          TaskScheduler().ParallelFor(end - start, [&](int, int from, int to) { total += to - from; });
+        });
+        EXPECT_EQ(10, total);
+      }
+    });
+  }
+  for (auto &engine : engines) {
+    engine.join();
+  }
+}
+
+} // namespace tesseract
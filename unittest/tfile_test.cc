@@ -167,6 +167,29 @@ TEST_F(TfileTest, Serialize) {
   m1.ExpectEq(m3);
 }
 
+TEST_F(TfileTest, OpenView) {
+  // This test verifies that Tfile can read from a buffer it does not own,
+  // and keeps that buffer alive through its owner.
+  MathData m1;
+  m1.Setup();
+  auto data = std::make_shared<std::vector<char>>();
+  TFile fpw;
+  fpw.OpenWrite(data.get());
+  EXPECT_TRUE(m1.Serialize(&fpw));
+  TFile fpr;
+  EXPECT_TRUE(fpr.OpenView(data->data(), data->size(), data));
+  std::weak_ptr<std::vector<char>> weak_data = data;
+  data.reset();
+  EXPECT_FALSE(weak_data.expired());
+  MathData m2;
+  EXPECT_TRUE(m2.DeSerialize(&fpr));
+  m1.ExpectEq(m2);
+  fpr.Rewind();
+  MathData m3;
+  EXPECT_TRUE(m3.DeSerialize(&fpr));
+  m1.ExpectEq(m3);
+}
+
 TEST_F(TfileTest, FGets) {
   // This test verifies that Tfile can interleave FGets with binary data.
   MathData m1;
@@ -0,0 +1,248 @@
+///////////////////////////////////////////////////////////////////////
+// File:        weightmatrix_test.cc
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+///////////////////////////////////////////////////////////////////////
+
+#include "weightmatrix.h"
+#include <vector>
+#include "gradients.h"
+#include "helpers.h"
+#include "include_gunit.h"
+#include "intsimdmatrix.h"
+#include "simddetect.h"
+#include "taskscheduler.h"
+
+namespace tesseract {
+
+class WeightMatrixTest : public ::testing::Test {
+protected:
+  static const int kNumOutputs = 23;
+  static const int kNumInputs = 37;
+  // The column at which the matrix is split in two.
+  static const int kSplit = 13;
+
+  void SetUp() override {
+    std::locale::global(std::locale(""));
+    matrix_.InitWeightsFloat(kNumOutputs, kNumInputs + 1, false, 1.0f, &random_);
+  }
+
+  // Returns the size of an output vector for matrix_.
+  int RoundedOutputs() const {
+    if (matrix_.is_int_mode() && IntSimdMatrix::intSimdMatrix) {
+      return IntSimdMatrix::intSimdMatrix->RoundOutputs(kNumOutputs);
+    }
+    return kNumOutputs;
+  }
+
+  WeightMatrix matrix_;
+  TRand random_;
+};
+
+// The products of the column slices of a float matrix add up to the product
+// of the whole matrix.
+TEST_F(WeightMatrixTest, FloatColumnSlices) {
+  std::vector<TFloat> u(kNumInputs);
+  for (auto &value : u) {
+    value = random_.SignedRand(1.0);
+  }
+  WeightMatrix head, tail;
+  head.InitFromColumns(matrix_, 0, kSplit, true);
+  tail.InitFromColumns(matrix_, kSplit, kNumInputs, false);
+  EXPECT_EQ(kNumOutputs, head.NumOutputs());
+  EXPECT_EQ(kNumOutputs, tail.NumOutputs());
+  std::vector<TFloat> whole(kNumOutputs), head_part(kNumOutputs), tail_part(kNumOutputs);
+  matrix_.MatrixDotVector(u.data(), whole.data());
+  head.MatrixDotVector(u.data(), head_part.data());
+  tail.MatrixDotVector(u.data() + kSplit, tail_part.data());
+  for (int i = 0; i < kNumOutputs; ++i) {
+    EXPECT_NEAR(whole[i], head_part[i] + tail_part[i], 1e-5) << "i=" << i;
+  }
+}
+
+// As FloatColumnSlices, but for an int matrix, whose row scales must carry
+// over to both slices.
+TEST_F(WeightMatrixTest, IntColumnSlices) {
+  matrix_.ConvertToInt();
+  WeightMatrix head, tail;
+  head.InitFromColumns(matrix_, 0, kSplit, true);
+  tail.InitFromColumns(matrix_, kSplit, kNumInputs, false);
+  EXPECT_TRUE(head.is_int_mode());
+  EXPECT_TRUE(tail.is_int_mode());
+  // Inputs are padded as required by the SIMD implementation.
+  std::vector<int8_t> u(matrix_.RoundInputs(kNumInputs), 0);
+  std::vector<int8_t> head_u(head.RoundInputs(kSplit), 0);
+  std::vector<int8_t> tail_u(tail.RoundInputs(kNumInputs - kSplit), 0);
+  for (int i = 0; i < kNumInputs; ++i) {
+    u[i] = static_cast<int8_t>(random_.SignedRand(INT8_MAX));
+    if (i < kSplit) {
+      head_u[i] = u[i];
+    } else {
+      tail_u[i - kSplit] = u[i];
+    }
+  }
+  int ro = RoundedOutputs();
+  std::vector<TFloat> whole(ro), head_part(ro), tail_part(ro);
+  matrix_.MatrixDotVector(u.data(), whole.data());
+  head.MatrixDotVector(head_u.data(), head_part.data());
+  tail.MatrixDotVector(tail_u.data(), tail_part.data());
+  for (int i = 0; i < kNumOutputs; ++i) {
+    EXPECT_NEAR(whole[i], head_part[i] + tail_part[i], 1e-4) << "i=" << i;
+  }
+}
+
+// The blocked outer product sums match a plain sum over all the samples, both
+// serially and on the threads of a scheduler, for a number of rows that is
+// not a multiple of the row block and more samples than a sample block.
+TEST_F(WeightMatrixTest, SumOuterTransposed) {
+  const int kNumSamples = 601;
+  matrix_.InitBackward();
+  TransposedArray u, v;
+  u.Resize(kNumOutputs, kNumSamples, 0.0);
+  v.Resize(kNumInputs, kNumSamples, 0.0);
+  for (int k = 0; k < kNumSamples; ++k) {
+    for (int i = 0; i < kNumOutputs; ++i) {
+      u.put(i, k, random_.SignedRand(1.0));
+    }
+    for (int j = 0; j < kNumInputs; ++j) {
+      v.put(j, k, random_.SignedRand(1.0));
+    }
+  }
+  for (const TaskScheduler *scheduler : {static_cast<const TaskScheduler *>(nullptr),
+                                         &TaskScheduler::Default()}) {
+    matrix_.SumOuterTransposed(u, v, scheduler);
+    for (int i = 0; i < kNumOutputs; ++i) {
+      for (int j = 0; j <= kNumInputs; ++j) {
+        double total = 0.0;
+        for (int k = 0; k < kNumSamples; ++k) {
+          total += u(i, k) * (j < kNumInputs ? v(j, k) : 1.0);
+        }
+        EXPECT_NEAR(total, matrix_.GetDW(i, j), 1e-3) << "i=" << i << " j=" << j;
+      }
+    }
+  }
+}
+
+// The summed deltas of replicas that share the weights of a matrix, each
+// with the outer products of a different sample, give the same update as the
+// deltas of the samples computed one after the other and added up.
+TEST_F(WeightMatrixTest, SumDeltasOfReplicas) {
+  const int kNumReplicas = 4;
+  const int kNumTimesteps = 17;
+  const uint64_t kSeed = 4242;
+  const float kLearningRate = 1e-3f;
+  const float kMomentum = 0.5f;
+  WeightMatrix master, sequential, sample_deltas;
+  for (auto *matrix : {&master, &sequential, &sample_deltas}) {
+    TRand randomizer;
+    randomizer.set_seed(kSeed);
+    matrix->InitWeightsFloat(kNumOutputs, kNumInputs + 1, false, 1.0f, &randomizer);
+    matrix->InitBackward();
+  }
+  std::vector<WeightMatrix> replicas(kNumReplicas);
+  std::vector<const WeightMatrix *> replica_ptrs;
+  for (int r = 0; r < kNumReplicas; ++r) {
+    TransposedArray u, v;
+    u.Resize(kNumOutputs, kNumTimesteps, 0.0);
+    v.Resize(kNumInputs, kNumTimesteps, 0.0);
+    for (int k = 0; k < kNumTimesteps; ++k) {
+      for (int i = 0; i < kNumOutputs; ++i) {
+        u.put(i, k, random_.SignedRand(1.0));
+      }
+      for (int j = 0; j < kNumInputs; ++j) {
+        v.put(j, k, random_.SignedRand(1.0));
+      }
+    }
+    replicas[r].ShareWeights(master);
+    replicas[r].SumOuterTransposed(u, v, nullptr);
+    replica_ptrs.push_back(&replicas[r]);
+    if (r == 0) {
+      sequential.SumOuterTransposed(u, v, nullptr);
+    } else {
+      sample_deltas.SumOuterTransposed(u, v, nullptr);
+      sequential.AddDeltas(sample_deltas);
+    }
+  }
+  master.SumDeltas(replica_ptrs);
+  for (int i = 0; i < kNumOutputs; ++i) {
+    for (int j = 0; j <= kNumInputs; ++j) {
+      EXPECT_NEAR(sequential.GetDW(i, j), master.GetDW(i, j), 1e-4) << "i=" << i << " j=" << j;
+    }
+  }
+  master.Update(kLearningRate, kMomentum, 0.0f, 1);
+  sequential.Update(kLearningRate, kMomentum, 0.0f, 1);
+  for (int i = 0; i < kNumOutputs; ++i) {
+    const TFloat *master_row = master.GetWeights(i);
+    const TFloat *sequential_row = sequential.GetWeights(i);
+    for (int j = 0; j <= kNumInputs; ++j) {
+      EXPECT_NEAR(sequential_row[j], master_row[j], 1e-6) << "i=" << i << " j=" << j;
+    }
+  }
+}
+
+
+// The vectorized training kernels give the results of the generic ones, for
+// a length that leaves a scalar tail. They only differ if the compiler fuses
+// some of the multiplies and adds.
+TEST_F(WeightMatrixTest, GradientKernelsMatchGeneric) {
+  const int kLength = 1003;
+  struct Kernels {
+    const char *name;
+    bool available;
+    DotProduct4Function dot_product4;
+    AdamStepFunction adam_step;
+  };
+  const Kernels kKernels[] = {
+      {"avx2", SIMDDetect::IsAVX2Available(), DotProduct4AVX2, AdamStepAVX2},
+      {"neon", SIMDDetect::IsNEONAvailable(), DotProduct4NEON, AdamStepNEON}};
+  std::vector<TFloat> rows[4], v(kLength);
+  for (auto &row : rows) {
+    row.resize(kLength);
+    for (auto &value : row) {
+      value = random_.SignedRand(1.0);
+    }
+  }
+  for (auto &value : v) {
+    value = random_.SignedRand(1.0);
+  }
+  const TFloat *u[4] = {rows[0].data(), rows[1].data(), rows[2].data(), rows[3].data()};
+  TFloat expected_sums[4];
+  DotProduct4Generic(u, v.data(), kLength, expected_sums);
+  std::vector<TFloat> dw(rows[0]), dw_sq_sum(kLength), updates(rows[1]), w(rows[2]);
+  for (auto &value : dw_sq_sum) {
+    value = 0.5 + random_.UnsignedRand(1.0);
+  }
+  std::vector<TFloat> expected_dw(dw), expected_dw_sq_sum(dw_sq_sum);
+  std::vector<TFloat> expected_updates(updates), expected_w(w);
+  AdamStepGeneric(kLength, 0.999, 0.5, 0.9, 1e-8, expected_dw.data(), expected_dw_sq_sum.data(),
+                  expected_updates.data(), expected_w.data());
+  for (const auto &kernels : kKernels) {
+    if (!kernels.available || kernels.dot_product4 == nullptr) {
+      continue;
+    }
+    TFloat sums[4];
+    kernels.dot_product4(u, v.data(), kLength, sums);
+    for (int r = 0; r < 4; ++r) {
+      EXPECT_NEAR(expected_sums[r], sums[r], 1e-4) << kernels.name << " r=" << r;
+    }
+    std::vector<TFloat> k_dw(dw), k_dw_sq_sum(dw_sq_sum), k_updates(updates), k_w(w);
+    kernels.adam_step(kLength, 0.999, 0.5, 0.9, 1e-8, k_dw.data(), k_dw_sq_sum.data(),
+                      k_updates.data(), k_w.data());
+    for (int i = 0; i < kLength; ++i) {
+      EXPECT_NEAR(expected_dw[i], k_dw[i], 1e-6) << kernels.name << " i=" << i;
+      EXPECT_NEAR(expected_dw_sq_sum[i], k_dw_sq_sum[i], 1e-6) << kernels.name << " i=" << i;
+      EXPECT_NEAR(expected_updates[i], k_updates[i], 1e-6) << kernels.name << " i=" << i;
+      EXPECT_NEAR(expected_w[i], k_w[i], 1e-4) << kernels.name << " i=" << i;
+    }
+  }
+}
+
+} // namespace tesseract